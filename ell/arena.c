@@ -0,0 +1,283 @@
+/*
+ *
+ *  Embedded Linux library
+ *
+ *  Copyright (C) 2019  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "util.h"
+#include "arena.h"
+#include "private.h"
+
+/**
+ * SECTION:arena
+ * @short_description: Region based allocator
+ *
+ * Region based allocator
+ */
+
+#define ARENA_ALIGN		16
+#define ARENA_MIN_BLOCK_SIZE	256
+
+struct arena_block {
+	struct arena_block *next;
+};
+
+#define ARENA_BLOCK_HEADER_SIZE	\
+	align_len(sizeof(struct arena_block), ARENA_ALIGN)
+
+/**
+ * l_arena:
+ *
+ * Opaque object representing a memory region.  All memory handed out by
+ * the region is released at once when the region is freed or reset.
+ */
+struct l_arena {
+	uint8_t *pos;
+	uint8_t *end;
+	size_t block_size;
+	struct arena_block *blocks;
+};
+
+#define ARENA_HEADER_SIZE	align_len(sizeof(struct l_arena), ARENA_ALIGN)
+
+static inline uint8_t *arena_first(struct l_arena *arena)
+{
+	return (uint8_t *) arena + ARENA_HEADER_SIZE;
+}
+
+static void *arena_grow(struct l_arena *arena, size_t size)
+{
+	struct arena_block *block;
+	uint8_t *ptr;
+
+	/* Oversized requests get a block of their own */
+	if (size > arena->block_size) {
+		block = l_malloc(ARENA_BLOCK_HEADER_SIZE + size);
+		block->next = arena->blocks;
+		arena->blocks = block;
+
+		return (uint8_t *) block + ARENA_BLOCK_HEADER_SIZE;
+	}
+
+	block = l_malloc(ARENA_BLOCK_HEADER_SIZE + arena->block_size);
+	block->next = arena->blocks;
+	arena->blocks = block;
+
+	ptr = (uint8_t *) block + ARENA_BLOCK_HEADER_SIZE;
+	arena->pos = ptr + size;
+	arena->end = ptr + arena->block_size;
+
+	return ptr;
+}
+
+static void *arena_alloc(struct l_arena *arena, size_t size, size_t align)
+{
+	uint8_t *ptr;
+
+	ptr = (uint8_t *) align_len((uintptr_t) arena->pos, align);
+
+	if (ptr > arena->end || (size_t) (arena->end - ptr) < size)
+		return arena_grow(arena, size);
+
+	arena->pos = ptr + size;
+
+	return ptr;
+}
+
+/**
+ * l_arena_new:
+ * @size: Number of bytes expected to be allocated from the region
+ *
+ * Creates a new memory region.  The region object and the first @size
+ * bytes of memory are obtained with a single heap allocation, so objects
+ * whose members all live in one region can be freed with a single call
+ * to l_arena_free().  Allocations beyond @size transparently add further
+ * blocks to the region.
+ *
+ * Returns: A newly allocated #l_arena object.
+ **/
+LIB_EXPORT struct l_arena *l_arena_new(size_t size)
+{
+	struct l_arena *arena;
+
+	if (size < ARENA_MIN_BLOCK_SIZE)
+		size = ARENA_MIN_BLOCK_SIZE;
+
+	size = align_len(size, ARENA_ALIGN);
+
+	arena = l_malloc(ARENA_HEADER_SIZE + size);
+	arena->block_size = size;
+	arena->blocks = NULL;
+	arena->pos = arena_first(arena);
+	arena->end = arena->pos + size;
+
+	return arena;
+}
+
+/**
+ * l_arena_reset:
+ * @arena: Region object
+ *
+ * Releases all memory allocated from @arena at once, keeping the region
+ * itself available for further allocations.
+ **/
+LIB_EXPORT void l_arena_reset(struct l_arena *arena)
+{
+	if (unlikely(!arena))
+		return;
+
+	while (arena->blocks) {
+		struct arena_block *block = arena->blocks;
+
+		arena->blocks = block->next;
+		l_free(block);
+	}
+
+	arena->pos = arena_first(arena);
+	arena->end = arena->pos + arena->block_size;
+}
+
+/**
+ * l_arena_free:
+ * @arena: Region object
+ *
+ * Frees @arena along with all memory allocated from it.
+ **/
+LIB_EXPORT void l_arena_free(struct l_arena *arena)
+{
+	if (unlikely(!arena))
+		return;
+
+	l_arena_reset(arena);
+	l_free(arena);
+}
+
+/**
+ * l_arena_alloc:
+ * @arena: Region object
+ * @size: Number of bytes to allocate
+ *
+ * Allocates @size bytes from @arena.  The memory is suitably aligned for
+ * any kind of variable and remains valid until @arena is reset or freed.
+ * The memory is not initialized.
+ *
+ * Returns: A pointer to the allocated memory.
+ **/
+LIB_EXPORT void *l_arena_alloc(struct l_arena *arena, size_t size)
+{
+	if (unlikely(!arena))
+		return NULL;
+
+	return arena_alloc(arena, size, ARENA_ALIGN);
+}
+
+/**
+ * l_arena_alloc0:
+ * @arena: Region object
+ * @size: Number of bytes to allocate
+ *
+ * Same as l_arena_alloc() but the memory is set to zero.
+ *
+ * Returns: A pointer to the allocated memory.
+ **/
+LIB_EXPORT void *l_arena_alloc0(struct l_arena *arena, size_t size)
+{
+	void *ptr = l_arena_alloc(arena, size);
+
+	if (ptr)
+		memset(ptr, 0, size);
+
+	return ptr;
+}
+
+/**
+ * l_arena_memdup:
+ * @arena: Region object
+ * @mem: pointer to memory you want to duplicate
+ * @size: size of memory you want to duplicate
+ *
+ * Duplicates @size bytes of @mem into memory allocated from @arena.
+ *
+ * Returns: A pointer to the copy.
+ **/
+LIB_EXPORT void *l_arena_memdup(struct l_arena *arena,
+					const void *mem, size_t size)
+{
+	void *ptr;
+
+	if (unlikely(!arena))
+		return NULL;
+
+	ptr = arena_alloc(arena, size, ARENA_ALIGN);
+	memcpy(ptr, mem, size);
+
+	return ptr;
+}
+
+/**
+ * l_arena_strndup:
+ * @arena: Region object
+ * @str: string pointer
+ * @max: Maximum number of characters to copy
+ *
+ * Copies up to @max characters of @str into memory allocated from @arena.
+ * The copy is always NUL terminated.
+ *
+ * Returns: A pointer to the copy or NULL if @str is NULL.
+ **/
+LIB_EXPORT char *l_arena_strndup(struct l_arena *arena,
+					const char *str, size_t max)
+{
+	char *ptr;
+	size_t len;
+
+	if (unlikely(!arena || !str))
+		return NULL;
+
+	len = strnlen(str, max);
+
+	ptr = arena_alloc(arena, len + 1, 1);
+	memcpy(ptr, str, len);
+	ptr[len] = '\0';
+
+	return ptr;
+}
+
+/**
+ * l_arena_strdup:
+ * @arena: Region object
+ * @str: string pointer
+ *
+ * Copies @str into memory allocated from @arena.
+ *
+ * Returns: A pointer to the copy or NULL if @str is NULL.
+ **/
+LIB_EXPORT char *l_arena_strdup(struct l_arena *arena, const char *str)
+{
+	if (unlikely(!str))
+		return NULL;
+
+	return l_arena_strndup(arena, str, strlen(str));
+}
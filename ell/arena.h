@@ -0,0 +1,48 @@
+/*
+ *
+ *  Embedded Linux library
+ *
+ *  Copyright (C) 2019  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __ELL_ARENA_H
+#define __ELL_ARENA_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct l_arena;
+
+struct l_arena *l_arena_new(size_t size);
+void l_arena_free(struct l_arena *arena);
+void l_arena_reset(struct l_arena *arena);
+
+void *l_arena_alloc(struct l_arena *arena, size_t size);
+void *l_arena_alloc0(struct l_arena *arena, size_t size);
+void *l_arena_memdup(struct l_arena *arena, const void *mem, size_t size);
+char *l_arena_strdup(struct l_arena *arena, const char *str);
+char *l_arena_strndup(struct l_arena *arena, const char *str, size_t max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ELL_ARENA_H */
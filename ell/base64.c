@@ -24,84 +24,224 @@
 
 #include <stdint.h>
 
-#include "utf8.h"
+#include "util.h"
 #include "base64.h"
 #include "private.h"
 
-LIB_EXPORT uint8_t *l_base64_decode(const char *in, size_t in_len,
-					size_t *n_written)
+#define B64_SPACE	0x40
+#define B64_PAD		0x41
+#define B64_INVALID	0xff
+
+/*
+ * Maps every character to its six bit value, or to one of the B64_ codes
+ * above.  Whitespace is the same set that l_ascii_isspace() accepts.
+ */
+static const uint8_t decode_table[256] = {
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0x40, 0x40, 0x40, 0x40, 0x40, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0x40, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0x3e, 0xff, 0xff, 0xff, 0x3f,
+	0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b,
+	0x3c, 0x3d, 0xff, 0xff, 0xff, 0x41, 0xff, 0xff,
+	0xff, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+	0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+	0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
+	0x17, 0x18, 0x19, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20,
+	0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+	0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30,
+	0x31, 0x32, 0x33, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+};
+
+static const char encode_table[64] =
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+enum decoder_state {
+	DECODER_DATA,
+	DECODER_PADDING,
+	DECODER_DONE,
+	DECODER_ERROR,
+};
+
+struct l_base64_decoder {
+	uint32_t reg;
+	uint8_t count;
+	uint8_t pad;
+	enum decoder_state state;
+};
+
+/* Writes out what is left of a quad once its padding is complete */
+static size_t decoder_flush(struct l_base64_decoder *decoder, uint8_t *out)
 {
-	const char *ptr, *in_end = in + in_len;
-	uint8_t *out_buf, *out;
-	int base64_len = 0, pad_len;
-	uint16_t reg = 0;
-
-	for (ptr = in; ptr < in_end; ptr++)
-		if (l_ascii_isspace(*ptr))
-			/* Whitespace */
-			continue;
-		else if (*ptr == '=')
-			/* Final padding */
+	decoder->state = DECODER_DONE;
+
+	if (decoder->count == 2) {
+		out[0] = decoder->reg >> 4;
+		return 1;
+	}
+
+	if (decoder->count == 3) {
+		out[0] = decoder->reg >> 10;
+		out[1] = decoder->reg >> 2;
+		return 2;
+	}
+
+	return 0;
+}
+
+/*
+ * Decodes as much of @in as possible into @out.  Whitespace is skipped
+ * anywhere, the first '=' starts the padding and anything following a
+ * complete padding is ignored.
+ */
+static size_t decoder_feed(struct l_base64_decoder *decoder,
+				const uint8_t *in, size_t in_len, uint8_t *out)
+{
+	const uint8_t *end = in + in_len;
+	uint8_t *start = out;
+
+	while (in < end) {
+		uint8_t v;
+
+		if (decoder->state == DECODER_DONE ||
+				decoder->state == DECODER_ERROR)
 			break;
-		else if (l_ascii_isalnum(*ptr) || *ptr == '+' || *ptr == '/')
-			/* Base64 character */
-			base64_len++;
-		else
-			/* Bad character */
-			return NULL;
 
-	in_end = ptr;
+		/* Whole quads of data without whitespace in between */
+		if (decoder->state == DECODER_DATA && !decoder->count) {
+			while (end - in >= 4) {
+				uint32_t a = decode_table[in[0]];
+				uint32_t b = decode_table[in[1]];
+				uint32_t c = decode_table[in[2]];
+				uint32_t d = decode_table[in[3]];
+				uint32_t reg;
 
-	if ((base64_len & 3) == 1)
-		/* Invalid length */
-		return NULL;
+				if ((a | b | c | d) & 0xc0)
+					break;
+
+				reg = (a << 18) | (b << 12) | (c << 6) | d;
+				out[0] = reg >> 16;
+				out[1] = reg >> 8;
+				out[2] = reg;
 
-	pad_len = (4 - base64_len) & 3;
-	for (; ptr < in + in_len && pad_len; ptr++)
-		if (l_ascii_isspace(*ptr))
-			/* Whitespace */
+				out += 3;
+				in += 4;
+			}
+
+			if (in == end)
+				break;
+		}
+
+		v = decode_table[*in++];
+
+		if (v == B64_SPACE)
 			continue;
-		else if (*ptr == '=')
-			/* Final padding */
-			pad_len--;
-		else
-			/* Bad character */
-			return NULL;
-	if (pad_len)
-		return NULL;
 
-	*n_written = base64_len * 3 / 4;
-	out_buf = l_malloc(*n_written);
+		if (decoder->state == DECODER_PADDING) {
+			if (v != B64_PAD) {
+				decoder->state = DECODER_ERROR;
+				break;
+			}
 
-	out = out_buf;
-	base64_len = 0;
+			if (!--decoder->pad)
+				out += decoder_flush(decoder, out);
 
-	for (ptr = in; ptr < in_end; ptr++) {
-		if (l_ascii_isspace(*ptr))
-			/* Whitespace */
 			continue;
+		}
+
+		if (v == B64_PAD) {
+			if (decoder->count == 1) {
+				decoder->state = DECODER_ERROR;
+				break;
+			}
+
+			decoder->pad = (4 - decoder->count) & 3;
+
+			/* This '=' is the first of the padding */
+			if (decoder->pad <= 1)
+				out += decoder_flush(decoder, out);
+			else {
+				decoder->pad--;
+				decoder->state = DECODER_PADDING;
+			}
+
+			continue;
+		}
 
-		/* Base64 character */
-		reg <<= 6;
-		if (l_ascii_isupper(*ptr))
-			reg |= *ptr - 'A' + 0;
-		else if (l_ascii_islower(*ptr))
-			reg |= *ptr - 'a' + 26;
-		else if (l_ascii_isdigit(*ptr))
-			reg |= *ptr - '0' + 52;
-		else if (*ptr == '+')
-			reg |= 62;
-		else if (*ptr == '/')
-			reg |= 63;
-
-		if ((base64_len & 3) == 1)
-			*out++ = reg >> 4;
-		else if ((base64_len & 3) == 2)
-			*out++ = reg >> 2;
-		else if ((base64_len & 3) == 3)
-			*out++ = reg >> 0;
-
-		base64_len++;
+		if (v == B64_INVALID) {
+			decoder->state = DECODER_ERROR;
+			break;
+		}
+
+		decoder->reg = (decoder->reg << 6) | v;
+
+		if (++decoder->count < 4)
+			continue;
+
+		out[0] = decoder->reg >> 16;
+		out[1] = decoder->reg >> 8;
+		out[2] = decoder->reg;
+		out += 3;
+		decoder->count = 0;
+	}
+
+	return out - start;
+}
+
+static bool decoder_finish(const struct l_base64_decoder *decoder)
+{
+	switch (decoder->state) {
+	case DECODER_DATA:
+		return decoder->count == 0;
+	case DECODER_DONE:
+		return true;
+	case DECODER_PADDING:
+	case DECODER_ERROR:
+		break;
+	}
+
+	return false;
+}
+
+LIB_EXPORT uint8_t *l_base64_decode(const char *in, size_t in_len,
+					size_t *n_written)
+{
+	struct l_base64_decoder decoder = { .state = DECODER_DATA };
+	uint8_t *out_buf;
+	size_t out_len;
+
+	/* Every character holds at most six bits */
+	out_buf = l_malloc(in_len / 4 * 3 + in_len % 4 + 1);
+	out_len = decoder_feed(&decoder, (const uint8_t *) in, in_len, out_buf);
+
+	if (!decoder_finish(&decoder)) {
+		l_free(out_buf);
+		return NULL;
+	}
+
+	*n_written = out_len;
+
+	if (!out_len) {
+		l_free(out_buf);
+		return NULL;
 	}
 
 	return out_buf;
@@ -114,8 +254,6 @@ LIB_EXPORT char *l_base64_encode(const uint8_t *in, size_t in_len,
 	char *out_buf, *out;
 	size_t out_len;
 	uint32_t reg;
-	uint8_t idx;
-	int i, pad = 4;
 	int col = 0;
 
 	/* For simplicity allow multiples of 4 only */
@@ -132,42 +270,112 @@ LIB_EXPORT char *l_base64_encode(const uint8_t *in, size_t in_len,
 
 	out = out_buf;
 
-	while (in < in_end) {
-		reg = *in++ << 16;
-
-		if (in < in_end)
-			reg |= *in++ << 8;
-		else
-			pad--;
-
-		if (in < in_end)
-			reg |= *in++ << 0;
-		else
-			pad--;
-
+	for (; in_end - in >= 3; in += 3) {
 		if (columns && col == columns) {
 			*out++ = '\n';
 			col = 0;
 		}
 		col += 4;
 
-		for (i = 0; i < pad; i++) {
-			idx = (reg >> 18) & 63;
-			reg <<= 6;
-
-			if (idx < 26)
-				*out++ = idx + 'A';
-			else if (idx < 52)
-				*out++ = idx - 26 + 'a';
-			else if (idx < 62)
-				*out++ = idx - 52 + '0';
-			else
-				*out++ = (idx == 62) ? '+' : '/';
-		}
+		reg = (in[0] << 16) | (in[1] << 8) | in[2];
+		out[0] = encode_table[(reg >> 18) & 63];
+		out[1] = encode_table[(reg >> 12) & 63];
+		out[2] = encode_table[(reg >> 6) & 63];
+		out[3] = encode_table[reg & 63];
+		out += 4;
 	}
 
-	for (; pad < 4; pad++)
-		*out++ = '=';
+	if (in == in_end)
+		return out_buf;
+
+	if (columns && col == columns)
+		*out++ = '\n';
+
+	reg = in[0] << 16;
+
+	if (in_end - in == 2)
+		reg |= in[1] << 8;
+
+	out[0] = encode_table[(reg >> 18) & 63];
+	out[1] = encode_table[(reg >> 12) & 63];
+	out[2] = in_end - in == 2 ? encode_table[(reg >> 6) & 63] : '=';
+	out[3] = '=';
 
 	return out_buf;
 }
+
+/**
+ * l_base64_decoder_new:
+ *
+ * Creates a decoder for base64 data that arrives in chunks, following the
+ * same rules as l_base64_decode().
+ *
+ * Returns: a newly allocated #l_base64_decoder object
+ **/
+LIB_EXPORT struct l_base64_decoder *l_base64_decoder_new(void)
+{
+	struct l_base64_decoder *decoder = l_new(struct l_base64_decoder, 1);
+
+	decoder->state = DECODER_DATA;
+
+	return decoder;
+}
+
+/**
+ * l_base64_decoder_free:
+ * @decoder: base64 decoder object
+ *
+ * Frees @decoder.
+ **/
+LIB_EXPORT void l_base64_decoder_free(struct l_base64_decoder *decoder)
+{
+	l_free(decoder);
+}
+
+/**
+ * l_base64_decoder_feed:
+ * @decoder: base64 decoder object
+ * @in: next chunk of base64 text
+ * @in_len: length of @in
+ * @out: buffer for the decoded bytes
+ * @n_written: number of bytes written to @out
+ *
+ * Decodes the next chunk of input.  Up to three characters of an
+ * incomplete quad are kept in @decoder for the next call, so @out must
+ * have room for at least (@in_len + 3) / 4 * 3 bytes.
+ *
+ * Returns: #false if the input so far is not valid base64
+ **/
+LIB_EXPORT bool l_base64_decoder_feed(struct l_base64_decoder *decoder,
+					const char *in, size_t in_len,
+					uint8_t *out, size_t *n_written)
+{
+	size_t len;
+
+	if (unlikely(!decoder || (!in && in_len) || !out))
+		return false;
+
+	len = decoder_feed(decoder, (const uint8_t *) in, in_len, out);
+
+	if (n_written)
+		*n_written = len;
+
+	return decoder->state != DECODER_ERROR;
+}
+
+/**
+ * l_base64_decoder_finish:
+ * @decoder: base64 decoder object
+ *
+ * Checks that the input fed to @decoder ended on a complete quad or with
+ * complete padding.
+ *
+ * Returns: #true if all input fed to @decoder was valid base64
+ **/
+LIB_EXPORT bool l_base64_decoder_finish(struct l_base64_decoder *decoder)
+{
+	if (unlikely(!decoder))
+		return false;
+
+	return decoder_finish(decoder);
+}
@@ -21,15 +21,28 @@
 #ifndef __ELL_BASE64_H
 #define __ELL_BASE64_H
 
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+struct l_base64_decoder;
+
 uint8_t *l_base64_decode(const char *in, size_t in_len, size_t *n_written);
 
 char *l_base64_encode(const uint8_t *in, size_t in_len, int columns,
 				size_t *n_written);
 
+struct l_base64_decoder *l_base64_decoder_new(void);
+void l_base64_decoder_free(struct l_base64_decoder *decoder);
+bool l_base64_decoder_feed(struct l_base64_decoder *decoder,
+				const char *in, size_t in_len,
+				uint8_t *out, size_t *n_written);
+bool l_base64_decoder_finish(struct l_base64_decoder *decoder);
+
 #ifdef __cplusplus
 }
 #endif
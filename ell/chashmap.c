@@ -0,0 +1,874 @@
+/*
+ *
+ *  Embedded Linux library
+ *
+ *  Copyright (C) 2019  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "util.h"
+#include "hashmap.h"
+#include "chashmap.h"
+#include "private.h"
+
+/**
+ * SECTION:chashmap
+ * @short_description: Concurrent hash table support
+ *
+ * Hash table that can be shared between threads.  Lookups never take a
+ * lock, modifications take one of several bucket stripe locks.  Memory of
+ * removed entries is reclaimed once every reader that could still see it
+ * has finished, using epoch based reclamation.
+ */
+
+#define STRIPES 32
+#define MIN_BUCKETS 64
+#define MAX_LOAD 2
+#define RECLAIM_THRESHOLD 64
+#define EPOCH_SLOTS 64
+#define CACHELINE 64
+
+struct entry {
+	struct entry *next;
+	void *key;
+	void *value;
+	unsigned int hash;
+};
+
+struct table {
+	unsigned int mask;
+	struct entry *buckets[];
+};
+
+enum retired_type {
+	RETIRED_ENTRY,
+	RETIRED_TABLE,
+};
+
+struct retired {
+	struct retired *next;
+	void *ptr;
+	unsigned long epoch;
+	enum retired_type type;
+};
+
+struct stripe {
+	bool lock;
+	uint8_t padding[CACHELINE - sizeof(bool)];
+};
+
+/**
+ * l_chashmap:
+ *
+ * Opaque object representing the concurrent hash table.
+ */
+struct l_chashmap {
+	l_hashmap_hash_func_t hash_func;
+	l_hashmap_compare_func_t compare_func;
+	l_hashmap_key_new_func_t key_new_func;
+	l_hashmap_key_free_func_t key_free_func;
+	struct table *table;
+	unsigned int entries;
+	bool retired_lock;
+	struct retired *retired;
+	unsigned int n_retired;
+	struct stripe stripes[STRIPES];
+};
+
+/*
+ * Epochs are shared by all maps.  Every reading thread owns a slot in
+ * which it announces the epoch it entered its read section in, or zero
+ * when it is outside of one.  The global epoch only advances once all
+ * active readers have caught up with it, so memory retired in epoch E is
+ * unreachable for everyone once the global epoch reaches E + 2.
+ *
+ * Slots are kept by a thread until it exits, a thread specific key hands
+ * them back from its destructor.  When all of them are taken, readers fall
+ * back to a shared counter that blocks any epoch advance while it is
+ * non-zero.
+ */
+struct epoch_slot {
+	unsigned long epoch;
+	bool used;
+} __attribute__((aligned(CACHELINE)));
+
+static struct epoch_slot epoch_slots[EPOCH_SLOTS];
+static unsigned long global_epoch = 1;
+static unsigned int overflow_readers;
+
+static __thread struct epoch_slot *thread_slot;
+static __thread unsigned int thread_nesting;
+
+static pthread_key_t epoch_slot_key;
+static pthread_once_t epoch_slot_once = PTHREAD_ONCE_INIT;
+static bool epoch_slot_key_valid;
+
+static void epoch_slot_release(void *data)
+{
+	struct epoch_slot *slot = data;
+
+	/* Other destructors may still do lookups, they need a new slot */
+	thread_slot = NULL;
+	thread_nesting = 0;
+
+	__atomic_store_n(&slot->epoch, 0, __ATOMIC_RELEASE);
+	__atomic_clear(&slot->used, __ATOMIC_RELEASE);
+}
+
+static void epoch_slot_key_create(void)
+{
+	epoch_slot_key_valid = !pthread_key_create(&epoch_slot_key,
+							epoch_slot_release);
+}
+
+static struct epoch_slot *epoch_slot_get(void)
+{
+	unsigned int i;
+
+	if (thread_slot)
+		return thread_slot;
+
+	/* Without a way to give the slot back, leave them to other threads */
+	pthread_once(&epoch_slot_once, epoch_slot_key_create);
+	if (!epoch_slot_key_valid)
+		return NULL;
+
+	for (i = 0; i < EPOCH_SLOTS; i++) {
+		struct epoch_slot *slot = &epoch_slots[i];
+
+		if (__atomic_load_n(&slot->used, __ATOMIC_RELAXED))
+			continue;
+
+		if (__atomic_test_and_set(&slot->used, __ATOMIC_ACQUIRE))
+			continue;
+
+		if (pthread_setspecific(epoch_slot_key, slot)) {
+			__atomic_clear(&slot->used, __ATOMIC_RELEASE);
+			break;
+		}
+
+		thread_slot = slot;
+		break;
+	}
+
+	return thread_slot;
+}
+
+static unsigned long epoch_try_advance(void)
+{
+	unsigned long epoch = __atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST);
+	unsigned int i;
+
+	if (__atomic_load_n(&overflow_readers, __ATOMIC_SEQ_CST))
+		return epoch;
+
+	for (i = 0; i < EPOCH_SLOTS; i++) {
+		unsigned long e = __atomic_load_n(&epoch_slots[i].epoch,
+							__ATOMIC_SEQ_CST);
+
+		if (e && e != epoch)
+			return epoch;
+	}
+
+	if (__atomic_compare_exchange_n(&global_epoch, &epoch, epoch + 1,
+					false, __ATOMIC_SEQ_CST,
+					__ATOMIC_SEQ_CST))
+		return epoch + 1;
+
+	/* Someone else advanced it, epoch holds the new value */
+	return epoch;
+}
+
+/**
+ * l_chashmap_read_lock:
+ *
+ * Enter a read section.  Entries, keys and values that are reachable
+ * through any #l_chashmap at the start of a read section stay valid until
+ * the matching l_chashmap_read_unlock, even if they get removed from the
+ * map concurrently.  Read sections nest and must not span a call to
+ * l_chashmap_synchronize.
+ *
+ * Lookups enter a read section on their own, so this is only needed when
+ * the returned values are used after the lookup.
+ **/
+LIB_EXPORT void l_chashmap_read_lock(void)
+{
+	struct epoch_slot *slot;
+	unsigned long epoch;
+
+	if (thread_nesting++)
+		return;
+
+	slot = epoch_slot_get();
+	if (!slot) {
+		__atomic_add_fetch(&overflow_readers, 1, __ATOMIC_SEQ_CST);
+		return;
+	}
+
+	epoch = __atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST);
+
+	while (true) {
+		unsigned long current;
+
+		__atomic_store_n(&slot->epoch, epoch, __ATOMIC_SEQ_CST);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+		current = __atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST);
+		if (current == epoch)
+			break;
+
+		epoch = current;
+	}
+}
+
+/**
+ * l_chashmap_read_unlock:
+ *
+ * Leave a read section entered with l_chashmap_read_lock.
+ **/
+LIB_EXPORT void l_chashmap_read_unlock(void)
+{
+	if (unlikely(!thread_nesting))
+		return;
+
+	if (--thread_nesting)
+		return;
+
+	if (!thread_slot) {
+		__atomic_sub_fetch(&overflow_readers, 1, __ATOMIC_SEQ_CST);
+		return;
+	}
+
+	__atomic_store_n(&thread_slot->epoch, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * l_chashmap_synchronize:
+ *
+ * Wait until all read sections that were active at the time of the call
+ * have been left.  A value returned by l_chashmap_remove can be freed once
+ * this returns.  Must not be called from within a read section.
+ **/
+LIB_EXPORT void l_chashmap_synchronize(void)
+{
+	unsigned long target;
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	target = __atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST) + 2;
+
+	while (epoch_try_advance() < target)
+		sched_yield();
+}
+
+static void spin_lock(bool *lock)
+{
+	while (__atomic_test_and_set(lock, __ATOMIC_ACQUIRE))
+		sched_yield();
+}
+
+static void spin_unlock(bool *lock)
+{
+	__atomic_clear(lock, __ATOMIC_RELEASE);
+}
+
+/*
+ * Bucket indexes use the low bits of the hash, so spread the bits of weak
+ * hashes such as raw pointer values first.  The stripe of a bucket is
+ * given by the lowest bits only and does not change when the table grows.
+ */
+static inline unsigned int hash_mix(unsigned int hash)
+{
+	hash ^= hash >> 16;
+	hash *= 0x45d9f3b;
+	hash ^= hash >> 16;
+
+	return hash;
+}
+
+static struct table *table_new(unsigned int size)
+{
+	struct table *table;
+
+	table = l_malloc(sizeof(struct table) + size * sizeof(struct entry *));
+	memset(table->buckets, 0, size * sizeof(struct entry *));
+	table->mask = size - 1;
+
+	return table;
+}
+
+static void table_free(struct table *table)
+{
+	unsigned int i;
+
+	for (i = 0; i <= table->mask; i++) {
+		struct entry *entry = table->buckets[i];
+
+		while (entry) {
+			struct entry *next = entry->next;
+
+			mempool_free(entry, sizeof(struct entry));
+			entry = next;
+		}
+	}
+
+	l_free(table);
+}
+
+static void entry_free(struct l_chashmap *map, struct entry *entry)
+{
+	if (map->key_free_func)
+		map->key_free_func(entry->key);
+
+	mempool_free(entry, sizeof(struct entry));
+}
+
+static void retired_free(struct l_chashmap *map, struct retired *retired)
+{
+	while (retired) {
+		struct retired *next = retired->next;
+
+		if (retired->type == RETIRED_ENTRY)
+			entry_free(map, retired->ptr);
+		else
+			table_free(retired->ptr);
+
+		l_free(retired);
+		retired = next;
+	}
+}
+
+static void reclaim(struct l_chashmap *map)
+{
+	unsigned long epoch = epoch_try_advance();
+	struct retired *done = NULL;
+	struct retired **link;
+
+	spin_lock(&map->retired_lock);
+
+	link = &map->retired;
+
+	while (*link) {
+		struct retired *retired = *link;
+
+		if (retired->epoch + 2 > epoch) {
+			link = &retired->next;
+			continue;
+		}
+
+		*link = retired->next;
+		retired->next = done;
+		done = retired;
+		map->n_retired--;
+	}
+
+	spin_unlock(&map->retired_lock);
+
+	retired_free(map, done);
+}
+
+static void retire(struct l_chashmap *map, void *ptr, enum retired_type type)
+{
+	struct retired *retired = l_new(struct retired, 1);
+	bool full;
+
+	retired->ptr = ptr;
+	retired->type = type;
+
+	/* The unlink must be visible before the epoch is sampled */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	retired->epoch = __atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST);
+
+	spin_lock(&map->retired_lock);
+	retired->next = map->retired;
+	map->retired = retired;
+	full = ++map->n_retired >= RECLAIM_THRESHOLD;
+	spin_unlock(&map->retired_lock);
+
+	if (full)
+		reclaim(map);
+}
+
+/* The table pointer only changes while all stripes are locked */
+static struct table *stripe_lock(struct l_chashmap *map, unsigned int hash)
+{
+	spin_lock(&map->stripes[hash & (STRIPES - 1)].lock);
+
+	return map->table;
+}
+
+static void stripe_unlock(struct l_chashmap *map, unsigned int hash)
+{
+	spin_unlock(&map->stripes[hash & (STRIPES - 1)].lock);
+}
+
+/*
+ * Readers may still be walking the old table, so entries are copied
+ * rather than relinked and the old table is retired as a whole.
+ */
+static void resize(struct l_chashmap *map)
+{
+	struct table *old;
+	struct table *table;
+	unsigned int i;
+
+	for (i = 0; i < STRIPES; i++)
+		spin_lock(&map->stripes[i].lock);
+
+	old = map->table;
+
+	if (__atomic_load_n(&map->entries, __ATOMIC_RELAXED) <=
+						(old->mask + 1) * MAX_LOAD) {
+		old = NULL;
+		goto done;
+	}
+
+	table = table_new((old->mask + 1) * 2);
+
+	for (i = 0; i <= old->mask; i++) {
+		struct entry *entry;
+
+		for (entry = old->buckets[i]; entry; entry = entry->next) {
+			struct entry *copy = mempool_new(struct entry);
+			unsigned int index = hash_mix(entry->hash) &
+								table->mask;
+
+			*copy = *entry;
+			copy->next = table->buckets[index];
+			table->buckets[index] = copy;
+		}
+	}
+
+	__atomic_store_n(&map->table, table, __ATOMIC_RELEASE);
+
+done:
+	for (i = 0; i < STRIPES; i++)
+		spin_unlock(&map->stripes[i].lock);
+
+	if (old)
+		retire(map, old, RETIRED_TABLE);
+}
+
+static unsigned int direct_hash_func(const void *p)
+{
+	return L_PTR_TO_UINT(p);
+}
+
+static int direct_compare_func(const void *a, const void *b)
+{
+	return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+/**
+ * l_chashmap_new:
+ *
+ * Create a new concurrent hash table.  The keys are compared by their
+ * pointer value.  Configuration functions must be called before the map
+ * is shared with other threads.
+ *
+ * See also l_hashmap_new().
+ *
+ * Returns: a newly allocated #l_chashmap object
+ **/
+LIB_EXPORT struct l_chashmap *l_chashmap_new(void)
+{
+	struct l_chashmap *map;
+
+	map = l_new(struct l_chashmap, 1);
+
+	map->hash_func = direct_hash_func;
+	map->compare_func = direct_compare_func;
+	map->table = table_new(MIN_BUCKETS);
+
+	return map;
+}
+
+/**
+ * l_chashmap_string_new:
+ *
+ * Create a new concurrent hash table.  The keys are considered strings and
+ * are copied.
+ *
+ * Returns: a newly allocated #l_chashmap object
+ **/
+LIB_EXPORT struct l_chashmap *l_chashmap_string_new(void)
+{
+	struct l_chashmap *map = l_chashmap_new();
+
+	map->hash_func = l_str_hash;
+	map->compare_func = (l_hashmap_compare_func_t) strcmp;
+	map->key_new_func = (l_hashmap_key_new_func_t) l_strdup;
+	map->key_free_func = l_free;
+
+	return map;
+}
+
+/**
+ * l_chashmap_set_hash_function:
+ * @map: concurrent hash table object
+ * @func: Key hashing function
+ *
+ * Sets the hashing function to be used by this object.
+ *
+ * This function can only be called when the @map is empty.
+ *
+ * Returns: #true when the hashing function could be updated successfully,
+ * and #false otherwise.
+ **/
+LIB_EXPORT bool l_chashmap_set_hash_function(struct l_chashmap *map,
+						l_hashmap_hash_func_t func)
+{
+	if (unlikely(!map))
+		return false;
+
+	if (map->entries != 0)
+		return false;
+
+	map->hash_func = func;
+
+	return true;
+}
+
+/**
+ * l_chashmap_set_compare_function:
+ * @map: concurrent hash table object
+ * @func: Key compare function
+ *
+ * Sets key comparison function to be used by this object.
+ *
+ * This function can only be called when the @map is empty.
+ *
+ * Returns: #true when the comparison function could be updated
+ * successfully, and #false otherwise.
+ **/
+LIB_EXPORT bool l_chashmap_set_compare_function(struct l_chashmap *map,
+						l_hashmap_compare_func_t func)
+{
+	if (unlikely(!map))
+		return false;
+
+	if (map->entries != 0)
+		return false;
+
+	map->compare_func = func;
+
+	return true;
+}
+
+/**
+ * l_chashmap_set_key_copy_function:
+ * @map: concurrent hash table object
+ * @func: Key duplicate function
+ *
+ * Sets key duplicate function to be used by this object.
+ *
+ * This function can only be called when the @map is empty.
+ *
+ * Returns: #true when the key copy function could be updated
+ * successfully, and #false otherwise.
+ **/
+LIB_EXPORT bool l_chashmap_set_key_copy_function(struct l_chashmap *map,
+						l_hashmap_key_new_func_t func)
+{
+	if (unlikely(!map))
+		return false;
+
+	if (map->entries != 0)
+		return false;
+
+	map->key_new_func = func;
+
+	return true;
+}
+
+/**
+ * l_chashmap_set_key_free_function:
+ * @map: concurrent hash table object
+ * @func: Key destructor function
+ *
+ * Sets key destructor function to be used by this object.  Keys of
+ * removed entries are freed once no reader can access them anymore.
+ *
+ * This function can only be called when the @map is empty.
+ *
+ * Returns: #true when the key free function could be updated
+ * successfully, and #false otherwise.
+ **/
+LIB_EXPORT bool l_chashmap_set_key_free_function(struct l_chashmap *map,
+					l_hashmap_key_free_func_t func)
+{
+	if (unlikely(!map))
+		return false;
+
+	if (map->entries != 0)
+		return false;
+
+	map->key_free_func = func;
+
+	return true;
+}
+
+/**
+ * l_chashmap_destroy:
+ * @map: concurrent hash table object
+ * @destroy: destroy function
+ *
+ * Free concurrent hash table and call @destroy on all remaining entries.
+ * No other thread may use @map anymore when this is called.
+ **/
+LIB_EXPORT void l_chashmap_destroy(struct l_chashmap *map,
+					l_hashmap_destroy_func_t destroy)
+{
+	struct table *table;
+	unsigned int i;
+
+	if (unlikely(!map))
+		return;
+
+	table = map->table;
+
+	for (i = 0; i <= table->mask; i++) {
+		struct entry *entry;
+
+		for (entry = table->buckets[i]; entry; entry = entry->next) {
+			if (destroy)
+				destroy(entry->value);
+
+			if (map->key_free_func)
+				map->key_free_func(entry->key);
+		}
+	}
+
+	table_free(table);
+	retired_free(map, map->retired);
+
+	l_free(map);
+}
+
+/**
+ * l_chashmap_insert:
+ * @map: concurrent hash table object
+ * @key: key pointer
+ * @value: value pointer
+ *
+ * Insert new @value entry with @key.  Unlike l_hashmap_insert an existing
+ * entry is never replaced, since concurrent readers may still use it.
+ *
+ * Returns: #true when value has been added and #false in case of failure
+ * or if an entry for @key already exists.
+ **/
+LIB_EXPORT bool l_chashmap_insert(struct l_chashmap *map,
+					const void *key, void *value)
+{
+	struct table *table;
+	struct entry *entry;
+	struct entry **head;
+	unsigned int hash;
+	unsigned int mixed;
+	unsigned int entries;
+	unsigned int size;
+
+	if (unlikely(!map))
+		return false;
+
+	hash = map->hash_func(key);
+	mixed = hash_mix(hash);
+	table = stripe_lock(map, mixed);
+	head = &table->buckets[mixed & table->mask];
+
+	for (entry = *head; entry; entry = entry->next) {
+		if (entry->hash == hash &&
+				!map->compare_func(key, entry->key)) {
+			stripe_unlock(map, mixed);
+			return false;
+		}
+	}
+
+	entry = mempool_new(struct entry);
+	entry->key = map->key_new_func ? map->key_new_func(key) : (void *) key;
+	entry->value = value;
+	entry->hash = hash;
+	entry->next = *head;
+
+	__atomic_store_n(head, entry, __ATOMIC_RELEASE);
+	entries = __atomic_add_fetch(&map->entries, 1, __ATOMIC_RELAXED);
+	size = table->mask + 1;
+
+	stripe_unlock(map, mixed);
+
+	if (entries > size * MAX_LOAD)
+		resize(map);
+
+	return true;
+}
+
+/**
+ * l_chashmap_remove:
+ * @map: concurrent hash table object
+ * @key: key pointer
+ *
+ * Remove entry for @key.  Other threads may still be using the returned
+ * value, call l_chashmap_synchronize before freeing it.
+ *
+ * Returns: value pointer of the removed entry or #NULL in case of failure
+ **/
+LIB_EXPORT void *l_chashmap_remove(struct l_chashmap *map, const void *key)
+{
+	struct table *table;
+	struct entry *entry;
+	struct entry **link;
+	unsigned int hash;
+	unsigned int mixed;
+	void *value;
+
+	if (unlikely(!map))
+		return NULL;
+
+	hash = map->hash_func(key);
+	mixed = hash_mix(hash);
+	table = stripe_lock(map, mixed);
+	link = &table->buckets[mixed & table->mask];
+
+	for (entry = *link; entry; link = &entry->next, entry = *link) {
+		if (entry->hash == hash &&
+				!map->compare_func(key, entry->key))
+			break;
+	}
+
+	if (!entry) {
+		stripe_unlock(map, mixed);
+		return NULL;
+	}
+
+	__atomic_store_n(link, entry->next, __ATOMIC_RELEASE);
+	__atomic_sub_fetch(&map->entries, 1, __ATOMIC_RELAXED);
+	value = entry->value;
+
+	stripe_unlock(map, mixed);
+
+	retire(map, entry, RETIRED_ENTRY);
+
+	return value;
+}
+
+/**
+ * l_chashmap_lookup:
+ * @map: concurrent hash table object
+ * @key: key pointer
+ *
+ * Lookup entry for @key.  This never blocks on concurrent modifications.
+ *
+ * Returns: value pointer for @key or #NULL in case of failure
+ **/
+LIB_EXPORT void *l_chashmap_lookup(struct l_chashmap *map, const void *key)
+{
+	struct table *table;
+	struct entry *entry;
+	unsigned int hash;
+	void *value = NULL;
+
+	if (unlikely(!map))
+		return NULL;
+
+	hash = map->hash_func(key);
+
+	l_chashmap_read_lock();
+
+	table = __atomic_load_n(&map->table, __ATOMIC_ACQUIRE);
+	entry = __atomic_load_n(&table->buckets[hash_mix(hash) & table->mask],
+							__ATOMIC_ACQUIRE);
+
+	for (; entry; entry = __atomic_load_n(&entry->next, __ATOMIC_ACQUIRE)) {
+		if (entry->hash == hash &&
+				!map->compare_func(key, entry->key)) {
+			value = entry->value;
+			break;
+		}
+	}
+
+	l_chashmap_read_unlock();
+
+	return value;
+}
+
+/**
+ * l_chashmap_foreach:
+ * @map: concurrent hash table object
+ * @function: callback function
+ * @user_data: user data given to callback function
+ *
+ * Call @function for every entry in @map.  Entries inserted or removed by
+ * other threads during the walk may or may not be visited.  @function is
+ * called from within a read section.
+ **/
+LIB_EXPORT void l_chashmap_foreach(struct l_chashmap *map,
+			l_hashmap_foreach_func_t function, void *user_data)
+{
+	struct table *table;
+	unsigned int i;
+
+	if (unlikely(!map || !function))
+		return;
+
+	l_chashmap_read_lock();
+
+	table = __atomic_load_n(&map->table, __ATOMIC_ACQUIRE);
+
+	for (i = 0; i <= table->mask; i++) {
+		struct entry *entry = __atomic_load_n(&table->buckets[i],
+							__ATOMIC_ACQUIRE);
+
+		while (entry) {
+			function(entry->key, entry->value, user_data);
+			entry = __atomic_load_n(&entry->next, __ATOMIC_ACQUIRE);
+		}
+	}
+
+	l_chashmap_read_unlock();
+}
+
+/**
+ * l_chashmap_size:
+ * @map: concurrent hash table object
+ *
+ * Returns: entries in the concurrent hash table
+ **/
+LIB_EXPORT unsigned int l_chashmap_size(struct l_chashmap *map)
+{
+	if (unlikely(!map))
+		return 0;
+
+	return __atomic_load_n(&map->entries, __ATOMIC_RELAXED);
+}
+
+/**
+ * l_chashmap_isempty:
+ * @map: concurrent hash table object
+ *
+ * Returns: #true if concurrent hash table is empty and #false if not
+ **/
+LIB_EXPORT bool l_chashmap_isempty(struct l_chashmap *map)
+{
+	return l_chashmap_size(map) == 0;
+}
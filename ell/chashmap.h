@@ -0,0 +1,68 @@
+/*
+ *
+ *  Embedded Linux library
+ *
+ *  Copyright (C) 2019  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __ELL_CHASHMAP_H
+#define __ELL_CHASHMAP_H
+
+#include <stdbool.h>
+#include <ell/hashmap.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct l_chashmap;
+
+struct l_chashmap *l_chashmap_new(void);
+struct l_chashmap *l_chashmap_string_new(void);
+
+bool l_chashmap_set_hash_function(struct l_chashmap *map,
+						l_hashmap_hash_func_t func);
+bool l_chashmap_set_compare_function(struct l_chashmap *map,
+						l_hashmap_compare_func_t func);
+bool l_chashmap_set_key_copy_function(struct l_chashmap *map,
+						l_hashmap_key_new_func_t func);
+bool l_chashmap_set_key_free_function(struct l_chashmap *map,
+					l_hashmap_key_free_func_t func);
+
+void l_chashmap_destroy(struct l_chashmap *map,
+			l_hashmap_destroy_func_t destroy);
+
+bool l_chashmap_insert(struct l_chashmap *map, const void *key, void *value);
+void *l_chashmap_remove(struct l_chashmap *map, const void *key);
+void *l_chashmap_lookup(struct l_chashmap *map, const void *key);
+
+void l_chashmap_foreach(struct l_chashmap *map,
+			l_hashmap_foreach_func_t function, void *user_data);
+
+unsigned int l_chashmap_size(struct l_chashmap *map);
+bool l_chashmap_isempty(struct l_chashmap *map);
+
+void l_chashmap_read_lock(void);
+void l_chashmap_read_unlock(void);
+void l_chashmap_synchronize(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ELL_CHASHMAP_H */
@@ -31,6 +31,7 @@
 #include <unistd.h>
 
 #include "util.h"
+#include "arena.h"
 #include "private.h"
 #include "dbus.h"
 #include "dbus-private.h"
@@ -73,6 +74,7 @@ struct l_dbus_message {
 	char *sender;
 	int fds[16];
 	uint32_t num_fds;
+	struct l_arena *arena;
 
 	bool sealed : 1;
 	bool signature_free : 1;
@@ -427,6 +429,12 @@ LIB_EXPORT void l_dbus_message_unref(struct l_dbus_message *message)
 	if (message->signature_free)
 		l_free(message->signature);
 
+	/* Header, body and the message itself all live in the arena */
+	if (message->arena) {
+		l_arena_free(message->arena);
+		return;
+	}
+
 	l_free(message->header);
 	l_free(message->body);
 	l_free(message);
@@ -716,6 +724,7 @@ struct l_dbus_message *dbus_message_from_blob(const void *data, size_t size,
 						int fds[], uint32_t num_fds)
 {
 	const struct dbus_header *hdr = data;
+	struct l_arena *arena;
 	struct l_dbus_message *message;
 	size_t body_pos;
 	unsigned int i;
@@ -723,9 +732,12 @@ struct l_dbus_message *dbus_message_from_blob(const void *data, size_t size,
 	if (unlikely(size < DBUS_HEADER_SIZE))
 		return NULL;
 
-	message = l_new(struct l_dbus_message, 1);
+	arena = dbus_message_arena_new(size, 0);
+
+	message = l_arena_alloc0(arena, sizeof(struct l_dbus_message));
 
 	message->refcount = 1;
+	message->arena = arena;
 
 	if (hdr->version == 1) {
 		message->header_size = align_len(DBUS_HEADER_SIZE +
@@ -762,18 +774,18 @@ struct l_dbus_message *dbus_message_from_blob(const void *data, size_t size,
 
 		message->header_size = align_len(header.len - header.pos, 8);
 		message->body_size = body.len - body.pos;
-		message->signature = l_strndup(body.sig_start + body.sig_pos,
+		message->signature = l_arena_strndup(arena,
+						body.sig_start + body.sig_pos,
 						body.sig_len - body.sig_pos);
-		message->signature_free = true;
 		message->header_end = header.len;
 		body_pos = body.data + body.pos - data;
 	}
 
-	message->header = l_malloc(message->header_size);
-	message->body = l_malloc(message->body_size);
+	message->header = l_arena_memdup(arena, data, message->header_size);
 
-	memcpy(message->header, data, message->header_size);
-	memcpy(message->body, data + body_pos, message->body_size);
+	if (message->body_size)
+		message->body = l_arena_memdup(arena, data + body_pos,
+							message->body_size);
 
 	message->sealed = true;
 
@@ -810,7 +822,22 @@ free:
 	return NULL;
 }
 
-struct l_dbus_message *dbus_message_build(void *header, size_t header_size,
+/*
+ * Creates an arena large enough to hold a received message along with its
+ * header and body, so that decoding it takes a single allocation.
+ */
+struct l_arena *dbus_message_arena_new(size_t header_size, size_t body_size)
+{
+	return l_arena_new(align_len(sizeof(struct l_dbus_message), 16) +
+				align_len(header_size, 16) + body_size);
+}
+
+/*
+ * The header and body must have been allocated from @arena, on success the
+ * message takes ownership of @arena.
+ */
+struct l_dbus_message *dbus_message_build(struct l_arena *arena,
+						void *header, size_t header_size,
 						void *body, size_t body_size,
 						int fds[], uint32_t num_fds)
 {
@@ -831,9 +858,10 @@ struct l_dbus_message *dbus_message_build(void *header, size_t header_size,
 	if (unlikely(hdr->version != 1))
 		return NULL;
 
-	message = l_new(struct l_dbus_message, 1);
+	message = l_arena_alloc0(arena, sizeof(struct l_dbus_message));
 
 	message->refcount = 1;
+	message->arena = arena;
 	message->header_size = header_size;
 	message->header = header;
 	message->body_size = body_size;
@@ -844,10 +872,8 @@ struct l_dbus_message *dbus_message_build(void *header, size_t header_size,
 		uint32_t unix_fds, orig_fds = num_fds;
 
 		if (!get_header_field(message, DBUS_MESSAGE_FIELD_UNIX_FDS,
-					'u', &unix_fds)) {
-			l_free(message);
+					'u', &unix_fds))
 			return NULL;
-		}
 
 		if (num_fds > unix_fds)
 			num_fds = unix_fds;
@@ -69,6 +69,7 @@ struct _dbus_property;
 struct l_dbus_message_iter;
 struct l_dbus_message;
 struct l_dbus;
+struct l_arena;
 struct _dbus_filter;
 struct _dbus_filter_condition;
 struct _dbus_filter_ops;
@@ -147,7 +148,9 @@ struct l_dbus_message *_dbus_message_new_error(uint8_t version,
 
 struct l_dbus_message *dbus_message_from_blob(const void *data, size_t size,
 						int fds[], uint32_t num_fds);
-struct l_dbus_message *dbus_message_build(void *header, size_t header_size,
+struct l_arena *dbus_message_arena_new(size_t header_size, size_t body_size);
+struct l_dbus_message *dbus_message_build(struct l_arena *arena,
+						void *header, size_t header_size,
 						void *body, size_t body_size,
 						int fds[], uint32_t num_fds);
 bool dbus_message_compare(struct l_dbus_message *message,
@@ -40,6 +40,7 @@
 #include "idle.h"
 #include "queue.h"
 #include "hashmap.h"
+#include "arena.h"
 #include "dbus.h"
 #include "private.h"
 #include "dbus-private.h"
@@ -134,7 +135,7 @@ static void message_queue_destroy(void *data)
 	if (callback->destroy)
 		callback->destroy(callback->user_data);
 
-	l_free(callback);
+	mempool_free(callback, sizeof(struct message_callback));
 }
 
 static void message_list_destroy(void *value)
@@ -322,7 +323,7 @@ static uint32_t send_message(struct l_dbus *dbus, bool priority,
 			!l_dbus_message_get_signature(message))
 		l_dbus_message_set_arguments(message, "");
 
-	callback = l_new(struct message_callback, 1);
+	callback = mempool_new(struct message_callback);
 
 	callback->serial = dbus->next_serial++;
 	callback->message = message;
@@ -665,6 +666,7 @@ static struct l_dbus_message *classic_recv_message(struct l_dbus *dbus)
 	struct iovec iov[2], *iovpos;
 	struct cmsghdr *cmsg;
 	ssize_t len, r;
+	struct l_arena *arena;
 	void *header, *body;
 	size_t header_size, body_size;
 	union {
@@ -682,10 +684,11 @@ static struct l_dbus_message *classic_recv_message(struct l_dbus *dbus)
 		return NULL;
 
 	header_size = align_len(DBUS_HEADER_SIZE + hdr.dbus1.field_length, 8);
-	header = l_malloc(header_size);
-
 	body_size = hdr.dbus1.body_length;
-	body = l_malloc(body_size);
+
+	arena = dbus_message_arena_new(header_size, body_size);
+	header = l_arena_alloc(arena, header_size);
+	body = body_size ? l_arena_alloc(arena, body_size) : NULL;
 
 	iov[0].iov_base = header;
 	iov[0].iov_len  = header_size;
@@ -769,8 +772,8 @@ static struct l_dbus_message *classic_recv_message(struct l_dbus *dbus)
 	if (num_fds > classic->num_fds)
 		goto bad_msg;
 
-	message = dbus_message_build(header, header_size, body, body_size,
-					classic->fd_buf, num_fds);
+	message = dbus_message_build(arena, header, header_size,
+					body, body_size, classic->fd_buf, num_fds);
 
 	if (message && num_fds) {
 		if (classic->num_fds > num_fds) {
@@ -798,8 +801,7 @@ cmsg_fail:
 	classic->fd_buf = NULL;
 	classic->num_fds = 0;
 
-	l_free(header);
-	l_free(body);
+	l_arena_free(arena);
 
 	return NULL;
 }
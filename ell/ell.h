@@ -26,6 +26,11 @@
 #include <ell/utf8.h>
 #include <ell/queue.h>
 #include <ell/hashmap.h>
+#include <ell/chashmap.h>
+#include <ell/mempool.h>
+#include <ell/arena.h>
+#include <ell/radix.h>
+#include <ell/ordmap.h>
 #include <ell/string.h>
 #include <ell/main.h>
 #include <ell/idle.h>
@@ -32,6 +32,7 @@
 #include "util.h"
 #include "queue.h"
 #include "io.h"
+#include "arena.h"
 #include "netlink-private.h"
 #include "genl.h"
 #include "genl-private.h"
@@ -109,6 +110,8 @@ struct l_genl_msg {
 	uint32_t len;
 	struct nest_info nests[MAX_NESTING_LEVEL];
 	uint8_t nesting_level;
+	struct l_arena *arena;
+	bool data_in_arena;
 };
 
 struct genl_request {
@@ -674,7 +677,7 @@ static void destroy_request(void *data)
 
 	l_genl_msg_unref(request->msg);
 
-	l_free(request);
+	mempool_free(request, sizeof(struct genl_request));
 }
 
 static void mcast_notify_free(void *data)
@@ -760,7 +763,15 @@ static bool msg_grow(struct l_genl_msg *msg, uint32_t needed)
 	if (grow_by < 32)
 		grow_by = 128;
 
-	msg->data = l_realloc(msg->data, msg->size + grow_by);
+	if (msg->data_in_arena) {
+		void *data = l_malloc(msg->size + grow_by);
+
+		memcpy(data, msg->data, msg->size);
+		msg->data = data;
+		msg->data_in_arena = false;
+	} else
+		msg->data = l_realloc(msg->data, msg->size + grow_by);
+
 	memset(msg->data + msg->size, 0, grow_by);
 	msg->size += grow_by;
 
@@ -769,9 +780,14 @@ static bool msg_grow(struct l_genl_msg *msg, uint32_t needed)
 
 struct l_genl_msg *_genl_msg_create(const struct nlmsghdr *nlmsg)
 {
+	struct l_arena *arena;
 	struct l_genl_msg *msg;
 
-	msg = l_new(struct l_genl_msg, 1);
+	/* The message and its data are released together by a single free */
+	arena = l_arena_new(sizeof(struct l_genl_msg) + nlmsg->nlmsg_len);
+
+	msg = l_arena_alloc0(arena, sizeof(struct l_genl_msg));
+	msg->arena = arena;
 
 	if (nlmsg->nlmsg_type == NLMSG_ERROR) {
 		struct nlmsgerr *err = NLMSG_DATA(nlmsg);
@@ -780,7 +796,8 @@ struct l_genl_msg *_genl_msg_create(const struct nlmsghdr *nlmsg)
 		goto done;
 	}
 
-	msg->data = l_memdup(nlmsg, nlmsg->nlmsg_len);
+	msg->data = l_arena_memdup(arena, nlmsg, nlmsg->nlmsg_len);
+	msg->data_in_arena = true;
 
 	msg->len = nlmsg->nlmsg_len;
 	msg->size = nlmsg->nlmsg_len;
@@ -1547,8 +1564,13 @@ LIB_EXPORT void l_genl_msg_unref(struct l_genl_msg *msg)
 	if (__sync_sub_and_fetch(&msg->ref_count, 1))
 		return;
 
-	l_free(msg->data);
-	l_free(msg);
+	if (!msg->data_in_arena)
+		l_free(msg->data);
+
+	if (msg->arena)
+		l_arena_free(msg->arena);
+	else
+		l_free(msg);
 }
 
 LIB_EXPORT uint8_t l_genl_msg_get_command(struct l_genl_msg *msg)
@@ -1837,7 +1859,7 @@ static unsigned int send_common(struct l_genl_family *family, uint16_t flags,
 	if (!genl)
 		return 0;
 
-	request = l_new(struct genl_request, 1);
+	request = mempool_new(struct genl_request);
 	request->type = family->id;
 	request->flags = NLM_F_REQUEST | flags;
 	request->msg = msg;
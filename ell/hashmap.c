@@ -24,8 +24,12 @@
 #include <config.h>
 #endif
 
+#include <sys/auxv.h>
+
 #include "util.h"
 #include "hashmap.h"
+#include "random.h"
+#include "siphash-private.h"
 #include "private.h"
 
 /**
@@ -51,6 +55,8 @@ struct entry {
  */
 struct l_hashmap {
 	l_hashmap_hash_func_t hash_func;
+	l_hashmap_seeded_hash_func_t seeded_hash_func;
+	uint64_t seed[2];
 	l_hashmap_compare_func_t compare_func;
 	l_hashmap_key_new_func_t key_new_func;
 	l_hashmap_key_free_func_t key_free_func;
@@ -73,6 +79,37 @@ static inline void free_key(const struct l_hashmap *hashmap, void *key)
 		hashmap->key_free_func(key);
 }
 
+static inline unsigned int get_hash(const struct l_hashmap *hashmap,
+					const void *key)
+{
+	if (hashmap->seeded_hash_func)
+		return hashmap->seeded_hash_func(key, hashmap->seed);
+
+	return hashmap->hash_func(key);
+}
+
+/*
+ * Derive a per-map seed from the random bytes the kernel hands to every
+ * process, which unlike getrandom() never blocks early during boot.
+ */
+static void hashmap_seed(struct l_hashmap *hashmap)
+{
+	const void *random = (const void *) getauxval(AT_RANDOM);
+	uint64_t key[2];
+
+	if (random)
+		memcpy(key, random, sizeof(key));
+	else if (!l_getrandom(key, sizeof(key))) {
+		key[0] = L_PTR_TO_UINT(&key);
+		key[1] = L_PTR_TO_UINT(hashmap_seed);
+	}
+
+	hashmap->seed[0] = _siphash13((const uint8_t *) &hashmap,
+						sizeof(hashmap), key);
+	hashmap->seed[1] = _siphash13((const uint8_t *) hashmap->seed,
+						sizeof(uint64_t), key);
+}
+
 static inline unsigned int hash_superfast(const uint8_t *key, unsigned int len)
 {
 	/*
@@ -170,11 +207,31 @@ LIB_EXPORT unsigned int l_str_hash(const void *p)
 	return hash_superfast((const uint8_t *)s, len);
 }
 
+/**
+ * l_str_hash_seeded:
+ * @p: string to hash
+ * @seed: hash seed
+ *
+ * Keyed string hash suitable for tables whose keys may be chosen by an
+ * untrusted peer.  Uses SipHash-1-3, which consumes 64 bits per round.
+ *
+ * Returns: the hash value of @p
+ **/
+LIB_EXPORT unsigned int l_str_hash_seeded(const void *p,
+						const uint64_t seed[2])
+{
+	const char *s = p;
+	uint64_t hash = _siphash13((const uint8_t *) s, strlen(s), seed);
+
+	return hash ^ (hash >> 32);
+}
+
 /**
  * l_hashmap_string_new:
  *
  * Create a new hash table. The keys are considered strings and are
- * copied.
+ * copied.  They are hashed with l_str_hash_seeded() using a random per
+ * table seed, so colliding keys can not be precomputed.
  *
  * No error handling is needed since. In case of real memory allocation
  * problems abort() will be called.
@@ -190,11 +247,14 @@ LIB_EXPORT struct l_hashmap *l_hashmap_string_new(void)
 	hashmap = l_new(struct l_hashmap, 1);
 
 	hashmap->hash_func = l_str_hash;
+	hashmap->seeded_hash_func = l_str_hash_seeded;
 	hashmap->compare_func = (l_hashmap_compare_func_t) strcmp;
 	hashmap->key_new_func = (l_hashmap_key_new_func_t) l_strdup;
 	hashmap->key_free_func = l_free;
 	hashmap->entries = 0;
 
+	hashmap_seed(hashmap);
+
 	return hashmap;
 }
 
@@ -220,6 +280,67 @@ LIB_EXPORT bool l_hashmap_set_hash_function(struct l_hashmap *hashmap,
 		return false;
 
 	hashmap->hash_func = func;
+	hashmap->seeded_hash_func = NULL;
+
+	return true;
+}
+
+/**
+ * l_hashmap_set_seeded_hash_function:
+ * @hashmap: hash table object
+ * @func: Keyed hashing function
+ *
+ * Sets a hashing function that additionally receives the seed of
+ * @hashmap, see l_hashmap_set_hash_seed().  It takes precedence over the
+ * function set with l_hashmap_set_hash_function().
+ *
+ * This function can only be called when the @hashmap is empty.
+ *
+ * Returns: #true when the hashing function could be updated successfully,
+ * and #false otherwise.
+ **/
+LIB_EXPORT bool l_hashmap_set_seeded_hash_function(struct l_hashmap *hashmap,
+					l_hashmap_seeded_hash_func_t func)
+{
+	if (unlikely(!hashmap))
+		return false;
+
+	if (hashmap->entries != 0)
+		return false;
+
+	if (func && !hashmap->seed[0] && !hashmap->seed[1])
+		hashmap_seed(hashmap);
+
+	hashmap->seeded_hash_func = func;
+
+	return true;
+}
+
+/**
+ * l_hashmap_set_hash_seed:
+ * @hashmap: hash table object
+ * @seed: 128 bit seed
+ *
+ * Sets the seed handed to the seeded hashing function.  By default every
+ * hash table gets a random seed, setting a fixed one is mainly useful for
+ * reproducible tests.
+ *
+ * This function can only be called when the @hashmap is empty.
+ *
+ * Returns: #true when the seed could be updated successfully, and #false
+ * otherwise.
+ **/
+LIB_EXPORT bool l_hashmap_set_hash_seed(struct l_hashmap *hashmap,
+					const uint64_t seed[2])
+{
+	if (unlikely(!hashmap || !seed))
+		return false;
+
+	if (hashmap->entries != 0)
+		return false;
+
+	hashmap->seed[0] = seed[0];
+	hashmap->seed[1] = seed[1];
 
 	return true;
 }
@@ -340,7 +461,7 @@ LIB_EXPORT void l_hashmap_destroy(struct l_hashmap *hashmap,
 			next = entry->next;
 
 			if (entry != head)
-				l_free(entry);
+				mempool_free(entry, sizeof(struct entry));
 
 			if (next == head)
 				break;
@@ -371,7 +492,7 @@ LIB_EXPORT bool l_hashmap_insert(struct l_hashmap *hashmap,
 		return false;
 
 	key_new = get_key_new(hashmap, key);
-	hash = hashmap->hash_func(key_new);
+	hash = get_hash(hashmap, key_new);
 	head = &hashmap->buckets[hash % NBUCKETS];
 
 	if (!head->next) {
@@ -382,7 +503,7 @@ LIB_EXPORT bool l_hashmap_insert(struct l_hashmap *hashmap,
 		goto done;
 	}
 
-	entry = l_new(struct entry, 1);
+	entry = mempool_new(struct entry);
 	entry->key = key_new;
 	entry->value = value;
 	entry->hash = hash;
@@ -416,7 +537,7 @@ LIB_EXPORT void *l_hashmap_remove(struct l_hashmap *hashmap, const void *key)
 	if (unlikely(!hashmap))
 		return NULL;
 
-	hash = hashmap->hash_func(key);
+	hash = get_hash(hashmap, key);
 	head = &hashmap->buckets[hash % NBUCKETS];
 
 	if (!head->next)
@@ -447,12 +568,12 @@ LIB_EXPORT void *l_hashmap_remove(struct l_hashmap *hashmap, const void *key)
 				head->value = entry->value;
 				head->hash = entry->hash;
 				head->next = entry->next;
-				l_free(entry);
+				mempool_free(entry, sizeof(struct entry));
 			}
 		} else {
 			prev->next = entry->next;
 			free_key(hashmap, entry->key);
-			l_free(entry);
+			mempool_free(entry, sizeof(struct entry));
 		}
 
 		hashmap->entries--;
@@ -484,7 +605,7 @@ LIB_EXPORT void *l_hashmap_lookup(struct l_hashmap *hashmap, const void *key)
 	if (unlikely(!hashmap))
 		return NULL;
 
-	hash = hashmap->hash_func(key);
+	hash = get_hash(hashmap, key);
 	head = &hashmap->buckets[hash % NBUCKETS];
 
 	if (!head->next)
@@ -598,14 +719,14 @@ LIB_EXPORT unsigned int l_hashmap_foreach_remove(struct l_hashmap *hashmap,
 					head->value = entry->value;
 					head->hash = entry->hash;
 					head->next = entry->next;
-					l_free(entry);
+					mempool_free(entry, sizeof(struct entry));
 					entry = head;
 					continue;
 				}
 			} else {
 				prev->next = entry->next;
 				free_key(hashmap, entry->key);
-				l_free(entry);
+				mempool_free(entry, sizeof(struct entry));
 				entry = prev->next;
 				if (entry == head)
 					break;
@@ -24,6 +24,7 @@
 #define __ELL_HASHMAP_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -33,6 +34,8 @@ typedef void (*l_hashmap_foreach_func_t) (const void *key, void *value,
 							void *user_data);
 typedef void (*l_hashmap_destroy_func_t) (void *value);
 typedef unsigned int (*l_hashmap_hash_func_t) (const void *p);
+typedef unsigned int (*l_hashmap_seeded_hash_func_t) (const void *p,
+						const uint64_t seed[2]);
 typedef int (*l_hashmap_compare_func_t) (const void *a, const void *b);
 typedef void *(*l_hashmap_key_new_func_t) (const void *p);
 typedef void (*l_hashmap_key_free_func_t) (void *p);
@@ -42,12 +45,17 @@ typedef bool (*l_hashmap_remove_func_t)(const void *key, void *value,
 struct l_hashmap;
 
 unsigned int l_str_hash(const void *p);
+unsigned int l_str_hash_seeded(const void *p, const uint64_t seed[2]);
 
 struct l_hashmap *l_hashmap_new(void);
 struct l_hashmap *l_hashmap_string_new(void);
 
 bool l_hashmap_set_hash_function(struct l_hashmap *hashmap,
 						l_hashmap_hash_func_t func);
+bool l_hashmap_set_seeded_hash_function(struct l_hashmap *hashmap,
+					l_hashmap_seeded_hash_func_t func);
+bool l_hashmap_set_hash_seed(struct l_hashmap *hashmap,
+					const uint64_t seed[2]);
 bool l_hashmap_set_compare_function(struct l_hashmap *hashmap,
 						l_hashmap_compare_func_t func);
 bool l_hashmap_set_key_copy_function(struct l_hashmap *hashmap,
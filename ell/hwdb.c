@@ -30,15 +30,19 @@
 #include <unistd.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <string.h>
 #include <alloca.h>
 #include <fnmatch.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
 
 #include "util.h"
+#include "hashmap.h"
 #include "hwdb.h"
 #include "private.h"
 
+static void cache_flush(struct l_hwdb *hwdb);
+
 static const char trie_sig[8] = { 'K', 'S', 'L', 'P', 'H', 'H', 'R', 'H' };
 
 struct trie_header {
@@ -85,6 +89,12 @@ struct l_hwdb {
 	size_t size;
 	void *addr;
 	uint64_t root;
+	size_t entry_size;
+	struct l_hashmap *cache;
+	struct cache_entry *cache_head;		/* Most recently used */
+	struct cache_entry *cache_tail;
+	unsigned int cache_size;
+	bool cache_busy;
 };
 
 LIB_EXPORT struct l_hwdb *l_hwdb_new(const char *pathname)
@@ -150,6 +160,7 @@ LIB_EXPORT struct l_hwdb *l_hwdb_new(const char *pathname)
 	hwdb->size = size;
 	hwdb->addr = addr;
 	hwdb->root = L_LE64_TO_CPU(hdr->root_offset);
+	hwdb->entry_size = L_LE64_TO_CPU(hdr->entry_size);
 
 	return l_hwdb_ref(hwdb);
 
@@ -191,6 +202,11 @@ LIB_EXPORT void l_hwdb_unref(struct l_hwdb *hwdb)
 	if (__sync_sub_and_fetch(&hwdb->ref_count, 1))
 		return;
 
+	if (hwdb->cache) {
+		cache_flush(hwdb);
+		l_hashmap_destroy(hwdb->cache, NULL);
+	}
+
 	munmap(hwdb->addr, hwdb->size);
 
 	close(hwdb->fd);
@@ -198,23 +214,84 @@ LIB_EXPORT void l_hwdb_unref(struct l_hwdb *hwdb)
 	l_free(hwdb);
 }
 
-static void trie_fnmatch(const void *addr, uint64_t offset, const char *prefix,
-				const char *string,
-				struct l_hwdb_entry **entries)
+/*
+ * The full pattern of a node is the prefix of its parent, the character
+ * of the child entry and the prefix string of the node itself.  As long
+ * as that contains no glob characters it can only match a modalias that
+ * starts with it, so it is compared one character at a time as the trie
+ * is walked.  The pattern is only built up for fnmatch() below the first
+ * node containing a glob character.
+ */
+struct trie_match {
+	const void *addr;
+	size_t entry_size;
+	const char *string;
+	char *path;
+	size_t path_size;
+	char path_buf[256];
+	l_hwdb_entry_func_t func;
+	void *user_data;
+};
+
+static bool trie_is_glob(char c)
 {
-	const struct trie_node *node = addr + offset;
-	const void *addr_ptr = addr + offset + sizeof(*node);
-	const char *prefix_str = addr + L_LE64_TO_CPU(node->prefix_offset);
-	uint64_t child_count = L_LE64_TO_CPU(node->child_count);
+	return c == '*' || c == '?' || c == '[' || c == '\\';
+}
+
+static void trie_path_reserve(struct trie_match *match, size_t len)
+{
+	size_t size = match->path_size;
+
+	if (len <= size)
+		return;
+
+	while (size < len)
+		size *= 2;
+
+	if (match->path == match->path_buf) {
+		match->path = l_malloc(size);
+		memcpy(match->path, match->path_buf, match->path_size);
+	} else
+		match->path = l_realloc(match->path, size);
+
+	match->path_size = size;
+}
+
+static void trie_add_entries(struct trie_match *match, const void *addr_ptr,
+							uint64_t entry_count)
+{
+	uint64_t i;
+
+	for (i = 0; i < entry_count; i++) {
+		const struct trie_entry *entry = addr_ptr;
+		const char *key_str = match->addr +
+					L_LE64_TO_CPU(entry->key_offset);
+		const char *val_str = match->addr +
+					L_LE64_TO_CPU(entry->value_offset);
+
+		if (key_str[0] == ' ')
+			match->func(key_str + 1, val_str, match->user_data);
+
+		addr_ptr += match->entry_size;
+	}
+}
+
+/* @len characters of the path are already set up by the parent */
+static void trie_match_glob(struct trie_match *match, uint64_t offset,
+								size_t len)
+{
+	const struct trie_node *node = match->addr + offset;
+	const void *addr_ptr = match->addr + offset + sizeof(*node);
+	const char *prefix_str = match->addr +
+					L_LE64_TO_CPU(node->prefix_offset);
+	uint64_t child_count = node->child_count;
 	uint64_t entry_count = L_LE64_TO_CPU(node->entry_count);
+	size_t prefix_len = strlen(prefix_str);
 	uint64_t i;
-	size_t scratch_len;
-	char *scratch_buf;
 
-	scratch_len = strlen(prefix) + strlen(prefix_str);
-	scratch_buf = alloca(scratch_len + 2);
-	sprintf(scratch_buf, "%s%s", prefix, prefix_str);
-	scratch_buf[scratch_len + 1] = '\0';
+	trie_path_reserve(match, len + prefix_len + 2);
+	memcpy(match->path + len, prefix_str, prefix_len);
+	len += prefix_len;
 
 	/*
 	 * Only incur the cost of this fnmatch() if there are children
@@ -222,19 +299,20 @@ static void trie_fnmatch(const void *addr, uint64_t offset, const char *prefix,
 	 * so fnmatch() will only be called once per node.
 	 */
 	if (child_count) {
-		scratch_buf[scratch_len] = '*';
+		match->path[len] = '*';
+		match->path[len + 1] = '\0';
 
-		if (fnmatch(scratch_buf, string, 0) == FNM_NOMATCH)
+		if (fnmatch(match->path, match->string, 0) == FNM_NOMATCH)
 			child_count = 0;
 	}
 
 	for (i = 0; i < child_count; i++) {
 		const struct trie_child *child = addr_ptr;
 
-		scratch_buf[scratch_len] = child->c;
+		match->path[len] = child->c;
 
-		trie_fnmatch(addr, L_LE64_TO_CPU(child->child_offset),
-				scratch_buf, string, entries);
+		trie_match_glob(match, L_LE64_TO_CPU(child->child_offset),
+								len + 1);
 
 		addr_ptr += sizeof(*child);
 	}
@@ -242,28 +320,259 @@ static void trie_fnmatch(const void *addr, uint64_t offset, const char *prefix,
 	if (!entry_count)
 		return;
 
-	scratch_buf[scratch_len] = '\0';
+	match->path[len] = '\0';
 
-	if (fnmatch(scratch_buf, string, 0))
+	if (fnmatch(match->path, match->string, 0))
 		return;
 
-	for (i = 0; i < entry_count; i++) {
-		const struct trie_entry *entry = addr_ptr;
-		const char *key_str = addr + L_LE64_TO_CPU(entry->key_offset);
-		const char *val_str = addr + L_LE64_TO_CPU(entry->value_offset);
-		struct l_hwdb_entry *result;
+	trie_add_entries(match, addr_ptr, entry_count);
+}
 
-		if (key_str[0] == ' ') {
-			result = l_new(struct l_hwdb_entry, 1);
+/* The first @pos characters of the modalias matched the path so far */
+static void trie_match_literal(struct trie_match *match, uint64_t offset,
+								size_t pos)
+{
+	const struct trie_node *node = match->addr + offset;
+	const void *addr_ptr = match->addr + offset + sizeof(*node);
+	const char *prefix_str = match->addr +
+					L_LE64_TO_CPU(node->prefix_offset);
+	const char *string = match->string;
+	uint64_t child_count = node->child_count;
+	uint64_t entry_count = L_LE64_TO_CPU(node->entry_count);
+	uint64_t i;
+	size_t n;
 
-			result->key = key_str + 1;
-			result->value = val_str;
-			result->next = (*entries);
-			*entries = result;
+	for (n = 0; prefix_str[n]; n++) {
+		if (trie_is_glob(prefix_str[n])) {
+			/* Start over at this node with the pattern built up */
+			trie_path_reserve(match, pos + 1);
+			memcpy(match->path, string, pos);
+
+			trie_match_glob(match, offset, pos);
+			return;
+		}
+
+		if (string[pos + n] != prefix_str[n])
+			return;
+	}
+
+	pos += n;
+
+	for (i = 0; i < child_count; i++) {
+		const struct trie_child *child = addr_ptr;
+		uint64_t child_offset = L_LE64_TO_CPU(child->child_offset);
+
+		addr_ptr += sizeof(*child);
+
+		if (!trie_is_glob(child->c)) {
+			if (string[pos] == (char) child->c)
+				trie_match_literal(match, child_offset,
+								pos + 1);
+
+			continue;
 		}
 
-		addr_ptr += sizeof(*entry);
+		trie_path_reserve(match, pos + 2);
+		memcpy(match->path, string, pos);
+		match->path[pos] = child->c;
+
+		trie_match_glob(match, child_offset, pos + 1);
 	}
+
+	if (string[pos] == '\0')
+		trie_add_entries(match, addr_ptr, entry_count);
+}
+
+static void trie_match_init(struct trie_match *match, struct l_hwdb *hwdb,
+				l_hwdb_entry_func_t func, void *user_data)
+{
+	match->addr = hwdb->addr;
+	match->entry_size = hwdb->entry_size;
+	match->string = NULL;
+	match->path = match->path_buf;
+	match->path_size = sizeof(match->path_buf);
+	match->func = func;
+	match->user_data = user_data;
+}
+
+static void trie_match_clear(struct trie_match *match)
+{
+	if (match->path != match->path_buf)
+		l_free(match->path);
+}
+
+static void trie_walk(struct l_hwdb *hwdb, const char *modalias,
+				l_hwdb_entry_func_t func, void *user_data)
+{
+	struct trie_match match;
+
+	trie_match_init(&match, hwdb, func, user_data);
+	match.string = modalias;
+
+	trie_match_literal(&match, hwdb->root, 0);
+
+	trie_match_clear(&match);
+}
+
+/*
+ * Lookup results are cached as key and value pointers into the mapped
+ * file.  The entries form a list in order of use, so the least recently
+ * used one is dropped when the cache is full.
+ */
+struct cache_entry {
+	struct cache_entry *prev;
+	struct cache_entry *next;
+	const char *modalias;
+	unsigned int count;
+	const char *pairs[];
+};
+
+struct cache_collect {
+	const char **pairs;
+	unsigned int count;
+	unsigned int size;
+	const char *buf[32];
+};
+
+static void cache_collect_entry(const char *key, const char *value,
+							void *user_data)
+{
+	struct cache_collect *collect = user_data;
+
+	if (collect->count + 2 > collect->size) {
+		collect->size *= 2;
+
+		if (collect->pairs == collect->buf) {
+			collect->pairs = l_new(const char *, collect->size);
+			memcpy(collect->pairs, collect->buf,
+						sizeof(collect->buf));
+		} else
+			collect->pairs = l_realloc(collect->pairs,
+					collect->size * sizeof(const char *));
+	}
+
+	collect->pairs[collect->count++] = key;
+	collect->pairs[collect->count++] = value;
+}
+
+static void cache_unlink(struct l_hwdb *hwdb, struct cache_entry *entry)
+{
+	if (entry->prev)
+		entry->prev->next = entry->next;
+	else
+		hwdb->cache_head = entry->next;
+
+	if (entry->next)
+		entry->next->prev = entry->prev;
+	else
+		hwdb->cache_tail = entry->prev;
+}
+
+static void cache_push_head(struct l_hwdb *hwdb, struct cache_entry *entry)
+{
+	entry->prev = NULL;
+	entry->next = hwdb->cache_head;
+
+	if (hwdb->cache_head)
+		hwdb->cache_head->prev = entry;
+	else
+		hwdb->cache_tail = entry;
+
+	hwdb->cache_head = entry;
+}
+
+static void cache_flush(struct l_hwdb *hwdb)
+{
+	while (hwdb->cache_head) {
+		struct cache_entry *entry = hwdb->cache_head;
+
+		hwdb->cache_head = entry->next;
+		l_hashmap_remove(hwdb->cache, entry->modalias);
+		l_free(entry);
+	}
+
+	hwdb->cache_tail = NULL;
+}
+
+static struct cache_entry *cache_lookup(struct l_hwdb *hwdb,
+						const char *modalias)
+{
+	struct cache_collect collect;
+	struct cache_entry *entry;
+	size_t len;
+
+	entry = l_hashmap_lookup(hwdb->cache, modalias);
+	if (entry) {
+		if (entry != hwdb->cache_head) {
+			cache_unlink(hwdb, entry);
+			cache_push_head(hwdb, entry);
+		}
+
+		return entry;
+	}
+
+	collect.pairs = collect.buf;
+	collect.count = 0;
+	collect.size = L_ARRAY_SIZE(collect.buf);
+
+	trie_walk(hwdb, modalias, cache_collect_entry, &collect);
+
+	len = strlen(modalias);
+	entry = l_malloc(sizeof(struct cache_entry) +
+				collect.count * sizeof(const char *) + len + 1);
+	entry->count = collect.count / 2;
+	memcpy(entry->pairs, collect.pairs,
+				collect.count * sizeof(const char *));
+	entry->modalias = memcpy(entry->pairs + collect.count, modalias,
+								len + 1);
+
+	if (collect.pairs != collect.buf)
+		l_free(collect.pairs);
+
+	if (l_hashmap_size(hwdb->cache) >= hwdb->cache_size) {
+		struct cache_entry *tail = hwdb->cache_tail;
+
+		cache_unlink(hwdb, tail);
+		l_hashmap_remove(hwdb->cache, tail->modalias);
+		l_free(tail);
+	}
+
+	l_hashmap_insert(hwdb->cache, entry->modalias, entry);
+	cache_push_head(hwdb, entry);
+
+	return entry;
+}
+
+static void entry_prepend(const char *key, const char *value, void *user_data)
+{
+	struct l_hwdb_entry **entries = user_data;
+	struct l_hwdb_entry *result = l_new(struct l_hwdb_entry, 1);
+
+	result->key = key;
+	result->value = value;
+	result->next = *entries;
+	*entries = result;
+}
+
+static struct l_hwdb_entry *hwdb_lookup(struct l_hwdb *hwdb,
+						const char *modalias)
+{
+	struct l_hwdb_entry *entries = NULL;
+	const struct cache_entry *cached;
+	unsigned int i;
+
+	if (!hwdb->cache || hwdb->cache_busy) {
+		trie_walk(hwdb, modalias, entry_prepend, &entries);
+		return entries;
+	}
+
+	cached = cache_lookup(hwdb, modalias);
+
+	for (i = 0; i < cached->count; i++)
+		entry_prepend(cached->pairs[i * 2], cached->pairs[i * 2 + 1],
+								&entries);
+
+	return entries;
 }
 
 LIB_EXPORT struct l_hwdb_entry *l_hwdb_lookup(struct l_hwdb *hwdb,
@@ -282,20 +591,29 @@ LIB_EXPORT struct l_hwdb_entry *l_hwdb_lookup(struct l_hwdb *hwdb,
 LIB_EXPORT struct l_hwdb_entry *l_hwdb_lookup_valist(struct l_hwdb *hwdb,
 					const char *format, va_list args)
 {
-	struct l_hwdb_entry *entries = NULL;
+	struct l_hwdb_entry *entries;
+	char buf[256];
 	char *modalias;
+	va_list copy;
 	int len;
 
 	if (!hwdb || !format)
 		return NULL;
 
-	len = vasprintf(&modalias, format, args);
+	/* Modaliases are short, only format on the heap if needed */
+	va_copy(copy, args);
+	len = vsnprintf(buf, sizeof(buf), format, copy);
+	va_end(copy);
+
 	if (len < 0)
 		return NULL;
 
-	trie_fnmatch(hwdb->addr, hwdb->root, "", modalias, &entries);
+	if ((size_t) len < sizeof(buf))
+		return hwdb_lookup(hwdb, buf);
 
-	free(modalias);
+	modalias = l_strdup_vprintf(format, args);
+	entries = hwdb_lookup(hwdb, modalias);
+	l_free(modalias);
 
 	return entries;
 }
@@ -311,8 +629,252 @@ LIB_EXPORT void l_hwdb_lookup_free(struct l_hwdb_entry *entries)
 	}
 }
 
-static void foreach_node(const void *addr, uint64_t offset, const char *prefix,
-				l_hwdb_foreach_func_t func, void *user_data)
+LIB_EXPORT bool l_hwdb_lookup_foreach(struct l_hwdb *hwdb, const char *modalias,
+					l_hwdb_entry_func_t func,
+					void *user_data)
+{
+	const struct cache_entry *cached;
+	unsigned int i;
+
+	if (!hwdb || !modalias || !func)
+		return false;
+
+	if (!hwdb->cache || hwdb->cache_busy) {
+		trie_walk(hwdb, modalias, func, user_data);
+		return true;
+	}
+
+	cached = cache_lookup(hwdb, modalias);
+
+	/* Lookups from within func bypass the cache and can't evict this */
+	hwdb->cache_busy = true;
+
+	for (i = 0; i < cached->count; i++)
+		func(cached->pairs[i * 2], cached->pairs[i * 2 + 1], user_data);
+
+	hwdb->cache_busy = false;
+
+	return true;
+}
+
+/*
+ * The cache holds pointers into the mapping, so it lives as long as @hwdb
+ * and isn't checked against the file.  A database replaced by rename, as
+ * udev does, leaves the mapping and the cached results intact; like
+ * uncached lookups they keep using the old database until a new l_hwdb is
+ * opened.  With a cache, lookups modify @hwdb and a cached hwdb can't be
+ * shared between threads.
+ */
+LIB_EXPORT bool l_hwdb_set_cache_size(struct l_hwdb *hwdb, unsigned int size)
+{
+	if (!hwdb || hwdb->cache_busy)
+		return false;
+
+	if (hwdb->cache)
+		cache_flush(hwdb);
+
+	hwdb->cache_size = size;
+
+	if (!size) {
+		l_hashmap_destroy(hwdb->cache, NULL);
+		hwdb->cache = NULL;
+		return true;
+	}
+
+	/* The keys are the modalias strings stored in the entries */
+	if (!hwdb->cache) {
+		hwdb->cache = l_hashmap_string_new();
+		l_hashmap_set_key_copy_function(hwdb->cache, NULL);
+		l_hashmap_set_key_free_function(hwdb->cache, NULL);
+	}
+
+	return true;
+}
+
+/*
+ * Sorting the modaliases makes the ones that share the pattern of a node
+ * adjacent, so each node is visited once for a range of them and each
+ * child takes a subrange.  Like with single lookups only subtrees below a
+ * glob character are matched per modalias.
+ */
+struct many_item {
+	const char *modalias;
+	unsigned int index;
+};
+
+struct trie_many {
+	struct trie_match match;
+	struct many_item *items;
+	unsigned int index;
+	l_hwdb_lookup_many_func_t func;
+	void *user_data;
+};
+
+static int many_item_compare(const void *a, const void *b)
+{
+	const struct many_item *item_a = a;
+	const struct many_item *item_b = b;
+
+	return strcmp(item_a->modalias, item_b->modalias);
+}
+
+static void many_entry(const char *key, const char *value, void *user_data)
+{
+	struct trie_many *many = user_data;
+
+	many->func(many->index, key, value, many->user_data);
+}
+
+/* First item in [lo, hi) with a character at @pos above @c or not below */
+static unsigned int many_bound(const struct many_item *items,
+				unsigned int lo, unsigned int hi,
+				size_t pos, unsigned char c, bool above)
+{
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		unsigned char m = items[mid].modalias[pos];
+
+		if (m < c || (above && m == c))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static void many_glob(struct trie_many *many, unsigned int i,
+				uint64_t offset, size_t pos, int c)
+{
+	struct trie_match *match = &many->match;
+
+	many->index = many->items[i].index;
+	match->string = many->items[i].modalias;
+
+	trie_path_reserve(match, pos + 2);
+	memcpy(match->path, match->string, pos);
+
+	if (c) {
+		match->path[pos] = c;
+		pos += 1;
+	}
+
+	trie_match_glob(match, offset, pos);
+}
+
+/* The items in [lo, hi) all matched the path so far */
+static void many_literal(struct trie_many *many, uint64_t offset, size_t pos,
+					unsigned int lo, unsigned int hi)
+{
+	const void *addr = many->match.addr;
+	const struct trie_node *node = addr + offset;
+	const void *addr_ptr = addr + offset + sizeof(*node);
+	const char *prefix_str = addr + L_LE64_TO_CPU(node->prefix_offset);
+	uint64_t child_count = node->child_count;
+	uint64_t entry_count = L_LE64_TO_CPU(node->entry_count);
+	unsigned int i;
+	uint64_t j;
+	size_t n;
+
+	for (n = 0; prefix_str[n]; n++) {
+		unsigned char c = prefix_str[n];
+
+		if (trie_is_glob(c)) {
+			for (i = lo; i < hi; i++)
+				many_glob(many, i, offset, pos, 0);
+
+			return;
+		}
+
+		lo = many_bound(many->items, lo, hi, pos + n, c, false);
+		hi = many_bound(many->items, lo, hi, pos + n, c, true);
+
+		if (lo == hi)
+			return;
+	}
+
+	pos += n;
+
+	for (j = 0; j < child_count; j++) {
+		const struct trie_child *child = addr_ptr;
+		uint64_t child_offset = L_LE64_TO_CPU(child->child_offset);
+		unsigned int child_lo, child_hi;
+
+		addr_ptr += sizeof(*child);
+
+		if (!child->c)
+			continue;
+
+		if (trie_is_glob(child->c)) {
+			for (i = lo; i < hi; i++)
+				many_glob(many, i, child_offset, pos,
+								child->c);
+
+			continue;
+		}
+
+		child_lo = many_bound(many->items, lo, hi, pos, child->c,
+									false);
+		child_hi = many_bound(many->items, child_lo, hi, pos,
+							child->c, true);
+
+		if (child_lo < child_hi)
+			many_literal(many, child_offset, pos + 1,
+							child_lo, child_hi);
+	}
+
+	/* The modaliases ending here sort first */
+	for (i = lo; i < hi && !many->items[i].modalias[pos]; i++) {
+		many->index = many->items[i].index;
+		trie_add_entries(&many->match, addr_ptr, entry_count);
+	}
+}
+
+LIB_EXPORT bool l_hwdb_lookup_many(struct l_hwdb *hwdb,
+					const char * const *modaliases,
+					unsigned int count,
+					l_hwdb_lookup_many_func_t func,
+					void *user_data)
+{
+	struct trie_many many;
+	unsigned int n = 0;
+	unsigned int i;
+
+	if (!hwdb || (count && !modaliases) || !func)
+		return false;
+
+	if (!count)
+		return true;
+
+	many.items = l_new(struct many_item, count);
+	many.func = func;
+	many.user_data = user_data;
+
+	for (i = 0; i < count; i++) {
+		if (!modaliases[i])
+			continue;
+
+		many.items[n].modalias = modaliases[i];
+		many.items[n].index = i;
+		n += 1;
+	}
+
+	qsort(many.items, n, sizeof(struct many_item), many_item_compare);
+
+	trie_match_init(&many.match, hwdb, many_entry, &many);
+
+	if (n)
+		many_literal(&many, hwdb->root, 0, 0, n);
+
+	trie_match_clear(&many.match);
+	l_free(many.items);
+
+	return true;
+}
+
+static void foreach_node(const void *addr, size_t entry_size, uint64_t offset,
+				const char *prefix, l_hwdb_foreach_func_t func,
+				void *user_data)
 {
 	const struct trie_node *node = addr + offset;
 	const void *addr_ptr = addr + offset + sizeof(*node);
@@ -334,8 +896,9 @@ static void foreach_node(const void *addr, uint64_t offset, const char *prefix,
 
 		scratch_buf[scratch_len] = child->c;
 
-		foreach_node(addr, L_LE64_TO_CPU(child->child_offset),
-						scratch_buf, func, user_data);
+		foreach_node(addr, entry_size,
+				L_LE64_TO_CPU(child->child_offset),
+				scratch_buf, func, user_data);
 
 		addr_ptr += sizeof(*child);
 	}
@@ -360,7 +923,8 @@ static void foreach_node(const void *addr, uint64_t offset, const char *prefix,
 			entries = result;
 		}
 
-		addr_ptr += sizeof(*entry);
+		/* Newer versions append fields to the entry structure */
+		addr_ptr += entry_size;
 	}
 
 	func(scratch_buf, entries, user_data);
@@ -374,7 +938,8 @@ LIB_EXPORT bool l_hwdb_foreach(struct l_hwdb *hwdb, l_hwdb_foreach_func_t func,
 	if (!hwdb || !func)
 		return false;
 
-	foreach_node(hwdb->addr, hwdb->root, "", func, user_data);
+	foreach_node(hwdb->addr, hwdb->entry_size, hwdb->root, "",
+							func, user_data);
 
 	return true;
 }
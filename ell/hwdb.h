@@ -49,6 +49,22 @@ struct l_hwdb_entry *l_hwdb_lookup_valist(struct l_hwdb *hwdb,
 					const char *format, va_list args);
 void l_hwdb_lookup_free(struct l_hwdb_entry *entries);
 
+typedef void (*l_hwdb_entry_func_t)(const char *key, const char *value,
+							void *user_data);
+typedef void (*l_hwdb_lookup_many_func_t)(unsigned int index,
+					const char *key, const char *value,
+					void *user_data);
+
+bool l_hwdb_lookup_foreach(struct l_hwdb *hwdb, const char *modalias,
+					l_hwdb_entry_func_t func,
+					void *user_data);
+bool l_hwdb_lookup_many(struct l_hwdb *hwdb,
+					const char * const *modaliases,
+					unsigned int count,
+					l_hwdb_lookup_many_func_t func,
+					void *user_data);
+bool l_hwdb_set_cache_size(struct l_hwdb *hwdb, unsigned int size);
+
 typedef void (*l_hwdb_foreach_func_t)(const char *modalias,
 					struct l_hwdb_entry *entries,
 							void *user_data);
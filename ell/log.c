@@ -26,16 +26,29 @@
 
 #define _GNU_SOURCE
 #include <stdio.h>
+#include <sched.h>
+#include <stdint.h>
+#include <inttypes.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include <errno.h>
 #include <fnmatch.h>
+#include <pthread.h>
+#include <sys/uio.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/eventfd.h>
 
+#include "util.h"
 #include "queue.h"
+#include "io.h"
+#include "time.h"
+#include "utf8.h"
+#include "ringbuf.h"
 #include "log.h"
+#include "log-private.h"
 #include "private.h"
 
 struct debug_section {
@@ -68,8 +81,20 @@ static const char *log_ident = "";
 static int log_fd = -1;
 static unsigned long log_pid;
 
-static inline void close_log(void)
+static bool async_enabled;
+static struct l_io *async_sink_io;
+
+static bool async_flush(bool wait);
+
+static void close_log(void)
 {
+	/* Hand whatever is still queued to the sink it was logged for */
+	if (async_enabled)
+		async_flush(true);
+
+	l_io_destroy(async_sink_io);
+	async_sink_io = NULL;
+
 	if (log_fd > 0) {
 		close(log_fd);
 		log_fd = -1;
@@ -157,29 +182,35 @@ LIB_EXPORT void l_log_set_stderr(void)
 	log_func = log_stderr;
 }
 
+static unsigned int syslog_iov(struct iovec *iov, char *hdr, size_t hdr_size,
+					int priority, const char *str,
+					size_t str_len)
+{
+	iov[0].iov_base = hdr;
+	iov[0].iov_len  = snprintf(hdr, hdr_size, "<%i>%s[%lu]: ", priority,
+					log_ident, (unsigned long) log_pid);
+	iov[1].iov_base = (char *) str;
+	iov[1].iov_len  = str_len;
+
+	return 2;
+}
+
 static void log_syslog(int priority, const char *file, const char *line,
 			const char *func, const char *format, va_list ap)
 {
 	struct msghdr msg;
 	struct iovec iov[2];
 	char hdr[64], *str;
-	int hdr_len, str_len;
+	int str_len;
 
 	str_len = vasprintf(&str, format, ap);
 	if (str_len < 0)
 		return;
 
-	hdr_len = snprintf(hdr, sizeof(hdr), "<%i>%s[%lu]: ", priority,
-					log_ident, (unsigned long) log_pid);
-
-	iov[0].iov_base = hdr;
-	iov[0].iov_len  = hdr_len;
-	iov[1].iov_base = str;
-	iov[1].iov_len  = str_len;
-
 	memset(&msg, 0, sizeof(msg));
 	msg.msg_iov = iov;
-	msg.msg_iovlen = 2;
+	msg.msg_iovlen = syslog_iov(iov, hdr, sizeof(hdr), priority,
+							str, str_len);
 
 	sendmsg(log_fd, &msg, 0);
 
@@ -205,26 +236,20 @@ LIB_EXPORT void l_log_set_syslog(void)
 	log_func = log_syslog;
 }
 
-static void log_journal(int priority, const char *file, const char *line,
-			const char *func, const char *format, va_list ap)
-{
-	struct msghdr msg;
-	struct iovec iov[12];
-	char prio[16], *str;
-	int prio_len, str_len;
-
-	str_len = vasprintf(&str, format, ap);
-	if (str_len < 0)
-		return;
-
-	prio_len = snprintf(prio, sizeof(prio), "PRIORITY=%u\n", priority);
+#define JOURNAL_IOV_MAX 12
 
+static unsigned int journal_iov(struct iovec *iov, char *prio,
+					size_t prio_size, int priority,
+					const char *file, const char *line,
+					const char *func, const char *str,
+					size_t str_len)
+{
 	iov[0].iov_base = "MESSAGE=";
 	iov[0].iov_len  = 8;
-	iov[1].iov_base = str;
+	iov[1].iov_base = (char *) str;
 	iov[1].iov_len  = str_len;
 	iov[2].iov_base = prio;
-	iov[2].iov_len  = prio_len;
+	iov[2].iov_len  = snprintf(prio, prio_size, "PRIORITY=%u\n", priority);
 	iov[3].iov_base = "CODE_FILE=";
 	iov[3].iov_len  = 10;
 	iov[4].iov_base = (char *) file;
@@ -244,9 +269,25 @@ static void log_journal(int priority, const char *file, const char *line,
 	iov[11].iov_base = "\n";
 	iov[11].iov_len  = 1;
 
+	return JOURNAL_IOV_MAX;
+}
+
+static void log_journal(int priority, const char *file, const char *line,
+			const char *func, const char *format, va_list ap)
+{
+	struct msghdr msg;
+	struct iovec iov[JOURNAL_IOV_MAX];
+	char prio[16], *str;
+	int str_len;
+
+	str_len = vasprintf(&str, format, ap);
+	if (str_len < 0)
+		return;
+
 	memset(&msg, 0, sizeof(msg));
 	msg.msg_iov = iov;
-	msg.msg_iovlen = 12;
+	msg.msg_iovlen = journal_iov(iov, prio, sizeof(prio), priority,
+					file, line, func, str, str_len);
 
 	sendmsg(log_fd, &msg, 0);
 
@@ -272,6 +313,589 @@ LIB_EXPORT void l_log_set_journal(void)
 	log_func = log_journal;
 }
 
+/* Lets unit tests log to one end of a socket pair */
+void _log_set_socket(int fd, bool journal)
+{
+	close_log();
+
+	log_fd = fd;
+	log_pid = getpid();
+
+	log_func = journal ? log_journal : log_syslog;
+}
+
+/*
+ * Asynchronous logging.  Every thread that logs gets a single producer /
+ * single consumer ring of its own, into which records are formatted in
+ * place without taking any lock.  The main loop thread is the only
+ * consumer: an eventfd wakes it up and it hands the queued records to the
+ * sink in batches.
+ *
+ * When a thread exits, a thread specific key destructor marks its ring as
+ * retired and the consumer frees it once everything in it has been sent.
+ */
+#define ASYNC_DEFAULT_SIZE	(64 * 1024)
+#define ASYNC_BATCH		32
+
+struct async_record {
+	uint32_t size;		/* Including header and padding */
+	int32_t priority;
+	uint32_t file_len;
+	uint32_t line_len;
+	uint32_t func_len;
+	uint32_t msg_len;
+	char data[];		/* file, line, func and message, NUL separated */
+};
+
+struct async_ring {
+	struct l_ringbuf *ringbuf;
+	unsigned long dropped;		/* Updated by the producer */
+	unsigned long reported;		/* Updated by the consumer */
+	bool retired;			/* Set once the producer exited */
+	struct async_ring *next;
+};
+
+static size_t async_ring_size;
+static unsigned int async_generation;
+static struct async_ring *async_rings;
+static int async_fd = -1;
+static struct l_io *async_io;
+static bool async_pending;
+
+static __thread struct async_ring *thread_ring;
+static __thread unsigned int thread_generation;
+
+static pthread_key_t async_ring_key;
+static pthread_once_t async_ring_once = PTHREAD_ONCE_INIT;
+static bool async_ring_key_valid;
+
+static inline const char *record_line(const struct async_record *rec)
+{
+	return rec->data + rec->file_len + 1;
+}
+
+static inline const char *record_func(const struct async_record *rec)
+{
+	return record_line(rec) + rec->line_len + 1;
+}
+
+static inline const char *record_msg(const struct async_record *rec)
+{
+	return record_func(rec) + rec->func_len + 1;
+}
+
+static size_t async_record_vformat(void *buf, size_t avail, int priority,
+					const char *file, const char *line,
+					const char *func, const char *format,
+					va_list ap)
+{
+	struct async_record *rec = buf;
+	size_t file_len = strlen(file);
+	size_t line_len = strlen(line);
+	size_t func_len = strlen(func);
+	size_t len = sizeof(*rec) + file_len + line_len + func_len + 3;
+	char *ptr;
+	int msg_len;
+
+	if (!rec || len >= avail)
+		return 0;
+
+	ptr = mempcpy(rec->data, file, file_len + 1);
+	ptr = mempcpy(ptr, line, line_len + 1);
+	ptr = mempcpy(ptr, func, func_len + 1);
+
+	msg_len = vsnprintf(ptr, avail - len, format, ap);
+	if (msg_len < 0 || (size_t) msg_len >= avail - len)
+		return 0;
+
+	/* Keep the next record header aligned */
+	len = align_len(len + msg_len + 1, 8);
+	if (len > avail)
+		return 0;
+
+	rec->size = len;
+	rec->priority = priority;
+	rec->file_len = file_len;
+	rec->line_len = line_len;
+	rec->func_len = func_len;
+	rec->msg_len = msg_len;
+
+	return len;
+}
+
+static size_t __attribute__((format(printf, 7, 8))) async_record_format(
+					void *buf, size_t avail, int priority,
+					const char *file, const char *line,
+					const char *func, const char *format, ...)
+{
+	va_list ap;
+	size_t len;
+
+	va_start(ap, format);
+	len = async_record_vformat(buf, avail, priority, file, line, func,
+								format, ap);
+	va_end(ap);
+
+	return len;
+}
+
+static void async_wakeup(void);
+
+static void async_ring_retire(void *data)
+{
+	struct async_ring *ring = data;
+	unsigned int generation = __atomic_load_n(&async_generation,
+							__ATOMIC_ACQUIRE);
+
+	/* Rings of an earlier asynchronous period are already gone */
+	if (thread_generation != generation)
+		return;
+
+	/* Any later destructor that logs gets a ring of its own */
+	thread_ring = NULL;
+
+	__atomic_store_n(&ring->retired, true, __ATOMIC_RELEASE);
+	async_wakeup();
+}
+
+static void async_ring_key_create(void)
+{
+	async_ring_key_valid = !pthread_key_create(&async_ring_key,
+							async_ring_retire);
+}
+
+static struct async_ring *async_get_ring(void)
+{
+	unsigned int generation = __atomic_load_n(&async_generation,
+							__ATOMIC_ACQUIRE);
+	struct async_ring *ring;
+
+	if (thread_ring && thread_generation == generation)
+		return thread_ring;
+
+	/* Without a way to retire the ring on thread exit, log synchronously */
+	pthread_once(&async_ring_once, async_ring_key_create);
+	if (!async_ring_key_valid)
+		return NULL;
+
+	ring = l_new(struct async_ring, 1);
+	ring->ringbuf = l_ringbuf_new_mirrored(async_ring_size);
+
+	if (!ring->ringbuf || !l_ringbuf_enable_spsc(ring->ringbuf) ||
+			pthread_setspecific(async_ring_key, ring)) {
+		l_ringbuf_free(ring->ringbuf);
+		l_free(ring);
+		return NULL;
+	}
+
+	/* Rings are only ever added while logging is asynchronous */
+	ring->next = __atomic_load_n(&async_rings, __ATOMIC_RELAXED);
+
+	while (!__atomic_compare_exchange_n(&async_rings, &ring->next, ring,
+						true, __ATOMIC_RELEASE,
+						__ATOMIC_RELAXED))
+		;
+
+	thread_ring = ring;
+	thread_generation = generation;
+
+	return ring;
+}
+
+static void async_wakeup(void)
+{
+	static const uint64_t one = 1;
+
+	/* Only the first record since the consumer last ran needs a write */
+	if (__atomic_exchange_n(&async_pending, true, __ATOMIC_ACQ_REL))
+		return;
+
+	if (write(async_fd, &one, sizeof(one)) < 0)
+		return;
+}
+
+static bool log_async(int priority, const char *file, const char *line,
+			const char *func, const char *format, va_list ap)
+{
+	struct async_ring *ring = async_get_ring();
+	size_t avail = 0;
+	size_t len;
+	void *buf;
+
+	if (!ring)
+		return false;
+
+	buf = l_ringbuf_reserve(ring->ringbuf, &avail);
+
+	len = async_record_vformat(buf, avail, priority, file, line, func,
+								format, ap);
+	if (len)
+		l_ringbuf_commit(ring->ringbuf, len);
+	else
+		__atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+
+	async_wakeup();
+
+	return true;
+}
+
+static void __attribute__((format(printf, 5, 6))) call_handler(int priority,
+					const char *file, const char *line,
+					const char *func, const char *format, ...)
+{
+	va_list ap;
+
+	va_start(ap, format);
+	log_func(priority, file, line, func, format, ap);
+	va_end(ap);
+}
+
+static unsigned int async_send_handler(struct async_record **recs,
+							unsigned int n)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		call_handler(recs[i]->priority, recs[i]->data,
+				record_line(recs[i]), record_func(recs[i]),
+				"%s", record_msg(recs[i]));
+
+	return n;
+}
+
+static unsigned int async_send_stderr(struct async_record **recs,
+							unsigned int n)
+{
+	struct iovec iov[ASYNC_BATCH];
+	unsigned int i = 0;
+	ssize_t written;
+
+	for (i = 0; i < n; i++) {
+		iov[i].iov_base = (char *) record_msg(recs[i]);
+		iov[i].iov_len = recs[i]->msg_len;
+	}
+
+	i = 0;
+
+	while (i < n) {
+		written = writev(STDERR_FILENO, iov + i, n - i);
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+
+			break;
+		}
+
+		while (i < n && (size_t) written >= iov[i].iov_len)
+			written -= iov[i++].iov_len;
+
+		if (i < n) {
+			iov[i].iov_base += written;
+			iov[i].iov_len -= written;
+		}
+	}
+
+	return n;
+}
+
+static unsigned int async_send_socket(struct async_record **recs,
+						unsigned int n, bool wait)
+{
+	struct mmsghdr msgs[ASYNC_BATCH];
+	struct iovec iov[ASYNC_BATCH * JOURNAL_IOV_MAX];
+	char hdrs[ASYNC_BATCH][64];
+	struct iovec *next = iov;
+	unsigned int i;
+	int r;
+
+	memset(msgs, 0, n * sizeof(struct mmsghdr));
+
+	for (i = 0; i < n; i++) {
+		const char *msg = record_msg(recs[i]);
+		unsigned int iovlen;
+
+		if (log_func == log_syslog)
+			iovlen = syslog_iov(next, hdrs[i], sizeof(hdrs[i]),
+						recs[i]->priority,
+						msg, recs[i]->msg_len);
+		else
+			iovlen = journal_iov(next, hdrs[i], sizeof(hdrs[i]),
+						recs[i]->priority,
+						recs[i]->data,
+						record_line(recs[i]),
+						record_func(recs[i]),
+						msg, recs[i]->msg_len);
+
+		msgs[i].msg_hdr.msg_iov = next;
+		msgs[i].msg_hdr.msg_iovlen = iovlen;
+		next += iovlen;
+	}
+
+	r = sendmmsg(log_fd, msgs, n, wait ? 0 : MSG_DONTWAIT);
+	if (r > 0)
+		return r;
+
+	if (errno == EAGAIN || errno == EINTR)
+		return 0;
+
+	/* The receiving end is gone, there is no point in keeping these */
+	return n;
+}
+
+static unsigned int async_send(struct async_record **recs, unsigned int n,
+								bool wait)
+{
+	if (log_func == log_syslog || log_func == log_journal)
+		return async_send_socket(recs, n, wait);
+
+	if (log_func == log_stderr)
+		return async_send_stderr(recs, n);
+
+	return async_send_handler(recs, n);
+}
+
+static bool async_report_dropped(unsigned long count, bool wait)
+{
+	uint64_t buf[32];
+	struct async_record *rec = (struct async_record *) buf;
+
+	if (!async_record_format(buf, sizeof(buf), L_LOG_WARNING,
+					__FILE__, L_STRINGIFY(__LINE__),
+					__func__, "%lu log messages dropped\n",
+					count))
+		return true;
+
+	return async_send(&rec, 1, wait) == 1;
+}
+
+static bool async_flush_ring(struct async_ring *ring, bool wait)
+{
+	struct async_record *recs[ASYNC_BATCH];
+	size_t limit = l_ringbuf_len(ring->ringbuf);
+	unsigned long dropped;
+
+	/*
+	 * Only flush what is there already, so that a busy producer can't
+	 * keep the consumer in here forever.
+	 */
+	while (limit) {
+		uint8_t *data = l_ringbuf_peek(ring->ringbuf, 0, NULL);
+		size_t offset = 0;
+		unsigned int n = 0;
+		unsigned int i, sent;
+
+		while (n < ASYNC_BATCH && offset < limit) {
+			recs[n] = (struct async_record *) (data + offset);
+			offset += recs[n++]->size;
+		}
+
+		sent = async_send(recs, n, wait);
+
+		for (i = 0, offset = 0; i < sent; i++)
+			offset += recs[i]->size;
+
+		l_ringbuf_drain(ring->ringbuf, offset);
+		limit -= offset;
+
+		if (sent < n)
+			return false;
+	}
+
+	dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+	if (dropped == ring->reported)
+		return true;
+
+	if (!async_report_dropped(dropped - ring->reported, wait))
+		return false;
+
+	ring->reported = dropped;
+
+	return true;
+}
+
+/* Returns the ring that now precedes the unlinked one's successor */
+static struct async_ring *async_ring_unlink(struct async_ring *prev,
+						struct async_ring *ring)
+{
+	struct async_ring *head = ring;
+
+	/* Producers only ever push to the head, everything else is ours */
+	if (!prev && __atomic_compare_exchange_n(&async_rings, &head,
+						ring->next, false,
+						__ATOMIC_ACQUIRE,
+						__ATOMIC_ACQUIRE))
+		return NULL;
+
+	if (!prev)
+		for (prev = head; prev->next != ring; prev = prev->next)
+			;
+
+	prev->next = ring->next;
+
+	return prev;
+}
+
+static bool async_flush(bool wait)
+{
+	struct async_ring *prev = NULL;
+	struct async_ring *ring;
+	struct async_ring *next;
+
+	for (ring = __atomic_load_n(&async_rings, __ATOMIC_ACQUIRE); ring;
+								ring = next) {
+		/* Everything a retired ring will ever hold is committed */
+		bool retired = __atomic_load_n(&ring->retired,
+							__ATOMIC_ACQUIRE);
+
+		next = ring->next;
+
+		if (!async_flush_ring(ring, wait))
+			return false;
+
+		if (!retired || l_ringbuf_len(ring->ringbuf)) {
+			prev = ring;
+			continue;
+		}
+
+		prev = async_ring_unlink(prev, ring);
+
+		l_ringbuf_free(ring->ringbuf);
+		l_free(ring);
+	}
+
+	return true;
+}
+
+static bool async_sink_writable(struct l_io *io, void *user_data)
+{
+	return !async_flush(false);
+}
+
+static bool async_read_handler(struct l_io *io, void *user_data)
+{
+	uint64_t count;
+
+	if (read(async_fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+		return true;
+
+	/*
+	 * The exchange acquires the producers' release of async_pending, so
+	 * records committed before it are seen by the flush below
+	 */
+	(void) __atomic_exchange_n(&async_pending, false, __ATOMIC_ACQ_REL);
+
+	if (async_flush(false))
+		return true;
+
+	/* The log socket is full, continue once it becomes writable */
+	if (!async_sink_io)
+		async_sink_io = l_io_new(log_fd);
+
+	l_io_set_write_handler(async_sink_io, async_sink_writable, NULL, NULL);
+
+	return true;
+}
+
+/**
+ * l_log_enable_async:
+ * @ring_size: size of the per-thread ring buffers or 0 for the default
+ *
+ * Switches to asynchronous logging.  Instead of calling the log handler
+ * right away, every thread formats its messages into a preallocated ring
+ * buffer of its own and the main loop hands them to the log handler in
+ * batches.  The buffer of a thread is released after it exits and its
+ * messages have been handed over.  Logging to syslog or the journal sends
+ * each batch with a single sendmmsg(2) call.  If a ring buffer is full,
+ * messages are dropped and the number of dropped messages is logged once
+ * there is room again.
+ *
+ * This requires the main loop to be initialized and must be called from
+ * the main loop thread.
+ *
+ * Returns: #true on success, #false otherwise
+ **/
+LIB_EXPORT bool l_log_enable_async(size_t ring_size)
+{
+	if (async_enabled)
+		return false;
+
+	async_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (async_fd < 0)
+		return false;
+
+	async_io = l_io_new(async_fd);
+	if (!async_io) {
+		close(async_fd);
+		async_fd = -1;
+		return false;
+	}
+
+	l_io_set_read_handler(async_io, async_read_handler, NULL, NULL);
+
+	async_ring_size = ring_size ? ring_size : ASYNC_DEFAULT_SIZE;
+
+	/* Rings of a previous asynchronous period must not be reused */
+	__atomic_add_fetch(&async_generation, 1, __ATOMIC_RELEASE);
+	__atomic_store_n(&async_enabled, true, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+/**
+ * l_log_disable_async:
+ *
+ * Hands all queued messages to the log handler and switches back to
+ * synchronous logging.  This must be called from the main loop thread,
+ * before l_main_exit and while no other thread is logging.
+ **/
+LIB_EXPORT void l_log_disable_async(void)
+{
+	struct async_ring *ring;
+
+	if (!async_enabled)
+		return;
+
+	__atomic_store_n(&async_enabled, false, __ATOMIC_RELEASE);
+
+	async_flush(true);
+
+	l_io_destroy(async_sink_io);
+	async_sink_io = NULL;
+
+	l_io_destroy(async_io);
+	async_io = NULL;
+
+	close(async_fd);
+	async_fd = -1;
+
+	/* Exiting threads must no longer touch the rings freed below */
+	__atomic_add_fetch(&async_generation, 1, __ATOMIC_RELEASE);
+
+	while ((ring = async_rings)) {
+		async_rings = ring->next;
+
+		l_ringbuf_free(ring->ringbuf);
+		l_free(ring);
+	}
+
+	async_pending = false;
+}
+
+/**
+ * l_log_flush:
+ *
+ * Hands all messages queued by asynchronous logging to the log handler,
+ * waiting for the log socket if necessary.  This must be called from the
+ * main loop thread.
+ **/
+LIB_EXPORT void l_log_flush(void)
+{
+	if (!async_enabled)
+		return;
+
+	async_flush(true);
+}
+
 /**
  * l_log_with_location:
  * @priority: priority level
@@ -290,7 +914,12 @@ LIB_EXPORT void l_log_with_location(int priority,
 	va_list ap;
 
 	va_start(ap, format);
-	log_func(priority, file, line, func, format, ap);
+
+	if (!__atomic_load_n(&async_enabled, __ATOMIC_ACQUIRE) ||
+			log_func == log_null ||
+			!log_async(priority, file, line, func, format, ap))
+		log_func(priority, file, line, func, format, ap);
+
 	va_end(ap);
 }
 
@@ -322,6 +951,7 @@ LIB_EXPORT void l_log_with_location(int priority,
  **/
 
 static const char *debug_pattern;
+static unsigned int debug_flags = L_DEBUG_FLAG_PRINT;
 
 void debug_enable(struct l_debug_desc *start, struct l_debug_desc *stop)
 {
@@ -340,9 +970,9 @@ void debug_enable(struct l_debug_desc *start, struct l_debug_desc *stop)
 
 		for (desc = start; desc < stop; desc++) {
 			if (!fnmatch(str, desc->file, 0))
-				desc->flags |= L_DEBUG_FLAG_PRINT;
+				desc->flags |= debug_flags;
 			if (!fnmatch(str, desc->func, 0))
-				desc->flags |= L_DEBUG_FLAG_PRINT;
+				desc->flags |= debug_flags;
 		}
 	}
 }
@@ -352,7 +982,7 @@ void debug_disable(struct l_debug_desc *start, struct l_debug_desc *stop)
 	struct l_debug_desc *desc;
 
 	for (desc = start; desc < stop; desc++)
-		desc->flags &= ~L_DEBUG_FLAG_PRINT;
+		desc->flags &= ~(L_DEBUG_FLAG_PRINT | L_DEBUG_FLAG_BINARY);
 }
 
 /**
@@ -441,6 +1071,803 @@ LIB_EXPORT void l_debug_disable(void)
 	debug_pattern = NULL;
 }
 
+/*
+ * Binary debug logging.  Instead of formatting the message, the enabled
+ * l_debug sites record the descriptor, a timestamp and the raw arguments
+ * into a flight recorder ring, which overwrites the oldest records when it
+ * is full.  The messages are only formatted when the ring is dumped.
+ */
+#define DEBUG_RECORD_MAX	512
+#define DEBUG_RING_MIN		(4 * DEBUG_RECORD_MAX)
+#define DEBUG_MSG_MAX		1024
+#define DEBUG_STR_NULL		UINT32_MAX
+
+struct debug_record {
+	uint32_t size;
+	int32_t err;
+	uint64_t timestamp;
+	const struct l_debug_desc *desc;
+	const char *line;
+	const char *format;
+	uint8_t args[];
+};
+
+enum debug_length {
+	DEBUG_LEN_NONE,
+	DEBUG_LEN_HH,
+	DEBUG_LEN_H,
+	DEBUG_LEN_L,
+	DEBUG_LEN_LL,
+	DEBUG_LEN_J,
+	DEBUG_LEN_Z,
+	DEBUG_LEN_T,
+	DEBUG_LEN_LD,
+};
+
+struct debug_conv {
+	const char *start;
+	const char *end;
+	bool width_arg;
+	bool prec_arg;
+	enum debug_length length;
+	char conv;
+};
+
+static bool debug_ring_lock;
+static uint8_t *debug_ring;
+static size_t debug_ring_size;
+static uint64_t debug_ring_head;
+static uint64_t debug_ring_tail;
+
+static const char *debug_next_conv(const char *format,
+						struct debug_conv *conv)
+{
+	const char *ptr = strchr(format, '%');
+
+	if (!ptr)
+		return NULL;
+
+	memset(conv, 0, sizeof(*conv));
+	conv->start = ptr++;
+
+	while (*ptr && strchr("-+ #0'I", *ptr))
+		ptr++;
+
+	if (*ptr == '*') {
+		conv->width_arg = true;
+		ptr++;
+	} else {
+		while (l_ascii_isdigit(*ptr))
+			ptr++;
+	}
+
+	if (*ptr == '.') {
+		ptr++;
+
+		if (*ptr == '*') {
+			conv->prec_arg = true;
+			ptr++;
+		} else {
+			while (l_ascii_isdigit(*ptr))
+				ptr++;
+		}
+	}
+
+	switch (*ptr) {
+	case 'h':
+		conv->length = DEBUG_LEN_H;
+
+		if (*++ptr == 'h') {
+			conv->length = DEBUG_LEN_HH;
+			ptr++;
+		}
+
+		break;
+	case 'l':
+		conv->length = DEBUG_LEN_L;
+
+		if (*++ptr == 'l') {
+			conv->length = DEBUG_LEN_LL;
+			ptr++;
+		}
+
+		break;
+	case 'q':
+		conv->length = DEBUG_LEN_LL;
+		ptr++;
+		break;
+	case 'j':
+		conv->length = DEBUG_LEN_J;
+		ptr++;
+		break;
+	case 'z':
+	case 'Z':
+		conv->length = DEBUG_LEN_Z;
+		ptr++;
+		break;
+	case 't':
+		conv->length = DEBUG_LEN_T;
+		ptr++;
+		break;
+	case 'L':
+		conv->length = DEBUG_LEN_LD;
+		ptr++;
+		break;
+	}
+
+	conv->conv = *ptr;
+	conv->end = *ptr ? ptr + 1 : ptr;
+
+	return conv->start;
+}
+
+struct debug_writer {
+	uint8_t *buf;
+	size_t len;
+	size_t size;
+};
+
+static bool debug_put(struct debug_writer *writer, const void *data,
+								size_t len)
+{
+	if (writer->size - writer->len < len)
+		return false;
+
+	memcpy(writer->buf + writer->len, data, len);
+	writer->len += len;
+
+	return true;
+}
+
+static bool debug_put_int(struct debug_writer *writer, int64_t value)
+{
+	return debug_put(writer, &value, sizeof(value));
+}
+
+static bool debug_put_str(struct debug_writer *writer, const char *str)
+{
+	uint32_t len;
+
+	if (writer->size - writer->len < sizeof(len))
+		return false;
+
+	if (!str) {
+		len = DEBUG_STR_NULL;
+		return debug_put(writer, &len, sizeof(len));
+	}
+
+	/* Long strings are truncated to whatever still fits */
+	len = minsize(strlen(str), writer->size - writer->len - sizeof(len));
+
+	debug_put(writer, &len, sizeof(len));
+	debug_put(writer, str, len);
+
+	return true;
+}
+
+static bool debug_put_arg(struct debug_writer *writer,
+				const struct debug_conv *conv, va_list *ap)
+{
+	int64_t value;
+
+	if (conv->width_arg && !debug_put_int(writer, va_arg(*ap, int)))
+		return false;
+
+	if (conv->prec_arg && !debug_put_int(writer, va_arg(*ap, int)))
+		return false;
+
+	switch (conv->conv) {
+	case 'd':
+	case 'i':
+		switch (conv->length) {
+		case DEBUG_LEN_L:
+			value = va_arg(*ap, long);
+			break;
+		case DEBUG_LEN_LL:
+			value = va_arg(*ap, long long);
+			break;
+		case DEBUG_LEN_J:
+			value = va_arg(*ap, intmax_t);
+			break;
+		case DEBUG_LEN_Z:
+			value = va_arg(*ap, ssize_t);
+			break;
+		case DEBUG_LEN_T:
+			value = va_arg(*ap, ptrdiff_t);
+			break;
+		case DEBUG_LEN_NONE:
+		case DEBUG_LEN_HH:
+		case DEBUG_LEN_H:
+		case DEBUG_LEN_LD:
+		default:
+			value = va_arg(*ap, int);
+			break;
+		}
+
+		return debug_put_int(writer, value);
+	case 'o':
+	case 'u':
+	case 'x':
+	case 'X':
+		switch (conv->length) {
+		case DEBUG_LEN_L:
+			value = va_arg(*ap, unsigned long);
+			break;
+		case DEBUG_LEN_LL:
+			value = va_arg(*ap, unsigned long long);
+			break;
+		case DEBUG_LEN_J:
+			value = va_arg(*ap, uintmax_t);
+			break;
+		case DEBUG_LEN_Z:
+			value = va_arg(*ap, size_t);
+			break;
+		case DEBUG_LEN_T:
+			value = va_arg(*ap, ptrdiff_t);
+			break;
+		case DEBUG_LEN_NONE:
+		case DEBUG_LEN_HH:
+		case DEBUG_LEN_H:
+		case DEBUG_LEN_LD:
+		default:
+			value = va_arg(*ap, unsigned int);
+			break;
+		}
+
+		return debug_put_int(writer, value);
+	case 'c':
+		return debug_put_int(writer, va_arg(*ap, int));
+	case 'e':
+	case 'E':
+	case 'f':
+	case 'F':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		if (conv->length == DEBUG_LEN_LD) {
+			long double ld = va_arg(*ap, long double);
+
+			return debug_put(writer, &ld, sizeof(ld));
+		} else {
+			double d = va_arg(*ap, double);
+
+			return debug_put(writer, &d, sizeof(d));
+		}
+	case 's':
+		/* Wide strings are not supported and show up as empty */
+		if (conv->length == DEBUG_LEN_L) {
+			va_arg(*ap, void *);
+			return debug_put_str(writer, "");
+		}
+
+		return debug_put_str(writer, va_arg(*ap, const char *));
+	case 'p':
+		return debug_put_int(writer, (uintptr_t) va_arg(*ap, void *));
+	case 'n':
+		va_arg(*ap, void *);
+		return true;
+	case 'm':
+	case '%':
+		return true;
+	}
+
+	/* Unknown conversion, the argument size can't be known */
+	return false;
+}
+
+static void debug_ring_copy(uint64_t pos, void *data, size_t len, bool in)
+{
+	size_t offset = pos & (debug_ring_size - 1);
+	size_t chunk = minsize(len, debug_ring_size - offset);
+
+	if (in) {
+		memcpy(debug_ring + offset, data, chunk);
+		memcpy(debug_ring, data + chunk, len - chunk);
+	} else {
+		memcpy(data, debug_ring + offset, chunk);
+		memcpy(data + chunk, debug_ring, len - chunk);
+	}
+}
+
+static inline void debug_ring_lock_acquire(void)
+{
+	while (__atomic_test_and_set(&debug_ring_lock, __ATOMIC_ACQUIRE))
+		sched_yield();
+}
+
+static inline void debug_ring_lock_release(void)
+{
+	__atomic_clear(&debug_ring_lock, __ATOMIC_RELEASE);
+}
+
+/**
+ * l_debug_record:
+ * @desc: debug descriptor
+ * @line: source line
+ * @format: format string
+ * @...: format arguments
+ *
+ * Records a debug message in binary form, used by l_debug while binary
+ * debug logging is enabled.
+ **/
+LIB_EXPORT void l_debug_record(const struct l_debug_desc *desc,
+					const char *line, const char *format, ...)
+{
+	uint64_t buf[DEBUG_RECORD_MAX / sizeof(uint64_t)];
+	struct debug_record *rec = (struct debug_record *) buf;
+	struct debug_writer writer = {
+		.buf = (uint8_t *) buf,
+		.len = sizeof(*rec),
+		.size = sizeof(buf),
+	};
+	struct debug_conv conv;
+	const char *ptr = format;
+	va_list ap;
+
+	rec->err = errno;
+	rec->timestamp = l_time_now();
+	rec->desc = desc;
+	rec->line = line;
+	rec->format = format;
+
+	va_start(ap, format);
+
+	while ((ptr = debug_next_conv(ptr, &conv))) {
+		if (!debug_put_arg(&writer, &conv, &ap))
+			break;
+
+		ptr = conv.end;
+	}
+
+	va_end(ap);
+
+	rec->size = align_len(writer.len, 8);
+
+	debug_ring_lock_acquire();
+
+	if (!debug_ring)
+		goto done;
+
+	while (debug_ring_head + rec->size - debug_ring_tail >
+							debug_ring_size) {
+		uint32_t size;
+
+		debug_ring_copy(debug_ring_tail, &size, sizeof(size), false);
+		debug_ring_tail += size;
+	}
+
+	debug_ring_copy(debug_ring_head, rec, rec->size, true);
+	debug_ring_head += rec->size;
+
+done:
+	debug_ring_lock_release();
+}
+
+struct debug_reader {
+	const uint8_t *buf;
+	size_t len;
+	size_t size;
+};
+
+static bool debug_get(struct debug_reader *reader, void *data, size_t len)
+{
+	if (reader->size - reader->len < len)
+		return false;
+
+	memcpy(data, reader->buf + reader->len, len);
+	reader->len += len;
+
+	return true;
+}
+
+/* Replaces * width and precision with the recorded values */
+static bool debug_conv_spec(struct debug_reader *reader,
+				const struct debug_conv *conv,
+				char *spec, size_t spec_size)
+{
+	const char *ptr;
+	size_t len = 0;
+
+	for (ptr = conv->start; ptr < conv->end; ptr++) {
+		int64_t value;
+
+		if (len + 24 > spec_size)
+			return false;
+
+		if (*ptr != '*') {
+			spec[len++] = *ptr;
+			continue;
+		}
+
+		if (!debug_get(reader, &value, sizeof(value)))
+			return false;
+
+		/* A negative precision is taken as if it was omitted */
+		if (ptr[-1] == '.' && value < 0) {
+			len--;
+			continue;
+		}
+
+		len += sprintf(spec + len, "%d", (int) value);
+	}
+
+	spec[len] = '\0';
+
+	return true;
+}
+
+static int debug_format_arg(struct debug_reader *reader,
+				const struct debug_conv *conv, int err,
+				bool crash_safe, char *out, size_t out_size)
+{
+	char str[DEBUG_RECORD_MAX];
+	char spec[64];
+	int64_t value;
+	uint32_t len;
+
+	if (!debug_conv_spec(reader, conv, spec, sizeof(spec)))
+		return -1;
+
+	switch (conv->conv) {
+	case 'd':
+	case 'i':
+		if (!debug_get(reader, &value, sizeof(value)))
+			return -1;
+
+		switch (conv->length) {
+		case DEBUG_LEN_L:
+			return snprintf(out, out_size, spec, (long) value);
+		case DEBUG_LEN_LL:
+			return snprintf(out, out_size, spec,
+						(long long) value);
+		case DEBUG_LEN_J:
+			return snprintf(out, out_size, spec, (intmax_t) value);
+		case DEBUG_LEN_Z:
+			return snprintf(out, out_size, spec, (ssize_t) value);
+		case DEBUG_LEN_T:
+			return snprintf(out, out_size, spec,
+						(ptrdiff_t) value);
+		case DEBUG_LEN_NONE:
+		case DEBUG_LEN_HH:
+		case DEBUG_LEN_H:
+		case DEBUG_LEN_LD:
+		default:
+			return snprintf(out, out_size, spec, (int) value);
+		}
+	case 'o':
+	case 'u':
+	case 'x':
+	case 'X':
+		if (!debug_get(reader, &value, sizeof(value)))
+			return -1;
+
+		switch (conv->length) {
+		case DEBUG_LEN_L:
+			return snprintf(out, out_size, spec,
+						(unsigned long) value);
+		case DEBUG_LEN_LL:
+			return snprintf(out, out_size, spec,
+						(unsigned long long) value);
+		case DEBUG_LEN_J:
+			return snprintf(out, out_size, spec,
+						(uintmax_t) value);
+		case DEBUG_LEN_Z:
+			return snprintf(out, out_size, spec, (size_t) value);
+		case DEBUG_LEN_T:
+			return snprintf(out, out_size, spec,
+						(ptrdiff_t) value);
+		case DEBUG_LEN_NONE:
+		case DEBUG_LEN_HH:
+		case DEBUG_LEN_H:
+		case DEBUG_LEN_LD:
+		default:
+			return snprintf(out, out_size, spec,
+						(unsigned int) value);
+		}
+	case 'c':
+		if (!debug_get(reader, &value, sizeof(value)))
+			return -1;
+
+		return snprintf(out, out_size, spec, (int) value);
+	case 'e':
+	case 'E':
+	case 'f':
+	case 'F':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		if (conv->length == DEBUG_LEN_LD) {
+			long double ld;
+
+			if (!debug_get(reader, &ld, sizeof(ld)))
+				return -1;
+
+			return snprintf(out, out_size, spec, ld);
+		} else {
+			double d;
+
+			if (!debug_get(reader, &d, sizeof(d)))
+				return -1;
+
+			return snprintf(out, out_size, spec, d);
+		}
+	case 's':
+		if (!debug_get(reader, &len, sizeof(len)))
+			return -1;
+
+		if (len == DEBUG_STR_NULL)
+			return snprintf(out, out_size, spec, "(null)");
+
+		/* The recorded string isn't NUL terminated */
+		if (len >= sizeof(str) || !debug_get(reader, str, len))
+			return -1;
+
+		str[len] = '\0';
+
+		return snprintf(out, out_size, spec, str);
+	case 'p':
+		if (!debug_get(reader, &value, sizeof(value)))
+			return -1;
+
+		return snprintf(out, out_size, spec,
+					(void *) (uintptr_t) value);
+	case 'm':
+		/* strerror isn't async-signal-safe, it may touch the locale */
+		if (crash_safe)
+			return snprintf(out, out_size, "error %d", err);
+
+		return snprintf(out, out_size, "%s", strerror(err));
+	case '%':
+		return snprintf(out, out_size, "%%");
+	case 'n':
+		return 0;
+	}
+
+	return -1;
+}
+
+static size_t debug_record_format(const struct debug_record *rec,
+						bool crash_safe,
+						char *out, size_t out_size)
+{
+	struct debug_reader reader = {
+		.buf = (const uint8_t *) rec,
+		.len = sizeof(*rec),
+		.size = rec->size,
+	};
+	const char *ptr = rec->format;
+	struct debug_conv conv;
+	size_t len;
+	int r;
+
+	r = snprintf(out, out_size, "[%" PRIu64 ".%06" PRIu64 "] %s:%s() ",
+				rec->timestamp / 1000000,
+				rec->timestamp % 1000000,
+				rec->desc->file, rec->desc->func);
+	len = minsize(r < 0 ? 0 : r, out_size - 1);
+
+	while (len < out_size - 1) {
+		const char *next = debug_next_conv(ptr, &conv);
+		size_t literal = next ? (size_t) (next - ptr) : strlen(ptr);
+
+		literal = minsize(literal, out_size - 1 - len);
+		memcpy(out + len, ptr, literal);
+		len += literal;
+
+		if (!next)
+			break;
+
+		r = debug_format_arg(&reader, &conv, rec->err, crash_safe,
+						out + len, out_size - len);
+		if (r < 0) {
+			/* The arguments were cut short when recording */
+			r = snprintf(out + len, out_size - len, "...\n");
+			len = minsize(len + r, out_size - 1);
+			break;
+		}
+
+		len = minsize(len + r, out_size - 1);
+		ptr = conv.end;
+	}
+
+	out[len] = '\0';
+
+	return len;
+}
+
+#define DEBUG_LOCK_TRIES	1000
+
+static bool debug_ring_lock_try(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < DEBUG_LOCK_TRIES; i++) {
+		if (!__atomic_test_and_set(&debug_ring_lock, __ATOMIC_ACQUIRE))
+			return true;
+
+		sched_yield();
+	}
+
+	return false;
+}
+
+/*
+ * With @crash_safe the lock is only waited for a bounded time, since the
+ * crash may have happened while it was held in l_debug_record.  The ring is
+ * then read without it and a record that doesn't look sane ends the dump.
+ */
+static bool debug_ring_pop(struct debug_record *rec, bool crash_safe)
+{
+	bool locked = true;
+	bool found = false;
+
+	if (crash_safe)
+		locked = debug_ring_lock_try();
+	else
+		debug_ring_lock_acquire();
+
+	if (debug_ring && debug_ring_tail != debug_ring_head) {
+		debug_ring_copy(debug_ring_tail, rec, sizeof(rec->size),
+									false);
+
+		if (rec->size >= sizeof(*rec) &&
+				rec->size <= DEBUG_RECORD_MAX &&
+				rec->size <= debug_ring_head - debug_ring_tail) {
+			debug_ring_copy(debug_ring_tail, rec, rec->size,
+									false);
+			debug_ring_tail += rec->size;
+			found = true;
+		}
+	}
+
+	if (locked)
+		debug_ring_lock_release();
+
+	return found;
+}
+
+static void debug_update_binary(bool enable)
+{
+	const struct l_queue_entry *entry;
+
+	for (entry = l_queue_get_entries(debug_sections); entry;
+					entry = entry->next) {
+		const struct debug_section *section = entry->data;
+		struct l_debug_desc *desc;
+
+		for (desc = section->start; desc < section->end; desc++) {
+			if (!enable)
+				desc->flags &= ~L_DEBUG_FLAG_BINARY;
+			else if (desc->flags & L_DEBUG_FLAG_PRINT)
+				desc->flags |= L_DEBUG_FLAG_BINARY;
+		}
+	}
+}
+
+/**
+ * l_debug_enable_binary:
+ * @size: size of the ring buffer holding the recorded messages
+ *
+ * Switches all enabled debug statements, and those enabled later on, to
+ * binary logging.  Instead of being formatted and handed to the log handler
+ * right away, the messages are recorded along with their raw arguments and
+ * a timestamp into a ring buffer, which overwrites the oldest messages once
+ * it is full.  The messages are only formatted when the ring buffer is
+ * dumped with l_debug_dump or l_debug_dump_fd.
+ *
+ * Messages of plugins need to be dumped before the plugins are unloaded.
+ *
+ * Returns: #true on success, #false if binary logging is already enabled
+ **/
+LIB_EXPORT bool l_debug_enable_binary(size_t size)
+{
+	size_t real_size = DEBUG_RING_MIN;
+	uint8_t *ring;
+
+	if (debug_ring)
+		return false;
+
+	while (real_size < size)
+		real_size <<= 1;
+
+	ring = l_malloc(real_size);
+
+	debug_ring_lock_acquire();
+	debug_ring = ring;
+	debug_ring_size = real_size;
+	debug_ring_head = 0;
+	debug_ring_tail = 0;
+	debug_ring_lock_release();
+
+	debug_flags = L_DEBUG_FLAG_PRINT | L_DEBUG_FLAG_BINARY;
+	debug_update_binary(true);
+
+	return true;
+}
+
+/**
+ * l_debug_disable_binary:
+ *
+ * Switches the enabled debug statements back to regular logging.  Any
+ * messages that haven't been dumped yet are discarded.
+ **/
+LIB_EXPORT void l_debug_disable_binary(void)
+{
+	uint8_t *ring;
+
+	debug_flags = L_DEBUG_FLAG_PRINT;
+	debug_update_binary(false);
+
+	debug_ring_lock_acquire();
+	ring = debug_ring;
+	debug_ring = NULL;
+	debug_ring_lock_release();
+
+	l_free(ring);
+}
+
+/**
+ * l_debug_dump:
+ *
+ * Formats the messages recorded by binary debug logging and hands them to
+ * the log handler, oldest first.  The messages are removed from the ring
+ * buffer.
+ **/
+LIB_EXPORT void l_debug_dump(void)
+{
+	uint64_t buf[DEBUG_RECORD_MAX / sizeof(uint64_t)];
+	struct debug_record *rec = (struct debug_record *) buf;
+	char msg[DEBUG_MSG_MAX];
+
+	while (debug_ring_pop(rec, false)) {
+		debug_record_format(rec, false, msg, sizeof(msg));
+		l_log_with_location(L_LOG_DEBUG, rec->desc->file, rec->line,
+					rec->desc->func, "%s", msg);
+	}
+}
+
+/**
+ * l_debug_dump_fd:
+ * @fd: file descriptor to write to
+ *
+ * Formats the messages recorded by binary debug logging and writes them
+ * to @fd, oldest first.  The messages are removed from the ring buffer.
+ * Since no memory is allocated and the ring buffer lock is not waited for
+ * indefinitely, this can be used from a crash handler, even if the crash
+ * happened while recording a message.  For the same reason the m
+ * conversion prints the error number instead of the error message.
+ *
+ * Returns: #true on success, #false if writing to @fd failed
+ **/
+LIB_EXPORT bool l_debug_dump_fd(int fd)
+{
+	uint64_t buf[DEBUG_RECORD_MAX / sizeof(uint64_t)];
+	struct debug_record *rec = (struct debug_record *) buf;
+	char msg[DEBUG_MSG_MAX];
+
+	while (debug_ring_pop(rec, true)) {
+		size_t len = debug_record_format(rec, true, msg, sizeof(msg));
+		size_t written = 0;
+
+		while (written < len) {
+			ssize_t r = write(fd, msg + written, len - written);
+
+			if (r < 0) {
+				if (errno == EINTR)
+					continue;
+
+				return false;
+			}
+
+			written += r;
+		}
+	}
+
+	return true;
+}
+
 __attribute__((constructor)) static void register_debug_section()
 {
 	extern struct l_debug_desc __start___ell_debug[];
@@ -25,6 +25,7 @@
 
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -45,6 +46,10 @@ void l_log_set_stderr(void);
 void l_log_set_syslog(void);
 void l_log_set_journal(void);
 
+bool l_log_enable_async(size_t ring_size);
+void l_log_disable_async(void);
+void l_log_flush(void);
+
 void l_log_with_location(int priority, const char *file, const char *line,
 				const char *func, const char *format, ...)
 				__attribute__((format(printf, 5, 6)));
@@ -58,18 +63,28 @@ struct l_debug_desc {
 	const char *func;
 #define L_DEBUG_FLAG_DEFAULT (0)
 #define L_DEBUG_FLAG_PRINT   (1 << 0)
+#define L_DEBUG_FLAG_BINARY  (1 << 1)
 	unsigned int flags;
 } __attribute__((aligned(8)));
 
+void l_debug_record(const struct l_debug_desc *desc, const char *line,
+					const char *format, ...)
+					__attribute__((format(printf, 3, 4)));
+
 #define L_DEBUG_SYMBOL(symbol, format, ...) do { \
 	static struct l_debug_desc symbol \
 	__attribute__((used, section("__ell_debug"), aligned(8))) = { \
 		.file = __FILE__, .func = __func__, \
 		.flags = L_DEBUG_FLAG_DEFAULT, \
 	}; \
-	if (symbol.flags & L_DEBUG_FLAG_PRINT) \
-		l_log(L_LOG_DEBUG, "%s:%s() " format, __FILE__, \
+	if (symbol.flags & L_DEBUG_FLAG_PRINT) { \
+		if (symbol.flags & L_DEBUG_FLAG_BINARY) \
+			l_debug_record(&symbol, L_STRINGIFY(__LINE__), \
+					format "\n", ##__VA_ARGS__); \
+		else \
+			l_log(L_LOG_DEBUG, "%s:%s() " format, __FILE__, \
 					__func__ , ##__VA_ARGS__); \
+	} \
 } while (0)
 
 void l_debug_enable_full(const char *pattern,
@@ -89,6 +104,11 @@ _Pragma("GCC diagnostic pop") \
 
 void l_debug_disable(void);
 
+bool l_debug_enable_binary(size_t size);
+void l_debug_disable_binary(void);
+void l_debug_dump(void);
+bool l_debug_dump_fd(int fd);
+
 #define l_error(format, ...)  l_log(L_LOG_ERR, format, ##__VA_ARGS__)
 #define l_warn(format, ...)   l_log(L_LOG_WARNING, format, ##__VA_ARGS__)
 #define l_info(format, ...)   l_log(L_LOG_INFO, format, ##__VA_ARGS__)
@@ -141,7 +141,7 @@ int watch_add(int fd, uint32_t events, watch_event_cb_t callback,
 	if ((unsigned int) fd > watch_entries - 1)
 		return -ERANGE;
 
-	data = l_new(struct watch_data, 1);
+	data = mempool_new(struct watch_data);
 
 	data->fd = fd;
 	data->events = events;
@@ -156,7 +156,7 @@ int watch_add(int fd, uint32_t events, watch_event_cb_t callback,
 
 	err = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, data->fd, &ev);
 	if (err < 0) {
-		l_free(data);
+		mempool_free(data, sizeof(struct watch_data));
 		return -errno;
 	}
 
@@ -219,7 +219,7 @@ int watch_clear(int fd)
 	if (data->flags & WATCH_FLAG_DISPATCHING)
 		data->flags |= WATCH_FLAG_DESTROYED;
 	else
-		l_free(data);
+		mempool_free(data, sizeof(struct watch_data));
 
 	return 0;
 }
@@ -406,6 +406,20 @@ static void create_sd_notify_socket(void)
 					L_INT_TO_PTR(msec), NULL);
 }
 
+#ifdef MALLOC_STATS
+static struct l_signal *malloc_stats_signal;
+
+static void malloc_stats_dump(const char *str, void *user_data)
+{
+	l_info("%s", str);
+}
+
+static void malloc_stats_handler(void *user_data)
+{
+	l_malloc_dump_stats(malloc_stats_dump, NULL);
+}
+#endif
+
 /**
  * l_main_init:
  *
@@ -414,6 +428,10 @@ static void create_sd_notify_socket(void)
  * or watch. A safe rule-of-thumb is to call it before any function
  * prefixed with "l_".
  *
+ * When ell is built with allocation accounting (--enable-malloc-stats),
+ * this also installs a SIGUSR2 handler that dumps the statistics to the
+ * log, so the application must not use SIGUSR2 for anything else.
+ *
  * Returns: true if initialization was successful, false otherwise.
  **/
 LIB_EXPORT bool l_main_init(void)
@@ -426,6 +444,12 @@ LIB_EXPORT bool l_main_init(void)
 
 	create_sd_notify_socket();
 
+#ifdef MALLOC_STATS
+	/* SIGUSR2 dumps the allocation accounting to the log */
+	malloc_stats_signal = l_signal_create(SIGUSR2, malloc_stats_handler,
+								NULL, NULL);
+#endif
+
 	epoll_terminate = false;
 
 	return true;
@@ -478,7 +502,7 @@ LIB_EXPORT void l_main_iterate(int timeout)
 		data = events[n].data.ptr;
 
 		if (data->flags & WATCH_FLAG_DESTROYED)
-			l_free(data);
+			mempool_free(data, sizeof(struct watch_data));
 		else
 			data->flags = 0;
 	}
@@ -547,6 +571,11 @@ LIB_EXPORT bool l_main_exit(void)
 		return false;
 	}
 
+#ifdef MALLOC_STATS
+	l_signal_remove(malloc_stats_signal);
+	malloc_stats_signal = NULL;
+#endif
+
 	for (i = 0; i < watch_entries; i++) {
 		struct watch_data *data = watch_list[i];
 
@@ -560,7 +589,7 @@ LIB_EXPORT bool l_main_exit(void)
 		else
 			l_error("Dangling file descriptor %d found", data->fd);
 
-		l_free(data);
+		mempool_free(data, sizeof(struct watch_data));
 	}
 
 	watch_entries = 0;
@@ -0,0 +1,451 @@
+/*
+ *
+ *  Embedded Linux library
+ *
+ *  Copyright (C) 2019  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "util.h"
+#include "mempool.h"
+#include "private.h"
+
+/**
+ * SECTION:mempool
+ * @short_description: Fixed-size object pools
+ *
+ * Fixed-size object pools
+ */
+
+/*
+ * With pools disabled every object is a separate heap allocation, so that
+ * memory debugging tools can track each of them individually.
+ */
+#if defined(DISABLE_MEMPOOL) || defined(__SANITIZE_ADDRESS__)
+#define MEMPOOL_PASSTHROUGH
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define MEMPOOL_PASSTHROUGH
+#endif
+#endif
+
+#define SLAB_SIZE		4096
+#define SLAB_MIN_OBJECTS	8
+#define OBJECT_ALIGN		16
+#define SIZE_CLASSES		8
+#define SIZE_CLASS_MAX		(SIZE_CLASSES * OBJECT_ALIGN)
+#define MAGAZINE_SIZE		32
+
+struct slab {
+	struct slab *next;
+};
+
+#define SLAB_HEADER_SIZE	align_len(sizeof(struct slab), OBJECT_ALIGN)
+
+struct free_object {
+	struct free_object *next;
+};
+
+/*
+ * Without pooling each object still has to be reachable from its pool so
+ * that l_mempool_destroy can release the ones that are outstanding.
+ */
+struct tracked_object {
+	struct tracked_object *prev;
+	struct tracked_object *next;
+};
+
+#define TRACKED_HEADER_SIZE	\
+	align_len(sizeof(struct tracked_object), OBJECT_ALIGN)
+
+/**
+ * l_mempool:
+ *
+ * Opaque object representing a pool of fixed-size objects.
+ */
+struct l_mempool {
+	size_t object_size;
+	size_t slab_size;
+	struct slab *slabs;
+	struct free_object *free_list;
+	struct tracked_object *tracked;
+	bool lock;
+};
+
+#ifdef MEMPOOL_PASSTHROUGH
+static void *pool_track(struct l_mempool *pool)
+{
+	struct tracked_object *object;
+
+	object = l_malloc(TRACKED_HEADER_SIZE + pool->object_size);
+	object->prev = NULL;
+	object->next = pool->tracked;
+
+	if (pool->tracked)
+		pool->tracked->prev = object;
+
+	pool->tracked = object;
+
+	return (uint8_t *) object + TRACKED_HEADER_SIZE;
+}
+
+static void pool_untrack(struct l_mempool *pool, void *ptr)
+{
+	struct tracked_object *object;
+
+	object = (void *) ((uint8_t *) ptr - TRACKED_HEADER_SIZE);
+
+	if (object->prev)
+		object->prev->next = object->next;
+	else
+		pool->tracked = object->next;
+
+	if (object->next)
+		object->next->prev = object->prev;
+
+	l_free(object);
+}
+#else
+/*
+ * Per-thread cache of free objects for one of the library-internal size
+ * classes.  Only refilling or flushing a magazine needs to take the lock of
+ * the shared pool.  The magazines of an exiting thread are put back into
+ * the size classes by the destructor of magazine_key.
+ */
+struct magazine {
+	void *objects[MAGAZINE_SIZE];
+	unsigned int count;
+};
+
+#define SIZE_CLASS(n) { .object_size = (n) * OBJECT_ALIGN }
+
+static struct l_mempool size_classes[SIZE_CLASSES] = {
+	SIZE_CLASS(1), SIZE_CLASS(2), SIZE_CLASS(3), SIZE_CLASS(4),
+	SIZE_CLASS(5), SIZE_CLASS(6), SIZE_CLASS(7), SIZE_CLASS(8),
+};
+
+static __thread struct magazine magazines[SIZE_CLASSES];
+static __thread bool magazines_registered;
+
+static pthread_key_t magazine_key;
+static pthread_once_t magazine_once = PTHREAD_ONCE_INIT;
+static bool magazine_key_valid;
+
+static void pool_lock(struct l_mempool *pool)
+{
+	while (__atomic_test_and_set(&pool->lock, __ATOMIC_ACQUIRE))
+		sched_yield();
+}
+
+static void pool_unlock(struct l_mempool *pool)
+{
+	__atomic_clear(&pool->lock, __ATOMIC_RELEASE);
+}
+
+static size_t pool_slab_size(size_t object_size)
+{
+	if (SLAB_HEADER_SIZE + SLAB_MIN_OBJECTS * object_size > SLAB_SIZE)
+		return SLAB_HEADER_SIZE + SLAB_MIN_OBJECTS * object_size;
+
+	return SLAB_SIZE;
+}
+
+static void pool_grow(struct l_mempool *pool)
+{
+	struct slab *slab;
+	uint8_t *object;
+	uint8_t *end;
+
+	if (!pool->slab_size)
+		pool->slab_size = pool_slab_size(pool->object_size);
+
+	slab = l_malloc(pool->slab_size);
+	slab->next = pool->slabs;
+	pool->slabs = slab;
+
+	object = (uint8_t *) slab + SLAB_HEADER_SIZE;
+	end = (uint8_t *) slab + pool->slab_size;
+
+	for (; object + pool->object_size <= end;
+					object += pool->object_size) {
+		struct free_object *free_object = (void *) object;
+
+		free_object->next = pool->free_list;
+		pool->free_list = free_object;
+	}
+}
+
+static void *pool_get(struct l_mempool *pool)
+{
+	struct free_object *object;
+
+	if (!pool->free_list)
+		pool_grow(pool);
+
+	object = pool->free_list;
+	pool->free_list = object->next;
+
+	return object;
+}
+
+static void pool_put(struct l_mempool *pool, void *ptr)
+{
+	struct free_object *object = ptr;
+
+	object->next = pool->free_list;
+	pool->free_list = object;
+}
+
+static void magazines_drain(void *data)
+{
+	struct magazine *thread_magazines = data;
+	unsigned int i;
+
+	/* Other destructors may still allocate, they register again */
+	magazines_registered = false;
+
+	for (i = 0; i < SIZE_CLASSES; i++) {
+		struct l_mempool *pool = &size_classes[i];
+		struct magazine *magazine = &thread_magazines[i];
+
+		if (!magazine->count)
+			continue;
+
+		pool_lock(pool);
+
+		while (magazine->count)
+			pool_put(pool, magazine->objects[--magazine->count]);
+
+		pool_unlock(pool);
+	}
+}
+
+static void magazine_key_create(void)
+{
+	magazine_key_valid = !pthread_key_create(&magazine_key,
+							magazines_drain);
+}
+
+static struct magazine *magazine_get(size_t size)
+{
+	if (unlikely(!magazines_registered)) {
+		/* Without the key the magazines stay with the thread */
+		pthread_once(&magazine_once, magazine_key_create);
+
+		if (magazine_key_valid &&
+				!pthread_setspecific(magazine_key, magazines))
+			magazines_registered = true;
+	}
+
+	return &magazines[(size - 1) / OBJECT_ALIGN];
+}
+#endif
+
+/**
+ * l_mempool_new:
+ * @object_size: Size of the objects handed out by the pool
+ *
+ * Creates a new pool of fixed-size objects.  Objects are carved out of
+ * larger slabs, which makes allocating and freeing them considerably
+ * cheaper than separate heap allocations.  Memory is only given back when
+ * the pool is destroyed.  Like most other ell objects a pool must only be
+ * used from one thread at a time.
+ *
+ * Returns: A newly allocated #l_mempool object or NULL if @object_size is 0.
+ **/
+LIB_EXPORT struct l_mempool *l_mempool_new(size_t object_size)
+{
+	struct l_mempool *pool;
+
+	if (unlikely(!object_size))
+		return NULL;
+
+	pool = l_new(struct l_mempool, 1);
+	pool->object_size = align_len(object_size, OBJECT_ALIGN);
+
+	return pool;
+}
+
+/**
+ * l_mempool_destroy:
+ * @pool: Pool object
+ *
+ * Frees @pool and all memory used by it.  All objects allocated from @pool
+ * become invalid.
+ **/
+LIB_EXPORT void l_mempool_destroy(struct l_mempool *pool)
+{
+	if (unlikely(!pool))
+		return;
+
+	while (pool->tracked) {
+		struct tracked_object *object = pool->tracked;
+
+		pool->tracked = object->next;
+		l_free(object);
+	}
+
+	while (pool->slabs) {
+		struct slab *slab = pool->slabs;
+
+		pool->slabs = slab->next;
+		l_free(slab);
+	}
+
+	l_free(pool);
+}
+
+/**
+ * l_mempool_alloc:
+ * @pool: Pool object
+ *
+ * Allocates a zero-initialized object from @pool.
+ *
+ * Returns: A pointer to the object.
+ **/
+LIB_EXPORT void *l_mempool_alloc(struct l_mempool *pool)
+{
+	void *ptr;
+
+	if (unlikely(!pool))
+		return NULL;
+
+#ifdef MEMPOOL_PASSTHROUGH
+	ptr = pool_track(pool);
+#else
+	ptr = pool_get(pool);
+#endif
+
+	memset(ptr, 0, pool->object_size);
+
+	return ptr;
+}
+
+/**
+ * l_mempool_free:
+ * @pool: Pool object
+ * @ptr: Object previously allocated from @pool
+ *
+ * Returns the object pointed to by @ptr to @pool.  If @ptr is NULL, no
+ * operation is performed.
+ **/
+LIB_EXPORT void l_mempool_free(struct l_mempool *pool, void *ptr)
+{
+	if (unlikely(!pool || !ptr))
+		return;
+
+#ifdef MEMPOOL_PASSTHROUGH
+	pool_untrack(pool, ptr);
+#else
+	pool_put(pool, ptr);
+#endif
+}
+
+void *mempool_alloc(size_t size)
+{
+#ifdef MEMPOOL_PASSTHROUGH
+	return memset(l_malloc(size), 0, size);
+#else
+	struct l_mempool *pool;
+	struct magazine *magazine;
+	void *ptr;
+
+	if (unlikely(!size || size > SIZE_CLASS_MAX))
+		return memset(l_malloc(size), 0, size);
+
+	pool = &size_classes[(size - 1) / OBJECT_ALIGN];
+	magazine = magazine_get(size);
+
+	if (!magazine->count) {
+		pool_lock(pool);
+
+		while (magazine->count < MAGAZINE_SIZE / 2)
+			magazine->objects[magazine->count++] = pool_get(pool);
+
+		pool_unlock(pool);
+	}
+
+	ptr = magazine->objects[--magazine->count];
+
+	return memset(ptr, 0, size);
+#endif
+}
+
+void mempool_free(void *ptr, size_t size)
+{
+#ifdef MEMPOOL_PASSTHROUGH
+	l_free(ptr);
+#else
+	struct l_mempool *pool;
+	struct magazine *magazine;
+
+	if (!ptr)
+		return;
+
+	if (unlikely(!size || size > SIZE_CLASS_MAX)) {
+		l_free(ptr);
+		return;
+	}
+
+	pool = &size_classes[(size - 1) / OBJECT_ALIGN];
+	magazine = magazine_get(size);
+
+	if (magazine->count == MAGAZINE_SIZE) {
+		pool_lock(pool);
+
+		while (magazine->count > MAGAZINE_SIZE / 2)
+			pool_put(pool, magazine->objects[--magazine->count]);
+
+		pool_unlock(pool);
+	}
+
+	magazine->objects[magazine->count++] = ptr;
+#endif
+}
+
+unsigned int mempool_slab_count(size_t size)
+{
+#ifdef MEMPOOL_PASSTHROUGH
+	return 0;
+#else
+	struct l_mempool *pool;
+	struct slab *slab;
+	unsigned int count = 0;
+
+	if (unlikely(!size || size > SIZE_CLASS_MAX))
+		return 0;
+
+	pool = &size_classes[(size - 1) / OBJECT_ALIGN];
+
+	pool_lock(pool);
+
+	for (slab = pool->slabs; slab; slab = slab->next)
+		count++;
+
+	pool_unlock(pool);
+
+	return count;
+#endif
+}
@@ -0,0 +1,44 @@
+/*
+ *
+ *  Embedded Linux library
+ *
+ *  Copyright (C) 2019  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __ELL_MEMPOOL_H
+#define __ELL_MEMPOOL_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct l_mempool;
+
+struct l_mempool *l_mempool_new(size_t object_size);
+void l_mempool_destroy(struct l_mempool *pool);
+
+void *l_mempool_alloc(struct l_mempool *pool);
+void l_mempool_free(struct l_mempool *pool, void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ELL_MEMPOOL_H */
@@ -0,0 +1,867 @@
+/*
+ *
+ *  Embedded Linux library
+ *
+ *  Copyright (C) 2019  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "util.h"
+#include "ordmap.h"
+#include "private.h"
+
+/**
+ * SECTION:ordmap
+ * @short_description: Ordered map support
+ *
+ * Ordered map support
+ */
+
+/*
+ * The map is a B+ tree.  All entries live in the leaves, which are linked
+ * in key order for iteration, while inner nodes only hold separator keys.
+ * Keys of a node are kept in one contiguous array so that a binary search
+ * touches as few cache lines as possible.
+ */
+#define MAX_KEYS 15
+#define MIN_KEYS (MAX_KEYS / 2)
+#define MAX_DEPTH 32
+
+struct bnode {
+	uint16_t count;
+	bool leaf;
+	const void *keys[MAX_KEYS];
+};
+
+struct bleaf {
+	struct bnode n;
+	void *values[MAX_KEYS];
+	struct bleaf *next;
+};
+
+struct binner {
+	struct bnode n;
+	struct bnode *children[MAX_KEYS + 1];
+};
+
+/**
+ * l_ordmap:
+ *
+ * Opaque object representing the ordered map.
+ */
+struct l_ordmap {
+	l_ordmap_compare_func_t compare;
+	struct bnode *root;
+	struct bleaf *first;
+	unsigned int entries;
+};
+
+struct path {
+	struct binner *nodes[MAX_DEPTH];
+	unsigned int index[MAX_DEPTH];
+	unsigned int depth;
+};
+
+static inline int map_compare(const struct l_ordmap *map,
+					const void *a, const void *b)
+{
+	if (map->compare)
+		return map->compare(a, b);
+
+	if ((uintptr_t) a < (uintptr_t) b)
+		return -1;
+
+	return (uintptr_t) a > (uintptr_t) b;
+}
+
+/* Index of the first key that is greater than or equal to @key */
+static unsigned int lower_index(const struct l_ordmap *map,
+				const struct bnode *n, const void *key)
+{
+	unsigned int lo = 0;
+	unsigned int hi = n->count;
+
+	while (lo < hi) {
+		unsigned int mid = (lo + hi) / 2;
+
+		if (map_compare(map, n->keys[mid], key) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/* Index of the first key that is greater than @key */
+static unsigned int upper_index(const struct l_ordmap *map,
+				const struct bnode *n, const void *key)
+{
+	unsigned int lo = 0;
+	unsigned int hi = n->count;
+
+	while (lo < hi) {
+		unsigned int mid = (lo + hi) / 2;
+
+		if (map_compare(map, n->keys[mid], key) <= 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/*
+ * Separator keys equal the smallest key of their right subtree, so equal
+ * keys are always found to the right.
+ */
+static struct bleaf *find_leaf(const struct l_ordmap *map, const void *key,
+							struct path *path)
+{
+	struct bnode *n = map->root;
+
+	if (path)
+		path->depth = 0;
+
+	while (n && !n->leaf) {
+		struct binner *inner = (struct binner *) n;
+		unsigned int i = upper_index(map, n, key);
+
+		if (path) {
+			path->nodes[path->depth] = inner;
+			path->index[path->depth++] = i;
+		}
+
+		n = inner->children[i];
+	}
+
+	return (struct bleaf *) n;
+}
+
+static void leaf_insert_at(struct bleaf *leaf, unsigned int pos,
+					const void *key, void *value)
+{
+	unsigned int count = leaf->n.count;
+
+	memmove(leaf->n.keys + pos + 1, leaf->n.keys + pos,
+					(count - pos) * sizeof(void *));
+	memmove(leaf->values + pos + 1, leaf->values + pos,
+					(count - pos) * sizeof(void *));
+
+	leaf->n.keys[pos] = key;
+	leaf->values[pos] = value;
+	leaf->n.count++;
+}
+
+static void leaf_remove_at(struct bleaf *leaf, unsigned int pos)
+{
+	unsigned int count = leaf->n.count;
+
+	memmove(leaf->n.keys + pos, leaf->n.keys + pos + 1,
+					(count - pos - 1) * sizeof(void *));
+	memmove(leaf->values + pos, leaf->values + pos + 1,
+					(count - pos - 1) * sizeof(void *));
+
+	leaf->n.count--;
+}
+
+static void inner_insert_at(struct binner *inner, unsigned int pos,
+				const void *key, struct bnode *right)
+{
+	unsigned int count = inner->n.count;
+
+	memmove(inner->n.keys + pos + 1, inner->n.keys + pos,
+					(count - pos) * sizeof(void *));
+	memmove(inner->children + pos + 2, inner->children + pos + 1,
+					(count - pos) * sizeof(void *));
+
+	inner->n.keys[pos] = key;
+	inner->children[pos + 1] = right;
+	inner->n.count++;
+}
+
+/* Removes key @pos and the child to its right */
+static void inner_remove_at(struct binner *inner, unsigned int pos)
+{
+	unsigned int count = inner->n.count;
+
+	memmove(inner->n.keys + pos, inner->n.keys + pos + 1,
+					(count - pos - 1) * sizeof(void *));
+	memmove(inner->children + pos + 1, inner->children + pos + 2,
+					(count - pos - 1) * sizeof(void *));
+
+	inner->n.count--;
+}
+
+static struct bleaf *leaf_split(struct bleaf *leaf)
+{
+	struct bleaf *right = l_new(struct bleaf, 1);
+	unsigned int keep = (MAX_KEYS + 1) / 2;
+	unsigned int move = leaf->n.count - keep;
+
+	right->n.leaf = true;
+	right->n.count = move;
+	memcpy(right->n.keys, leaf->n.keys + keep, move * sizeof(void *));
+	memcpy(right->values, leaf->values + keep, move * sizeof(void *));
+	leaf->n.count = keep;
+
+	right->next = leaf->next;
+	leaf->next = right;
+
+	return right;
+}
+
+/*
+ * Splits a full inner node while inserting @key and @child at @pos.  The
+ * middle key moves up and is returned in @out_key.
+ */
+static struct binner *inner_split(struct binner *inner, unsigned int pos,
+					const void *key, struct bnode *child,
+					const void **out_key)
+{
+	const void *keys[MAX_KEYS + 1];
+	struct bnode *children[MAX_KEYS + 2];
+	struct binner *right = l_new(struct binner, 1);
+	unsigned int keep = (MAX_KEYS + 1) / 2;
+
+	memcpy(keys, inner->n.keys, pos * sizeof(void *));
+	keys[pos] = key;
+	memcpy(keys + pos + 1, inner->n.keys + pos,
+				(MAX_KEYS - pos) * sizeof(void *));
+
+	memcpy(children, inner->children, (pos + 1) * sizeof(void *));
+	children[pos + 1] = child;
+	memcpy(children + pos + 2, inner->children + pos + 1,
+				(MAX_KEYS - pos) * sizeof(void *));
+
+	inner->n.count = keep;
+	memcpy(inner->n.keys, keys, keep * sizeof(void *));
+	memcpy(inner->children, children, (keep + 1) * sizeof(void *));
+
+	*out_key = keys[keep];
+
+	right->n.count = MAX_KEYS - keep;
+	memcpy(right->n.keys, keys + keep + 1, right->n.count * sizeof(void *));
+	memcpy(right->children, children + keep + 1,
+				(right->n.count + 1) * sizeof(void *));
+
+	return right;
+}
+
+static void rebalance_leaf(struct l_ordmap *map, struct bleaf *leaf,
+				struct binner *parent, unsigned int i)
+{
+	struct bleaf *left = i > 0 ?
+			(struct bleaf *) parent->children[i - 1] : NULL;
+	struct bleaf *right = i < parent->n.count ?
+			(struct bleaf *) parent->children[i + 1] : NULL;
+
+	if (left && left->n.count > MIN_KEYS) {
+		unsigned int last = left->n.count - 1;
+
+		leaf_insert_at(leaf, 0, left->n.keys[last], left->values[last]);
+		left->n.count--;
+		parent->n.keys[i - 1] = leaf->n.keys[0];
+		return;
+	}
+
+	if (right && right->n.count > MIN_KEYS) {
+		leaf_insert_at(leaf, leaf->n.count, right->n.keys[0],
+							right->values[0]);
+		leaf_remove_at(right, 0);
+		parent->n.keys[i] = right->n.keys[0];
+		return;
+	}
+
+	/* Merge into the left one of the two siblings */
+	if (!left) {
+		left = leaf;
+		leaf = right;
+		i++;
+	}
+
+	memcpy(left->n.keys + left->n.count, leaf->n.keys,
+				leaf->n.count * sizeof(void *));
+	memcpy(left->values + left->n.count, leaf->values,
+				leaf->n.count * sizeof(void *));
+	left->n.count += leaf->n.count;
+	left->next = leaf->next;
+
+	inner_remove_at(parent, i - 1);
+	l_free(leaf);
+}
+
+static void rebalance_inner(struct l_ordmap *map, struct binner *inner,
+				struct binner *parent, unsigned int i)
+{
+	struct binner *left = i > 0 ?
+			(struct binner *) parent->children[i - 1] : NULL;
+	struct binner *right = i < parent->n.count ?
+			(struct binner *) parent->children[i + 1] : NULL;
+	unsigned int count;
+
+	if (left && left->n.count > MIN_KEYS) {
+		count = inner->n.count;
+
+		memmove(inner->n.keys + 1, inner->n.keys,
+					count * sizeof(void *));
+		memmove(inner->children + 1, inner->children,
+					(count + 1) * sizeof(void *));
+
+		inner->n.keys[0] = parent->n.keys[i - 1];
+		inner->children[0] = left->children[left->n.count];
+		inner->n.count++;
+
+		parent->n.keys[i - 1] = left->n.keys[left->n.count - 1];
+		left->n.count--;
+		return;
+	}
+
+	if (right && right->n.count > MIN_KEYS) {
+		count = inner->n.count;
+
+		inner->n.keys[count] = parent->n.keys[i];
+		inner->children[count + 1] = right->children[0];
+		inner->n.count++;
+
+		parent->n.keys[i] = right->n.keys[0];
+
+		memmove(right->n.keys, right->n.keys + 1,
+				(right->n.count - 1) * sizeof(void *));
+		memmove(right->children, right->children + 1,
+				right->n.count * sizeof(void *));
+		right->n.count--;
+		return;
+	}
+
+	if (!left) {
+		left = inner;
+		inner = right;
+		i++;
+	}
+
+	count = left->n.count;
+
+	left->n.keys[count] = parent->n.keys[i - 1];
+	memcpy(left->n.keys + count + 1, inner->n.keys,
+				inner->n.count * sizeof(void *));
+	memcpy(left->children + count + 1, inner->children,
+				(inner->n.count + 1) * sizeof(void *));
+	left->n.count += 1 + inner->n.count;
+
+	inner_remove_at(parent, i - 1);
+	l_free(inner);
+}
+
+static void rebalance(struct l_ordmap *map, struct bnode *n,
+							struct path *path)
+{
+	while (path->depth) {
+		struct binner *parent = path->nodes[path->depth - 1];
+		unsigned int i = path->index[path->depth - 1];
+
+		if (n->count >= MIN_KEYS)
+			return;
+
+		if (n->leaf)
+			rebalance_leaf(map, (struct bleaf *) n, parent, i);
+		else
+			rebalance_inner(map, (struct binner *) n, parent, i);
+
+		n = &parent->n;
+		path->depth--;
+	}
+
+	/* Shrink the tree once the root runs empty */
+	if (n->count)
+		return;
+
+	if (n->leaf) {
+		map->root = NULL;
+		map->first = NULL;
+	} else
+		map->root = ((struct binner *) n)->children[0];
+
+	l_free(n);
+}
+
+static void bnode_free(struct bnode *n)
+{
+	unsigned int i;
+
+	if (!n->leaf)
+		for (i = 0; i <= n->count; i++)
+			bnode_free(((struct binner *) n)->children[i]);
+
+	l_free(n);
+}
+
+/**
+ * l_ordmap_new:
+ * @compare: Key comparison function or NULL
+ *
+ * Create a new ordered map.  Keys are not copied, they must stay valid
+ * while they are in the map.  If @compare is NULL the key pointers are
+ * compared as unsigned integers, which suits keys created with
+ * L_UINT_TO_PTR.
+ *
+ * Returns: a newly allocated #l_ordmap object
+ **/
+LIB_EXPORT struct l_ordmap *l_ordmap_new(l_ordmap_compare_func_t compare)
+{
+	struct l_ordmap *map = l_new(struct l_ordmap, 1);
+
+	map->compare = compare;
+
+	return map;
+}
+
+/**
+ * l_ordmap_destroy:
+ * @map: ordered map object
+ * @destroy: destroy function
+ *
+ * Free ordered map and call @destory on all remaining entries.
+ **/
+LIB_EXPORT void l_ordmap_destroy(struct l_ordmap *map,
+					l_ordmap_destroy_func_t destroy)
+{
+	struct bleaf *leaf;
+	unsigned int i;
+
+	if (unlikely(!map))
+		return;
+
+	if (destroy)
+		for (leaf = map->first; leaf; leaf = leaf->next)
+			for (i = 0; i < leaf->n.count; i++)
+				destroy(leaf->values[i]);
+
+	if (map->root)
+		bnode_free(map->root);
+
+	l_free(map);
+}
+
+/**
+ * l_ordmap_insert:
+ * @map: ordered map object
+ * @key: key pointer
+ * @value: value pointer
+ *
+ * Insert new @value entry with @key.
+ *
+ * Returns: #true when value has been added and #false in case of failure or
+ * if an entry with an equal key already exists.
+ **/
+LIB_EXPORT bool l_ordmap_insert(struct l_ordmap *map, const void *key,
+								void *value)
+{
+	struct path path;
+	struct bleaf *leaf;
+	struct bnode *child;
+	const void *sep;
+	unsigned int pos;
+
+	if (unlikely(!map))
+		return false;
+
+	if (!map->root) {
+		leaf = l_new(struct bleaf, 1);
+		leaf->n.leaf = true;
+
+		map->root = &leaf->n;
+		map->first = leaf;
+	}
+
+	leaf = find_leaf(map, key, &path);
+	pos = lower_index(map, &leaf->n, key);
+
+	if (pos < leaf->n.count && !map_compare(map, leaf->n.keys[pos], key))
+		return false;
+
+	map->entries++;
+
+	if (leaf->n.count < MAX_KEYS) {
+		leaf_insert_at(leaf, pos, key, value);
+		return true;
+	}
+
+	child = &leaf_split(leaf)->n;
+
+	if (pos < leaf->n.count)
+		leaf_insert_at(leaf, pos, key, value);
+	else
+		leaf_insert_at((struct bleaf *) child, pos - leaf->n.count,
+								key, value);
+
+	sep = child->keys[0];
+
+	while (path.depth) {
+		struct binner *parent = path.nodes[--path.depth];
+		unsigned int i = path.index[path.depth];
+
+		if (parent->n.count < MAX_KEYS) {
+			inner_insert_at(parent, i, sep, child);
+			return true;
+		}
+
+		child = &inner_split(parent, i, sep, child, &sep)->n;
+	}
+
+	/* The root was split, grow the tree by one level */
+	{
+		struct binner *root = l_new(struct binner, 1);
+
+		root->n.count = 1;
+		root->n.keys[0] = sep;
+		root->children[0] = map->root;
+		root->children[1] = child;
+
+		map->root = &root->n;
+	}
+
+	return true;
+}
+
+/**
+ * l_ordmap_remove:
+ * @map: ordered map object
+ * @key: key pointer
+ *
+ * Remove entry for @key.
+ *
+ * Returns: value pointer of the removed entry or #NULL in case of failure
+ **/
+LIB_EXPORT void *l_ordmap_remove(struct l_ordmap *map, const void *key)
+{
+	struct path path;
+	struct bleaf *leaf;
+	unsigned int pos;
+	void *value;
+
+	if (unlikely(!map))
+		return NULL;
+
+	leaf = find_leaf(map, key, &path);
+	if (!leaf)
+		return NULL;
+
+	pos = lower_index(map, &leaf->n, key);
+
+	if (pos == leaf->n.count || map_compare(map, leaf->n.keys[pos], key))
+		return NULL;
+
+	value = leaf->values[pos];
+	leaf_remove_at(leaf, pos);
+	map->entries--;
+
+	rebalance(map, &leaf->n, &path);
+
+	return value;
+}
+
+/**
+ * l_ordmap_lookup:
+ * @map: ordered map object
+ * @key: key pointer
+ *
+ * Lookup entry for @key.
+ *
+ * Returns: value pointer for @key or #NULL in case of failure
+ **/
+LIB_EXPORT void *l_ordmap_lookup(struct l_ordmap *map, const void *key)
+{
+	struct bleaf *leaf;
+	unsigned int pos;
+
+	if (unlikely(!map))
+		return NULL;
+
+	leaf = find_leaf(map, key, NULL);
+	if (!leaf)
+		return NULL;
+
+	pos = lower_index(map, &leaf->n, key);
+
+	if (pos == leaf->n.count || map_compare(map, leaf->n.keys[pos], key))
+		return NULL;
+
+	return leaf->values[pos];
+}
+
+/**
+ * l_ordmap_foreach:
+ * @map: ordered map object
+ * @function: callback function
+ * @user_data: user data given to callback function
+ *
+ * Call @function for every entry in @map in ascending key order.  The map
+ * must not be modified from within @function, use l_ordmap_foreach_remove
+ * or an iterator to remove entries while iterating.
+ **/
+LIB_EXPORT void l_ordmap_foreach(struct l_ordmap *map,
+			l_ordmap_foreach_func_t function, void *user_data)
+{
+	struct bleaf *leaf;
+	unsigned int i;
+
+	if (unlikely(!map || !function))
+		return;
+
+	for (leaf = map->first; leaf; leaf = leaf->next)
+		for (i = 0; i < leaf->n.count; i++)
+			function(leaf->n.keys[i], leaf->values[i], user_data);
+}
+
+/**
+ * l_ordmap_foreach_remove:
+ * @map: ordered map object
+ * @function: callback function
+ * @user_data: user data given to callback function
+ *
+ * Call @function for every entry in @map in ascending key order and remove
+ * the entries for which it returns #true.
+ *
+ * Returns: number of entries removed
+ **/
+LIB_EXPORT unsigned int l_ordmap_foreach_remove(struct l_ordmap *map,
+					l_ordmap_remove_func_t function,
+					void *user_data)
+{
+	struct l_ordmap_iter iter;
+	unsigned int count = 0;
+	bool valid;
+
+	if (unlikely(!map || !function))
+		return 0;
+
+	for (valid = l_ordmap_iter_first(&iter, map); valid;
+					valid = l_ordmap_iter_next(&iter)) {
+		if (!function(iter.key, iter.value, user_data))
+			continue;
+
+		l_ordmap_iter_remove(&iter);
+		count++;
+	}
+
+	return count;
+}
+
+/**
+ * l_ordmap_size:
+ * @map: ordered map object
+ *
+ * Returns: entries in the ordered map
+ **/
+LIB_EXPORT unsigned int l_ordmap_size(struct l_ordmap *map)
+{
+	if (unlikely(!map))
+		return 0;
+
+	return map->entries;
+}
+
+/**
+ * l_ordmap_isempty:
+ * @map: ordered map object
+ *
+ * Returns: #true if ordered map is empty and #false if not
+ **/
+LIB_EXPORT bool l_ordmap_isempty(struct l_ordmap *map)
+{
+	if (unlikely(!map))
+		return true;
+
+	return map->entries == 0;
+}
+
+static bool iter_set(struct l_ordmap_iter *iter, struct bleaf *leaf,
+							unsigned int pos)
+{
+	if (leaf && pos >= leaf->n.count) {
+		leaf = leaf->next;
+		pos = 0;
+	}
+
+	iter->node = leaf;
+	iter->pos = pos;
+	iter->pending = false;
+
+	if (!leaf) {
+		iter->key = NULL;
+		iter->value = NULL;
+		return false;
+	}
+
+	iter->key = leaf->n.keys[pos];
+	iter->value = leaf->values[pos];
+
+	return true;
+}
+
+/**
+ * l_ordmap_iter_first:
+ * @iter: iterator
+ * @map: ordered map object
+ *
+ * Positions @iter at the entry with the smallest key.  Iterators stay
+ * valid across removals done with l_ordmap_iter_remove on the same
+ * iterator, any other modification of @map invalidates them.
+ *
+ * Returns: #true if @iter points to an entry, #false if @map is empty
+ **/
+LIB_EXPORT bool l_ordmap_iter_first(struct l_ordmap_iter *iter,
+						struct l_ordmap *map)
+{
+	if (unlikely(!iter))
+		return false;
+
+	iter->map = map;
+
+	return iter_set(iter, map ? map->first : NULL, 0);
+}
+
+/**
+ * l_ordmap_iter_lower_bound:
+ * @iter: iterator
+ * @map: ordered map object
+ * @key: key pointer
+ *
+ * Positions @iter at the first entry whose key is not less than @key.
+ *
+ * Returns: #true if @iter points to an entry, #false if there is none
+ **/
+LIB_EXPORT bool l_ordmap_iter_lower_bound(struct l_ordmap_iter *iter,
+				struct l_ordmap *map, const void *key)
+{
+	struct bleaf *leaf;
+
+	if (unlikely(!iter))
+		return false;
+
+	iter->map = map;
+
+	if (unlikely(!map))
+		return iter_set(iter, NULL, 0);
+
+	leaf = find_leaf(map, key, NULL);
+	if (!leaf)
+		return iter_set(iter, NULL, 0);
+
+	return iter_set(iter, leaf, lower_index(map, &leaf->n, key));
+}
+
+/**
+ * l_ordmap_iter_upper_bound:
+ * @iter: iterator
+ * @map: ordered map object
+ * @key: key pointer
+ *
+ * Positions @iter at the first entry whose key is greater than @key.
+ *
+ * Returns: #true if @iter points to an entry, #false if there is none
+ **/
+LIB_EXPORT bool l_ordmap_iter_upper_bound(struct l_ordmap_iter *iter,
+				struct l_ordmap *map, const void *key)
+{
+	struct bleaf *leaf;
+
+	if (unlikely(!iter))
+		return false;
+
+	iter->map = map;
+
+	if (unlikely(!map))
+		return iter_set(iter, NULL, 0);
+
+	leaf = find_leaf(map, key, NULL);
+	if (!leaf)
+		return iter_set(iter, NULL, 0);
+
+	return iter_set(iter, leaf, upper_index(map, &leaf->n, key));
+}
+
+/**
+ * l_ordmap_iter_next:
+ * @iter: iterator
+ *
+ * Advances @iter to the entry with the next larger key.
+ *
+ * Returns: #true if @iter points to an entry, #false at the end of the map
+ **/
+LIB_EXPORT bool l_ordmap_iter_next(struct l_ordmap_iter *iter)
+{
+	if (unlikely(!iter || !iter->node))
+		return false;
+
+	/* The entry following a removed one is already in place */
+	if (iter->pending)
+		return iter_set(iter, iter->node, iter->pos);
+
+	return iter_set(iter, iter->node, iter->pos + 1);
+}
+
+/**
+ * l_ordmap_iter_remove:
+ * @iter: iterator
+ *
+ * Removes the entry @iter points to.  A subsequent call to
+ * l_ordmap_iter_next moves @iter to the entry that followed the removed
+ * one.
+ *
+ * Returns: value pointer of the removed entry or #NULL in case of failure
+ **/
+LIB_EXPORT void *l_ordmap_iter_remove(struct l_ordmap_iter *iter)
+{
+	struct l_ordmap_iter next;
+	const void *next_key = NULL;
+	bool has_next;
+	void *value;
+
+	if (unlikely(!iter || !iter->node || iter->pending))
+		return NULL;
+
+	/*
+	 * Rebalancing may move entries between nodes, so remember the key
+	 * of the following entry and look it up again afterwards.
+	 */
+	next = *iter;
+	has_next = l_ordmap_iter_next(&next);
+	if (has_next)
+		next_key = next.key;
+
+	value = l_ordmap_remove(iter->map, iter->key);
+
+	if (has_next)
+		l_ordmap_iter_lower_bound(iter, iter->map, next_key);
+	else
+		iter_set(iter, NULL, 0);
+
+	iter->key = NULL;
+	iter->value = NULL;
+	iter->pending = true;
+
+	return value;
+}
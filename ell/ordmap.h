@@ -0,0 +1,78 @@
+/*
+ *
+ *  Embedded Linux library
+ *
+ *  Copyright (C) 2019  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __ELL_ORDMAP_H
+#define __ELL_ORDMAP_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int (*l_ordmap_compare_func_t) (const void *a, const void *b);
+typedef void (*l_ordmap_foreach_func_t) (const void *key, void *value,
+							void *user_data);
+typedef bool (*l_ordmap_remove_func_t) (const void *key, void *value,
+							void *user_data);
+typedef void (*l_ordmap_destroy_func_t) (void *value);
+
+struct l_ordmap;
+
+struct l_ordmap_iter {
+	struct l_ordmap *map;
+	const void *key;
+	void *value;
+	void *node;
+	unsigned int pos;
+	bool pending;
+};
+
+struct l_ordmap *l_ordmap_new(l_ordmap_compare_func_t compare);
+void l_ordmap_destroy(struct l_ordmap *map, l_ordmap_destroy_func_t destroy);
+
+bool l_ordmap_insert(struct l_ordmap *map, const void *key, void *value);
+void *l_ordmap_remove(struct l_ordmap *map, const void *key);
+void *l_ordmap_lookup(struct l_ordmap *map, const void *key);
+
+void l_ordmap_foreach(struct l_ordmap *map, l_ordmap_foreach_func_t function,
+							void *user_data);
+unsigned int l_ordmap_foreach_remove(struct l_ordmap *map,
+					l_ordmap_remove_func_t function,
+					void *user_data);
+
+unsigned int l_ordmap_size(struct l_ordmap *map);
+bool l_ordmap_isempty(struct l_ordmap *map);
+
+bool l_ordmap_iter_first(struct l_ordmap_iter *iter, struct l_ordmap *map);
+bool l_ordmap_iter_lower_bound(struct l_ordmap_iter *iter,
+				struct l_ordmap *map, const void *key);
+bool l_ordmap_iter_upper_bound(struct l_ordmap_iter *iter,
+				struct l_ordmap *map, const void *key);
+bool l_ordmap_iter_next(struct l_ordmap_iter *iter);
+void *l_ordmap_iter_remove(struct l_ordmap_iter *iter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ELL_ORDMAP_H */
@@ -54,3 +54,9 @@ int watch_clear(int fd);
 int idle_add(idle_event_cb_t callback, void *user_data, uint32_t flags,
 		idle_destroy_cb_t destroy);
 void idle_remove(int id);
+
+void *mempool_alloc(size_t size);
+void mempool_free(void *ptr, size_t size);
+unsigned int mempool_slab_count(size_t size);
+
+#define mempool_new(type) ((type *) mempool_alloc(sizeof(type)))
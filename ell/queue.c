@@ -108,7 +108,7 @@ LIB_EXPORT void l_queue_clear(struct l_queue *queue,
 
 		entry = entry->next;
 
-		l_free(tmp);
+		mempool_free(tmp, sizeof(struct l_queue_entry));
 	}
 
 	queue->head = NULL;
@@ -133,7 +133,7 @@ LIB_EXPORT bool l_queue_push_tail(struct l_queue *queue, void *data)
 	if (unlikely(!queue))
 		return false;
 
-	entry = l_new(struct l_queue_entry, 1);
+	entry = mempool_new(struct l_queue_entry);
 
 	entry->data = data;
 	entry->next = NULL;
@@ -168,7 +168,7 @@ LIB_EXPORT bool l_queue_push_head(struct l_queue *queue, void *data)
 	if (unlikely(!queue))
 		return false;
 
-	entry = l_new(struct l_queue_entry, 1);
+	entry = mempool_new(struct l_queue_entry);
 
 	entry->data = data;
 	entry->next = queue->head;
@@ -212,7 +212,7 @@ LIB_EXPORT void *l_queue_pop_head(struct l_queue *queue)
 
 	data = entry->data;
 
-	l_free(entry);
+	mempool_free(entry, sizeof(struct l_queue_entry));
 
 	queue->entries--;
 
@@ -285,7 +285,7 @@ LIB_EXPORT bool l_queue_insert(struct l_queue *queue, void *data,
 	if (unlikely(!queue || !function))
 		return false;
 
-	entry = l_new(struct l_queue_entry, 1);
+	entry = mempool_new(struct l_queue_entry);
 
 	entry->data = data;
 	entry->next = NULL;
@@ -323,6 +323,89 @@ done:
 	return true;
 }
 
+/**
+ * l_queue_sort:
+ * @queue: queue object
+ * @function: compare function
+ * @user_data: user data given to compare function
+ *
+ * Sorts the entries of the queue in place using a bottom-up merge sort.
+ * The sort is stable, i.e. entries which compare equal keep their relative
+ * order, and relinks the existing entries without allocating any memory.
+ * @function follows the same convention as for l_queue_insert().
+ *
+ * Returns: #true when the queue has been sorted and #false in case of failure
+ **/
+LIB_EXPORT bool l_queue_sort(struct l_queue *queue,
+			l_queue_compare_func_t function, void *user_data)
+{
+	struct l_queue_entry *list, *tail, *left, *right, *entry;
+	unsigned int run, merges, left_size, right_size;
+
+	if (unlikely(!queue || !function))
+		return false;
+
+	list = queue->head;
+	if (!list)
+		return true;
+
+	for (run = 1;; run *= 2) {
+		left = list;
+		list = NULL;
+		tail = NULL;
+		merges = 0;
+
+		while (left) {
+			merges++;
+
+			right = left;
+			for (left_size = 0; right && left_size < run;
+								left_size++)
+				right = right->next;
+
+			right_size = run;
+
+			while (left_size || (right_size && right)) {
+				if (!left_size) {
+					entry = right;
+					right = right->next;
+					right_size--;
+				} else if (!right_size || !right ||
+						function(left->data,
+							right->data,
+							user_data) <= 0) {
+					entry = left;
+					left = left->next;
+					left_size--;
+				} else {
+					entry = right;
+					right = right->next;
+					right_size--;
+				}
+
+				if (tail)
+					tail->next = entry;
+				else
+					list = entry;
+
+				tail = entry;
+			}
+
+			left = right;
+		}
+
+		tail->next = NULL;
+
+		if (merges <= 1)
+			break;
+	}
+
+	queue->head = list;
+	queue->tail = tail;
+
+	return true;
+}
+
 /**
  * l_queue_find:
  * @queue: queue object
@@ -379,7 +462,7 @@ LIB_EXPORT bool l_queue_remove(struct l_queue *queue, void *data)
 		if (!entry->next)
 			queue->tail = prev;
 
-		l_free(entry);
+		mempool_free(entry, sizeof(struct l_queue_entry));
 
 		queue->entries--;
 
@@ -476,7 +559,7 @@ LIB_EXPORT unsigned int l_queue_foreach_remove(struct l_queue *queue,
 
 			entry = entry->next;
 
-			l_free(tmp);
+			mempool_free(tmp, sizeof(struct l_queue_entry));
 
 			count++;
 		} else {
@@ -529,7 +612,7 @@ LIB_EXPORT void *l_queue_remove_if(struct l_queue *queue,
 
 			data = tmp->data;
 
-			l_free(tmp);
+			mempool_free(tmp, sizeof(struct l_queue_entry));
 			queue->entries--;
 
 			return data;
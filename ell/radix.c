@@ -0,0 +1,1109 @@
+/*
+ *
+ *  Embedded Linux library
+ *
+ *  Copyright (C) 2019  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "util.h"
+#include "radix.h"
+#include "private.h"
+
+/**
+ * SECTION:radix
+ * @short_description: Radix tree support
+ *
+ * Radix tree support
+ */
+
+/*
+ * Adaptive radix tree: inner nodes come in four sizes and are grown or
+ * shrunk as children are added or removed, paths without branches are
+ * compressed into a per-node prefix.  Children that are leaves are stored
+ * as tagged pointers.  A key that ends at an inner node (because it is a
+ * prefix of other keys) is stored in the leaf slot of that node.
+ */
+#define PREFIX_INLINE 8
+
+enum node_type {
+	NODE4,
+	NODE16,
+	NODE48,
+	NODE256,
+};
+
+struct radix_leaf {
+	void *value;
+	size_t len;
+	uint8_t key[];
+};
+
+struct node {
+	uint8_t type;
+	uint16_t num_children;
+	size_t prefix_len;
+	union {
+		uint8_t inline_prefix[PREFIX_INLINE];
+		uint8_t *heap_prefix;
+	};
+	struct radix_leaf *leaf;
+};
+
+struct node4 {
+	struct node n;
+	uint8_t keys[4];
+	struct node *children[4];
+};
+
+struct node16 {
+	struct node n;
+	uint8_t keys[16];
+	struct node *children[16];
+};
+
+struct node48 {
+	struct node n;
+	uint8_t index[256];
+	struct node *children[48];
+};
+
+struct node256 {
+	struct node n;
+	struct node *children[256];
+};
+
+static const size_t node_sizes[] = {
+	[NODE4] = sizeof(struct node4),
+	[NODE16] = sizeof(struct node16),
+	[NODE48] = sizeof(struct node48),
+	[NODE256] = sizeof(struct node256),
+};
+
+#define IS_LEAF(p) ((uintptr_t) (p) & 1)
+#define TO_LEAF(p) ((struct radix_leaf *) ((uintptr_t) (p) & ~(uintptr_t) 1))
+#define FROM_LEAF(l) ((struct node *) ((uintptr_t) (l) | 1))
+
+/**
+ * l_radix:
+ *
+ * Opaque object representing the radix tree.
+ */
+struct l_radix {
+	struct node *root;
+	unsigned int entries;
+};
+
+static struct node *node_new(enum node_type type)
+{
+	struct node *n = mempool_alloc(node_sizes[type]);
+
+	n->type = type;
+
+	return n;
+}
+
+static void node_free_struct(struct node *n)
+{
+	mempool_free(n, node_sizes[n->type]);
+}
+
+static void node_free(struct node *n)
+{
+	if (n->prefix_len > PREFIX_INLINE)
+		l_free(n->heap_prefix);
+
+	node_free_struct(n);
+}
+
+static inline const uint8_t *node_prefix(const struct node *n)
+{
+	return n->prefix_len > PREFIX_INLINE ? n->heap_prefix :
+							n->inline_prefix;
+}
+
+/* @prefix is allowed to point into the current prefix of @n */
+static void node_set_prefix(struct node *n, const uint8_t *prefix, size_t len)
+{
+	uint8_t *old = n->prefix_len > PREFIX_INLINE ? n->heap_prefix : NULL;
+
+	if (len > PREFIX_INLINE)
+		n->heap_prefix = l_memdup(prefix, len);
+	else
+		memmove(n->inline_prefix, prefix, len);
+
+	n->prefix_len = len;
+	l_free(old);
+}
+
+/* Moves the header, including ownership of the prefix, to a new node */
+static void node_copy_header(struct node *dst, const struct node *src)
+{
+	dst->num_children = src->num_children;
+	dst->prefix_len = src->prefix_len;
+	memcpy(dst->inline_prefix, src->inline_prefix, PREFIX_INLINE);
+	dst->leaf = src->leaf;
+}
+
+static struct radix_leaf *leaf_new(const void *key, size_t len, void *value)
+{
+	struct radix_leaf *leaf = l_malloc(sizeof(struct radix_leaf) + len);
+
+	leaf->value = value;
+	leaf->len = len;
+	memcpy(leaf->key, key, len);
+
+	return leaf;
+}
+
+static inline bool leaf_matches(const struct radix_leaf *leaf,
+					const uint8_t *key, size_t len)
+{
+	return leaf->len == len && !memcmp(leaf->key, key, len);
+}
+
+static int node16_find(const struct node16 *n, uint8_t c)
+{
+	unsigned int mask = 0;
+	unsigned int i;
+
+	/* Written so that the compiler can turn it into a vector compare */
+	for (i = 0; i < 16; i++)
+		mask |= (unsigned int) (n->keys[i] == c) << i;
+
+	mask &= (1U << n->n.num_children) - 1;
+
+	return mask ? __builtin_ctz(mask) : -1;
+}
+
+static struct node **node_find_child(struct node *n, uint8_t c)
+{
+	switch (n->type) {
+	case NODE4:
+	{
+		struct node4 *n4 = (struct node4 *) n;
+		unsigned int i;
+
+		for (i = 0; i < n->num_children; i++)
+			if (n4->keys[i] == c)
+				return &n4->children[i];
+
+		return NULL;
+	}
+	case NODE16:
+	{
+		struct node16 *n16 = (struct node16 *) n;
+		int i = node16_find(n16, c);
+
+		return i < 0 ? NULL : &n16->children[i];
+	}
+	case NODE48:
+	{
+		struct node48 *n48 = (struct node48 *) n;
+
+		if (!n48->index[c])
+			return NULL;
+
+		return &n48->children[n48->index[c] - 1];
+	}
+	case NODE256:
+	{
+		struct node256 *n256 = (struct node256 *) n;
+
+		return n256->children[c] ? &n256->children[c] : NULL;
+	}
+	}
+
+	return NULL;
+}
+
+static void sorted_insert(uint8_t *keys, struct node **children,
+				unsigned int count, uint8_t c,
+				struct node *child)
+{
+	unsigned int i;
+
+	for (i = 0; i < count && keys[i] < c; i++)
+		;
+
+	memmove(keys + i + 1, keys + i, count - i);
+	memmove(children + i + 1, children + i,
+				(count - i) * sizeof(struct node *));
+
+	keys[i] = c;
+	children[i] = child;
+}
+
+static void node_add_child(struct node **ref, uint8_t c, struct node *child)
+{
+	struct node *n = *ref;
+
+	switch (n->type) {
+	case NODE4:
+	{
+		struct node4 *n4 = (struct node4 *) n;
+		struct node16 *n16;
+
+		if (n->num_children < 4) {
+			sorted_insert(n4->keys, n4->children,
+						n->num_children, c, child);
+			n->num_children++;
+			return;
+		}
+
+		n16 = (struct node16 *) node_new(NODE16);
+		node_copy_header(&n16->n, n);
+		memcpy(n16->keys, n4->keys, 4);
+		memcpy(n16->children, n4->children, sizeof(n4->children));
+		node_free_struct(n);
+
+		*ref = &n16->n;
+		node_add_child(ref, c, child);
+		return;
+	}
+	case NODE16:
+	{
+		struct node16 *n16 = (struct node16 *) n;
+		struct node48 *n48;
+		unsigned int i;
+
+		if (n->num_children < 16) {
+			sorted_insert(n16->keys, n16->children,
+						n->num_children, c, child);
+			n->num_children++;
+			return;
+		}
+
+		n48 = (struct node48 *) node_new(NODE48);
+		node_copy_header(&n48->n, n);
+
+		for (i = 0; i < 16; i++) {
+			n48->index[n16->keys[i]] = i + 1;
+			n48->children[i] = n16->children[i];
+		}
+
+		node_free_struct(n);
+
+		*ref = &n48->n;
+		node_add_child(ref, c, child);
+		return;
+	}
+	case NODE48:
+	{
+		struct node48 *n48 = (struct node48 *) n;
+		struct node256 *n256;
+		unsigned int i;
+
+		if (n->num_children < 48) {
+			for (i = 0; n48->children[i]; i++)
+				;
+
+			n48->index[c] = i + 1;
+			n48->children[i] = child;
+			n->num_children++;
+			return;
+		}
+
+		n256 = (struct node256 *) node_new(NODE256);
+		node_copy_header(&n256->n, n);
+
+		for (i = 0; i < 256; i++)
+			if (n48->index[i])
+				n256->children[i] =
+					n48->children[n48->index[i] - 1];
+
+		node_free_struct(n);
+
+		*ref = &n256->n;
+		node_add_child(ref, c, child);
+		return;
+	}
+	case NODE256:
+	{
+		struct node256 *n256 = (struct node256 *) n;
+
+		n256->children[c] = child;
+		n->num_children++;
+		return;
+	}
+	}
+}
+
+static void node_shrink(struct node **ref)
+{
+	struct node *n = *ref;
+	unsigned int i, j;
+
+	switch (n->type) {
+	case NODE4:
+		return;
+	case NODE16:
+	{
+		struct node16 *n16 = (struct node16 *) n;
+		struct node4 *n4;
+
+		if (n->num_children > 3)
+			return;
+
+		n4 = (struct node4 *) node_new(NODE4);
+		node_copy_header(&n4->n, n);
+		memcpy(n4->keys, n16->keys, n->num_children);
+		memcpy(n4->children, n16->children,
+				n->num_children * sizeof(struct node *));
+		node_free_struct(n);
+
+		*ref = &n4->n;
+		return;
+	}
+	case NODE48:
+	{
+		struct node48 *n48 = (struct node48 *) n;
+		struct node16 *n16;
+
+		if (n->num_children > 12)
+			return;
+
+		n16 = (struct node16 *) node_new(NODE16);
+		node_copy_header(&n16->n, n);
+
+		for (i = 0, j = 0; i < 256; i++) {
+			if (!n48->index[i])
+				continue;
+
+			n16->keys[j] = i;
+			n16->children[j++] = n48->children[n48->index[i] - 1];
+		}
+
+		node_free_struct(n);
+
+		*ref = &n16->n;
+		return;
+	}
+	case NODE256:
+	{
+		struct node256 *n256 = (struct node256 *) n;
+		struct node48 *n48;
+
+		if (n->num_children > 37)
+			return;
+
+		n48 = (struct node48 *) node_new(NODE48);
+		node_copy_header(&n48->n, n);
+
+		for (i = 0, j = 0; i < 256; i++) {
+			if (!n256->children[i])
+				continue;
+
+			n48->index[i] = j + 1;
+			n48->children[j++] = n256->children[i];
+		}
+
+		node_free_struct(n);
+
+		*ref = &n48->n;
+		return;
+	}
+	}
+}
+
+static void node_remove_child(struct node **ref, uint8_t c)
+{
+	struct node *n = *ref;
+
+	switch (n->type) {
+	case NODE4:
+	case NODE16:
+	{
+		uint8_t *keys;
+		struct node **children;
+		unsigned int i;
+
+		if (n->type == NODE4) {
+			keys = ((struct node4 *) n)->keys;
+			children = ((struct node4 *) n)->children;
+		} else {
+			keys = ((struct node16 *) n)->keys;
+			children = ((struct node16 *) n)->children;
+		}
+
+		for (i = 0; keys[i] != c; i++)
+			;
+
+		memmove(keys + i, keys + i + 1, n->num_children - i - 1);
+		memmove(children + i, children + i + 1,
+				(n->num_children - i - 1) *
+				sizeof(struct node *));
+		break;
+	}
+	case NODE48:
+	{
+		struct node48 *n48 = (struct node48 *) n;
+
+		n48->children[n48->index[c] - 1] = NULL;
+		n48->index[c] = 0;
+		break;
+	}
+	case NODE256:
+		((struct node256 *) n)->children[c] = NULL;
+		break;
+	}
+
+	n->num_children--;
+	node_shrink(ref);
+}
+
+static struct node *node_first_child(struct node *n, uint8_t *out_c)
+{
+	unsigned int i;
+
+	switch (n->type) {
+	case NODE4:
+		*out_c = ((struct node4 *) n)->keys[0];
+		return ((struct node4 *) n)->children[0];
+	case NODE16:
+		*out_c = ((struct node16 *) n)->keys[0];
+		return ((struct node16 *) n)->children[0];
+	case NODE48:
+		for (i = 0; i < 256; i++) {
+			uint8_t idx = ((struct node48 *) n)->index[i];
+
+			if (idx) {
+				*out_c = i;
+				return ((struct node48 *) n)->children[idx - 1];
+			}
+		}
+		break;
+	case NODE256:
+		for (i = 0; i < 256; i++) {
+			struct node *child = ((struct node256 *) n)->children[i];
+
+			if (child) {
+				*out_c = i;
+				return child;
+			}
+		}
+		break;
+	}
+
+	return NULL;
+}
+
+/*
+ * Removes nodes that no longer branch: a node without children collapses
+ * into its leaf and a node with a single child is merged into that child.
+ */
+static void node_compact(struct node **ref)
+{
+	struct node *n = *ref;
+	struct node *child;
+	uint8_t *prefix;
+	size_t len;
+	uint8_t c = 0;
+
+	if (n->num_children == 0) {
+		*ref = n->leaf ? FROM_LEAF(n->leaf) : NULL;
+		node_free(n);
+		return;
+	}
+
+	if (n->num_children > 1 || n->leaf)
+		return;
+
+	child = node_first_child(n, &c);
+
+	if (!IS_LEAF(child)) {
+		len = n->prefix_len + 1 + child->prefix_len;
+		prefix = l_malloc(len);
+
+		memcpy(prefix, node_prefix(n), n->prefix_len);
+		prefix[n->prefix_len] = c;
+		memcpy(prefix + n->prefix_len + 1, node_prefix(child),
+							child->prefix_len);
+
+		node_set_prefix(child, prefix, len);
+		l_free(prefix);
+	}
+
+	*ref = child;
+	node_free(n);
+}
+
+/* Stores @leaf below the inner node at @ref whose prefix ends at @depth */
+static void node_attach(struct node **ref, struct radix_leaf *leaf,
+							size_t depth)
+{
+	if (leaf->len == depth)
+		(*ref)->leaf = leaf;
+	else
+		node_add_child(ref, leaf->key[depth], FROM_LEAF(leaf));
+}
+
+static bool radix_insert(struct node **ref, struct radix_leaf *leaf)
+{
+	const uint8_t *key = leaf->key;
+	size_t len = leaf->len;
+	size_t depth = 0;
+
+	while (true) {
+		struct node *n = *ref;
+		struct node **child;
+		const uint8_t *prefix;
+		size_t max;
+		size_t p;
+
+		if (!n) {
+			*ref = FROM_LEAF(leaf);
+			return true;
+		}
+
+		if (IS_LEAF(n)) {
+			struct radix_leaf *other = TO_LEAF(n);
+
+			if (leaf_matches(other, key, len))
+				return false;
+
+			max = minsize(other->len, len);
+
+			for (p = depth; p < max && other->key[p] == key[p]; p++)
+				;
+
+			n = node_new(NODE4);
+			node_set_prefix(n, key + depth, p - depth);
+			*ref = n;
+
+			node_attach(ref, other, p);
+			node_attach(ref, leaf, p);
+			return true;
+		}
+
+		prefix = node_prefix(n);
+		max = minsize(n->prefix_len, len - depth);
+
+		for (p = 0; p < max && prefix[p] == key[depth + p]; p++)
+			;
+
+		if (p < n->prefix_len) {
+			struct node *split = node_new(NODE4);
+			uint8_t c = prefix[p];
+
+			node_set_prefix(split, prefix, p);
+			node_set_prefix(n, prefix + p + 1, n->prefix_len - p - 1);
+			*ref = split;
+
+			node_add_child(ref, c, n);
+			node_attach(ref, leaf, depth + p);
+			return true;
+		}
+
+		depth += n->prefix_len;
+
+		if (depth == len) {
+			if (n->leaf)
+				return false;
+
+			n->leaf = leaf;
+			return true;
+		}
+
+		child = node_find_child(n, key[depth]);
+		if (!child) {
+			node_add_child(ref, key[depth], FROM_LEAF(leaf));
+			return true;
+		}
+
+		ref = child;
+		depth++;
+	}
+}
+
+static struct radix_leaf *radix_remove(struct node **ref, const uint8_t *key,
+						size_t len, size_t depth)
+{
+	struct node *n = *ref;
+	struct radix_leaf *leaf;
+	struct node **child;
+	uint8_t c;
+
+	if (!n)
+		return NULL;
+
+	if (IS_LEAF(n)) {
+		leaf = TO_LEAF(n);
+
+		if (!leaf_matches(leaf, key, len))
+			return NULL;
+
+		*ref = NULL;
+		return leaf;
+	}
+
+	if (n->prefix_len > len - depth ||
+			memcmp(node_prefix(n), key + depth, n->prefix_len))
+		return NULL;
+
+	depth += n->prefix_len;
+
+	if (depth == len) {
+		leaf = n->leaf;
+		if (!leaf)
+			return NULL;
+
+		n->leaf = NULL;
+		node_compact(ref);
+		return leaf;
+	}
+
+	c = key[depth];
+
+	child = node_find_child(n, c);
+	if (!child)
+		return NULL;
+
+	leaf = radix_remove(child, key, len, depth + 1);
+	if (!leaf)
+		return NULL;
+
+	if (!*child)
+		node_remove_child(ref, c);
+
+	node_compact(ref);
+
+	return leaf;
+}
+
+static void radix_foreach(struct node *n, l_radix_foreach_func_t function,
+							void *user_data)
+{
+	unsigned int i;
+
+	if (IS_LEAF(n)) {
+		struct radix_leaf *leaf = TO_LEAF(n);
+
+		function(leaf->key, leaf->len, leaf->value, user_data);
+		return;
+	}
+
+	/* A key ending at this node sorts before all keys below it */
+	if (n->leaf)
+		function(n->leaf->key, n->leaf->len, n->leaf->value,
+								user_data);
+
+	switch (n->type) {
+	case NODE4:
+		for (i = 0; i < n->num_children; i++)
+			radix_foreach(((struct node4 *) n)->children[i],
+							function, user_data);
+		break;
+	case NODE16:
+		for (i = 0; i < n->num_children; i++)
+			radix_foreach(((struct node16 *) n)->children[i],
+							function, user_data);
+		break;
+	case NODE48:
+	{
+		struct node48 *n48 = (struct node48 *) n;
+
+		for (i = 0; i < 256; i++)
+			if (n48->index[i])
+				radix_foreach(n48->children[n48->index[i] - 1],
+							function, user_data);
+		break;
+	}
+	case NODE256:
+	{
+		struct node256 *n256 = (struct node256 *) n;
+
+		for (i = 0; i < 256; i++)
+			if (n256->children[i])
+				radix_foreach(n256->children[i],
+							function, user_data);
+		break;
+	}
+	}
+}
+
+static void radix_free(struct node *n, l_radix_destroy_func_t destroy)
+{
+	unsigned int i;
+
+	if (IS_LEAF(n)) {
+		struct radix_leaf *leaf = TO_LEAF(n);
+
+		if (destroy)
+			destroy(leaf->value);
+
+		l_free(leaf);
+		return;
+	}
+
+	if (n->leaf)
+		radix_free(FROM_LEAF(n->leaf), destroy);
+
+	switch (n->type) {
+	case NODE4:
+		for (i = 0; i < n->num_children; i++)
+			radix_free(((struct node4 *) n)->children[i], destroy);
+		break;
+	case NODE16:
+		for (i = 0; i < n->num_children; i++)
+			radix_free(((struct node16 *) n)->children[i], destroy);
+		break;
+	case NODE48:
+		for (i = 0; i < 48; i++)
+			if (((struct node48 *) n)->children[i])
+				radix_free(((struct node48 *) n)->children[i],
+								destroy);
+		break;
+	case NODE256:
+		for (i = 0; i < 256; i++)
+			if (((struct node256 *) n)->children[i])
+				radix_free(((struct node256 *) n)->children[i],
+								destroy);
+		break;
+	}
+
+	node_free(n);
+}
+
+/**
+ * l_radix_new:
+ *
+ * Create a new radix tree.  Keys are arbitrary byte strings, which are
+ * copied into the tree.
+ *
+ * Returns: a newly allocated #l_radix object
+ **/
+LIB_EXPORT struct l_radix *l_radix_new(void)
+{
+	return l_new(struct l_radix, 1);
+}
+
+/**
+ * l_radix_destroy:
+ * @radix: radix tree object
+ * @destroy: destroy function
+ *
+ * Free radix tree and call @destory on all remaining entries.
+ **/
+LIB_EXPORT void l_radix_destroy(struct l_radix *radix,
+					l_radix_destroy_func_t destroy)
+{
+	if (unlikely(!radix))
+		return;
+
+	if (radix->root)
+		radix_free(radix->root, destroy);
+
+	l_free(radix);
+}
+
+/**
+ * l_radix_insert:
+ * @radix: radix tree object
+ * @key: key pointer
+ * @len: length of @key in bytes
+ * @value: value pointer
+ *
+ * Insert new @value entry with @key.
+ *
+ * Returns: #true when value has been added and #false in case of failure or
+ * if an entry with the same key already exists.
+ **/
+LIB_EXPORT bool l_radix_insert(struct l_radix *radix, const void *key,
+						size_t len, void *value)
+{
+	struct radix_leaf *leaf;
+
+	if (unlikely(!radix || (!key && len)))
+		return false;
+
+	leaf = leaf_new(key, len, value);
+
+	if (!radix_insert(&radix->root, leaf)) {
+		l_free(leaf);
+		return false;
+	}
+
+	radix->entries++;
+
+	return true;
+}
+
+/**
+ * l_radix_remove:
+ * @radix: radix tree object
+ * @key: key pointer
+ * @len: length of @key in bytes
+ *
+ * Remove entry for @key.
+ *
+ * Returns: value pointer of the removed entry or #NULL in case of failure
+ **/
+LIB_EXPORT void *l_radix_remove(struct l_radix *radix, const void *key,
+								size_t len)
+{
+	struct radix_leaf *leaf;
+	void *value;
+
+	if (unlikely(!radix || (!key && len)))
+		return NULL;
+
+	leaf = radix_remove(&radix->root, key, len, 0);
+	if (!leaf)
+		return NULL;
+
+	value = leaf->value;
+	l_free(leaf);
+	radix->entries--;
+
+	return value;
+}
+
+/**
+ * l_radix_lookup:
+ * @radix: radix tree object
+ * @key: key pointer
+ * @len: length of @key in bytes
+ *
+ * Lookup entry for @key.
+ *
+ * Returns: value pointer for @key or #NULL in case of failure
+ **/
+LIB_EXPORT void *l_radix_lookup(struct l_radix *radix, const void *key,
+								size_t len)
+{
+	const uint8_t *k = key;
+	struct node *n;
+	size_t depth = 0;
+
+	if (unlikely(!radix || (!key && len)))
+		return NULL;
+
+	n = radix->root;
+
+	while (n) {
+		struct node **child;
+
+		if (IS_LEAF(n)) {
+			struct radix_leaf *leaf = TO_LEAF(n);
+
+			return leaf_matches(leaf, k, len) ? leaf->value : NULL;
+		}
+
+		if (n->prefix_len > len - depth ||
+				memcmp(node_prefix(n), k + depth,
+							n->prefix_len))
+			return NULL;
+
+		depth += n->prefix_len;
+
+		if (depth == len)
+			return n->leaf ? n->leaf->value : NULL;
+
+		child = node_find_child(n, k[depth]);
+		if (!child)
+			return NULL;
+
+		n = *child;
+		depth++;
+	}
+
+	return NULL;
+}
+
+/**
+ * l_radix_lookup_prefix:
+ * @radix: radix tree object
+ * @key: key pointer
+ * @len: length of @key in bytes
+ * @out_len: Set to the length of the matching entry's key, can be NULL
+ *
+ * Finds the entry with the longest key that is a prefix of (or equal to)
+ * @key.
+ *
+ * Returns: value pointer of the entry found or #NULL if no entry's key is
+ * a prefix of @key.
+ **/
+LIB_EXPORT void *l_radix_lookup_prefix(struct l_radix *radix,
+					const void *key, size_t len,
+					size_t *out_len)
+{
+	const uint8_t *k = key;
+	struct radix_leaf *best = NULL;
+	struct node *n;
+	size_t depth = 0;
+
+	if (unlikely(!radix || (!key && len)))
+		return NULL;
+
+	n = radix->root;
+
+	while (n) {
+		struct node **child;
+
+		if (IS_LEAF(n)) {
+			struct radix_leaf *leaf = TO_LEAF(n);
+
+			if (leaf->len <= len && !memcmp(leaf->key, k, leaf->len))
+				best = leaf;
+
+			break;
+		}
+
+		if (n->prefix_len > len - depth ||
+				memcmp(node_prefix(n), k + depth,
+							n->prefix_len))
+			break;
+
+		depth += n->prefix_len;
+
+		if (n->leaf)
+			best = n->leaf;
+
+		if (depth == len)
+			break;
+
+		child = node_find_child(n, k[depth]);
+		if (!child)
+			break;
+
+		n = *child;
+		depth++;
+	}
+
+	if (!best)
+		return NULL;
+
+	if (out_len)
+		*out_len = best->len;
+
+	return best->value;
+}
+
+/**
+ * l_radix_foreach:
+ * @radix: radix tree object
+ * @function: callback function
+ * @user_data: user data given to callback function
+ *
+ * Call @function for every entry in @radix, in lexicographical order of
+ * the keys.  The tree must not be modified from within @function.
+ **/
+LIB_EXPORT void l_radix_foreach(struct l_radix *radix,
+			l_radix_foreach_func_t function, void *user_data)
+{
+	if (unlikely(!radix || !function))
+		return;
+
+	if (radix->root)
+		radix_foreach(radix->root, function, user_data);
+}
+
+/**
+ * l_radix_foreach_prefix:
+ * @radix: radix tree object
+ * @prefix: key prefix
+ * @len: length of @prefix in bytes
+ * @function: callback function
+ * @user_data: user data given to callback function
+ *
+ * Call @function for every entry in @radix whose key starts with @prefix,
+ * in lexicographical order of the keys.  The tree must not be modified
+ * from within @function.
+ **/
+LIB_EXPORT void l_radix_foreach_prefix(struct l_radix *radix,
+					const void *prefix, size_t len,
+					l_radix_foreach_func_t function,
+					void *user_data)
+{
+	const uint8_t *k = prefix;
+	struct node *n;
+	size_t depth = 0;
+
+	if (unlikely(!radix || !function || (!prefix && len)))
+		return;
+
+	n = radix->root;
+
+	while (n) {
+		struct node **child;
+		size_t max;
+
+		if (IS_LEAF(n)) {
+			struct radix_leaf *leaf = TO_LEAF(n);
+
+			if (leaf->len >= len && !memcmp(leaf->key, k, len))
+				function(leaf->key, leaf->len, leaf->value,
+								user_data);
+
+			return;
+		}
+
+		max = minsize(n->prefix_len, len - depth);
+
+		if (memcmp(node_prefix(n), k + depth, max))
+			return;
+
+		if (depth + n->prefix_len >= len) {
+			radix_foreach(n, function, user_data);
+			return;
+		}
+
+		depth += n->prefix_len;
+
+		child = node_find_child(n, k[depth]);
+		if (!child)
+			return;
+
+		n = *child;
+		depth++;
+	}
+}
+
+/**
+ * l_radix_size:
+ * @radix: radix tree object
+ *
+ * Returns: entries in the radix tree
+ **/
+LIB_EXPORT unsigned int l_radix_size(struct l_radix *radix)
+{
+	if (unlikely(!radix))
+		return 0;
+
+	return radix->entries;
+}
+
+/**
+ * l_radix_isempty:
+ * @radix: radix tree object
+ *
+ * Returns: #true if radix tree is empty and #false if not
+ **/
+LIB_EXPORT bool l_radix_isempty(struct l_radix *radix)
+{
+	if (unlikely(!radix))
+		return true;
+
+	return radix->entries == 0;
+}
@@ -0,0 +1,63 @@
+/*
+ *
+ *  Embedded Linux library
+ *
+ *  Copyright (C) 2019  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __ELL_RADIX_H
+#define __ELL_RADIX_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*l_radix_foreach_func_t) (const void *key, size_t len,
+						void *value, void *user_data);
+typedef void (*l_radix_destroy_func_t) (void *value);
+
+struct l_radix;
+
+struct l_radix *l_radix_new(void);
+void l_radix_destroy(struct l_radix *radix, l_radix_destroy_func_t destroy);
+
+bool l_radix_insert(struct l_radix *radix, const void *key, size_t len,
+							void *value);
+void *l_radix_remove(struct l_radix *radix, const void *key, size_t len);
+void *l_radix_lookup(struct l_radix *radix, const void *key, size_t len);
+void *l_radix_lookup_prefix(struct l_radix *radix, const void *key,
+					size_t len, size_t *out_len);
+
+void l_radix_foreach(struct l_radix *radix,
+			l_radix_foreach_func_t function, void *user_data);
+void l_radix_foreach_prefix(struct l_radix *radix,
+				const void *prefix, size_t len,
+				l_radix_foreach_func_t function,
+				void *user_data);
+
+unsigned int l_radix_size(struct l_radix *radix);
+bool l_radix_isempty(struct l_radix *radix);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ELL_RADIX_H */
@@ -27,9 +27,15 @@
 
 #define _GNU_SOURCE
 #include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
 #include <string.h>
 #include <sys/uio.h>
+#include <sys/mman.h>
 #include <sys/param.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <linux/memfd.h>
 
 #include "private.h"
 #include "ringbuf.h"
@@ -41,6 +47,8 @@
  * Ring Buffer support
  */
 
+#define CACHE_LINE_SIZE 64
+
 /**
  * l_ringbuf:
  *
@@ -49,10 +57,20 @@
 struct l_ringbuf {
 	void *buffer;
 	size_t size;
-	size_t in;
-	size_t out;
 	l_ringbuf_tracing_func_t in_tracing;
 	void *in_data;
+	bool mirrored;
+	bool spsc;
+	int notify_fd;
+	/*
+	 * In SPSC mode the producer and the consumer run on different
+	 * threads.  Keep the index each of them writes on its own cache line.
+	 */
+	uint8_t producer_pad[CACHE_LINE_SIZE];
+	size_t in;
+	uint8_t consumer_pad[CACHE_LINE_SIZE - sizeof(size_t)];
+	size_t out;
+	bool waiting;
 };
 
 #define RINGBUF_RESET 0
@@ -69,6 +87,89 @@ static inline unsigned int align_power2(unsigned int u)
 	return 1 << fls(u - 1);
 }
 
+/*
+ * The producer owns the in index and the consumer owns the out index.  Each
+ * side publishes its own index with release semantics and reads the other
+ * one with acquire semantics, which is all that is needed for a single
+ * producer and a single consumer to share the buffer without locking.
+ */
+static inline size_t ringbuf_in(struct l_ringbuf *ringbuf)
+{
+	return __atomic_load_n(&ringbuf->in, __ATOMIC_ACQUIRE);
+}
+
+static inline size_t ringbuf_out(struct l_ringbuf *ringbuf)
+{
+	return __atomic_load_n(&ringbuf->out, __ATOMIC_ACQUIRE);
+}
+
+static inline size_t ringbuf_used(struct l_ringbuf *ringbuf)
+{
+	size_t out = ringbuf_out(ringbuf);
+
+	return ringbuf_in(ringbuf) - out;
+}
+
+static inline size_t ringbuf_unused(struct l_ringbuf *ringbuf)
+{
+	size_t in = ringbuf_in(ringbuf);
+
+	return ringbuf->size - in + ringbuf_out(ringbuf);
+}
+
+static void ringbuf_produced(struct l_ringbuf *ringbuf, size_t len)
+{
+	static const uint64_t one = 1;
+
+	__atomic_store_n(&ringbuf->in, ringbuf->in + len, __ATOMIC_RELEASE);
+
+	if (!ringbuf->spsc)
+		return;
+
+	/* Pairs with the fence in l_ringbuf_arm_notify */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	/*
+	 * Only write to the consumer's cache line when it is actually
+	 * waiting, so that a busy consumer costs the producer a shared read
+	 */
+	if (!__atomic_load_n(&ringbuf->waiting, __ATOMIC_RELAXED))
+		return;
+
+	if (__atomic_exchange_n(&ringbuf->waiting, false, __ATOMIC_ACQ_REL) &&
+						ringbuf->notify_fd >= 0) {
+		if (write(ringbuf->notify_fd, &one, sizeof(one)) < 0)
+			return;
+	}
+}
+
+static void ringbuf_consumed(struct l_ringbuf *ringbuf, size_t len)
+{
+	size_t out = ringbuf->out + len;
+
+	/* The consumer must never touch the in index of a shared buffer */
+	if (!ringbuf->spsc && out == ringbuf->in) {
+		ringbuf->in = RINGBUF_RESET;
+		ringbuf->out = RINGBUF_RESET;
+		return;
+	}
+
+	__atomic_store_n(&ringbuf->out, out, __ATOMIC_RELEASE);
+}
+
+/*
+ * Number of bytes that can be accessed contiguously at @offset, out of
+ * @len.  With a mirrored mapping the data never needs to be split.
+ */
+static inline size_t ringbuf_contiguous(struct l_ringbuf *ringbuf,
+						size_t offset, size_t len)
+{
+	if (ringbuf->mirrored)
+		return len;
+
+	return minsize(len, ringbuf->size - offset);
+}
+
 /**
  * l_ringbuf_new:
  * @size: Minimum size of the ring buffer.
@@ -94,6 +195,89 @@ LIB_EXPORT struct l_ringbuf *l_ringbuf_new(size_t size)
 	ringbuf->size = real_size;
 	ringbuf->in = RINGBUF_RESET;
 	ringbuf->out = RINGBUF_RESET;
+	ringbuf->notify_fd = -1;
+
+	return ringbuf;
+}
+
+static void *mirrored_map(size_t size)
+{
+#ifdef __NR_memfd_create
+	void *base, *addr;
+	int fd;
+
+	fd = syscall(__NR_memfd_create, "ell-ringbuf", MFD_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+
+	if (ftruncate(fd, size) < 0)
+		goto fail;
+
+	/* Reserve twice the size, then map the same pages into both halves */
+	base = mmap(NULL, size * 2, PROT_NONE,
+					MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED)
+		goto fail;
+
+	addr = mmap(base, size, PROT_READ | PROT_WRITE,
+					MAP_SHARED | MAP_FIXED, fd, 0);
+	if (addr != base)
+		goto unmap;
+
+	addr = mmap(base + size, size, PROT_READ | PROT_WRITE,
+					MAP_SHARED | MAP_FIXED, fd, 0);
+	if (addr != base + size)
+		goto unmap;
+
+	close(fd);
+	return base;
+
+unmap:
+	munmap(base, size * 2);
+fail:
+	close(fd);
+#endif
+	return NULL;
+}
+
+/**
+ * l_ringbuf_new_mirrored:
+ * @size: Minimum size of the ring buffer.
+ *
+ * Create a new ring buffer whose storage is mapped twice, back to back, in
+ * the address space.  Any span of occupied or free bytes, including one
+ * that crosses the end of the buffer, is then contiguous in memory.  So
+ * l_ringbuf_peek() and l_ringbuf_reserve() always report the full length,
+ * which allows data to be read into and parsed from the ring buffer in
+ * place.  The size is rounded up to a multiple of the page size.
+ *
+ * Returns: a newly allocated #l_ringbuf object, or NULL if the mirrored
+ * mapping could not be established.
+ **/
+LIB_EXPORT struct l_ringbuf *l_ringbuf_new_mirrored(size_t size)
+{
+	struct l_ringbuf *ringbuf;
+	size_t page_size = sysconf(_SC_PAGESIZE);
+	size_t real_size;
+	void *buffer;
+
+	if (size < 2 || size > UINT_MAX / 2)
+		return NULL;
+
+	/* Both halves need to be page aligned */
+	real_size = align_power2(size < page_size ? page_size : size);
+
+	buffer = mirrored_map(real_size);
+	if (!buffer)
+		return NULL;
+
+	ringbuf = l_new(struct l_ringbuf, 1);
+	ringbuf->buffer = buffer;
+	ringbuf->size = real_size;
+	ringbuf->in = RINGBUF_RESET;
+	ringbuf->out = RINGBUF_RESET;
+	ringbuf->mirrored = true;
+	ringbuf->notify_fd = -1;
 
 	return ringbuf;
 }
@@ -109,7 +293,14 @@ LIB_EXPORT void l_ringbuf_free(struct l_ringbuf *ringbuf)
 	if (!ringbuf)
 		return;
 
-	l_free(ringbuf->buffer);
+	if (ringbuf->mirrored)
+		munmap(ringbuf->buffer, ringbuf->size * 2);
+	else
+		l_free(ringbuf->buffer);
+
+	if (ringbuf->notify_fd >= 0)
+		close(ringbuf->notify_fd);
+
 	l_free(ringbuf);
 }
 
@@ -161,7 +352,7 @@ LIB_EXPORT size_t l_ringbuf_len(struct l_ringbuf *ringbuf)
 	if (!ringbuf)
 		return 0;
 
-	return ringbuf->in - ringbuf->out;
+	return ringbuf_used(ringbuf);
 }
 
 /**
@@ -180,16 +371,11 @@ LIB_EXPORT size_t l_ringbuf_drain(struct l_ringbuf *ringbuf, size_t count)
 	if (!ringbuf)
 		return 0;
 
-	len = minsize(count, ringbuf->in - ringbuf->out);
+	len = minsize(count, ringbuf_used(ringbuf));
 	if (!len)
 		return 0;
 
-	ringbuf->out += len;
-
-	if (ringbuf->out == ringbuf->in) {
-		ringbuf->in = RINGBUF_RESET;
-		ringbuf->out = RINGBUF_RESET;
-	}
+	ringbuf_consumed(ringbuf, len);
 
 	return len;
 }
@@ -205,6 +391,8 @@ LIB_EXPORT size_t l_ringbuf_drain(struct l_ringbuf *ringbuf, size_t count)
  * locations.  Typically offset of 0 is used first.  Then, if len_nowrap
  * is less than the length returned by l_ringbuf_len, the rest of the data
  * can be obtained by calling l_ringbuf_peek with offset set to len_nowrap.
+ * For ring buffers created with l_ringbuf_new_mirrored the data is always
+ * contiguous.
  *
  * Returns: Pointer into ring buffer internal storage
  **/
@@ -217,8 +405,8 @@ LIB_EXPORT void *l_ringbuf_peek(struct l_ringbuf *ringbuf, size_t offset,
 	offset = (ringbuf->out + offset) & (ringbuf->size - 1);
 
 	if (len_nowrap) {
-		size_t len = ringbuf->in - ringbuf->out;
-		*len_nowrap = minsize(len, ringbuf->size - offset);
+		size_t len = ringbuf_used(ringbuf);
+		*len_nowrap = ringbuf_contiguous(ringbuf, offset, len);
 	}
 
 	return ringbuf->buffer + offset;
@@ -243,13 +431,13 @@ LIB_EXPORT ssize_t l_ringbuf_write(struct l_ringbuf *ringbuf, int fd)
 		return -1;
 
 	/* Determine how much data is available */
-	len = ringbuf->in - ringbuf->out;
+	len = ringbuf_used(ringbuf);
 	if (!len)
 		return 0;
 
 	/* Grab data from buffer starting at offset until the end */
 	offset = ringbuf->out & (ringbuf->size - 1);
-	end = minsize(len, ringbuf->size - offset);
+	end = ringbuf_contiguous(ringbuf, offset, len);
 
 	iov[0].iov_base = ringbuf->buffer + offset;
 	iov[0].iov_len = end;
@@ -262,12 +450,7 @@ LIB_EXPORT ssize_t l_ringbuf_write(struct l_ringbuf *ringbuf, int fd)
 	if (consumed < 0)
 		return -1;
 
-	ringbuf->out += consumed;
-
-	if (ringbuf->out == ringbuf->in) {
-		ringbuf->in = RINGBUF_RESET;
-		ringbuf->out = RINGBUF_RESET;
-	}
+	ringbuf_consumed(ringbuf, consumed);
 
 	return consumed;
 }
@@ -283,7 +466,7 @@ LIB_EXPORT size_t l_ringbuf_avail(struct l_ringbuf *ringbuf)
 	if (!ringbuf)
 		return 0;
 
-	return ringbuf->size - ringbuf->in + ringbuf->out;
+	return ringbuf_unused(ringbuf);
 }
 
 /**
@@ -322,47 +505,54 @@ LIB_EXPORT int l_ringbuf_vprintf(struct l_ringbuf *ringbuf,
 						const char *format, va_list ap)
 {
 	size_t avail, offset, end;
+	char stack_str[256];
 	char *str;
+	va_list aq;
 	int len;
 
 	if (!ringbuf || !format)
 		return -1;
 
 	/* Determine maximum length available for string */
-	avail = ringbuf->size - ringbuf->in + ringbuf->out;
+	avail = ringbuf_unused(ringbuf);
 	if (!avail)
 		return -1;
 
-	len = vasprintf(&str, format, ap);
-	if (len < 0)
-		return -1;
+	/* Format straight into the free space up to the wrap point */
+	offset = ringbuf->in & (ringbuf->size - 1);
+	end = ringbuf_contiguous(ringbuf, offset, avail);
 
-	if ((size_t) len > avail) {
-		l_free(str);
+	va_copy(aq, ap);
+	len = vsnprintf(ringbuf->buffer + offset, end, format, aq);
+	va_end(aq);
+
+	if (len < 0 || (size_t) len > avail)
 		return -1;
-	}
 
-	/* Determine possible length of string before wrapping */
-	offset = ringbuf->in & (ringbuf->size - 1);
-	end = minsize((size_t) len, ringbuf->size - offset);
-	memcpy(ringbuf->buffer + offset, str, end);
+	/* Room is needed for the terminating NUL written by vsnprintf */
+	if ((size_t) len < end)
+		goto done;
 
-	if (ringbuf->in_tracing)
-		ringbuf->in_tracing(ringbuf->buffer + offset, end,
-							ringbuf->in_data);
+	/*
+	 * The string wraps around, so format it again into temporary
+	 * storage and put the remainder at the beginning.  Short strings,
+	 * i.e. the common case, do not need a heap allocation.
+	 */
+	if ((size_t) len < sizeof(stack_str))
+		str = stack_str;
+	else
+		str = l_malloc(len + 1);
 
-	if (len - end > 0) {
-		/* Put the remainder of string at the beginning */
-		memcpy(ringbuf->buffer, str + end, len - end);
+	vsnprintf(str, len + 1, format, ap);
 
-		if (ringbuf->in_tracing)
-			ringbuf->in_tracing(ringbuf->buffer, len - end,
-							ringbuf->in_data);
-	}
+	memcpy(ringbuf->buffer + offset, str, end);
+	memcpy(ringbuf->buffer, str + end, len - end);
 
-	l_free(str);
+	if (str != stack_str)
+		l_free(str);
 
-	ringbuf->in += len;
+done:
+	l_ringbuf_commit(ringbuf, len);
 
 	return len;
 }
@@ -386,13 +576,13 @@ LIB_EXPORT ssize_t l_ringbuf_read(struct l_ringbuf *ringbuf, int fd)
 		return -1;
 
 	/* Determine how much can actually be consumed */
-	avail = ringbuf->size - ringbuf->in + ringbuf->out;
+	avail = ringbuf_unused(ringbuf);
 	if (!avail)
 		return -1;
 
 	/* Determine how much to consume before wrapping */
 	offset = ringbuf->in & (ringbuf->size - 1);
-	end = minsize(avail, ringbuf->size - offset);
+	end = ringbuf_contiguous(ringbuf, offset, avail);
 
 	iov[0].iov_base = ringbuf->buffer + offset;
 	iov[0].iov_len = end;
@@ -416,7 +606,167 @@ LIB_EXPORT ssize_t l_ringbuf_read(struct l_ringbuf *ringbuf, int fd)
 							ringbuf->in_data);
 	}
 
-	ringbuf->in += consumed;
+	ringbuf_produced(ringbuf, consumed);
 
 	return consumed;
 }
+
+/**
+ * l_ringbuf_reserve:
+ * @ringbuf: Ring Buffer object
+ * @len_nowrap: Number of contiguous free bytes at the returned location
+ *
+ * Gives direct access to the free space of the ring buffer, so that data can
+ * be produced in place, e.g. by passing the returned pointer to read(2).
+ * Since the ring buffer can wrap around, only the first @len_nowrap bytes
+ * of the free space are contiguous, unless the ring buffer was created with
+ * l_ringbuf_new_mirrored.  The data becomes part of the ring buffer once
+ * l_ringbuf_commit is called.
+ *
+ * Returns: Pointer into ring buffer internal storage or NULL if the ring
+ * buffer is full.
+ **/
+LIB_EXPORT void *l_ringbuf_reserve(struct l_ringbuf *ringbuf,
+							size_t *len_nowrap)
+{
+	size_t avail, offset;
+
+	if (!ringbuf)
+		return NULL;
+
+	avail = ringbuf_unused(ringbuf);
+	if (!avail)
+		return NULL;
+
+	offset = ringbuf->in & (ringbuf->size - 1);
+
+	if (len_nowrap)
+		*len_nowrap = ringbuf_contiguous(ringbuf, offset, avail);
+
+	return ringbuf->buffer + offset;
+}
+
+/**
+ * l_ringbuf_commit:
+ * @ringbuf: Ring Buffer object
+ * @count: Number of bytes to commit
+ *
+ * Appends @count bytes, previously written to the location obtained from
+ * l_ringbuf_reserve, to the occupied part of the ring buffer.
+ *
+ * Returns: Number of bytes committed
+ **/
+LIB_EXPORT size_t l_ringbuf_commit(struct l_ringbuf *ringbuf, size_t count)
+{
+	size_t len, offset, end;
+
+	if (!ringbuf)
+		return 0;
+
+	len = minsize(count, ringbuf_unused(ringbuf));
+	if (!len)
+		return 0;
+
+	if (ringbuf->in_tracing) {
+		offset = ringbuf->in & (ringbuf->size - 1);
+		end = ringbuf_contiguous(ringbuf, offset, len);
+
+		ringbuf->in_tracing(ringbuf->buffer + offset, end,
+							ringbuf->in_data);
+
+		if (len - end > 0)
+			ringbuf->in_tracing(ringbuf->buffer, len - end,
+							ringbuf->in_data);
+	}
+
+	ringbuf_produced(ringbuf, len);
+
+	return len;
+}
+
+/**
+ * l_ringbuf_enable_spsc:
+ * @ringbuf: Ring Buffer object
+ *
+ * Switches the ring buffer into single-producer / single-consumer mode, in
+ * which one thread may add data (l_ringbuf_printf, l_ringbuf_read,
+ * l_ringbuf_commit) while another thread concurrently consumes it
+ * (l_ringbuf_peek, l_ringbuf_drain, l_ringbuf_write) without any external
+ * locking.  This must be done before the ring buffer is shared.
+ *
+ * In this mode the ring buffer also provides an eventfd, see
+ * l_ringbuf_get_notify_fd, that the consumer can watch with l_io.
+ *
+ * Returns: #true on success and #false on failure
+ **/
+LIB_EXPORT bool l_ringbuf_enable_spsc(struct l_ringbuf *ringbuf)
+{
+	if (!ringbuf)
+		return false;
+
+	if (ringbuf->spsc)
+		return true;
+
+	ringbuf->notify_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (ringbuf->notify_fd < 0)
+		return false;
+
+	ringbuf->spsc = true;
+
+	return true;
+}
+
+/**
+ * l_ringbuf_get_notify_fd:
+ * @ringbuf: Ring Buffer object
+ *
+ * Returns the eventfd of a ring buffer in single-producer / single-consumer
+ * mode.  It becomes readable when the producer adds data after the consumer
+ * armed the notification with l_ringbuf_arm_notify.
+ *
+ * Returns: The file descriptor or -1 if the ring buffer is not in SPSC mode.
+ **/
+LIB_EXPORT int l_ringbuf_get_notify_fd(struct l_ringbuf *ringbuf)
+{
+	if (!ringbuf)
+		return -1;
+
+	return ringbuf->notify_fd;
+}
+
+/**
+ * l_ringbuf_arm_notify:
+ * @ringbuf: Ring Buffer object
+ *
+ * Called by the consumer once it has processed all data, before it goes
+ * back to waiting on the notify fd.  Any pending notification is cleared and
+ * the producer is asked to signal the notify fd as soon as the ring buffer
+ * goes from empty to non-empty.  Producers do not touch the eventfd at all
+ * while the consumer is busy.
+ *
+ * Returns: #true if the consumer can wait for the notification, #false if
+ * data was added in the meantime and should be consumed first.
+ **/
+LIB_EXPORT bool l_ringbuf_arm_notify(struct l_ringbuf *ringbuf)
+{
+	uint64_t count;
+
+	if (!ringbuf || !ringbuf->spsc)
+		return false;
+
+	if (read(ringbuf->notify_fd, &count, sizeof(count)) < 0 &&
+							errno != EAGAIN)
+		return false;
+
+	__atomic_store_n(&ringbuf->waiting, true, __ATOMIC_RELEASE);
+
+	/* Pairs with the fence in ringbuf_produced */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if (!ringbuf_used(ringbuf))
+		return true;
+
+	__atomic_store_n(&ringbuf->waiting, false, __ATOMIC_RELAXED);
+
+	return false;
+}
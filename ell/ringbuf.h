@@ -38,6 +38,7 @@ typedef void (*l_ringbuf_tracing_func_t)(const void *buf, size_t count,
 struct l_ringbuf;
 
 struct l_ringbuf *l_ringbuf_new(size_t size);
+struct l_ringbuf *l_ringbuf_new_mirrored(size_t size);
 void l_ringbuf_free(struct l_ringbuf *ringbuf);
 
 bool l_ringbuf_set_input_tracing(struct l_ringbuf *ringbuf,
@@ -58,6 +59,13 @@ int l_ringbuf_vprintf(struct l_ringbuf *ringbuf, const char *format,
 					va_list ap);
 ssize_t l_ringbuf_read(struct l_ringbuf *ringbuf, int fd);
 
+void *l_ringbuf_reserve(struct l_ringbuf *ringbuf, size_t *len_nowrap);
+size_t l_ringbuf_commit(struct l_ringbuf *ringbuf, size_t count);
+
+bool l_ringbuf_enable_spsc(struct l_ringbuf *ringbuf);
+int l_ringbuf_get_notify_fd(struct l_ringbuf *ringbuf);
+bool l_ringbuf_arm_notify(struct l_ringbuf *ringbuf);
+
 #ifdef __cplusplus
 }
 #endif
@@ -36,27 +36,56 @@
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
-#include <sys/mman.h>
+#include <sys/uio.h>
 
 #include "util.h"
 #include "strv.h"
 #include "utf8.h"
 #include "string.h"
 #include "queue.h"
+#include "radix.h"
+#include "dir.h"
+#include "idle.h"
 #include "settings.h"
 #include "private.h"
+#include "siphash-private.h"
 #include "missing.h"
 
+/*
+ * When loading without copying, keys and raw values point into the
+ * borrowed buffer and are not NUL terminated.  The NUL terminated value
+ * and its unescaped form are only created once they are asked for.  Only
+ * those copies are wiped when freed, a buffer borrowed from the caller is
+ * left alone and one owned by the settings is wiped as a whole.
+ */
 struct setting_data {
-	char *key;
+	const char *key;
+	size_t key_len;
+	const char *raw;
+	size_t raw_len;
 	char *value;
+	char *unescaped;
+	bool key_borrowed;
+};
+
+struct buffer {
+	char *data;
+	size_t len;
 };
 
-struct group_data {
+/*
+ * Groups and settings are kept in queues to preserve the file order, the
+ * radix trees index them by name.  When a name appears more than once the
+ * index points at the first occurrence, which is what lookups return.
+ */
+struct l_settings_group {
 	char *name;
 	struct l_queue *settings;
+	struct l_radix *index;
+	const struct l_settings *owner;
 };
 
 struct l_settings {
@@ -64,34 +93,138 @@ struct l_settings {
 	l_settings_destroy_cb_t debug_destroy;
 	void *debug_data;
 	struct l_queue *groups;
+	struct l_radix *index;
+	struct l_queue *buffers;
+	bool borrow;
 };
 
+static void setting_clear_value(struct setting_data *pair)
+{
+	if (pair->unescaped && pair->unescaped != pair->value) {
+		explicit_bzero(pair->unescaped, strlen(pair->unescaped));
+		l_free(pair->unescaped);
+	}
+
+	if (pair->value) {
+		explicit_bzero(pair->value, strlen(pair->value));
+		l_free(pair->value);
+	}
+
+	pair->unescaped = NULL;
+	pair->value = NULL;
+}
+
+static void setting_set_value(struct setting_data *pair, char *value)
+{
+	setting_clear_value(pair);
+
+	pair->value = value;
+	pair->raw = value;
+	pair->raw_len = strlen(value);
+}
+
 static void setting_destroy(void *data)
 {
 	struct setting_data *pair = data;
 
-	l_free(pair->key);
-	explicit_bzero(pair->value, strlen(pair->value));
-	l_free(pair->value);
+	if (!pair->key_borrowed)
+		l_free((char *) pair->key);
+
+	setting_clear_value(pair);
 	l_free(pair);
 }
 
+static const char *setting_value(const struct setting_data *setting)
+{
+	/* Only the lazily created copies change, the setting stays the same */
+	struct setting_data *pair = (struct setting_data *) setting;
+
+	if (!pair->value) {
+		pair->value = l_strndup(pair->raw, pair->raw_len);
+		pair->raw = pair->value;
+	}
+
+	return pair->value;
+}
+
+static char *unescape_value(const char *value);
+
+static const char *setting_unescaped(const struct setting_data *setting)
+{
+	struct setting_data *pair = (struct setting_data *) setting;
+	const char *value = setting_value(setting);
+
+	if (pair->unescaped)
+		return pair->unescaped;
+
+	/* Most values don't contain escapes and can be shared */
+	if (!strchr(value, '\\'))
+		pair->unescaped = pair->value;
+	else
+		pair->unescaped = unescape_value(value);
+
+	return pair->unescaped;
+}
+
+static void buffer_destroy(void *data)
+{
+	struct buffer *buffer = data;
+
+	explicit_bzero(buffer->data, buffer->len);
+	l_free(buffer->data);
+	l_free(buffer);
+}
+
 static void group_destroy(void *data)
 {
-	struct group_data *group = data;
+	struct l_settings_group *group = data;
 
 	l_free(group->name);
 	l_queue_destroy(group->settings, setting_destroy);
+	l_radix_destroy(group->index, NULL);
 
 	l_free(group);
 }
 
+static struct l_settings_group *group_new(struct l_settings *settings,
+							char *name)
+{
+	struct l_settings_group *group;
+
+	group = l_new(struct l_settings_group, 1);
+	group->name = name;
+	group->settings = l_queue_new();
+	group->index = l_radix_new();
+	group->owner = settings;
+
+	l_queue_push_tail(settings->groups, group);
+
+	/* Fails for duplicates, the first group of a name stays indexed */
+	l_radix_insert(settings->index, name, strlen(name), group);
+
+	return group;
+}
+
+static struct l_settings_group *group_lookup(const struct l_settings *settings,
+						const char *group_name)
+{
+	return l_radix_lookup(settings->index, group_name, strlen(group_name));
+}
+
+static struct setting_data *setting_lookup(
+					const struct l_settings_group *group,
+					const char *key)
+{
+	return l_radix_lookup(group->index, key, strlen(key));
+}
+
 LIB_EXPORT struct l_settings *l_settings_new(void)
 {
 	struct l_settings *settings;
 
 	settings = l_new(struct l_settings, 1);
 	settings->groups = l_queue_new();
+	settings->index = l_radix_new();
 
 	return settings;
 }
@@ -105,6 +238,8 @@ LIB_EXPORT void l_settings_free(struct l_settings *settings)
 		settings->debug_destroy(settings->debug_data);
 
 	l_queue_destroy(settings->groups, group_destroy);
+	l_radix_destroy(settings->index, NULL);
+	l_queue_destroy(settings->buffers, buffer_destroy);
 
 	l_free(settings);
 }
@@ -227,7 +362,6 @@ static bool parse_group(struct l_settings *settings, const char *data,
 {
 	size_t i = 1;
 	size_t end;
-	struct group_data *group;
 
 	while (i < len && data[i] != ']') {
 		if (l_ascii_isprint(data[i]) == false || data[i] == '[') {
@@ -258,11 +392,7 @@ static bool parse_group(struct l_settings *settings, const char *data,
 		return false;
 	}
 
-	group = l_new(struct group_data, 1);
-	group->name = l_strndup(data + 1, end - 1);
-	group->settings = l_queue_new();
-
-	l_queue_push_tail(settings->groups, group);
+	group_new(settings, l_strndup(data + 1, end - 1));
 
 	return true;
 }
@@ -283,7 +413,7 @@ static unsigned int parse_key(struct l_settings *settings, const char *data,
 {
 	unsigned int i;
 	unsigned int end;
-	struct group_data *group;
+	struct l_settings_group *group;
 	struct setting_data *pair;
 
 	for (i = 0; i < len; i++) {
@@ -314,7 +444,14 @@ static unsigned int parse_key(struct l_settings *settings, const char *data,
 
 	group = l_queue_peek_tail(settings->groups);
 	pair = l_new(struct setting_data, 1);
-	pair->key = l_strndup(data, end);
+	pair->key_len = end;
+
+	if (settings->borrow) {
+		pair->key = data;
+		pair->key_borrowed = true;
+	} else
+		pair->key = l_strndup(data, end);
+
 	l_queue_push_head(group->settings, pair);
 
 	return end;
@@ -324,7 +461,7 @@ static bool parse_value(struct l_settings *settings, const char *data,
 			size_t len, size_t line)
 {
 	unsigned int end = len;
-	struct group_data *group;
+	struct l_settings_group *group;
 	struct setting_data *pair;
 
 	group = l_queue_peek_tail(settings->groups);
@@ -334,14 +471,19 @@ static bool parse_value(struct l_settings *settings, const char *data,
 		l_util_debug(settings->debug_handler, settings->debug_data,
 				"Invalid UTF8 in value on line: %zd", line);
 
-		l_free(pair->key);
-		l_free(pair);
+		setting_destroy(pair);
 
 		return false;
 	}
 
-	pair->value = l_strndup(data, end);
+	if (settings->borrow) {
+		pair->raw = data;
+		pair->raw_len = strnlen(data, end);
+	} else
+		setting_set_value(pair, l_strndup(data, end));
+
 	l_queue_push_tail(group->settings, pair);
+	l_radix_insert(group->index, pair->key, pair->key_len, pair);
 
 	return true;
 }
@@ -436,7 +578,7 @@ LIB_EXPORT char *l_settings_to_data(const struct l_settings *settings,
 
 	group_entry = l_queue_get_entries(settings->groups);
 	while (group_entry) {
-		struct group_data *group = group_entry->data;
+		struct l_settings_group *group = group_entry->data;
 		const struct l_queue_entry *setting_entry =
 				l_queue_get_entries(group->settings);
 
@@ -445,8 +587,11 @@ LIB_EXPORT char *l_settings_to_data(const struct l_settings *settings,
 		while (setting_entry) {
 			struct setting_data *setting = setting_entry->data;
 
-			l_string_append_printf(buf, "%s=%s\n",
-						setting->key, setting->value);
+			l_string_append_printf(buf, "%.*s=%.*s\n",
+						(int) setting->key_len,
+						setting->key,
+						(int) setting->raw_len,
+						setting->raw);
 			setting_entry = setting_entry->next;
 		}
 
@@ -464,247 +609,967 @@ LIB_EXPORT char *l_settings_to_data(const struct l_settings *settings,
 	return ret;
 }
 
-LIB_EXPORT bool l_settings_load_from_file(struct l_settings *settings,
-						const char *filename)
-{
-	int fd;
-	struct stat st;
-	char *data;
-	bool r;
-
-	if (unlikely(!settings || !filename))
-		return false;
+#define WRITE_IOV_MAX 64
 
-	fd = open(filename, O_RDONLY);
-	if (fd < 0) {
-		l_util_debug(settings->debug_handler, settings->debug_data,
-				"Could not open %s (%s)", filename,
-				strerror(errno));
-		return false;
-	}
+struct write_state {
+	int fd;
+	struct iovec iov[WRITE_IOV_MAX];
+	int iovcnt;
+	bool failed;
+};
 
-	if (fstat(fd, &st) < 0) {
-		l_util_debug(settings->debug_handler, settings->debug_data,
-				"Could not stat %s (%s)", filename,
-				strerror(errno));
-		close(fd);
+/*
+ * Reads up to @size bytes into a private buffer.  Unlike a shared mapping
+ * it doesn't change under an in-place rewrite of the file and truncating
+ * the file can't make accessing it fault.
+ */
+static char *read_all(int fd, size_t size, size_t *out_len)
+{
+	char *data = l_malloc(size + 1);
+	size_t len = 0;
+	ssize_t r;
 
-		return false;
-	}
+	while (len < size) {
+		r = read(fd, data + len, size - len);
+		if (r < 0 && errno == EINTR)
+			continue;
 
-	/* Nothing to do, assume success */
-	if (st.st_size == 0) {
-		close(fd);
-		return true;
-	}
+		if (r < 0) {
+			explicit_bzero(data, len);
+			l_free(data);
+			return NULL;
+		}
 
-	data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
-	if (data == MAP_FAILED) {
-		l_util_debug(settings->debug_handler, settings->debug_data,
-				"Could not mmap %s (%s)", filename,
-				strerror(errno));
-		close(fd);
+		if (r == 0)
+			break;
 
-		return false;
+		len += r;
 	}
 
-	r = l_settings_load_from_data(settings, data, st.st_size);
-
-	munmap(data, st.st_size);
-	close(fd);
+	*out_len = len;
 
-	return r;
+	return data;
 }
 
-LIB_EXPORT bool l_settings_set_debug(struct l_settings *settings,
-					l_settings_debug_cb_t callback,
-					void *user_data,
-					l_settings_destroy_cb_t destroy)
+static bool write_all(int fd, struct iovec *iov, int iovcnt)
 {
-	if (unlikely(!settings))
-		return false;
+	ssize_t r;
 
-	if (settings->debug_destroy)
-		settings->debug_destroy(settings->debug_data);
+	while (iovcnt) {
+		r = writev(fd, iov, iovcnt);
+		if (r < 0 && errno == EINTR)
+			continue;
 
-	settings->debug_handler = callback;
-	settings->debug_destroy = destroy;
-	settings->debug_data = user_data;
+		if (r < 0)
+			return false;
+
+		/* Skip what was written, a partial write resumes mid vector */
+		while (iovcnt && (size_t) r >= iov->iov_len) {
+			r -= iov->iov_len;
+			iov += 1;
+			iovcnt -= 1;
+		}
+
+		if (iovcnt) {
+			iov->iov_base = (uint8_t *) iov->iov_base + r;
+			iov->iov_len -= r;
+		}
+	}
 
 	return true;
 }
 
-static bool group_match(const void *a, const void *b)
+static void write_flush(struct write_state *state)
 {
-	const struct group_data *group = a;
-	const char *name = b;
+	if (!state->failed && !write_all(state->fd, state->iov,
+							state->iovcnt))
+		state->failed = true;
 
-	return !strcmp(group->name, name);
+	state->iovcnt = 0;
 }
 
-struct gather_data {
-	int cur;
-	char **v;
-};
-
-static void gather_groups(void *data, void *user_data)
+static void write_append(struct write_state *state, const void *data,
+								size_t len)
 {
-	struct group_data *group_data = data;
-	struct gather_data *gather = user_data;
+	if (!len)
+		return;
 
-	gather->v[gather->cur++] = l_strdup(group_data->name);
+	if (state->iovcnt == WRITE_IOV_MAX)
+		write_flush(state);
+
+	state->iov[state->iovcnt].iov_base = (void *) data;
+	state->iov[state->iovcnt].iov_len = len;
+	state->iovcnt += 1;
 }
 
-LIB_EXPORT char **l_settings_get_groups(const struct l_settings *settings)
+static void write_group(struct write_state *state,
+				const struct l_settings_group *group)
 {
-	char **ret;
-	struct gather_data gather;
-
-	if (unlikely(!settings))
-		return NULL;
+	const struct l_queue_entry *entry;
 
-	ret = l_new(char *, l_queue_length(settings->groups) + 1);
-	gather.v = ret;
-	gather.cur = 0;
+	write_append(state, "[", 1);
+	write_append(state, group->name, strlen(group->name));
+	write_append(state, "]\n", 2);
 
-	l_queue_foreach(settings->groups, gather_groups, &gather);
+	for (entry = l_queue_get_entries(group->settings); entry;
+						entry = entry->next) {
+		const struct setting_data *setting = entry->data;
 
-	return ret;
+		write_append(state, setting->key, setting->key_len);
+		write_append(state, "=", 1);
+		write_append(state, setting->raw, setting->raw_len);
+		write_append(state, "\n", 1);
+	}
 }
 
-LIB_EXPORT bool l_settings_has_group(const struct l_settings *settings,
-					const char *group_name)
+/*
+ * Produces the same output as l_settings_to_data, but the key and value
+ * strings are handed to writev in place instead of being copied.
+ */
+LIB_EXPORT bool l_settings_write_to_fd(const struct l_settings *settings,
+									int fd)
 {
-	struct group_data *group;
+	struct write_state state = { .fd = fd };
+	const struct l_queue_entry *entry;
+	bool first = true;
 
-	if (unlikely(!settings))
+	if (unlikely(!settings || fd < 0))
 		return false;
 
-	group = l_queue_find(settings->groups, group_match, group_name);
+	for (entry = l_queue_get_entries(settings->groups); entry;
+						entry = entry->next) {
+		const struct l_settings_group *group = entry->data;
 
-	return !!group;
-}
+		if (!first)
+			write_append(&state, "\n", 1);
 
-static bool key_match(const void *a, const void *b)
-{
-	const struct setting_data *setting = a;
-	const char *key = b;
+		write_group(&state, group);
+		first = false;
 
-	return !strcmp(setting->key, key);
-}
+		if (state.failed)
+			return false;
+	}
 
-static void gather_keys(void *data, void *user_data)
-{
-	struct setting_data *setting_data = data;
-	struct gather_data *gather = user_data;
+	write_flush(&state);
 
-	gather->v[gather->cur++] = l_strdup(setting_data->key);
+	return !state.failed;
 }
 
-LIB_EXPORT char **l_settings_get_keys(const struct l_settings *settings,
-					const char *group_name)
+/* Writes a temporary file next to @filename and renames it over it */
+static bool replace_file(const char *filename, mode_t mode,
+				bool (*write_func)(int fd, void *user_data),
+				void *user_data)
 {
-	char **ret;
-	struct group_data *group_data;
-	struct gather_data gather;
+	char *tmpname = l_strdup_printf("%s.XXXXXX", filename);
+	const char *slash;
+	char *dirname;
+	int fd;
 
-	if (unlikely(!settings))
-		return NULL;
+	fd = mkostemp(tmpname, O_CLOEXEC);
+	if (fd < 0)
+		goto error;
 
-	group_data = l_queue_find(settings->groups, group_match, group_name);
-	if (!group_data)
-		return NULL;
+	if (!write_func(fd, user_data) || fchmod(fd, mode) < 0 ||
+							fsync(fd) < 0) {
+		close(fd);
+		goto unlink;
+	}
 
-	ret = l_new(char *, l_queue_length(group_data->settings) + 1);
-	gather.v = ret;
-	gather.cur = 0;
+	if (close(fd) < 0)
+		goto unlink;
 
-	l_queue_foreach(group_data->settings, gather_keys, &gather);
+	if (rename(tmpname, filename) < 0)
+		goto unlink;
 
-	return ret;
-}
+	l_free(tmpname);
 
-LIB_EXPORT bool l_settings_has_key(const struct l_settings *settings,
-					const char *group_name, const char *key)
-{
-	struct group_data *group;
-	struct setting_data *setting;
+	/* Make the rename itself durable */
+	slash = strrchr(filename, '/');
+	if (!slash)
+		dirname = l_strdup(".");
+	else if (slash == filename)
+		dirname = l_strdup("/");
+	else
+		dirname = l_strndup(filename, slash - filename);
 
-	if (unlikely(!settings))
-		return false;
+	fd = open(dirname, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	l_free(dirname);
 
-	group = l_queue_find(settings->groups, group_match, group_name);
-	if (!group)
-		return false;
+	if (fd >= 0) {
+		fsync(fd);
+		close(fd);
+	}
 
-	setting = l_queue_find(group->settings, key_match, key);
+	return true;
 
-	return !!setting;
+unlink:
+	unlink(tmpname);
+error:
+	l_free(tmpname);
+	return false;
 }
 
-LIB_EXPORT const char *l_settings_get_value(const struct l_settings *settings,
-						const char *group_name,
-						const char *key)
+static bool save_write(int fd, void *user_data)
 {
-	struct group_data *group;
-	struct setting_data *setting;
-
-	if (unlikely(!settings))
-		return NULL;
-
-	group = l_queue_find(settings->groups, group_match, group_name);
-	if (!group)
-		return NULL;
-
-	setting = l_queue_find(group->settings, key_match, key);
-	if (!setting)
-		return NULL;
-
-	return setting->value;
+	return l_settings_write_to_fd(user_data, fd);
 }
 
-static bool validate_group_name(const char *group_name)
+/*
+ * An existing file keeps its permissions, a new one is only accessible
+ * by its owner since settings can contain secrets.
+ */
+LIB_EXPORT bool l_settings_save_atomic(struct l_settings *settings,
+							const char *filename)
 {
-	int i;
+	struct stat st;
+	mode_t mode = 0600;
 
-	for (i = 0; group_name[i]; i++) {
-		if (!l_ascii_isprint(group_name[i]))
-			return false;
+	if (unlikely(!settings || !filename))
+		return false;
 
-		if (group_name[i] == ']' || group_name[i] == '[')
-			return false;
+	if (stat(filename, &st) == 0)
+		mode = st.st_mode & 07777;
+
+	if (!replace_file(filename, mode, save_write, settings)) {
+		l_util_debug(settings->debug_handler, settings->debug_data,
+				"Could not save %s (%s)", filename,
+				strerror(errno));
+		return false;
 	}
 
 	return true;
 }
 
-static bool validate_key(const char *key)
+/* @data has to stay valid and unchanged until @settings is freed */
+LIB_EXPORT bool l_settings_load_from_data_nocopy(struct l_settings *settings,
+						const char *data, size_t len)
 {
-	int i;
+	bool r;
 
-	for (i = 0; key[i]; i++) {
-		if (!validate_key_character(key[i]))
-			return false;
-	}
+	if (unlikely(!settings))
+		return false;
 
-	return true;
+	settings->borrow = true;
+	r = l_settings_load_from_data(settings, data, len);
+	settings->borrow = false;
+
+	return r;
 }
 
-static bool set_value(struct l_settings *settings, const char *group_name,
-			const char *key, char *value)
+static void add_buffer(struct l_settings *settings, char *data, size_t len)
 {
-	struct group_data *group;
-	struct setting_data *pair;
+	struct buffer *buffer = l_new(struct buffer, 1);
 
-	if (!validate_group_name(group_name)) {
-		l_util_debug(settings->debug_handler, settings->debug_data,
-				"Invalid group name %s", group_name);
-		l_free(value);
+	buffer->data = data;
+	buffer->len = len;
 
-		return false;
-	}
+	if (!settings->buffers)
+		settings->buffers = l_queue_new();
 
-	if (!validate_key(key)) {
+	l_queue_push_tail(settings->buffers, buffer);
+}
+
+static bool load_from_file(struct l_settings *settings, const char *filename,
+								bool nocopy)
+{
+	int fd;
+	struct stat st;
+	char *data;
+	size_t len;
+	bool r;
+
+	if (unlikely(!settings || !filename))
+		return false;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		l_util_debug(settings->debug_handler, settings->debug_data,
+				"Could not open %s (%s)", filename,
+				strerror(errno));
+		return false;
+	}
+
+	if (fstat(fd, &st) < 0) {
+		l_util_debug(settings->debug_handler, settings->debug_data,
+				"Could not stat %s (%s)", filename,
+				strerror(errno));
+		close(fd);
+
+		return false;
+	}
+
+	/* Nothing to do, assume success */
+	if (st.st_size == 0) {
+		close(fd);
+		return true;
+	}
+
+	data = read_all(fd, st.st_size, &len);
+	if (!data) {
+		l_util_debug(settings->debug_handler, settings->debug_data,
+				"Could not read %s (%s)", filename,
+				strerror(errno));
+		close(fd);
+
+		return false;
+	}
+
+	close(fd);
+
+	if (!nocopy) {
+		r = l_settings_load_from_data(settings, data, len);
+		explicit_bzero(data, len);
+		l_free(data);
+	} else {
+		/* Even a failed load can leave settings pointing into it */
+		add_buffer(settings, data, len);
+
+		r = l_settings_load_from_data_nocopy(settings, data, len);
+	}
+
+	return r;
+}
+
+LIB_EXPORT bool l_settings_load_from_file(struct l_settings *settings,
+						const char *filename)
+{
+	return load_from_file(settings, filename, false);
+}
+
+/* The file is read into a buffer that is kept until @settings is freed */
+LIB_EXPORT bool l_settings_load_from_file_nocopy(struct l_settings *settings,
+							const char *filename)
+{
+	return load_from_file(settings, filename, true);
+}
+
+#define CACHE_SUFFIX ".cache"
+
+static const uint8_t cache_sig[8] = { 'E', 'L', 'L', 'S', 'E', 'T', 'C', 'H' };
+
+/*
+ * A cache image is the header followed by the group table, the setting
+ * table and the strings.  Groups and settings are stored in file order,
+ * the settings of each group following those of the previous one.  All
+ * string offsets are relative to the strings section.
+ */
+struct cache_header {
+	uint8_t  signature[8];		/* Signature */
+	uint64_t version;		/* Version of the format */
+	uint64_t file_size;		/* Size of complete file */
+	uint64_t header_size;		/* Size of header structure */
+	uint64_t source_size;		/* Size of the text file */
+	uint64_t source_mtime;		/* Modification time of text file */
+	uint64_t source_hash;		/* Hash of the text file contents */
+	uint64_t group_count;		/* Number of group structures */
+	uint64_t setting_count;		/* Number of setting structures */
+	uint64_t strings_size;		/* Size of the strings section */
+} __attribute__ ((packed));
+
+struct cache_group {
+	uint64_t name_offset;		/* Location of group name */
+	uint32_t name_len;		/* Length of group name */
+	uint32_t setting_count;		/* Number of settings in group */
+} __attribute__ ((packed));
+
+struct cache_setting {
+	uint64_t key_offset;		/* Location of key */
+	uint64_t value_offset;		/* Location of raw value */
+	uint32_t key_len;		/* Length of key */
+	uint32_t value_len;		/* Length of raw value */
+} __attribute__ ((packed));
+
+#define CACHE_VERSION 1
+
+static uint64_t cache_mtime(const struct stat *st)
+{
+	return (uint64_t) st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+}
+
+static uint64_t cache_hash(const void *data, size_t len)
+{
+	static const uint64_t key[2] = { 0, 0 };
+
+	return _siphash13(data, len, key);
+}
+
+static char *cache_filename(const char *filename)
+{
+	return l_strdup_printf("%s" CACHE_SUFFIX, filename);
+}
+
+struct cache_image {
+	void *data;
+	size_t len;
+};
+
+static bool cache_write(int fd, void *user_data)
+{
+	struct cache_image *image = user_data;
+	struct iovec iov = { .iov_base = image->data, .iov_len = image->len };
+
+	return write_all(fd, &iov, 1);
+}
+
+LIB_EXPORT bool l_settings_write_cache(const char *filename)
+{
+	struct l_settings *settings;
+	const struct buffer *buffer;
+	const struct l_queue_entry *group_entry;
+	const struct l_queue_entry *entry;
+	struct cache_header *hdr;
+	struct cache_group *group_table;
+	struct cache_setting *setting_table;
+	char *strings;
+	char *image;
+	char *cachename;
+	size_t group_count = 0;
+	size_t setting_count = 0;
+	size_t strings_size = 0;
+	size_t size;
+	uint64_t offset = 0;
+	uint64_t mtime;
+	struct timespec now;
+	struct stat st;
+	bool r;
+
+	if (unlikely(!filename))
+		return false;
+
+	/* Before reading, a later change then at worst invalidates the cache */
+	if (stat(filename, &st) < 0)
+		return false;
+
+	/*
+	 * A file modified within the timestamp granularity of now could
+	 * change again without its mtime changing, so it is always hashed.
+	 */
+	clock_gettime(CLOCK_REALTIME, &now);
+	mtime = cache_mtime(&st);
+
+	if (st.st_mtim.tv_sec >= now.tv_sec - 1)
+		mtime = 0;
+
+	settings = l_settings_new();
+
+	if (!l_settings_load_from_file_nocopy(settings, filename)) {
+		l_settings_free(settings);
+		return false;
+	}
+
+	buffer = l_queue_peek_head(settings->buffers);
+
+	for (group_entry = l_queue_get_entries(settings->groups); group_entry;
+					group_entry = group_entry->next) {
+		const struct l_settings_group *group = group_entry->data;
+
+		group_count += 1;
+		strings_size += strlen(group->name) + 1;
+
+		for (entry = l_queue_get_entries(group->settings); entry;
+							entry = entry->next) {
+			const struct setting_data *setting = entry->data;
+
+			setting_count += 1;
+			strings_size += setting->key_len + setting->raw_len + 2;
+		}
+	}
+
+	size = sizeof(struct cache_header) +
+			group_count * sizeof(struct cache_group) +
+			setting_count * sizeof(struct cache_setting) +
+			strings_size;
+
+	image = l_malloc(size);
+	hdr = (struct cache_header *) image;
+	group_table = (struct cache_group *) (hdr + 1);
+	setting_table = (struct cache_setting *) (group_table + group_count);
+	strings = (char *) (setting_table + setting_count);
+
+	memcpy(hdr->signature, cache_sig, sizeof(cache_sig));
+	hdr->version = L_CPU_TO_LE64(CACHE_VERSION);
+	hdr->file_size = L_CPU_TO_LE64(size);
+	hdr->header_size = L_CPU_TO_LE64(sizeof(struct cache_header));
+	hdr->source_size = L_CPU_TO_LE64(st.st_size);
+	hdr->source_mtime = L_CPU_TO_LE64(mtime);
+	hdr->source_hash = L_CPU_TO_LE64(buffer ?
+				cache_hash(buffer->data, buffer->len) :
+				cache_hash(NULL, 0));
+	hdr->group_count = L_CPU_TO_LE64(group_count);
+	hdr->setting_count = L_CPU_TO_LE64(setting_count);
+	hdr->strings_size = L_CPU_TO_LE64(strings_size);
+
+	for (group_entry = l_queue_get_entries(settings->groups); group_entry;
+					group_entry = group_entry->next) {
+		const struct l_settings_group *group = group_entry->data;
+		size_t len = strlen(group->name);
+
+		group_table->name_offset = L_CPU_TO_LE64(offset);
+		group_table->name_len = L_CPU_TO_LE32(len);
+		group_table->setting_count =
+				L_CPU_TO_LE32(l_queue_length(group->settings));
+		group_table += 1;
+
+		memcpy(strings + offset, group->name, len + 1);
+		offset += len + 1;
+
+		for (entry = l_queue_get_entries(group->settings); entry;
+							entry = entry->next) {
+			const struct setting_data *setting = entry->data;
+
+			setting_table->key_offset = L_CPU_TO_LE64(offset);
+			setting_table->key_len = L_CPU_TO_LE32(setting->key_len);
+
+			memcpy(strings + offset, setting->key, setting->key_len);
+			offset += setting->key_len;
+			strings[offset++] = '\0';
+
+			setting_table->value_offset = L_CPU_TO_LE64(offset);
+			setting_table->value_len =
+					L_CPU_TO_LE32(setting->raw_len);
+			setting_table += 1;
+
+			memcpy(strings + offset, setting->raw, setting->raw_len);
+			offset += setting->raw_len;
+			strings[offset++] = '\0';
+		}
+	}
+
+	l_settings_free(settings);
+
+	cachename = cache_filename(filename);
+	/* Not readable by anyone who can't read the settings themselves */
+	r = replace_file(cachename, st.st_mode & 0666, cache_write,
+				&(struct cache_image) { image, size });
+	l_free(cachename);
+	l_free(image);
+
+	return r;
+}
+
+static bool cache_source_matches(const struct cache_header *hdr,
+						const char *filename)
+{
+	struct stat st;
+	char *data;
+	size_t len;
+	bool r;
+	int fd;
+
+	fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	if (fstat(fd, &st) < 0 ||
+			(uint64_t) st.st_size != L_LE64_TO_CPU(hdr->source_size)) {
+		close(fd);
+		return false;
+	}
+
+	if (cache_mtime(&st) == L_LE64_TO_CPU(hdr->source_mtime)) {
+		close(fd);
+		return true;
+	}
+
+	/* Touched or copied, only a change of the contents matters */
+	if (!st.st_size) {
+		close(fd);
+		return cache_hash(NULL, 0) == L_LE64_TO_CPU(hdr->source_hash);
+	}
+
+	data = read_all(fd, st.st_size, &len);
+	close(fd);
+
+	if (!data)
+		return false;
+
+	r = len == (size_t) st.st_size &&
+		cache_hash(data, len) == L_LE64_TO_CPU(hdr->source_hash);
+	explicit_bzero(data, len);
+	l_free(data);
+
+	return r;
+}
+
+static bool cache_validate(const void *addr, size_t size)
+{
+	const struct cache_header *hdr = addr;
+	const struct cache_group *group_table;
+	const struct cache_setting *setting_table;
+	uint64_t group_count;
+	uint64_t setting_count;
+	uint64_t strings_size;
+	uint64_t total = 0;
+	uint64_t i;
+
+	if (size < sizeof(struct cache_header))
+		return false;
+
+	if (memcmp(hdr->signature, cache_sig, sizeof(cache_sig)))
+		return false;
+
+	if (L_LE64_TO_CPU(hdr->version) != CACHE_VERSION)
+		return false;
+
+	if (L_LE64_TO_CPU(hdr->file_size) != size)
+		return false;
+
+	if (L_LE64_TO_CPU(hdr->header_size) != sizeof(struct cache_header))
+		return false;
+
+	group_count = L_LE64_TO_CPU(hdr->group_count);
+	setting_count = L_LE64_TO_CPU(hdr->setting_count);
+	strings_size = L_LE64_TO_CPU(hdr->strings_size);
+
+	if (group_count > size / sizeof(struct cache_group) ||
+			setting_count > size / sizeof(struct cache_setting) ||
+			strings_size > size)
+		return false;
+
+	if (sizeof(struct cache_header) +
+			group_count * sizeof(struct cache_group) +
+			setting_count * sizeof(struct cache_setting) +
+			strings_size != size)
+		return false;
+
+	group_table = (const struct cache_group *) (hdr + 1);
+	setting_table = (const struct cache_setting *)
+					(group_table + group_count);
+
+	/* Every string including its terminator has to be in the section */
+	for (i = 0; i < group_count; i++) {
+		uint64_t offset = L_LE64_TO_CPU(group_table[i].name_offset);
+		uint32_t len = L_LE32_TO_CPU(group_table[i].name_len);
+
+		if (offset >= strings_size || len >= strings_size - offset)
+			return false;
+
+		total += L_LE32_TO_CPU(group_table[i].setting_count);
+	}
+
+	if (total != setting_count)
+		return false;
+
+	for (i = 0; i < setting_count; i++) {
+		uint64_t key = L_LE64_TO_CPU(setting_table[i].key_offset);
+		uint64_t value = L_LE64_TO_CPU(setting_table[i].value_offset);
+		uint32_t key_len = L_LE32_TO_CPU(setting_table[i].key_len);
+		uint32_t value_len = L_LE32_TO_CPU(setting_table[i].value_len);
+
+		if (key >= strings_size || key_len >= strings_size - key)
+			return false;
+
+		if (value >= strings_size || value_len >= strings_size - value)
+			return false;
+	}
+
+	return true;
+}
+
+static void cache_load(struct l_settings *settings, const void *addr)
+{
+	const struct cache_header *hdr = addr;
+	const struct cache_group *group_table;
+	const struct cache_setting *setting_table;
+	const char *strings;
+	uint64_t group_count = L_LE64_TO_CPU(hdr->group_count);
+	uint64_t setting_count = L_LE64_TO_CPU(hdr->setting_count);
+	uint64_t i;
+
+	group_table = (const struct cache_group *) (hdr + 1);
+	setting_table = (const struct cache_setting *)
+					(group_table + group_count);
+	strings = (const char *) (setting_table + setting_count);
+
+	for (i = 0; i < group_count; i++) {
+		const struct cache_group *cg = &group_table[i];
+		struct l_settings_group *group;
+		uint32_t j;
+
+		group = group_new(settings,
+			l_strndup(strings + L_LE64_TO_CPU(cg->name_offset),
+					L_LE32_TO_CPU(cg->name_len)));
+
+		for (j = 0; j < L_LE32_TO_CPU(cg->setting_count); j++) {
+			const struct cache_setting *cs = setting_table++;
+			struct setting_data *pair = l_new(struct setting_data, 1);
+
+			pair->key = strings + L_LE64_TO_CPU(cs->key_offset);
+			pair->key_len = L_LE32_TO_CPU(cs->key_len);
+			pair->key_borrowed = true;
+			pair->raw = strings + L_LE64_TO_CPU(cs->value_offset);
+			pair->raw_len = L_LE32_TO_CPU(cs->value_len);
+
+			l_queue_push_tail(group->settings, pair);
+			l_radix_insert(group->index, pair->key, pair->key_len,
+									pair);
+		}
+	}
+}
+
+static bool load_from_cache(struct l_settings *settings, const char *filename)
+{
+	char *cachename = cache_filename(filename);
+	struct stat st;
+	char *data;
+	size_t len;
+	int fd;
+
+	fd = open(cachename, O_RDONLY | O_CLOEXEC);
+	l_free(cachename);
+
+	if (fd < 0)
+		return false;
+
+	if (fstat(fd, &st) < 0 || !st.st_size) {
+		close(fd);
+		return false;
+	}
+
+	/* Validated offsets must stay valid, so don't use a shared mapping */
+	data = read_all(fd, st.st_size, &len);
+	close(fd);
+
+	if (!data)
+		return false;
+
+	if (!cache_validate(data, len) ||
+			!cache_source_matches((const struct cache_header *) data,
+								filename)) {
+		l_util_debug(settings->debug_handler, settings->debug_data,
+				"Ignoring stale cache of %s", filename);
+		explicit_bzero(data, len);
+		l_free(data);
+		return false;
+	}
+
+	add_buffer(settings, data, len);
+	cache_load(settings, data);
+
+	return true;
+}
+
+/* Falls back to parsing @filename when its cache is missing or stale */
+LIB_EXPORT bool l_settings_load_from_file_cached(struct l_settings *settings,
+							const char *filename)
+{
+	if (unlikely(!settings || !filename))
+		return false;
+
+	if (load_from_cache(settings, filename))
+		return true;
+
+	return load_from_file(settings, filename, false);
+}
+
+LIB_EXPORT bool l_settings_set_debug(struct l_settings *settings,
+					l_settings_debug_cb_t callback,
+					void *user_data,
+					l_settings_destroy_cb_t destroy)
+{
+	if (unlikely(!settings))
+		return false;
+
+	if (settings->debug_destroy)
+		settings->debug_destroy(settings->debug_data);
+
+	settings->debug_handler = callback;
+	settings->debug_destroy = destroy;
+	settings->debug_data = user_data;
+
+	return true;
+}
+
+static bool group_match(const void *a, const void *b)
+{
+	const struct l_settings_group *group = a;
+	const char *name = b;
+
+	return !strcmp(group->name, name);
+}
+
+struct gather_data {
+	int cur;
+	char **v;
+};
+
+static void gather_groups(void *data, void *user_data)
+{
+	struct l_settings_group *group_data = data;
+	struct gather_data *gather = user_data;
+
+	gather->v[gather->cur++] = l_strdup(group_data->name);
+}
+
+LIB_EXPORT char **l_settings_get_groups(const struct l_settings *settings)
+{
+	char **ret;
+	struct gather_data gather;
+
+	if (unlikely(!settings))
+		return NULL;
+
+	ret = l_new(char *, l_queue_length(settings->groups) + 1);
+	gather.v = ret;
+	gather.cur = 0;
+
+	l_queue_foreach(settings->groups, gather_groups, &gather);
+
+	return ret;
+}
+
+LIB_EXPORT bool l_settings_has_group(const struct l_settings *settings,
+					const char *group_name)
+{
+	struct l_settings_group *group;
+
+	if (unlikely(!settings))
+		return false;
+
+	group = group_lookup(settings, group_name);
+
+	return !!group;
+}
+
+static bool key_match(const void *a, const void *b)
+{
+	const struct setting_data *setting = a;
+	const char *key = b;
+
+	return strlen(key) == setting->key_len &&
+			!memcmp(setting->key, key, setting->key_len);
+}
+
+static void gather_keys(void *data, void *user_data)
+{
+	struct setting_data *setting_data = data;
+	struct gather_data *gather = user_data;
+
+	gather->v[gather->cur++] = l_strndup(setting_data->key,
+							setting_data->key_len);
+}
+
+LIB_EXPORT char **l_settings_get_keys(const struct l_settings *settings,
+					const char *group_name)
+{
+	char **ret;
+	struct l_settings_group *group_data;
+	struct gather_data gather;
+
+	if (unlikely(!settings))
+		return NULL;
+
+	group_data = group_lookup(settings, group_name);
+	if (!group_data)
+		return NULL;
+
+	ret = l_new(char *, l_queue_length(group_data->settings) + 1);
+	gather.v = ret;
+	gather.cur = 0;
+
+	l_queue_foreach(group_data->settings, gather_keys, &gather);
+
+	return ret;
+}
+
+LIB_EXPORT bool l_settings_has_key(const struct l_settings *settings,
+					const char *group_name, const char *key)
+{
+	if (unlikely(!settings))
+		return false;
+
+	return l_settings_group_has_key(group_lookup(settings, group_name),
+									key);
+}
+
+LIB_EXPORT const char *l_settings_get_value(const struct l_settings *settings,
+						const char *group_name,
+						const char *key)
+{
+	if (unlikely(!settings))
+		return NULL;
+
+	return l_settings_group_get_value(group_lookup(settings, group_name),
+									key);
+}
+
+LIB_EXPORT const struct l_settings_group *l_settings_get_group(
+					const struct l_settings *settings,
+					const char *group_name)
+{
+	if (unlikely(!settings))
+		return NULL;
+
+	return group_lookup(settings, group_name);
+}
+
+LIB_EXPORT bool l_settings_group_has_key(const struct l_settings_group *group,
+							const char *key)
+{
+	if (unlikely(!group))
+		return false;
+
+	return !!setting_lookup(group, key);
+}
+
+LIB_EXPORT const char *l_settings_group_get_value(
+					const struct l_settings_group *group,
+					const char *key)
+{
+	struct setting_data *setting;
+
+	if (unlikely(!group))
+		return NULL;
+
+	setting = setting_lookup(group, key);
+	if (!setting)
+		return NULL;
+
+	return setting_value(setting);
+}
+
+static bool validate_group_name(const char *group_name)
+{
+	int i;
+
+	for (i = 0; group_name[i]; i++) {
+		if (!l_ascii_isprint(group_name[i]))
+			return false;
+
+		if (group_name[i] == ']' || group_name[i] == '[')
+			return false;
+	}
+
+	return true;
+}
+
+static bool validate_key(const char *key)
+{
+	int i;
+
+	for (i = 0; key[i]; i++) {
+		if (!validate_key_character(key[i]))
+			return false;
+	}
+
+	return true;
+}
+
+static bool set_value(struct l_settings *settings, const char *group_name,
+			const char *key, char *value)
+{
+	struct l_settings_group *group;
+	struct setting_data *pair;
+
+	if (!validate_group_name(group_name)) {
+		l_util_debug(settings->debug_handler, settings->debug_data,
+				"Invalid group name %s", group_name);
+		l_free(value);
+
+		return false;
+	}
+
+	if (!validate_key(key)) {
 		l_util_debug(settings->debug_handler, settings->debug_data,
 				"Invalid key %s", key);
 		l_free(value);
@@ -712,29 +1577,26 @@ static bool set_value(struct l_settings *settings, const char *group_name,
 		return false;
 	}
 
-	group = l_queue_find(settings->groups, group_match, group_name);
+	group = group_lookup(settings, group_name);
 	if (!group) {
-		group = l_new(struct group_data, 1);
-		group->name = l_strdup(group_name);
-		group->settings = l_queue_new();
-
-		l_queue_push_tail(settings->groups, group);
+		group = group_new(settings, l_strdup(group_name));
 		goto add_pair;
 	}
 
-	pair = l_queue_find(group->settings, key_match, key);
+	pair = setting_lookup(group, key);
 	if (!pair) {
 add_pair:
 		pair = l_new(struct setting_data, 1);
 		pair->key = l_strdup(key);
-		pair->value = value;
+		pair->key_len = strlen(key);
+		setting_set_value(pair, value);
 		l_queue_push_tail(group->settings, pair);
+		l_radix_insert(group->index, pair->key, pair->key_len, pair);
 
 		return true;
 	}
 
-	l_free(pair->value);
-	pair->value = value;
+	setting_set_value(pair, value);
 
 	return true;
 }
@@ -749,13 +1611,9 @@ LIB_EXPORT bool l_settings_set_value(struct l_settings *settings,
 	return set_value(settings, group_name, key, l_strdup(value));
 }
 
-LIB_EXPORT bool l_settings_get_bool(const struct l_settings *settings,
-					const char *group_name, const char *key,
-					bool *out)
+static bool get_bool(const struct l_settings *settings, const char *value,
+							bool *out)
 {
-	const char *value;
-
-	value = l_settings_get_value(settings, group_name, key);
 	if (!value)
 		return false;
 
@@ -779,6 +1637,25 @@ LIB_EXPORT bool l_settings_get_bool(const struct l_settings *settings,
 	return false;
 }
 
+LIB_EXPORT bool l_settings_get_bool(const struct l_settings *settings,
+					const char *group_name, const char *key,
+					bool *out)
+{
+	const char *value = l_settings_get_value(settings, group_name, key);
+
+	return get_bool(settings, value, out);
+}
+
+LIB_EXPORT bool l_settings_group_get_bool(const struct l_settings_group *group,
+					const char *key, bool *out)
+{
+	if (unlikely(!group))
+		return false;
+
+	return get_bool(group->owner, l_settings_group_get_value(group, key),
+									out);
+}
+
 LIB_EXPORT bool l_settings_set_bool(struct l_settings *settings,
 					const char *group_name, const char *key,
 					bool in)
@@ -795,11 +1672,9 @@ LIB_EXPORT bool l_settings_set_bool(struct l_settings *settings,
 	return l_settings_set_value(settings, group_name, key, v);
 }
 
-LIB_EXPORT bool l_settings_get_int(const struct l_settings *settings,
-					const char *group_name,
-					const char *key, int *out)
+static bool get_int(const struct l_settings *settings, const char *value,
+							int *out)
 {
-	const char *value = l_settings_get_value(settings, group_name, key);
 	long int r;
 	int t;
 	char *endp;
@@ -831,6 +1706,25 @@ error:
 	return false;
 }
 
+LIB_EXPORT bool l_settings_get_int(const struct l_settings *settings,
+					const char *group_name, const char *key,
+					int *out)
+{
+	const char *value = l_settings_get_value(settings, group_name, key);
+
+	return get_int(settings, value, out);
+}
+
+LIB_EXPORT bool l_settings_group_get_int(const struct l_settings_group *group,
+					const char *key, int *out)
+{
+	if (unlikely(!group))
+		return false;
+
+	return get_int(group->owner, l_settings_group_get_value(group, key),
+									out);
+}
+
 LIB_EXPORT bool l_settings_set_int(struct l_settings *settings,
 					const char *group_name, const char *key,
 					int in)
@@ -842,11 +1736,9 @@ LIB_EXPORT bool l_settings_set_int(struct l_settings *settings,
 	return l_settings_set_value(settings, group_name, key, buf);
 }
 
-LIB_EXPORT bool l_settings_get_uint(const struct l_settings *settings,
-					const char *group_name, const char *key,
-					unsigned int *out)
+static bool get_uint(const struct l_settings *settings, const char *value,
+							unsigned int *out)
 {
-	const char *value = l_settings_get_value(settings, group_name, key);
 	unsigned long int r;
 	unsigned int t;
 	char *endp;
@@ -875,7 +1767,26 @@ error:
 	l_util_debug(settings->debug_handler, settings->debug_data,
 			"Could not interpret %s as a uint", value);
 
-	return false;
+	return false;
+}
+
+LIB_EXPORT bool l_settings_get_uint(const struct l_settings *settings,
+					const char *group_name, const char *key,
+					unsigned int *out)
+{
+	const char *value = l_settings_get_value(settings, group_name, key);
+
+	return get_uint(settings, value, out);
+}
+
+LIB_EXPORT bool l_settings_group_get_uint(const struct l_settings_group *group,
+					const char *key, unsigned int *out)
+{
+	if (unlikely(!group))
+		return false;
+
+	return get_uint(group->owner, l_settings_group_get_value(group, key),
+									out);
 }
 
 LIB_EXPORT bool l_settings_set_uint(struct l_settings *settings,
@@ -889,11 +1800,9 @@ LIB_EXPORT bool l_settings_set_uint(struct l_settings *settings,
 	return l_settings_set_value(settings, group_name, key, buf);
 }
 
-LIB_EXPORT bool l_settings_get_int64(const struct l_settings *settings,
-					const char *group_name, const char *key,
-					int64_t *out)
+static bool get_int64(const struct l_settings *settings, const char *value,
+							int64_t *out)
 {
-	const char *value = l_settings_get_value(settings, group_name, key);
 	int64_t r;
 	char *endp;
 
@@ -924,6 +1833,25 @@ error:
 	return false;
 }
 
+LIB_EXPORT bool l_settings_get_int64(const struct l_settings *settings,
+					const char *group_name, const char *key,
+					int64_t *out)
+{
+	const char *value = l_settings_get_value(settings, group_name, key);
+
+	return get_int64(settings, value, out);
+}
+
+LIB_EXPORT bool l_settings_group_get_int64(const struct l_settings_group *group,
+					const char *key, int64_t *out)
+{
+	if (unlikely(!group))
+		return false;
+
+	return get_int64(group->owner, l_settings_group_get_value(group, key),
+									out);
+}
+
 LIB_EXPORT bool l_settings_set_int64(struct l_settings *settings,
 					const char *group_name, const char *key,
 					int64_t in)
@@ -935,11 +1863,9 @@ LIB_EXPORT bool l_settings_set_int64(struct l_settings *settings,
 	return l_settings_set_value(settings, group_name, key, buf);
 }
 
-LIB_EXPORT bool l_settings_get_uint64(const struct l_settings *settings,
-					const char *group_name, const char *key,
-					uint64_t *out)
+static bool get_uint64(const struct l_settings *settings, const char *value,
+							uint64_t *out)
 {
-	const char *value = l_settings_get_value(settings, group_name, key);
 	uint64_t r;
 	char *endp;
 
@@ -970,6 +1896,26 @@ error:
 	return false;
 }
 
+LIB_EXPORT bool l_settings_get_uint64(const struct l_settings *settings,
+					const char *group_name, const char *key,
+					uint64_t *out)
+{
+	const char *value = l_settings_get_value(settings, group_name, key);
+
+	return get_uint64(settings, value, out);
+}
+
+LIB_EXPORT bool l_settings_group_get_uint64(
+					const struct l_settings_group *group,
+					const char *key, uint64_t *out)
+{
+	if (unlikely(!group))
+		return false;
+
+	return get_uint64(group->owner, l_settings_group_get_value(group, key),
+									out);
+}
+
 LIB_EXPORT bool l_settings_set_uint64(struct l_settings *settings,
 					const char *group_name, const char *key,
 					uint64_t in)
@@ -981,15 +1927,28 @@ LIB_EXPORT bool l_settings_set_uint64(struct l_settings *settings,
 	return l_settings_set_value(settings, group_name, key, buf);
 }
 
+static const char *get_unescaped(const struct l_settings_group *group,
+							const char *key)
+{
+	struct setting_data *setting;
+
+	if (unlikely(!group))
+		return NULL;
+
+	setting = setting_lookup(group, key);
+	if (!setting)
+		return NULL;
+
+	return setting_unescaped(setting);
+}
+
 LIB_EXPORT char *l_settings_get_string(const struct l_settings *settings,
 					const char *group_name, const char *key)
 {
-	const char *value = l_settings_get_value(settings, group_name, key);
-
-	if (!value)
+	if (unlikely(!settings))
 		return NULL;
 
-	return unescape_value(value);
+	return l_strdup(get_unescaped(group_lookup(settings, group_name), key));
 }
 
 LIB_EXPORT bool l_settings_set_string(struct l_settings *settings,
@@ -1006,26 +1965,38 @@ LIB_EXPORT bool l_settings_set_string(struct l_settings *settings,
 	return set_value(settings, group_name, key, buf);
 }
 
+LIB_EXPORT char *l_settings_group_get_string(
+					const struct l_settings_group *group,
+					const char *key)
+{
+	return l_strdup(get_unescaped(group, key));
+}
+
+static char **get_string_list(const char *str, const char delimiter)
+{
+	if (!str)
+		return NULL;
+
+	return l_strsplit(str, delimiter);
+}
+
 LIB_EXPORT char **l_settings_get_string_list(const struct l_settings *settings,
 						const char *group_name,
 						const char *key,
 						const char delimiter)
 {
-	const char *value = l_settings_get_value(settings, group_name, key);
-	char *str;
-	char **ret;
-
-	if (!value)
-		return NULL;
-
-	str = unescape_value(value);
-	if (str == NULL)
+	if (unlikely(!settings))
 		return NULL;
 
-	ret = l_strsplit(str, delimiter);
-	l_free(str);
+	return get_string_list(get_unescaped(group_lookup(settings, group_name),
+							key), delimiter);
+}
 
-	return ret;
+LIB_EXPORT char **l_settings_group_get_string_list(
+					const struct l_settings_group *group,
+					const char *key, const char delimiter)
+{
+	return get_string_list(get_unescaped(group, key), delimiter);
 }
 
 LIB_EXPORT bool l_settings_set_string_list(struct l_settings *settings,
@@ -1045,16 +2016,14 @@ LIB_EXPORT bool l_settings_set_string_list(struct l_settings *settings,
 	return set_value(settings, group_name, key, buf);
 }
 
-LIB_EXPORT bool l_settings_get_double(const struct l_settings *settings,
-					const char *group_name, const char *key,
-					double *out)
+static bool get_double(const struct l_settings *settings, const char *value,
+							double *out)
 {
-	const char *value = l_settings_get_value(settings, group_name, key);
 	char *endp;
 	double r;
 
 	if (!value)
-		return NULL;
+		return false;
 
 	if (*value == '\0')
 		goto error;
@@ -1080,6 +2049,26 @@ error:
 	return false;
 }
 
+LIB_EXPORT bool l_settings_get_double(const struct l_settings *settings,
+					const char *group_name, const char *key,
+					double *out)
+{
+	const char *value = l_settings_get_value(settings, group_name, key);
+
+	return get_double(settings, value, out);
+}
+
+LIB_EXPORT bool l_settings_group_get_double(
+					const struct l_settings_group *group,
+					const char *key, double *out)
+{
+	if (unlikely(!group))
+		return false;
+
+	return get_double(group->owner, l_settings_group_get_value(group, key),
+									out);
+}
+
 LIB_EXPORT bool l_settings_set_double(struct l_settings *settings,
 					const char *group_name, const char *key,
 					double in)
@@ -1091,16 +2080,14 @@ LIB_EXPORT bool l_settings_set_double(struct l_settings *settings,
 	return l_settings_set_value(settings, group_name, key, buf);
 }
 
-LIB_EXPORT bool l_settings_get_float(const struct l_settings *settings,
-					const char *group_name, const char *key,
-					float *out)
+static bool get_float(const struct l_settings *settings, const char *value,
+							float *out)
 {
-	const char *value = l_settings_get_value(settings, group_name, key);
 	char *endp;
 	float r;
 
 	if (!value)
-		return NULL;
+		return false;
 
 	if (*value == '\0')
 		goto error;
@@ -1126,6 +2113,25 @@ error:
 	return false;
 }
 
+LIB_EXPORT bool l_settings_get_float(const struct l_settings *settings,
+					const char *group_name, const char *key,
+					float *out)
+{
+	const char *value = l_settings_get_value(settings, group_name, key);
+
+	return get_float(settings, value, out);
+}
+
+LIB_EXPORT bool l_settings_group_get_float(const struct l_settings_group *group,
+					const char *key, float *out)
+{
+	if (unlikely(!group))
+		return false;
+
+	return get_float(group->owner, l_settings_group_get_value(group, key),
+									out);
+}
+
 LIB_EXPORT bool l_settings_set_float(struct l_settings *settings,
 					const char *group_name, const char *key,
 					float in)
@@ -1140,17 +2146,25 @@ LIB_EXPORT bool l_settings_set_float(struct l_settings *settings,
 LIB_EXPORT bool l_settings_remove_group(struct l_settings *settings,
 					const char *group_name)
 {
-	struct group_data *group;
+	struct l_settings_group *group;
 
 	if (unlikely(!settings))
 		return false;
 
-	group = l_queue_remove_if(settings->groups, group_match, group_name);
+	group = group_lookup(settings, group_name);
 	if (!group)
 		return false;
 
+	l_queue_remove(settings->groups, group);
+	l_radix_remove(settings->index, group->name, strlen(group->name));
 	group_destroy(group);
 
+	/* Index the next group of the same name, if any */
+	group = l_queue_find(settings->groups, group_match, group_name);
+	if (group)
+		l_radix_insert(settings->index, group->name,
+						strlen(group->name), group);
+
 	return true;
 }
 
@@ -1158,21 +2172,369 @@ LIB_EXPORT bool l_settings_remove_key(struct l_settings *settings,
 					const char *group_name,
 					const char *key)
 {
-	struct group_data *group;
+	struct l_settings_group *group;
 	struct setting_data *setting;
 
 	if (unlikely(!settings))
 		return false;
 
-	group = l_queue_find(settings->groups, group_match, group_name);
+	group = group_lookup(settings, group_name);
 	if (!group)
 		return false;
 
-	setting = l_queue_remove_if(group->settings, key_match, key);
+	setting = setting_lookup(group, key);
 	if (!setting)
 		return false;
 
+	l_queue_remove(group->settings, setting);
+	l_radix_remove(group->index, setting->key, setting->key_len);
 	setting_destroy(setting);
 
+	/* Index the next setting with the same key, if any */
+	setting = l_queue_find(group->settings, key_match, key);
+	if (setting)
+		l_radix_insert(group->index, setting->key,
+						setting->key_len, setting);
+
+	return true;
+}
+
+struct l_settings_watch {
+	char *filename;
+	const char *basename;
+	struct l_settings *settings;
+	char *data;
+	size_t len;
+	struct l_dir_watch *dir_watch;
+	l_settings_watch_func_t function;
+	void *user_data;
+	l_settings_destroy_cb_t destroy;
+	bool in_notify;
+	bool destroyed;
+};
+
+static void watch_notify(struct l_settings_watch *watch,
+				const struct l_settings_group *group,
+				const struct setting_data *setting,
+				enum l_settings_watch_event event)
+{
+	char *key = NULL;
+
+	if (!watch->function || watch->destroyed)
+		return;
+
+	if (setting)
+		key = l_strndup(setting->key, setting->key_len);
+
+	watch->function(group->name, key, event, watch->user_data);
+
+	l_free(key);
+}
+
+/* Duplicates of a name are ignored, just like lookups do */
+static bool group_is_indexed(const struct l_settings *settings,
+					const struct l_settings_group *group)
+{
+	return group_lookup(settings, group->name) == group;
+}
+
+static struct setting_data *setting_match(
+					const struct l_settings_group *group,
+					const struct setting_data *setting)
+{
+	return l_radix_lookup(group->index, setting->key, setting->key_len);
+}
+
+static void watch_notify_group(struct l_settings_watch *watch,
+				const struct l_settings_group *group,
+				enum l_settings_watch_event event)
+{
+	const struct l_queue_entry *entry;
+
+	for (entry = l_queue_get_entries(group->settings); entry;
+						entry = entry->next) {
+		const struct setting_data *setting = entry->data;
+
+		if (setting_match(group, setting) == setting)
+			watch_notify(watch, group, setting, event);
+	}
+}
+
+static bool watch_diff_group(struct l_settings_watch *watch,
+				const struct l_settings_group *old_group,
+				const struct l_settings_group *new_group)
+{
+	const struct l_queue_entry *entry;
+	bool changed = false;
+
+	for (entry = l_queue_get_entries(new_group->settings); entry;
+						entry = entry->next) {
+		const struct setting_data *setting = entry->data;
+		const struct setting_data *old;
+
+		if (setting_match(new_group, setting) != setting)
+			continue;
+
+		old = setting_match(old_group, setting);
+		if (!old) {
+			watch_notify(watch, new_group, setting,
+					L_SETTINGS_WATCH_EVENT_ADDED);
+			changed = true;
+		} else if (old->raw_len != setting->raw_len ||
+				memcmp(old->raw, setting->raw,
+							setting->raw_len)) {
+			watch_notify(watch, new_group, setting,
+					L_SETTINGS_WATCH_EVENT_CHANGED);
+			changed = true;
+		}
+	}
+
+	for (entry = l_queue_get_entries(old_group->settings); entry;
+						entry = entry->next) {
+		const struct setting_data *setting = entry->data;
+
+		if (setting_match(old_group, setting) != setting)
+			continue;
+
+		if (setting_match(new_group, setting))
+			continue;
+
+		watch_notify(watch, old_group, setting,
+					L_SETTINGS_WATCH_EVENT_REMOVED);
+		changed = true;
+	}
+
+	return changed;
+}
+
+static void watch_diff(struct l_settings_watch *watch,
+				const struct l_settings *old_settings,
+				const struct l_settings *new_settings)
+{
+	const struct l_queue_entry *entry;
+
+	for (entry = l_queue_get_entries(new_settings->groups); entry;
+						entry = entry->next) {
+		const struct l_settings_group *group = entry->data;
+		const struct l_settings_group *old;
+
+		if (!group_is_indexed(new_settings, group))
+			continue;
+
+		old = group_lookup(old_settings, group->name);
+		if (!old) {
+			watch_notify(watch, group, NULL,
+					L_SETTINGS_WATCH_EVENT_ADDED);
+			watch_notify_group(watch, group,
+					L_SETTINGS_WATCH_EVENT_ADDED);
+		} else if (watch_diff_group(watch, old, group))
+			watch_notify(watch, group, NULL,
+					L_SETTINGS_WATCH_EVENT_CHANGED);
+	}
+
+	for (entry = l_queue_get_entries(old_settings->groups); entry;
+						entry = entry->next) {
+		const struct l_settings_group *group = entry->data;
+
+		if (!group_is_indexed(old_settings, group))
+			continue;
+
+		if (group_lookup(new_settings, group->name))
+			continue;
+
+		watch_notify_group(watch, group,
+					L_SETTINGS_WATCH_EVENT_REMOVED);
+		watch_notify(watch, group, NULL,
+					L_SETTINGS_WATCH_EVENT_REMOVED);
+	}
+}
+
+static bool watch_read(struct l_settings_watch *watch, char **out_data,
+							size_t *out_len)
+{
+	struct stat st;
+	char *data;
+	int fd;
+
+	*out_data = NULL;
+	*out_len = 0;
+
+	fd = open(watch->filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return errno == ENOENT;
+
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		return false;
+	}
+
+	data = read_all(fd, st.st_size, out_len);
+	close(fd);
+
+	if (!data)
+		return false;
+
+	*out_data = data;
+
 	return true;
 }
+
+/* Like the buffers of l_settings, the text may hold secrets */
+static void watch_data_free(char *data, size_t len)
+{
+	if (!data)
+		return;
+
+	explicit_bzero(data, len);
+	l_free(data);
+}
+
+static void watch_reload(struct l_settings_watch *watch)
+{
+	struct l_settings *old_settings;
+	struct l_settings *settings;
+	char *old_data;
+	size_t old_len;
+	char *data;
+	size_t len;
+
+	if (!watch_read(watch, &data, &len))
+		return;
+
+	/* Unchanged content, e.g. the file was only touched */
+	if (len == watch->len && (!len || !memcmp(watch->data, data, len))) {
+		watch_data_free(data, len);
+		return;
+	}
+
+	settings = l_settings_new();
+
+	if (len && !l_settings_load_from_data_nocopy(settings, data, len)) {
+		l_settings_free(settings);
+		watch_data_free(data, len);
+		return;
+	}
+
+	old_settings = watch->settings;
+	old_data = watch->data;
+	old_len = watch->len;
+
+	watch->settings = settings;
+	watch->data = data;
+	watch->len = len;
+
+	watch_diff(watch, old_settings, settings);
+
+	l_settings_free(old_settings);
+	watch_data_free(old_data, old_len);
+}
+
+static void watch_free(void *data)
+{
+	struct l_settings_watch *watch = data;
+
+	l_dir_watch_destroy(watch->dir_watch);
+	l_settings_free(watch->settings);
+	watch_data_free(watch->data, watch->len);
+	l_free(watch->filename);
+	l_free(watch);
+}
+
+static void watch_dir_event(const char *filename, enum l_dir_watch_event event,
+							void *user_data)
+{
+	struct l_settings_watch *watch = user_data;
+
+	if (watch->destroyed || strcmp(filename, watch->basename))
+		return;
+
+	switch (event) {
+	case L_DIR_WATCH_EVENT_CREATED:
+	case L_DIR_WATCH_EVENT_REMOVED:
+	case L_DIR_WATCH_EVENT_MODIFIED:
+		watch->in_notify = true;
+		watch_reload(watch);
+		watch->in_notify = false;
+		break;
+	case L_DIR_WATCH_EVENT_ACCESSED:
+		break;
+	}
+
+	/*
+	 * Destroyed from the callback.  The directory watch can't be
+	 * destroyed from within its own callback either, so free later.
+	 */
+	if (watch->destroyed)
+		l_idle_oneshot(watch_free, watch, NULL);
+}
+
+LIB_EXPORT struct l_settings_watch *l_settings_watch_new(const char *filename,
+					l_settings_watch_func_t function,
+					void *user_data,
+					l_settings_destroy_cb_t destroy)
+{
+	struct l_settings_watch *watch;
+	const char *slash;
+	char *dirname;
+
+	if (unlikely(!filename))
+		return NULL;
+
+	watch = l_new(struct l_settings_watch, 1);
+	watch->filename = l_strdup(filename);
+
+	slash = strrchr(watch->filename, '/');
+	watch->basename = slash ? slash + 1 : watch->filename;
+
+	if (!slash)
+		dirname = l_strdup(".");
+	else if (slash == watch->filename)
+		dirname = l_strdup("/");
+	else
+		dirname = l_strndup(watch->filename, slash - watch->filename);
+
+	watch->dir_watch = l_dir_watch_new(dirname, watch_dir_event, watch,
+									NULL);
+	l_free(dirname);
+
+	if (!watch->dir_watch) {
+		l_free(watch->filename);
+		l_free(watch);
+		return NULL;
+	}
+
+	/* No callback yet, the initial load is not reported */
+	watch->settings = l_settings_new();
+	watch_reload(watch);
+
+	watch->function = function;
+	watch->user_data = user_data;
+	watch->destroy = destroy;
+
+	return watch;
+}
+
+LIB_EXPORT void l_settings_watch_destroy(struct l_settings_watch *watch)
+{
+	if (unlikely(!watch))
+		return;
+
+	if (watch->destroy)
+		watch->destroy(watch->user_data);
+
+	if (watch->in_notify) {
+		watch->destroyed = true;
+		return;
+	}
+
+	watch_free(watch);
+}
+
+LIB_EXPORT const struct l_settings *l_settings_watch_get_settings(
+					const struct l_settings_watch *watch)
+{
+	if (unlikely(!watch))
+		return NULL;
+
+	return watch->settings;
+}
@@ -31,6 +31,7 @@ extern "C" {
 #endif
 
 struct l_settings;
+struct l_settings_group;
 
 typedef void (*l_settings_debug_cb_t) (const char *str, void *user_data);
 typedef void (*l_settings_destroy_cb_t) (void *user_data);
@@ -40,10 +41,20 @@ void l_settings_free(struct l_settings *settings);
 
 bool l_settings_load_from_data(struct l_settings *settings,
 						const char *data, size_t len);
+bool l_settings_load_from_data_nocopy(struct l_settings *settings,
+						const char *data, size_t len);
 char *l_settings_to_data(const struct l_settings *settings, size_t *len);
+bool l_settings_write_to_fd(const struct l_settings *settings, int fd);
+bool l_settings_save_atomic(struct l_settings *settings,
+						const char *filename);
 
 bool l_settings_load_from_file(struct l_settings *settings,
 					const char *filename);
+bool l_settings_load_from_file_nocopy(struct l_settings *settings,
+					const char *filename);
+bool l_settings_load_from_file_cached(struct l_settings *settings,
+					const char *filename);
+bool l_settings_write_cache(const char *filename);
 
 bool l_settings_set_debug(struct l_settings *settings,
 				l_settings_debug_cb_t callback,
@@ -121,8 +132,56 @@ bool l_settings_set_float(struct l_settings *settings, const char *group_name,
 
 bool l_settings_remove_key(struct l_settings *settings, const char *group_name,
 				const char *key);
+const struct l_settings_group *l_settings_get_group(
+					const struct l_settings *settings,
+					const char *group_name);
+bool l_settings_group_has_key(const struct l_settings_group *group,
+							const char *key);
+const char *l_settings_group_get_value(const struct l_settings_group *group,
+							const char *key);
+bool l_settings_group_get_bool(const struct l_settings_group *group,
+					const char *key, bool *out);
+bool l_settings_group_get_int(const struct l_settings_group *group,
+					const char *key, int *out);
+bool l_settings_group_get_uint(const struct l_settings_group *group,
+					const char *key, unsigned int *out);
+bool l_settings_group_get_int64(const struct l_settings_group *group,
+					const char *key, int64_t *out);
+bool l_settings_group_get_uint64(const struct l_settings_group *group,
+					const char *key, uint64_t *out);
+char *l_settings_group_get_string(const struct l_settings_group *group,
+							const char *key);
+char **l_settings_group_get_string_list(const struct l_settings_group *group,
+					const char *key, char delimiter);
+bool l_settings_group_get_double(const struct l_settings_group *group,
+					const char *key, double *out);
+bool l_settings_group_get_float(const struct l_settings_group *group,
+					const char *key, float *out);
+
 bool l_settings_remove_group(struct l_settings *settings,
 				const char *group_name);
+
+struct l_settings_watch;
+
+enum l_settings_watch_event {
+	L_SETTINGS_WATCH_EVENT_ADDED,
+	L_SETTINGS_WATCH_EVENT_CHANGED,
+	L_SETTINGS_WATCH_EVENT_REMOVED,
+};
+
+typedef void (*l_settings_watch_func_t) (const char *group_name,
+					const char *key,
+					enum l_settings_watch_event event,
+					void *user_data);
+
+struct l_settings_watch *l_settings_watch_new(const char *filename,
+					l_settings_watch_func_t function,
+					void *user_data,
+					l_settings_destroy_cb_t destroy);
+void l_settings_watch_destroy(struct l_settings_watch *watch);
+const struct l_settings *l_settings_watch_get_settings(
+					const struct l_settings_watch *watch);
+
 #ifdef __cplusplus
 }
 #endif
@@ -25,3 +25,4 @@
 
 void _siphash24(uint8_t out[8], const uint8_t *in, size_t inlen,
 						const uint8_t k[16]);
+uint64_t _siphash13(const uint8_t *in, size_t inlen, const uint64_t k[2]);
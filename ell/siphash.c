@@ -24,6 +24,8 @@
 #include <config.h>
 #endif
 
+#include <endian.h>
+
 #include "siphash-private.h"
 
 /*
@@ -136,3 +138,63 @@ void _siphash24(uint8_t out[8], const uint8_t *in, size_t inlen,
 	b = v0 ^ v1 ^ v2  ^ v3;
 	U64TO8_LE(out, b);
 }
+
+/*
+ * SipHash-1-3 with the key given as two words, for hash tables where
+ * speed on short keys matters more than a conservative security margin.
+ */
+uint64_t _siphash13(const uint8_t *in, size_t inlen, const uint64_t k[2])
+{
+	uint64_t v0 = 0x736f6d6570736575ULL ^ k[0];
+	uint64_t v1 = 0x646f72616e646f6dULL ^ k[1];
+	uint64_t v2 = 0x6c7967656e657261ULL ^ k[0];
+	uint64_t v3 = 0x7465646279746573ULL ^ k[1];
+	uint64_t b = ((uint64_t) inlen) << 56;
+	uint64_t m;
+	const uint8_t *end = in + inlen - (inlen % sizeof(uint64_t));
+	const int left = inlen & 7;
+
+	for (; in != end; in += 8) {
+		memcpy(&m, in, sizeof(m));
+		m = le64toh(m);
+		v3 ^= m;
+		SIPROUND;
+		v0 ^= m;
+	}
+
+	switch (left) {
+	case 7:
+		b |= ((uint64_t) in[6]) << 48;
+		/* fall through */
+	case 6:
+		b |= ((uint64_t) in[5]) << 40;
+		/* fall through */
+	case 5:
+		b |= ((uint64_t) in[4]) << 32;
+		/* fall through */
+	case 4:
+		b |= ((uint64_t) in[3]) << 24;
+		/* fall through */
+	case 3:
+		b |= ((uint64_t) in[2]) << 16;
+		/* fall through */
+	case 2:
+		b |= ((uint64_t) in[1]) << 8;
+		/* fall through */
+	case 1:
+		b |= ((uint64_t) in[0]);
+		break;
+	case 0:
+		break;
+	}
+
+	v3 ^= b;
+	SIPROUND;
+	v0 ^= b;
+	v2 ^= 0xff;
+	SIPROUND;
+	SIPROUND;
+	SIPROUND;
+
+	return v0 ^ v1 ^ v2 ^ v3;
+}
@@ -26,6 +26,7 @@
 
 #define _GNU_SOURCE
 #include <limits.h>
+#include <string.h>
 
 #include "uintset.h"
 #include "private.h"
@@ -165,21 +166,1023 @@ static unsigned long find_next_bit(const unsigned long *addr,
 	return bit;
 }
 
+/*
+ * The set is split into chunks of 2^16 numbers, keyed by the upper 16 bits
+ * of the offset from the minimum.  Chunks without any numbers in them are
+ * not allocated at all.  Each populated chunk uses whichever representation
+ * is the most compact for its contents:
+ *
+ *   - a sorted array of 16 bit offsets for sparse chunks,
+ *   - a plain bitmap for dense chunks,
+ *   - a sorted list of [start, last] runs for chunks consisting of long
+ *     consecutive sequences, e.g. fully allocated ID ranges.
+ *
+ * Bitmaps carry two summary levels, one bit per bitmap word, tracking which
+ * words are completely full and which are non-empty.  The set itself keeps
+ * a bitmap of completely full chunks.  Together these allow the unused and
+ * min / max searches to skip over populated areas without scanning them.
+ */
+#define CHUNK_SHIFT		16
+#define CHUNK_SIZE		(1U << CHUNK_SHIFT)
+#define CHUNK_MASK		(CHUNK_SIZE - 1)
+#define BITMAP_WORDS		(CHUNK_SIZE / BITS_PER_LONG)
+#define SUMMARY_WORDS		(BITMAP_WORDS / BITS_PER_LONG)
+#define BITMAP_ALLOC_WORDS	(BITMAP_WORDS + 2 * SUMMARY_WORDS)
+#define ARRAY_MAX		4096
+#define RUNS_MAX		(BITMAP_WORDS * sizeof(unsigned long) / \
+							sizeof(struct run))
+
+enum container_type {
+	CONTAINER_ARRAY,
+	CONTAINER_BITMAP,
+	CONTAINER_RUN,
+};
+
+struct run {
+	uint16_t start;
+	uint16_t last;
+};
+
+struct container {
+	uint16_t key;
+	uint8_t type;
+	uint32_t cardinality;
+	uint32_t len;
+	uint32_t alloc;
+	union {
+		uint16_t *array;
+		unsigned long *bits;
+		struct run *runs;
+	};
+};
+
 struct l_uintset {
-	unsigned long *bits;
-	uint16_t size;
+	struct container *containers;
+	uint32_t n_containers;
+	uint32_t alloc_containers;
+	unsigned long *full_chunks;
+	uint32_t full_chunks_words;
 	uint32_t min;
 	uint32_t max;
 };
 
+enum set_op {
+	SET_OP_AND,
+	SET_OP_OR,
+	SET_OP_AND_NOT,
+};
+
+static inline uint32_t set_range(const struct l_uintset *set)
+{
+	return set->max - set->min;
+}
+
+/* Highest offset (inclusive) that is valid within the chunk @key */
+static inline uint32_t chunk_limit(const struct l_uintset *set, uint16_t key)
+{
+	if (key == set_range(set) >> CHUNK_SHIFT)
+		return set_range(set) & CHUNK_MASK;
+
+	return CHUNK_MASK;
+}
+
+/* Index of the first element in @array which is >= @low */
+static uint32_t array_lower_bound(const uint16_t *array, uint32_t len,
+								uint16_t low)
+{
+	uint32_t lo = 0;
+	uint32_t hi = len;
+
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+
+		if (array[mid] < low)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/* Index of the first run which ends at or after @low */
+static uint32_t run_lower_bound(const struct run *runs, uint32_t len,
+								uint16_t low)
+{
+	uint32_t lo = 0;
+	uint32_t hi = len;
+
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+
+		if (runs[mid].last < low)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static void container_reserve(struct container *c, size_t elem_size,
+								uint32_t len)
+{
+	if (len <= c->alloc)
+		return;
+
+	c->alloc = c->alloc ? c->alloc * 2 : 4;
+	if (c->alloc < len)
+		c->alloc = len;
+
+	c->array = l_realloc(c->array, c->alloc * elem_size);
+}
+
+static inline unsigned long *bitmap_full(unsigned long *bits)
+{
+	return bits + BITMAP_WORDS;
+}
+
+static inline unsigned long *bitmap_nonempty(unsigned long *bits)
+{
+	return bits + BITMAP_WORDS + SUMMARY_WORDS;
+}
+
+static unsigned long *bitmap_new(void)
+{
+	return l_new(unsigned long, BITMAP_ALLOC_WORDS);
+}
+
+static void bitmap_update_summary(unsigned long *bits, unsigned int word)
+{
+	unsigned long *full = bitmap_full(bits);
+	unsigned long *nonempty = bitmap_nonempty(bits);
+	unsigned long mask = 1UL << (word % BITS_PER_LONG);
+
+	if (bits[word] == ~0UL)
+		full[word / BITS_PER_LONG] |= mask;
+	else
+		full[word / BITS_PER_LONG] &= ~mask;
+
+	if (bits[word])
+		nonempty[word / BITS_PER_LONG] |= mask;
+	else
+		nonempty[word / BITS_PER_LONG] &= ~mask;
+}
+
+static void bitmap_rebuild_summary(unsigned long *bits)
+{
+	unsigned long *full = bitmap_full(bits);
+	unsigned long *nonempty = bitmap_nonempty(bits);
+	unsigned int i;
+
+	memset(full, 0, 2 * SUMMARY_WORDS * sizeof(unsigned long));
+
+	for (i = 0; i < BITMAP_WORDS; i++) {
+		unsigned long mask = 1UL << (i % BITS_PER_LONG);
+
+		if (bits[i] == ~0UL)
+			full[i / BITS_PER_LONG] |= mask;
+
+		if (bits[i])
+			nonempty[i / BITS_PER_LONG] |= mask;
+	}
+}
+
+static uint32_t bitmap_count_runs(const unsigned long *bits)
+{
+	uint32_t runs = 0;
+	unsigned int i;
+
+	for (i = 0; i < BITMAP_WORDS; i++) {
+		unsigned long word = bits[i];
+		unsigned long carry = i ? bits[i - 1] >> (BITS_PER_LONG - 1)
+									: 0;
+
+		/* Count the set bits whose predecessor is unset */
+		runs += __builtin_popcountl(word & ~((word << 1) | carry));
+	}
+
+	return runs;
+}
+
+/* Sets the bits @start to @last (inclusive) a word at a time */
+static void bitmap_set_range(unsigned long *bits, uint32_t start,
+								uint32_t last)
+{
+	uint32_t first_word = start / BITS_PER_LONG;
+	uint32_t last_word = last / BITS_PER_LONG;
+	unsigned long first_mask = ~0UL << (start % BITS_PER_LONG);
+	unsigned long last_mask = ~0UL >> (BITS_PER_LONG - 1 -
+						last % BITS_PER_LONG);
+	uint32_t i;
+
+	if (first_word == last_word) {
+		bits[first_word] |= first_mask & last_mask;
+		return;
+	}
+
+	bits[first_word] |= first_mask;
+
+	for (i = first_word + 1; i < last_word; i++)
+		bits[i] = ~0UL;
+
+	bits[last_word] |= last_mask;
+}
+
+/* ORs all numbers of a non-bitmap container @c into @bits */
+static void container_fill_bits(const struct container *c,
+							unsigned long *bits)
+{
+	uint32_t i;
+
+	if (c->type == CONTAINER_ARRAY) {
+		for (i = 0; i < c->len; i++)
+			bits[c->array[i] / BITS_PER_LONG] |=
+					1UL << (c->array[i] % BITS_PER_LONG);
+	} else if (c->type == CONTAINER_RUN) {
+		for (i = 0; i < c->len; i++)
+			bitmap_set_range(bits, c->runs[i].start,
+							c->runs[i].last);
+	}
+}
+
+/* Returns the bitmap words of @c, expanding it into @scratch if needed */
+static const unsigned long *container_bits(const struct container *c,
+						unsigned long *scratch)
+{
+	if (c->type == CONTAINER_BITMAP)
+		return c->bits;
+
+	memset(scratch, 0, BITMAP_WORDS * sizeof(unsigned long));
+	container_fill_bits(c, scratch);
+
+	return scratch;
+}
+
+static void container_to_bitmap(struct container *c)
+{
+	unsigned long *bits;
+
+	if (c->type == CONTAINER_BITMAP)
+		return;
+
+	bits = bitmap_new();
+	container_fill_bits(c, bits);
+	bitmap_rebuild_summary(bits);
+
+	l_free(c->array);
+	c->bits = bits;
+	c->type = CONTAINER_BITMAP;
+	c->len = 0;
+	c->alloc = 0;
+}
+
+static void container_to_array(struct container *c)
+{
+	uint16_t *array = l_new(uint16_t, c->cardinality);
+	uint32_t len = 0;
+	uint32_t i;
+
+	if (c->type == CONTAINER_BITMAP) {
+		unsigned long bit;
+
+		for (bit = find_first_bit(c->bits, CHUNK_SIZE);
+				bit < CHUNK_SIZE;
+				bit = find_next_bit(c->bits, CHUNK_SIZE,
+								bit + 1))
+			array[len++] = bit;
+	} else if (c->type == CONTAINER_RUN) {
+		for (i = 0; i < c->len; i++) {
+			uint32_t n;
+
+			for (n = c->runs[i].start; n <= c->runs[i].last; n++)
+				array[len++] = n;
+		}
+	} else {
+		l_free(array);
+		return;
+	}
+
+	l_free(c->array);
+	c->array = array;
+	c->type = CONTAINER_ARRAY;
+	c->len = len;
+	c->alloc = c->cardinality;
+}
+
+static void container_to_runs(struct container *c, uint32_t n_runs)
+{
+	struct run *runs = l_new(struct run, n_runs);
+	uint32_t len = 0;
+	uint32_t i;
+
+	if (c->type == CONTAINER_ARRAY) {
+		for (i = 0; i < c->len; i++) {
+			if (len && runs[len - 1].last + 1 == c->array[i]) {
+				runs[len - 1].last = c->array[i];
+				continue;
+			}
+
+			runs[len].start = c->array[i];
+			runs[len].last = c->array[i];
+			len++;
+		}
+	} else if (c->type == CONTAINER_BITMAP) {
+		unsigned long bit = find_first_bit(c->bits, CHUNK_SIZE);
+
+		while (bit < CHUNK_SIZE) {
+			unsigned long end = find_first_zero_bit(c->bits,
+							CHUNK_SIZE, bit);
+
+			runs[len].start = bit;
+			runs[len].last = end - 1;
+			len++;
+
+			bit = find_next_bit(c->bits, CHUNK_SIZE, end);
+		}
+	} else {
+		l_free(runs);
+		return;
+	}
+
+	l_free(c->array);
+	c->runs = runs;
+	c->type = CONTAINER_RUN;
+	c->len = len;
+	c->alloc = n_runs;
+}
+
+/*
+ * Switch the container to a more compact representation if its contents
+ * warrant it.  Conversions are only attempted when crossing one of the
+ * thresholds, so the common put / take paths stay cheap.
+ */
+static void container_optimize(struct container *c, uint32_t capacity)
+{
+	uint32_t n_runs;
+	uint32_t i;
+
+	switch (c->type) {
+	case CONTAINER_ARRAY:
+		if (c->cardinality <= ARRAY_MAX)
+			break;
+
+		for (i = 0, n_runs = 0; i < c->len; i++)
+			if (!i || c->array[i - 1] + 1 != c->array[i])
+				n_runs++;
+
+		if (n_runs <= c->cardinality / 4)
+			container_to_runs(c, n_runs);
+		else
+			container_to_bitmap(c);
+
+		break;
+	case CONTAINER_BITMAP:
+		if (c->cardinality == capacity) {
+			container_to_runs(c, 1);
+			break;
+		}
+
+		if (c->cardinality <= ARRAY_MAX / 2) {
+			container_to_array(c);
+			break;
+		}
+
+		break;
+	case CONTAINER_RUN:
+		if (c->len > RUNS_MAX)
+			container_to_bitmap(c);
+		else if (c->cardinality <= ARRAY_MAX &&
+				c->len * sizeof(struct run) >
+				c->cardinality * sizeof(uint16_t))
+			container_to_array(c);
+
+		break;
+	}
+}
+
+/*
+ * Pick the best representation for a bitmap produced by a bulk operation,
+ * where counting its runs is cheap compared to the operation itself.
+ */
+static void container_compact(struct container *c, uint32_t capacity)
+{
+	uint32_t n_runs;
+
+	if (c->type == CONTAINER_BITMAP && c->cardinality > ARRAY_MAX &&
+						c->cardinality < capacity) {
+		n_runs = bitmap_count_runs(c->bits);
+
+		if (n_runs <= RUNS_MAX / 2) {
+			container_to_runs(c, n_runs);
+			return;
+		}
+	}
+
+	container_optimize(c, capacity);
+}
+
+static bool container_contains(const struct container *c, uint16_t low)
+{
+	uint32_t i;
+
+	switch (c->type) {
+	case CONTAINER_ARRAY:
+		i = array_lower_bound(c->array, c->len, low);
+		return i < c->len && c->array[i] == low;
+	case CONTAINER_BITMAP:
+		return c->bits[low / BITS_PER_LONG] &
+					(1UL << (low % BITS_PER_LONG));
+	case CONTAINER_RUN:
+		i = run_lower_bound(c->runs, c->len, low);
+		return i < c->len && c->runs[i].start <= low;
+	}
+
+	return false;
+}
+
+static bool container_add(struct container *c, uint16_t low)
+{
+	unsigned long mask;
+	uint32_t i;
+
+	switch (c->type) {
+	case CONTAINER_ARRAY:
+		i = array_lower_bound(c->array, c->len, low);
+		if (i < c->len && c->array[i] == low)
+			return false;
+
+		container_reserve(c, sizeof(uint16_t), c->len + 1);
+		memmove(c->array + i + 1, c->array + i,
+					(c->len - i) * sizeof(uint16_t));
+		c->array[i] = low;
+		c->len++;
+		break;
+	case CONTAINER_BITMAP:
+		mask = 1UL << (low % BITS_PER_LONG);
+
+		if (c->bits[low / BITS_PER_LONG] & mask)
+			return false;
+
+		c->bits[low / BITS_PER_LONG] |= mask;
+		bitmap_update_summary(c->bits, low / BITS_PER_LONG);
+		break;
+	case CONTAINER_RUN:
+		i = run_lower_bound(c->runs, c->len, low);
+		if (i < c->len && c->runs[i].start <= low)
+			return false;
+
+		/* Extends the previous run, possibly joining it with next */
+		if (i > 0 && c->runs[i - 1].last + 1 == low) {
+			if (i < c->len && c->runs[i].start == low + 1) {
+				c->runs[i - 1].last = c->runs[i].last;
+				memmove(c->runs + i, c->runs + i + 1,
+					(c->len - i - 1) * sizeof(struct run));
+				c->len--;
+			} else
+				c->runs[i - 1].last = low;
+
+			break;
+		}
+
+		if (i < c->len && c->runs[i].start == low + 1) {
+			c->runs[i].start = low;
+			break;
+		}
+
+		container_reserve(c, sizeof(struct run), c->len + 1);
+		memmove(c->runs + i + 1, c->runs + i,
+					(c->len - i) * sizeof(struct run));
+		c->runs[i].start = low;
+		c->runs[i].last = low;
+		c->len++;
+		break;
+	}
+
+	c->cardinality++;
+	return true;
+}
+
+static bool container_remove(struct container *c, uint16_t low)
+{
+	unsigned long mask;
+	struct run *run;
+	uint32_t i;
+
+	switch (c->type) {
+	case CONTAINER_ARRAY:
+		i = array_lower_bound(c->array, c->len, low);
+		if (i >= c->len || c->array[i] != low)
+			return false;
+
+		memmove(c->array + i, c->array + i + 1,
+					(c->len - i - 1) * sizeof(uint16_t));
+		c->len--;
+		break;
+	case CONTAINER_BITMAP:
+		mask = 1UL << (low % BITS_PER_LONG);
+
+		if (!(c->bits[low / BITS_PER_LONG] & mask))
+			return false;
+
+		c->bits[low / BITS_PER_LONG] &= ~mask;
+		bitmap_update_summary(c->bits, low / BITS_PER_LONG);
+		break;
+	case CONTAINER_RUN:
+		i = run_lower_bound(c->runs, c->len, low);
+		if (i >= c->len || c->runs[i].start > low)
+			return false;
+
+		run = &c->runs[i];
+
+		if (run->start == run->last) {
+			memmove(c->runs + i, c->runs + i + 1,
+					(c->len - i - 1) * sizeof(struct run));
+			c->len--;
+		} else if (run->start == low)
+			run->start++;
+		else if (run->last == low)
+			run->last--;
+		else {
+			/* Split the run in two around @low */
+			container_reserve(c, sizeof(struct run), c->len + 1);
+			run = &c->runs[i];
+
+			memmove(c->runs + i + 2, c->runs + i + 1,
+					(c->len - i - 1) * sizeof(struct run));
+			c->runs[i + 1].start = low + 1;
+			c->runs[i + 1].last = run->last;
+			run->last = low - 1;
+			c->len++;
+		}
+
+		break;
+	}
+
+	c->cardinality--;
+	return true;
+}
+
+static uint32_t container_first(const struct container *c)
+{
+	unsigned long word;
+
+	switch (c->type) {
+	case CONTAINER_ARRAY:
+		return c->array[0];
+	case CONTAINER_BITMAP:
+		word = find_first_bit(bitmap_nonempty(c->bits), BITMAP_WORDS);
+		return word * BITS_PER_LONG + __ffs(c->bits[word]);
+	case CONTAINER_RUN:
+		return c->runs[0].start;
+	}
+
+	return CHUNK_SIZE;
+}
+
+static uint32_t container_last(const struct container *c)
+{
+	unsigned long word;
+
+	switch (c->type) {
+	case CONTAINER_ARRAY:
+		return c->array[c->len - 1];
+	case CONTAINER_BITMAP:
+		word = find_last_bit(bitmap_nonempty(c->bits), BITMAP_WORDS);
+		return word * BITS_PER_LONG + __fls(c->bits[word]) - 1;
+	case CONTAINER_RUN:
+		return c->runs[c->len - 1].last;
+	}
+
+	return CHUNK_SIZE;
+}
+
+/*
+ * Returns the first offset >= @low and <= @limit which is not contained
+ * in @c, or CHUNK_SIZE if there is none.
+ */
+static uint32_t container_next_unused(const struct container *c,
+						uint32_t low, uint32_t limit)
+{
+	unsigned long word;
+	uint32_t i;
+	uint32_t r;
+
+	switch (c->type) {
+	case CONTAINER_ARRAY:
+		i = array_lower_bound(c->array, c->len, low);
+
+		for (r = low; i < c->len && c->array[i] == r; i++)
+			r++;
+
+		break;
+	case CONTAINER_BITMAP:
+		i = low / BITS_PER_LONG;
+		word = c->bits[i] | ~(~0UL << (low % BITS_PER_LONG));
+
+		/* Skip over full words using the summary */
+		if (word == ~0UL) {
+			i = find_first_zero_bit(bitmap_full(c->bits),
+							BITMAP_WORDS, i + 1);
+			if (i >= BITMAP_WORDS) {
+				r = CHUNK_SIZE;
+				break;
+			}
+
+			word = c->bits[i];
+		}
+
+		r = i * BITS_PER_LONG + __ffz(word);
+		break;
+	case CONTAINER_RUN:
+		i = run_lower_bound(c->runs, c->len, low);
+
+		/* Runs are never adjacent, so the end of a run is unused */
+		if (i < c->len && c->runs[i].start <= low)
+			r = c->runs[i].last + 1;
+		else
+			r = low;
+
+		break;
+	default:
+		r = CHUNK_SIZE;
+		break;
+	}
+
+	return r <= limit ? r : CHUNK_SIZE;
+}
+
+static void container_foreach(const struct container *c, uint32_t base,
+					l_uintset_foreach_func_t function,
+					void *user_data)
+{
+	unsigned long bit;
+	uint32_t i;
+	uint32_t n;
+
+	switch (c->type) {
+	case CONTAINER_ARRAY:
+		for (i = 0; i < c->len; i++)
+			function(base + c->array[i], user_data);
+
+		break;
+	case CONTAINER_BITMAP:
+		for (bit = find_first_bit(c->bits, CHUNK_SIZE);
+				bit < CHUNK_SIZE;
+				bit = find_next_bit(c->bits, CHUNK_SIZE,
+								bit + 1))
+			function(base + bit, user_data);
+
+		break;
+	case CONTAINER_RUN:
+		for (i = 0; i < c->len; i++)
+			for (n = c->runs[i].start; n <= c->runs[i].last; n++)
+				function(base + n, user_data);
+
+		break;
+	}
+}
+
+static size_t container_data_size(const struct container *c)
+{
+	switch (c->type) {
+	case CONTAINER_ARRAY:
+		return c->alloc * sizeof(uint16_t);
+	case CONTAINER_BITMAP:
+		return BITMAP_ALLOC_WORDS * sizeof(unsigned long);
+	case CONTAINER_RUN:
+		return c->alloc * sizeof(struct run);
+	}
+
+	return 0;
+}
+
+/* Index of the first container whose key is >= @key */
+static uint32_t set_lower_bound(const struct l_uintset *set, uint32_t key)
+{
+	uint32_t lo = 0;
+	uint32_t hi = set->n_containers;
+
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+
+		if (set->containers[mid].key < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static struct container *set_find_container(const struct l_uintset *set,
+								uint16_t key)
+{
+	uint32_t i = set_lower_bound(set, key);
+
+	if (i < set->n_containers && set->containers[i].key == key)
+		return &set->containers[i];
+
+	return NULL;
+}
+
+static struct container *set_insert_container(struct l_uintset *set,
+								uint32_t i,
+								uint16_t key)
+{
+	struct container *c;
+
+	if (set->n_containers == set->alloc_containers) {
+		set->alloc_containers = set->alloc_containers ?
+					set->alloc_containers * 2 : 4;
+		set->containers = l_realloc(set->containers,
+					set->alloc_containers *
+					sizeof(struct container));
+	}
+
+	memmove(set->containers + i + 1, set->containers + i,
+			(set->n_containers - i) * sizeof(struct container));
+	set->n_containers++;
+
+	c = &set->containers[i];
+	memset(c, 0, sizeof(*c));
+	c->key = key;
+	c->type = CONTAINER_ARRAY;
+
+	return c;
+}
+
+static bool set_chunk_is_full(const struct l_uintset *set, uint32_t key)
+{
+	if (key / BITS_PER_LONG >= set->full_chunks_words)
+		return false;
+
+	return set->full_chunks[key / BITS_PER_LONG] &
+					(1UL << (key % BITS_PER_LONG));
+}
+
+static void set_update_full(struct l_uintset *set, const struct container *c)
+{
+	uint32_t word = c->key / BITS_PER_LONG;
+	unsigned long mask = 1UL << (c->key % BITS_PER_LONG);
+
+	if (c->cardinality != chunk_limit(set, c->key) + 1) {
+		if (word < set->full_chunks_words)
+			set->full_chunks[word] &= ~mask;
+
+		return;
+	}
+
+	if (word >= set->full_chunks_words) {
+		set->full_chunks = l_realloc(set->full_chunks,
+					(word + 1) * sizeof(unsigned long));
+		memset(set->full_chunks + set->full_chunks_words, 0,
+				(word + 1 - set->full_chunks_words) *
+				sizeof(unsigned long));
+		set->full_chunks_words = word + 1;
+	}
+
+	set->full_chunks[word] |= mask;
+}
+
+static void set_remove_container(struct l_uintset *set, struct container *c)
+{
+	uint32_t i = c - set->containers;
+
+	l_free(c->array);
+
+	memmove(set->containers + i, set->containers + i + 1,
+		(set->n_containers - i - 1) * sizeof(struct container));
+	set->n_containers--;
+}
+
+static void set_add(struct l_uintset *set, uint32_t offset)
+{
+	uint16_t key = offset >> CHUNK_SHIFT;
+	uint32_t i = set_lower_bound(set, key);
+	struct container *c;
+
+	if (i < set->n_containers && set->containers[i].key == key)
+		c = &set->containers[i];
+	else
+		c = set_insert_container(set, i, key);
+
+	if (!container_add(c, offset & CHUNK_MASK))
+		return;
+
+	container_optimize(c, chunk_limit(set, key) + 1);
+	set_update_full(set, c);
+}
+
+static struct container *set_append_container(struct l_uintset *set,
+								uint16_t key)
+{
+	return set_insert_container(set, set->n_containers, key);
+}
+
+static void set_append_copy(struct l_uintset *set, const struct container *src)
+{
+	struct container *c = set_append_container(set, src->key);
+
+	*c = *src;
+	c->array = l_memdup(src->array, container_data_size(src));
+
+	set_update_full(set, c);
+}
+
+/*
+ * Appends the numbers of the array container @a which are (or, if @keep is
+ * false, are not) also contained in @b.
+ */
+static void set_append_filtered(struct l_uintset *set,
+					const struct container *a,
+					const struct container *b, bool keep)
+{
+	struct container *c = set_append_container(set, a->key);
+	uint32_t i;
+
+	c->array = l_new(uint16_t, a->len);
+	c->alloc = a->len;
+
+	for (i = 0; i < a->len; i++)
+		if (container_contains(b, a->array[i]) == keep)
+			c->array[c->len++] = a->array[i];
+
+	c->cardinality = c->len;
+
+	if (!c->cardinality)
+		set_remove_container(set, c);
+	else
+		set_update_full(set, c);
+}
+
+/*
+ * Appends the intersection of the run containers @a and @b.  Both lists of
+ * runs are sorted, so they are merged like two sorted arrays.  Runs in the
+ * inputs are never adjacent, and neither are the overlaps produced here.
+ */
+static void set_append_run_intersection(struct l_uintset *set,
+					const struct container *a,
+					const struct container *b)
+{
+	struct container *c = set_append_container(set, a->key);
+	uint32_t i = 0;
+	uint32_t j = 0;
+
+	c->type = CONTAINER_RUN;
+	c->runs = l_new(struct run, a->len + b->len);
+	c->alloc = a->len + b->len;
+
+	while (i < a->len && j < b->len) {
+		const struct run *ra = &a->runs[i];
+		const struct run *rb = &b->runs[j];
+		uint16_t start = ra->start > rb->start ? ra->start : rb->start;
+		uint16_t last = ra->last < rb->last ? ra->last : rb->last;
+
+		if (start <= last) {
+			c->runs[c->len].start = start;
+			c->runs[c->len].last = last;
+			c->len++;
+			c->cardinality += last - start + 1;
+		}
+
+		/* The run that ends first can't overlap anything else */
+		if (ra->last < rb->last)
+			i++;
+		else
+			j++;
+	}
+
+	if (!c->cardinality) {
+		set_remove_container(set, c);
+		return;
+	}
+
+	container_optimize(c, chunk_limit(set, c->key) + 1);
+	set_update_full(set, c);
+}
+
+/*
+ * Combines two bitmaps word by word.  The loops are kept trivial so that
+ * the compiler can vectorize them.
+ */
+static void set_append_bitmap_op(struct l_uintset *set, uint16_t key,
+					const unsigned long *a,
+					const unsigned long *b,
+					enum set_op op)
+{
+	unsigned long *bits = bitmap_new();
+	uint32_t cardinality = 0;
+	struct container *c;
+	unsigned int i;
+
+	switch (op) {
+	case SET_OP_AND:
+		for (i = 0; i < BITMAP_WORDS; i++)
+			bits[i] = a[i] & b[i];
+		break;
+	case SET_OP_OR:
+		for (i = 0; i < BITMAP_WORDS; i++)
+			bits[i] = a[i] | b[i];
+		break;
+	case SET_OP_AND_NOT:
+		for (i = 0; i < BITMAP_WORDS; i++)
+			bits[i] = a[i] & ~b[i];
+		break;
+	}
+
+	for (i = 0; i < BITMAP_WORDS; i++)
+		cardinality += __builtin_popcountl(bits[i]);
+
+	if (!cardinality) {
+		l_free(bits);
+		return;
+	}
+
+	bitmap_rebuild_summary(bits);
+
+	c = set_append_container(set, key);
+	c->type = CONTAINER_BITMAP;
+	c->bits = bits;
+	c->cardinality = cardinality;
+
+	container_compact(c, chunk_limit(set, key) + 1);
+	set_update_full(set, c);
+}
+
+static void set_clear(struct l_uintset *set)
+{
+	uint32_t i;
+
+	for (i = 0; i < set->n_containers; i++)
+		l_free(set->containers[i].array);
+
+	l_free(set->containers);
+	set->containers = NULL;
+	set->n_containers = 0;
+	set->alloc_containers = 0;
+
+	l_free(set->full_chunks);
+	set->full_chunks = NULL;
+	set->full_chunks_words = 0;
+}
+
+/*
+ * Returns the first unused offset >= @offset, or UINT64_MAX if all numbers
+ * from @offset to the end of the set are in use.  Full chunks are skipped
+ * using the set summary, so at most a few chunks are ever looked at.
+ */
+static uint64_t set_find_unused_from(const struct l_uintset *set,
+							uint32_t offset)
+{
+	uint32_t last_key = set_range(set) >> CHUNK_SHIFT;
+	uint32_t key = offset >> CHUNK_SHIFT;
+	uint32_t low = offset & CHUNK_MASK;
+
+	while (key <= last_key) {
+		const struct container *c;
+		uint32_t i;
+		uint32_t r;
+
+		if (set_chunk_is_full(set, key)) {
+			uint64_t nbits = (uint64_t) set->full_chunks_words *
+								BITS_PER_LONG;
+
+			key = find_first_zero_bit(set->full_chunks, nbits, key);
+			if (key > last_key)
+				break;
+
+			low = 0;
+		}
+
+		i = set_lower_bound(set, key);
+		if (i >= set->n_containers || set->containers[i].key != key)
+			return ((uint64_t) key << CHUNK_SHIFT) | low;
+
+		c = &set->containers[i];
+
+		r = container_next_unused(c, low, chunk_limit(set, key));
+		if (r < CHUNK_SIZE)
+			return ((uint64_t) key << CHUNK_SHIFT) | r;
+
+		key++;
+		low = 0;
+	}
+
+	return UINT64_MAX;
+}
+
 /**
  * l_uintset_new_from_range:
  * @min: The minimum value of the set of numbers contained in the set
  * @max: The maximum value of the set of numbers contained
  *
- * Creates a new empty collection of unsigned integers.  The size of the set
- * is limited to roughly 2^16 entries.  @min and @max give the minimum and
- * maximum elements of the set.
+ * Creates a new empty collection of unsigned integers.  @min and @max give
+ * the minimum and maximum elements of the set.  @max can be at most
+ * UINT32_MAX - 1, so that l_uintset_get_max(set) + 1, which the lookup
+ * functions return when nothing is found, never wraps around to a valid
+ * element.  Memory is only used for the parts of the range that are
+ * populated.
  *
  * Returns: A newly allocated l_uintset object, and NULL otherwise.
  **/
@@ -187,15 +1190,11 @@ LIB_EXPORT struct l_uintset *l_uintset_new_from_range(uint32_t min,
 								uint32_t max)
 {
 	struct l_uintset *ret;
-	unsigned int size = max - min + 1;
 
-	if (size > USHRT_MAX)
+	if (unlikely(max < min || max == UINT32_MAX))
 		return NULL;
 
 	ret = l_new(struct l_uintset, 1);
-	ret->bits = l_new(unsigned long,
-				(size + BITS_PER_LONG - 1) / BITS_PER_LONG);
-	ret->size = size;
 	ret->min = min;
 	ret->max = max;
 
@@ -206,9 +1205,8 @@ LIB_EXPORT struct l_uintset *l_uintset_new_from_range(uint32_t min,
  * l_uintset_new:
  * @size: The maximum size of the set
  *
- * Creates a new empty collection of unsigned integers.  The size of the set
- * is limited to roughly 2^16 entries.  The set is created with minimum value
- * of 1 and maximum value equal to size.
+ * Creates a new empty collection of unsigned integers.  The set is created
+ * with minimum value of 1 and maximum value equal to size.
  *
  * Returns: A newly allocated l_uintset object, and NULL otherwise.
  **/
@@ -228,7 +1226,7 @@ LIB_EXPORT void l_uintset_free(struct l_uintset *set)
 	if (unlikely(!set))
 		return;
 
-	l_free(set->bits);
+	set_clear(set);
 	l_free(set);
 }
 
@@ -245,21 +1243,29 @@ LIB_EXPORT void l_uintset_free(struct l_uintset *set)
  **/
 LIB_EXPORT bool l_uintset_take(struct l_uintset *set, uint32_t number)
 {
+	struct container *c;
 	uint32_t offset;
+	uint16_t key;
 
 	if (unlikely(!set))
 		return false;
 
-	offset = (number - set->min) / BITS_PER_LONG;
+	offset = number - set->min;
+	if (offset > set_range(set))
+		return false;
 
-	number -= set->min;
+	key = offset >> CHUNK_SHIFT;
 
-	if (number > set->size)
-		return false;
+	c = set_find_container(set, key);
+	if (!c || !container_remove(c, offset & CHUNK_MASK))
+		return true;
 
-	number %= BITS_PER_LONG;
+	set_update_full(set, c);
 
-	set->bits[offset] &= ~(1UL << number);
+	if (!c->cardinality)
+		set_remove_container(set, c);
+	else
+		container_optimize(c, chunk_limit(set, key) + 1);
 
 	return true;
 }
@@ -278,18 +1284,16 @@ LIB_EXPORT bool l_uintset_take(struct l_uintset *set, uint32_t number)
  **/
 LIB_EXPORT bool l_uintset_put(struct l_uintset *set, uint32_t number)
 {
-	uint32_t bit;
 	uint32_t offset;
 
 	if (unlikely(!set))
 		return false;
 
-	bit = number - set->min;
-	if (bit >= set->size)
+	offset = number - set->min;
+	if (offset > set_range(set))
 		return false;
 
-	offset = bit / BITS_PER_LONG;
-	set->bits[offset] |= 1UL << (bit % BITS_PER_LONG);
+	set_add(set, offset);
 
 	return true;
 }
@@ -303,21 +1307,21 @@ LIB_EXPORT bool l_uintset_put(struct l_uintset *set, uint32_t number)
  **/
 LIB_EXPORT bool l_uintset_contains(struct l_uintset *set, uint32_t number)
 {
-	uint32_t bit;
+	struct container *c;
 	uint32_t offset;
 
 	if (unlikely(!set))
 		return false;
 
-	bit = number - set->min;
-	if (bit >= set->size)
+	offset = number - set->min;
+	if (offset > set_range(set))
 		return false;
 
-	offset = bit / BITS_PER_LONG;
-	if (set->bits[offset] & (1UL << (bit % BITS_PER_LONG)))
-		return true;
+	c = set_find_container(set, offset >> CHUNK_SHIFT);
+	if (!c)
+		return false;
 
-	return false;
+	return container_contains(c, offset & CHUNK_MASK);
 }
 
 /**
@@ -360,17 +1364,16 @@ LIB_EXPORT uint32_t l_uintset_get_max(struct l_uintset *set)
  **/
 LIB_EXPORT uint32_t l_uintset_find_unused_min(struct l_uintset *set)
 {
-	unsigned int bit;
+	uint64_t offset;
 
 	if (unlikely(!set))
 		return UINT_MAX;
 
-	bit = find_first_zero_bit(set->bits, set->size, 0);
-
-	if (bit >= set->size)
+	offset = set_find_unused_from(set, 0);
+	if (offset == UINT64_MAX)
 		return set->max + 1;
 
-	return bit + set->min;
+	return offset + set->min;
 }
 
 /**
@@ -386,7 +1389,7 @@ LIB_EXPORT uint32_t l_uintset_find_unused_min(struct l_uintset *set)
  **/
 LIB_EXPORT uint32_t l_uintset_find_unused(struct l_uintset *set, uint32_t start)
 {
-	unsigned int bit;
+	uint64_t offset;
 
 	if (unlikely(!set))
 		return UINT_MAX;
@@ -394,14 +1397,14 @@ LIB_EXPORT uint32_t l_uintset_find_unused(struct l_uintset *set, uint32_t start)
 	if (start < set->min || start > set->max)
 		return set->max + 1;
 
-	bit = find_first_zero_bit(set->bits, set->size, start - set->min);
-	if (bit >= set->size)
-		bit = find_first_zero_bit(set->bits, set->size, 0);
+	offset = set_find_unused_from(set, start - set->min);
+	if (offset == UINT64_MAX)
+		offset = set_find_unused_from(set, 0);
 
-	if (bit >= set->size)
+	if (offset == UINT64_MAX)
 		return set->max + 1;
 
-	return bit + set->min;
+	return offset + set->min;
 }
 
 /**
@@ -413,17 +1416,18 @@ LIB_EXPORT uint32_t l_uintset_find_unused(struct l_uintset *set, uint32_t start)
  **/
 LIB_EXPORT uint32_t l_uintset_find_max(struct l_uintset *set)
 {
-	unsigned int bit;
+	const struct container *c;
 
 	if (unlikely(!set))
 		return UINT_MAX;
 
-	bit = find_last_bit(set->bits, set->size);
-
-	if (bit >= set->size)
+	if (!set->n_containers)
 		return set->max + 1;
 
-	return bit + set->min;
+	c = &set->containers[set->n_containers - 1];
+
+	return set->min + ((uint32_t) c->key << CHUNK_SHIFT) +
+							container_last(c);
 }
 
 /**
@@ -435,17 +1439,18 @@ LIB_EXPORT uint32_t l_uintset_find_max(struct l_uintset *set)
  **/
 LIB_EXPORT uint32_t l_uintset_find_min(struct l_uintset *set)
 {
-	unsigned int bit;
+	const struct container *c;
 
 	if (unlikely(!set))
 		return UINT_MAX;
 
-	bit = find_first_bit(set->bits, set->size);
-
-	if (bit >= set->size)
+	if (!set->n_containers)
 		return set->max + 1;
 
-	return bit + set->min;
+	c = &set->containers[0];
+
+	return set->min + ((uint32_t) c->key << CHUNK_SHIFT) +
+							container_first(c);
 }
 
 /**
@@ -460,14 +1465,128 @@ LIB_EXPORT void l_uintset_foreach(struct l_uintset *set,
 					l_uintset_foreach_func_t function,
 					void *user_data)
 {
-	unsigned int bit;
+	uint32_t i;
 
 	if (unlikely(!set || !function))
 		return;
 
-	for (bit = find_first_bit(set->bits, set->size); bit < set->size;
-			bit = find_next_bit(set->bits, set->size, bit + 1))
-		function(set->min + bit, user_data);
+	for (i = 0; i < set->n_containers; i++) {
+		const struct container *c = &set->containers[i];
+
+		container_foreach(c, set->min +
+					((uint32_t) c->key << CHUNK_SHIFT),
+					function, user_data);
+	}
+}
+
+/**
+ * l_uintset_get_memory_usage:
+ * @set: The set of numbers
+ *
+ * Reports the amount of heap memory currently used by @set, including the
+ * set object itself and the storage of all populated chunks.
+ *
+ * Returns: The number of bytes used by @set, or 0 if @set is NULL.
+ **/
+LIB_EXPORT size_t l_uintset_get_memory_usage(const struct l_uintset *set)
+{
+	size_t size;
+	uint32_t i;
+
+	if (unlikely(!set))
+		return 0;
+
+	size = sizeof(struct l_uintset) +
+		set->alloc_containers * sizeof(struct container) +
+		set->full_chunks_words * sizeof(unsigned long);
+
+	for (i = 0; i < set->n_containers; i++)
+		size += container_data_size(&set->containers[i]);
+
+	return size;
+}
+
+static void container_intersect(struct l_uintset *set,
+					const struct container *a,
+					const struct container *b,
+					unsigned long *scratch)
+{
+	/* Probe the other container for each number of an array */
+	if (b->type == CONTAINER_ARRAY) {
+		const struct container *tmp = a;
+
+		a = b;
+		b = tmp;
+	}
+
+	if (a->type == CONTAINER_ARRAY) {
+		set_append_filtered(set, a, b, true);
+		return;
+	}
+
+	if (a->type == CONTAINER_RUN && b->type == CONTAINER_RUN) {
+		set_append_run_intersection(set, a, b);
+		return;
+	}
+
+	/* Runs are expanded into a mask for the bitmap */
+	set_append_bitmap_op(set, a->key, container_bits(a, scratch),
+					container_bits(b, scratch), SET_OP_AND);
+}
+
+static void container_union(struct l_uintset *set,
+					const struct container *a,
+					const struct container *b,
+					unsigned long *scratch_a,
+					unsigned long *scratch_b)
+{
+	struct container *c;
+	uint32_t i = 0;
+	uint32_t j = 0;
+
+	if (a->type != CONTAINER_ARRAY || b->type != CONTAINER_ARRAY ||
+					a->len + b->len > ARRAY_MAX) {
+		set_append_bitmap_op(set, a->key,
+					container_bits(a, scratch_a),
+					container_bits(b, scratch_b),
+					SET_OP_OR);
+		return;
+	}
+
+	/* Small arrays are merged directly */
+	c = set_append_container(set, a->key);
+	c->array = l_new(uint16_t, a->len + b->len);
+	c->alloc = a->len + b->len;
+
+	while (i < a->len || j < b->len) {
+		if (j >= b->len || (i < a->len && a->array[i] < b->array[j]))
+			c->array[c->len++] = a->array[i++];
+		else if (i >= a->len || a->array[i] > b->array[j])
+			c->array[c->len++] = b->array[j++];
+		else {
+			c->array[c->len++] = a->array[i++];
+			j++;
+		}
+	}
+
+	c->cardinality = c->len;
+	set_update_full(set, c);
+}
+
+static void container_difference(struct l_uintset *set,
+					const struct container *a,
+					const struct container *b,
+					unsigned long *scratch_a,
+					unsigned long *scratch_b)
+{
+	if (a->type == CONTAINER_ARRAY) {
+		set_append_filtered(set, a, b, false);
+		return;
+	}
+
+	set_append_bitmap_op(set, a->key, container_bits(a, scratch_a),
+					container_bits(b, scratch_b),
+					SET_OP_AND_NOT);
 }
 
 /**
@@ -487,8 +1606,9 @@ LIB_EXPORT struct l_uintset *l_uintset_intersect(const struct l_uintset *set_a,
 						const struct l_uintset *set_b)
 {
 	struct l_uintset *intersection;
-	uint32_t offset;
-	uint32_t offset_max;
+	unsigned long *scratch = NULL;
+	uint32_t i = 0;
+	uint32_t j = 0;
 
 	if (unlikely(!set_a || !set_b))
 		return NULL;
@@ -498,11 +1618,182 @@ LIB_EXPORT struct l_uintset *l_uintset_intersect(const struct l_uintset *set_a,
 
 	intersection = l_uintset_new_from_range(set_a->min, set_a->max);
 
-	offset_max = (set_a->size + BITS_PER_LONG - 1) / BITS_PER_LONG;
+	while (i < set_a->n_containers && j < set_b->n_containers) {
+		const struct container *a = &set_a->containers[i];
+		const struct container *b = &set_b->containers[j];
+
+		if (a->key < b->key)
+			i++;
+		else if (a->key > b->key)
+			j++;
+		else {
+			if (!scratch)
+				scratch = l_new(unsigned long, BITMAP_WORDS);
+
+			container_intersect(intersection, a, b, scratch);
+			i++;
+			j++;
+		}
+	}
 
-	for (offset = 0; offset < offset_max; offset++)
-		intersection->bits[offset] =
-				set_a->bits[offset] & set_b->bits[offset];
+	l_free(scratch);
 
 	return intersection;
 }
+
+/**
+ * l_uintset_union:
+ * @set_a: The set of numbers
+ * @set_b: The set of numbers
+ *
+ * Computes the union of two sets of numbers of an equal base, see
+ * l_uintset_intersect() for the requirements on @set_a and @set_b.
+ *
+ * Returns: A newly allocated l_uintset object containing all numbers which
+ * are in @set_a or @set_b. If the bases are not equal returns NULL. If
+ * either @set_a or @set_b is NULL returns NULL.
+ **/
+LIB_EXPORT struct l_uintset *l_uintset_union(const struct l_uintset *set_a,
+						const struct l_uintset *set_b)
+{
+	struct l_uintset *result;
+	unsigned long *scratch = NULL;
+	uint32_t i = 0;
+	uint32_t j = 0;
+
+	if (unlikely(!set_a || !set_b))
+		return NULL;
+
+	if (unlikely(set_a->min != set_b->min || set_a->max != set_b->max))
+		return NULL;
+
+	result = l_uintset_new_from_range(set_a->min, set_a->max);
+
+	while (i < set_a->n_containers && j < set_b->n_containers) {
+		const struct container *a = &set_a->containers[i];
+		const struct container *b = &set_b->containers[j];
+
+		if (a->key < b->key) {
+			set_append_copy(result, a);
+			i++;
+		} else if (a->key > b->key) {
+			set_append_copy(result, b);
+			j++;
+		} else {
+			if (!scratch)
+				scratch = l_new(unsigned long,
+							2 * BITMAP_WORDS);
+
+			container_union(result, a, b, scratch,
+						scratch + BITMAP_WORDS);
+			i++;
+			j++;
+		}
+	}
+
+	for (; i < set_a->n_containers; i++)
+		set_append_copy(result, &set_a->containers[i]);
+
+	for (; j < set_b->n_containers; j++)
+		set_append_copy(result, &set_b->containers[j]);
+
+	l_free(scratch);
+
+	return result;
+}
+
+/**
+ * l_uintset_difference:
+ * @set_a: The set of numbers
+ * @set_b: The set of numbers to remove from @set_a
+ *
+ * Computes the difference of two sets of numbers of an equal base, see
+ * l_uintset_intersect() for the requirements on @set_a and @set_b.
+ *
+ * Returns: A newly allocated l_uintset object containing all numbers which
+ * are in @set_a but not in @set_b. If the bases are not equal returns NULL.
+ * If either @set_a or @set_b is NULL returns NULL.
+ **/
+LIB_EXPORT struct l_uintset *l_uintset_difference(
+						const struct l_uintset *set_a,
+						const struct l_uintset *set_b)
+{
+	struct l_uintset *result;
+	unsigned long *scratch = NULL;
+	uint32_t i;
+	uint32_t j = 0;
+
+	if (unlikely(!set_a || !set_b))
+		return NULL;
+
+	if (unlikely(set_a->min != set_b->min || set_a->max != set_b->max))
+		return NULL;
+
+	result = l_uintset_new_from_range(set_a->min, set_a->max);
+
+	for (i = 0; i < set_a->n_containers; i++) {
+		const struct container *a = &set_a->containers[i];
+
+		while (j < set_b->n_containers &&
+					set_b->containers[j].key < a->key)
+			j++;
+
+		if (j >= set_b->n_containers ||
+					set_b->containers[j].key != a->key) {
+			set_append_copy(result, a);
+			continue;
+		}
+
+		if (!scratch)
+			scratch = l_new(unsigned long, 2 * BITMAP_WORDS);
+
+		container_difference(result, a, &set_b->containers[j],
+					scratch, scratch + BITMAP_WORDS);
+	}
+
+	l_free(scratch);
+
+	return result;
+}
+
+/**
+ * l_uintset_clone:
+ * @set: The set of numbers
+ *
+ * Returns: A newly allocated copy of @set, or NULL if @set is NULL.
+ **/
+LIB_EXPORT struct l_uintset *l_uintset_clone(const struct l_uintset *set)
+{
+	struct l_uintset *clone;
+	uint32_t i;
+
+	if (unlikely(!set))
+		return NULL;
+
+	clone = l_uintset_new_from_range(set->min, set->max);
+
+	for (i = 0; i < set->n_containers; i++)
+		set_append_copy(clone, &set->containers[i]);
+
+	return clone;
+}
+
+/**
+ * l_uintset_size:
+ * @set: The set of numbers
+ *
+ * Returns: The number of numbers contained in @set, or 0 if @set is NULL.
+ **/
+LIB_EXPORT uint64_t l_uintset_size(const struct l_uintset *set)
+{
+	uint64_t size = 0;
+	uint32_t i;
+
+	if (unlikely(!set))
+		return 0;
+
+	for (i = 0; i < set->n_containers; i++)
+		size += set->containers[i].cardinality;
+
+	return size;
+}
@@ -55,8 +55,16 @@ uint32_t l_uintset_find_unused(struct l_uintset *set, uint32_t start);
 void l_uintset_foreach(struct l_uintset *set,
 			l_uintset_foreach_func_t function, void *user_data);
 
+size_t l_uintset_get_memory_usage(const struct l_uintset *set);
+
 struct l_uintset *l_uintset_intersect(const struct l_uintset *set_a,
 						const struct l_uintset *set_b);
+struct l_uintset *l_uintset_union(const struct l_uintset *set_a,
+						const struct l_uintset *set_b);
+struct l_uintset *l_uintset_difference(const struct l_uintset *set_a,
+						const struct l_uintset *set_b);
+struct l_uintset *l_uintset_clone(const struct l_uintset *set);
+uint64_t l_uintset_size(const struct l_uintset *set);
 
 #ifdef __cplusplus
 }
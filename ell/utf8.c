@@ -27,6 +27,10 @@
 #include <stdio.h>
 #include <wchar.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "util.h"
 #include "strv.h"
 #include "utf8.h"
@@ -98,7 +102,7 @@ LIB_EXPORT int l_utf8_get_codepoint(const char *str, size_t len, wchar_t *cp)
 		return 1;
 	}
 
-	expect_bytes = __builtin_clz(~(str[0] << 24));
+	expect_bytes = __builtin_clz(~((unsigned int) (uint8_t) str[0] << 24));
 
 	if (expect_bytes < 2 || expect_bytes > 4)
 		goto error;
@@ -129,6 +133,43 @@ error:
 	return -1;
 }
 
+/*
+ * Returns the length of the run of non-NUL ASCII characters at the start
+ * of @str, which is the common case for text on the bus and in settings.
+ */
+static size_t ascii_prefix(const char *str, size_t len)
+{
+	size_t i = 0;
+
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128();
+
+	for (; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (str + i));
+		unsigned int mask = _mm_movemask_epi8(_mm_cmpgt_epi8(v, zero));
+
+		if (mask != 0xffff)
+			return i + __builtin_ctz(~mask);
+	}
+#else
+	for (; i + 8 <= len; i += 8) {
+		uint64_t w;
+
+		memcpy(&w, str + i, sizeof(w));
+
+		/* Any byte with the top bit set or any zero byte */
+		if ((w | ((w - 0x0101010101010101ULL) & ~w)) &
+						0x8080808080808080ULL)
+			break;
+	}
+#endif
+
+	while (i < len && (signed char) str[i] > 0)
+		i++;
+
+	return i;
+}
+
 /**
  * l_utf8_validate:
  * @str: a pointer to character data
@@ -148,7 +189,12 @@ LIB_EXPORT bool l_utf8_validate(const char *str, size_t len, const char **end)
 	int ret;
 	wchar_t val;
 
-	while (pos < len && str[pos]) {
+	while (pos < len) {
+		pos += ascii_prefix(str + pos, len - pos);
+
+		if (pos == len || !str[pos])
+			break;
+
 		ret = l_utf8_get_codepoint(str + pos, len - pos, &val);
 
 		if (ret < 0)
@@ -207,7 +253,7 @@ static inline int __attribute__ ((always_inline))
 	return 4;
 }
 
-static inline uint16_t __attribute__ ((always_inline))
+static inline wchar_t __attribute__ ((always_inline))
 			surrogate_value(uint16_t h, uint16_t l)
 {
 	return 0x10000 + (h - 0xd800) * 0x400 + l - 0xdc00;
@@ -254,75 +300,66 @@ LIB_EXPORT char *l_utf8_from_utf16(const void *utf16, ssize_t utf16_size)
 {
 	char *utf8;
 	size_t utf8_len = 0;
-	wchar_t high_surrogate = 0;
-	ssize_t i = 0;
+	size_t n_utf16;
+	size_t i;
 	uint16_t in;
 	wchar_t c;
 
 	if (unlikely(utf16_size % 2))
 		return NULL;
 
-	while (utf16_size < 0 || i < utf16_size) {
-		in = l_get_u16(utf16 + i);
+	if (utf16_size < 0) {
+		n_utf16 = 0;
 
-		if (!in)
-			break;
+		while (l_get_u16(utf16 + n_utf16 * 2))
+			n_utf16++;
+	} else
+		n_utf16 = utf16_size / 2;
 
-		if (in >= 0xdc00 && in < 0xe000) {
-			if (high_surrogate)
-				c = surrogate_value(high_surrogate, in);
-			else
-				return NULL;
+	/* A code unit never takes more than three bytes in UTF-8 */
+	utf8 = l_malloc(n_utf16 * 3 + 1);
 
-			high_surrogate = 0;
-		} else {
-			if (high_surrogate)
-				return NULL;
+	for (i = 0; i < n_utf16; i++) {
+		in = l_get_u16(utf16 + i * 2);
 
-			if (in >= 0xd800 && in < 0xdc00) {
-				high_surrogate = in;
-				goto next;
-			}
+		if (!in)
+			break;
 
-			c = in;
+		if (in < 0x80) {
+			utf8[utf8_len++] = in;
+			continue;
 		}
 
-		if (!valid_unicode(c))
-			return NULL;
-
-		utf8_len += utf8_length(c);
-next:
-		i += 2;
-	}
-
-	if (high_surrogate)
-		return NULL;
+		if (in >= 0xdc00 && in < 0xe000)
+			goto error;
 
-	utf8 = l_malloc(utf8_len + 1);
-	utf8_len = 0;
-	i = 0;
+		if (in >= 0xd800 && in < 0xdc00) {
+			uint16_t low;
 
-	while (utf16_size < 0 || i < utf16_size) {
-		in = l_get_u16(utf16 + i);
+			if (++i == n_utf16)
+				goto error;
 
-		if (!in)
-			break;
+			low = l_get_u16(utf16 + i * 2);
+			if (low < 0xdc00 || low >= 0xe000)
+				goto error;
 
-		if (in >= 0xd800 && in < 0xdc00) {
-			high_surrogate = in;
-			i += 2;
-			in = l_get_u16(utf16 + i);
-			c = surrogate_value(high_surrogate, in);
+			c = surrogate_value(in, low);
 		} else
 			c = in;
 
+		if (!valid_unicode(c))
+			goto error;
+
 		utf8_len += l_utf8_from_wchar(c, utf8 + utf8_len);
-		i += 2;
 	}
 
 	utf8[utf8_len] = '\0';
 
-	return utf8;
+	return l_realloc(utf8, utf8_len + 1);
+
+error:
+	l_free(utf8);
+	return NULL;
 }
 
 /**
@@ -330,15 +367,16 @@ next:
  * @utf8: UTF8 formatted string
  * @out_size: The size in bytes of the converted utf16 string
  *
- * Converts a UTF8 formatted string to UTF16.  It is assumed that the string
- * is valid UTF8 and no sanity checking is performed.
+ * Converts a UTF8 formatted string to UTF16.
  *
  * Returns: A newly-allocated buffer containing UTF8 encoded string converted
- * to UTF16.  The UTF16 string will always be null terminated.
+ * to UTF16 or NULL if @utf8 is not valid UTF8.  The UTF16 string will always
+ * be null terminated.
  **/
 LIB_EXPORT void *l_utf8_to_utf16(const char *utf8, size_t *out_size)
 {
 	const char *c;
+	const char *end;
 	wchar_t wc;
 	int len;
 	uint16_t *utf16;
@@ -347,36 +385,30 @@ LIB_EXPORT void *l_utf8_to_utf16(const char *utf8, size_t *out_size)
 	if (unlikely(!utf8))
 		return NULL;
 
-	c = utf8;
-	n_utf16 = 0;
-
-	while (*c) {
-		len = l_utf8_get_codepoint(c, 4, &wc);
-		if (len < 0)
-			return NULL;
-
-		if (wc < 0x10000)
-			n_utf16 += 1;
-		else
-			n_utf16 += 2;
-
-		c += len;
-	}
+	end = utf8 + strlen(utf8);
 
-	utf16 = l_malloc((n_utf16 + 1) * 2);
-	c = utf8;
+	/* No character takes more UTF16 code units than UTF8 bytes */
+	utf16 = l_malloc((end - utf8 + 1) * 2);
 	n_utf16 = 0;
 
-	while (*c) {
-		len = l_utf8_get_codepoint(c, 4, &wc);
+	for (c = utf8; c < end; c += len) {
+		if ((signed char) *c > 0) {
+			utf16[n_utf16++] = *c;
+			len = 1;
+			continue;
+		}
+
+		len = l_utf8_get_codepoint(c, end - c, &wc);
+		if (len < 0) {
+			l_free(utf16);
+			return NULL;
+		}
 
 		if (wc >= 0x10000) {
-			utf16[n_utf16++] = (wc - 0x1000) / 0x400 + 0xd800;
-			utf16[n_utf16++] = (wc - 0x1000) % 0x400 + 0xdc00;
+			utf16[n_utf16++] = (wc - 0x10000) / 0x400 + 0xd800;
+			utf16[n_utf16++] = (wc - 0x10000) % 0x400 + 0xdc00;
 		} else
 			utf16[n_utf16++] = wc;
-
-		c += len;
 	}
 
 	utf16[n_utf16] = 0;
@@ -384,7 +416,7 @@ LIB_EXPORT void *l_utf8_to_utf16(const char *utf8, size_t *out_size)
 	if (out_size)
 		*out_size = (n_utf16 + 1) * 2;
 
-	return utf16;
+	return l_realloc(utf16, (n_utf16 + 1) * 2);
 }
 
 /**
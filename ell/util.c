@@ -31,6 +31,10 @@
 #include <stdlib.h>
 #include <limits.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "util.h"
 #include "private.h"
 
@@ -43,6 +47,319 @@
 
 #define STRLOC __FILE__ ":" L_STRINGIFY(__LINE__)
 
+#ifdef MALLOC_STATS
+#include <dlfcn.h>
+#include <sched.h>
+
+/*
+ * Allocation accounting.  Every allocation is attributed to the code that
+ * called into the allocator, identified by its return address, and live
+ * allocations are tracked in an open addressing table keyed by pointer so
+ * that frees can be attributed to the same call site.  The bookkeeping
+ * uses libc directly to avoid recursing into the accounting.
+ */
+#define MALLOC_CALLER __builtin_return_address(0)
+#define MALLOC_SITES 1024
+
+struct malloc_site {
+	const void *caller;
+	size_t live_bytes;
+	size_t peak_bytes;
+	size_t live_allocations;
+	uint64_t total_allocations;
+};
+
+struct malloc_entry {
+	const void *ptr;
+	size_t size;
+	unsigned int site;
+};
+
+/* Site 0 collects the allocations of all call sites that did not fit */
+static struct malloc_site malloc_sites[MALLOC_SITES];
+static struct malloc_entry *malloc_entries;
+static size_t malloc_entries_size;
+static size_t malloc_entries_used;
+static struct l_malloc_stats malloc_totals;
+static bool malloc_lock;
+
+static void malloc_stats_lock(void)
+{
+	while (__atomic_test_and_set(&malloc_lock, __ATOMIC_ACQUIRE))
+		sched_yield();
+}
+
+static void malloc_stats_unlock(void)
+{
+	__atomic_clear(&malloc_lock, __ATOMIC_RELEASE);
+}
+
+static size_t malloc_hash(const void *ptr)
+{
+	return ((uintptr_t) ptr >> 4) * 0x9e3779b97f4a7c15ULL;
+}
+
+static unsigned int malloc_site_lookup(const void *caller)
+{
+	size_t pos = malloc_hash(caller) & (MALLOC_SITES - 1);
+	unsigned int i;
+
+	for (i = 0; i < MALLOC_SITES; i++, pos = (pos + 1) & (MALLOC_SITES - 1)) {
+		if (!pos)
+			continue;
+
+		if (malloc_sites[pos].caller == caller)
+			return pos;
+
+		if (!malloc_sites[pos].caller) {
+			malloc_sites[pos].caller = caller;
+			return pos;
+		}
+	}
+
+	return 0;
+}
+
+static struct malloc_entry *malloc_entry_find(const void *ptr)
+{
+	size_t mask = malloc_entries_size - 1;
+	size_t pos;
+
+	if (!malloc_entries)
+		return NULL;
+
+	for (pos = malloc_hash(ptr) & mask; malloc_entries[pos].ptr;
+						pos = (pos + 1) & mask)
+		if (malloc_entries[pos].ptr == ptr)
+			return &malloc_entries[pos];
+
+	return NULL;
+}
+
+static void malloc_entry_insert(const void *ptr, size_t size,
+							unsigned int site)
+{
+	size_t mask;
+	size_t pos;
+
+	if ((malloc_entries_used + 1) * 2 > malloc_entries_size) {
+		struct malloc_entry *old = malloc_entries;
+		size_t old_size = malloc_entries_size;
+		size_t i;
+
+		malloc_entries_size = old_size ? old_size * 2 : 1024;
+		malloc_entries = calloc(malloc_entries_size,
+						sizeof(struct malloc_entry));
+		if (!malloc_entries) {
+			fprintf(stderr, "%s:%s(): failed to allocate\n",
+							STRLOC, __func__);
+			abort();
+		}
+
+		malloc_entries_used = 0;
+
+		for (i = 0; i < old_size; i++)
+			if (old[i].ptr)
+				malloc_entry_insert(old[i].ptr, old[i].size,
+							old[i].site);
+
+		free(old);
+	}
+
+	mask = malloc_entries_size - 1;
+
+	for (pos = malloc_hash(ptr) & mask; malloc_entries[pos].ptr;
+						pos = (pos + 1) & mask)
+		;
+
+	malloc_entries[pos].ptr = ptr;
+	malloc_entries[pos].size = size;
+	malloc_entries[pos].site = site;
+	malloc_entries_used++;
+}
+
+static void malloc_entry_remove(struct malloc_entry *entry)
+{
+	size_t mask = malloc_entries_size - 1;
+	size_t hole = entry - malloc_entries;
+	size_t pos = hole;
+
+	/* Backward shift deletion keeps the probe sequences intact */
+	while (true) {
+		size_t home;
+
+		pos = (pos + 1) & mask;
+
+		if (!malloc_entries[pos].ptr)
+			break;
+
+		home = malloc_hash(malloc_entries[pos].ptr) & mask;
+
+		if (((pos - home) & mask) >= ((pos - hole) & mask)) {
+			malloc_entries[hole] = malloc_entries[pos];
+			hole = pos;
+		}
+	}
+
+	malloc_entries[hole].ptr = NULL;
+	malloc_entries_used--;
+}
+
+static void malloc_site_account(struct malloc_site *site, size_t size,
+								bool add)
+{
+	if (!add) {
+		site->live_bytes -= size;
+		site->live_allocations--;
+		return;
+	}
+
+	site->live_bytes += size;
+	site->live_allocations++;
+	site->total_allocations++;
+
+	if (site->live_bytes > site->peak_bytes)
+		site->peak_bytes = site->live_bytes;
+}
+
+static void malloc_account(unsigned int site, size_t size, bool add)
+{
+	malloc_site_account(&malloc_sites[site], size, add);
+
+	if (!add) {
+		malloc_totals.live_bytes -= size;
+		malloc_totals.live_allocations--;
+		return;
+	}
+
+	malloc_totals.live_bytes += size;
+	malloc_totals.live_allocations++;
+	malloc_totals.total_allocations++;
+
+	if (malloc_totals.live_bytes > malloc_totals.peak_bytes)
+		malloc_totals.peak_bytes = malloc_totals.live_bytes;
+}
+
+static bool malloc_forget(const void *ptr, unsigned int *site)
+{
+	struct malloc_entry *entry = malloc_entry_find(ptr);
+
+	if (!entry)
+		return false;
+
+	malloc_account(entry->site, entry->size, false);
+
+	if (site)
+		*site = entry->site;
+
+	malloc_entry_remove(entry);
+
+	return true;
+}
+
+static void malloc_stats_alloc(void *ptr, size_t size,
+							const void *caller)
+{
+	unsigned int site;
+
+	malloc_stats_lock();
+
+	/* Stale entry of memory that was released with plain free() */
+	malloc_forget(ptr, NULL);
+
+	site = malloc_site_lookup(caller);
+	malloc_entry_insert(ptr, size, site);
+	malloc_account(site, size, true);
+
+	malloc_stats_unlock();
+}
+
+/*
+ * A resized block stays attributed to its original call site, the old
+ * pointer is dropped before realloc() gets to invalidate it.
+ */
+static unsigned int malloc_stats_realloc_begin(const void *mem,
+							const void *caller)
+{
+	unsigned int site;
+
+	malloc_stats_lock();
+
+	if (!mem || !malloc_forget(mem, &site))
+		site = malloc_site_lookup(caller);
+
+	malloc_stats_unlock();
+
+	return site;
+}
+
+static void malloc_stats_realloc_end(void *ptr, size_t size,
+							unsigned int site)
+{
+	malloc_stats_lock();
+
+	malloc_forget(ptr, NULL);
+	malloc_entry_insert(ptr, size, site);
+	malloc_account(site, size, true);
+
+	malloc_stats_unlock();
+}
+
+static void malloc_stats_retag(const void *ptr, const void *caller)
+{
+	struct malloc_entry *entry;
+	struct malloc_site *site;
+
+	malloc_stats_lock();
+
+	entry = malloc_entry_find(ptr);
+	if (entry) {
+		site = &malloc_sites[entry->site];
+		malloc_site_account(site, entry->size, false);
+		site->total_allocations--;
+
+		entry->site = malloc_site_lookup(caller);
+		malloc_site_account(&malloc_sites[entry->site],
+							entry->size, true);
+	}
+
+	malloc_stats_unlock();
+}
+
+static void malloc_stats_free(const void *ptr)
+{
+	malloc_stats_lock();
+	malloc_forget(ptr, NULL);
+	malloc_stats_unlock();
+}
+#else
+#define MALLOC_CALLER NULL
+
+static inline void malloc_stats_alloc(void *ptr, size_t size,
+							const void *caller)
+{
+}
+
+static inline unsigned int malloc_stats_realloc_begin(const void *mem,
+							const void *caller)
+{
+	return 0;
+}
+
+static inline void malloc_stats_realloc_end(void *ptr, size_t size,
+							unsigned int site)
+{
+}
+
+static inline void malloc_stats_retag(const void *ptr, const void *caller)
+{
+}
+
+static inline void malloc_stats_free(const void *ptr)
+{
+}
+#endif
+
 /**
  * l_malloc:
  * @size: memory size to allocate
@@ -60,8 +377,10 @@ LIB_EXPORT void *l_malloc(size_t size)
 		void *ptr;
 
 		ptr = malloc(size);
-		if (ptr)
+		if (ptr) {
+			malloc_stats_alloc(ptr, size, MALLOC_CALLER);
 			return ptr;
+		}
 
 		fprintf(stderr, "%s:%s(): failed to allocate %zd bytes\n",
 					STRLOC, __func__, size);
@@ -87,11 +406,16 @@ LIB_EXPORT void *l_malloc(size_t size)
 LIB_EXPORT void *l_realloc(void *mem, size_t size)
 {
 	if (likely(size)) {
+		unsigned int site;
 		void *ptr;
 
+		site = malloc_stats_realloc_begin(mem, MALLOC_CALLER);
+
 		ptr = realloc(mem, size);
-		if (ptr)
+		if (ptr) {
+			malloc_stats_realloc_end(ptr, size, site);
 			return ptr;
+		}
 
 		fprintf(stderr, "%s:%s(): failed to re-allocate %zd bytes\n",
 					STRLOC, __func__, size);
@@ -122,6 +446,10 @@ LIB_EXPORT void *l_memdup(const void *mem, size_t size)
 
 	memcpy(ptr, mem, size);
 
+	/* Attribute the copy to our caller instead of l_memdup itself */
+	if (ptr)
+		malloc_stats_retag(ptr, MALLOC_CALLER);
+
 	return ptr;
 }
 
@@ -133,9 +461,128 @@ LIB_EXPORT void *l_memdup(const void *mem, size_t size)
  **/
 LIB_EXPORT void l_free(void *ptr)
 {
+	if (ptr)
+		malloc_stats_free(ptr);
+
 	free(ptr);
 }
 
+/**
+ * l_malloc_get_stats:
+ * @stats: Structure to fill in
+ *
+ * Retrieves the totals of the allocation accounting, which is only
+ * available if ell was built with --enable-malloc-stats.  The accounting
+ * covers the memory obtained through l_malloc, l_realloc and the string
+ * duplication helpers.
+ *
+ * Returns: true if @stats has been filled in, false if allocation
+ * accounting is not available.
+ **/
+LIB_EXPORT bool l_malloc_get_stats(struct l_malloc_stats *stats)
+{
+	if (unlikely(!stats))
+		return false;
+
+#ifdef MALLOC_STATS
+	malloc_stats_lock();
+	*stats = malloc_totals;
+	malloc_stats_unlock();
+
+	return true;
+#else
+	memset(stats, 0, sizeof(*stats));
+
+	return false;
+#endif
+}
+
+#ifdef MALLOC_STATS
+static int malloc_site_compare(const void *a, const void *b)
+{
+	const struct malloc_site *site_a = a;
+	const struct malloc_site *site_b = b;
+
+	if (site_a->live_bytes != site_b->live_bytes)
+		return site_a->live_bytes < site_b->live_bytes ? 1 : -1;
+
+	if (site_a->peak_bytes != site_b->peak_bytes)
+		return site_a->peak_bytes < site_b->peak_bytes ? 1 : -1;
+
+	return 0;
+}
+#endif
+
+/**
+ * l_malloc_dump_stats:
+ * @function: Function called for each line of output
+ * @user_data: User data passed to @function
+ *
+ * Dumps the totals of the allocation accounting followed by one line for
+ * every call site that allocated memory, ordered by the number of bytes
+ * each of them currently holds.  Does nothing if ell was built without
+ * --enable-malloc-stats.
+ **/
+LIB_EXPORT void l_malloc_dump_stats(l_util_hexdump_func_t function,
+							void *user_data)
+{
+#ifdef MALLOC_STATS
+	struct malloc_site *sites;
+	struct l_malloc_stats totals;
+	unsigned int count = 0;
+	unsigned int i;
+
+	if (unlikely(!function))
+		return;
+
+	sites = malloc(sizeof(malloc_sites));
+	if (!sites)
+		return;
+
+	malloc_stats_lock();
+
+	totals = malloc_totals;
+
+	for (i = 0; i < MALLOC_SITES; i++)
+		if (malloc_sites[i].total_allocations)
+			sites[count++] = malloc_sites[i];
+
+	malloc_stats_unlock();
+
+	qsort(sites, count, sizeof(struct malloc_site), malloc_site_compare);
+
+	l_util_debug(function, user_data, "live %zu bytes in %zu blocks, "
+				"peak %zu bytes, %" PRIu64 " allocations",
+				totals.live_bytes, totals.live_allocations,
+				totals.peak_bytes, totals.total_allocations);
+
+	for (i = 0; i < count; i++) {
+		Dl_info info;
+		char location[128];
+
+		if (!sites[i].caller)
+			strcpy(location, "(other)");
+		else if (dladdr(sites[i].caller, &info) && info.dli_sname)
+			snprintf(location, sizeof(location), "%s+0x%tx",
+					info.dli_sname, (const char *)
+					sites[i].caller - (const char *)
+					info.dli_saddr);
+		else
+			snprintf(location, sizeof(location), "%p",
+							sites[i].caller);
+
+		l_util_debug(function, user_data, "%-40s live %zu bytes "
+				"in %zu blocks, peak %zu bytes, "
+				"%" PRIu64 " allocations", location,
+				sites[i].live_bytes, sites[i].live_allocations,
+				sites[i].peak_bytes,
+				sites[i].total_allocations);
+	}
+
+	free(sites);
+#endif
+}
+
 /**
  * l_strdup:
  * @str: string pointer
@@ -150,8 +597,11 @@ LIB_EXPORT char *l_strdup(const char *str)
 		char *tmp;
 
 		tmp = strdup(str);
-		if (tmp)
+		if (tmp) {
+			malloc_stats_alloc(tmp, strlen(tmp) + 1,
+							MALLOC_CALLER);
 			return tmp;
+		}
 
 		fprintf(stderr, "%s:%s(): failed to allocate string\n",
 						STRLOC, __func__);
@@ -178,8 +628,11 @@ LIB_EXPORT char *l_strndup(const char *str, size_t max)
 		char *tmp;
 
 		tmp = strndup(str, max);
-		if (tmp)
+		if (tmp) {
+			malloc_stats_alloc(tmp, strlen(tmp) + 1,
+							MALLOC_CALLER);
 			return tmp;
+		}
 
 		fprintf(stderr, "%s:%s(): failed to allocate string\n",
 						STRLOC, __func__);
@@ -214,6 +667,8 @@ LIB_EXPORT char *l_strdup_printf(const char *format, ...)
 		return NULL;
 	}
 
+	malloc_stats_alloc(str, len + 1, MALLOC_CALLER);
+
 	return str;
 }
 
@@ -239,6 +694,8 @@ LIB_EXPORT char *l_strdup_vprintf(const char *format, va_list args)
 		return NULL;
 	}
 
+	malloc_stats_alloc(str, len + 1, MALLOC_CALLER);
+
 	return str;
 }
 
@@ -342,22 +799,120 @@ LIB_EXPORT bool l_str_has_suffix(const char *str, const char *suffix)
 	return !strcmp(&str[len_diff], suffix);
 }
 
+/*
+ * Hex conversion kernels shared by the hexstring and hexdump helpers.  On
+ * x86 SSE2 is always available and converts 16 bytes per step, the scalar
+ * loops handle the remainder and other architectures.
+ */
+static void hex_encode(char *out, const uint8_t *in, size_t len, bool upper)
+{
+	const char *hexdigits = upper ? "0123456789ABCDEF" :
+						"0123456789abcdef";
+	size_t i = 0;
+
+#ifdef __SSE2__
+	const __m128i mask = _mm_set1_epi8(0x0f);
+	const __m128i nine = _mm_set1_epi8(9);
+	const __m128i zero = _mm_set1_epi8('0');
+	const __m128i letter = _mm_set1_epi8(upper ? 'A' - '0' - 10 :
+							'a' - '0' - 10);
+
+	for (; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (in + i));
+		__m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+		__m128i lo = _mm_and_si128(v, mask);
+
+		hi = _mm_add_epi8(_mm_add_epi8(hi, zero), _mm_and_si128(
+					_mm_cmpgt_epi8(hi, nine), letter));
+		lo = _mm_add_epi8(_mm_add_epi8(lo, zero), _mm_and_si128(
+					_mm_cmpgt_epi8(lo, nine), letter));
+
+		_mm_storeu_si128((__m128i *) (out + i * 2),
+						_mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128((__m128i *) (out + i * 2 + 16),
+						_mm_unpackhi_epi8(hi, lo));
+	}
+#endif
+
+	for (; i < len; i++) {
+		out[i * 2 + 0] = hexdigits[in[i] >> 4];
+		out[i * 2 + 1] = hexdigits[in[i] & 0xf];
+	}
+}
+
+static int hex_value(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+
+	c |= 0x20;
+
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+
+	return -1;
+}
+
+/* Decodes @len digits into @len / 2 bytes, @len must be even */
+static bool hex_decode(uint8_t *out, const char *in, size_t len)
+{
+	size_t i = 0;
+
+#ifdef __SSE2__
+	for (; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (in + i));
+		__m128i l = _mm_or_si128(v, _mm_set1_epi8(0x20));
+		__m128i digit = _mm_and_si128(
+				_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+				_mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+		__m128i alpha = _mm_and_si128(
+				_mm_cmpgt_epi8(l, _mm_set1_epi8('a' - 1)),
+				_mm_cmplt_epi8(l, _mm_set1_epi8('f' + 1)));
+		__m128i value;
+
+		if (_mm_movemask_epi8(_mm_or_si128(digit, alpha)) != 0xffff)
+			return false;
+
+		value = _mm_or_si128(
+			_mm_and_si128(digit, _mm_sub_epi8(v,
+						_mm_set1_epi8('0'))),
+			_mm_and_si128(alpha, _mm_sub_epi8(l,
+						_mm_set1_epi8('a' - 10))));
+
+		/* Each 16 bit lane holds the high nibble in its low byte */
+		value = _mm_and_si128(_mm_or_si128(_mm_slli_epi16(value, 4),
+						_mm_srli_epi16(value, 8)),
+						_mm_set1_epi16(0xff));
+
+		_mm_storel_epi64((__m128i *) (out + i / 2),
+					_mm_packus_epi16(value, value));
+	}
+#endif
+
+	for (; i < len; i += 2) {
+		int hi = hex_value(in[i]);
+		int lo = hex_value(in[i + 1]);
+
+		if (hi < 0 || lo < 0)
+			return false;
+
+		out[i / 2] = (hi << 4) | lo;
+	}
+
+	return true;
+}
+
 static char *hexstring_common(const unsigned char *buf, size_t len,
-				const char hexdigits[static 16])
+								bool upper)
 {
 	char *str;
-	size_t i;
 
 	if (unlikely(!buf) || unlikely(!len))
 		return NULL;
 
 	str = l_malloc(len * 2 + 1);
 
-	for (i = 0; i < len; i++) {
-		str[(i * 2) + 0] = hexdigits[buf[i] >> 4];
-		str[(i * 2) + 1] = hexdigits[buf[i] & 0xf];
-	}
-
+	hex_encode(str, buf, len, upper);
 	str[len * 2] = '\0';
 
 	return str;
@@ -374,8 +929,7 @@ static char *hexstring_common(const unsigned char *buf, size_t len,
  **/
 LIB_EXPORT char *l_util_hexstring(const unsigned char *buf, size_t len)
 {
-	static const char hexdigits[] = "0123456789abcdef";
-	return hexstring_common(buf, len, hexdigits);
+	return hexstring_common(buf, len, false);
 }
 
 /**
@@ -389,8 +943,7 @@ LIB_EXPORT char *l_util_hexstring(const unsigned char *buf, size_t len)
  **/
 LIB_EXPORT char *l_util_hexstring_upper(const unsigned char *buf, size_t len)
 {
-	static const char hexdigits[] = "0123456789ABCDEF";
-	return hexstring_common(buf, len, hexdigits);
+	return hexstring_common(buf, len, true);
 }
 
 /**
@@ -403,57 +956,63 @@ LIB_EXPORT char *l_util_hexstring_upper(const unsigned char *buf, size_t len)
 LIB_EXPORT unsigned char *l_util_from_hexstring(const char *str,
 							size_t *out_len)
 {
-	size_t i, j;
 	size_t len;
-	char c;
 	unsigned char *buf;
 
 	if (unlikely(!str))
 		return NULL;
 
-	for (i = 0; str[i]; i++) {
-		c = toupper(str[i]);
-
-		if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'F'))
-			continue;
+	len = strlen(str);
 
+	if ((len % 2) != 0)
 		return NULL;
-	}
 
-	if ((i % 2) != 0)
-		return NULL;
+	buf = l_malloc(len >> 1);
 
-	len = i;
-	buf = l_malloc(i >> 1);
+	if (!hex_decode(buf, str, len)) {
+		l_free(buf);
+		return NULL;
+	}
 
-	for (i = 0, j = 0; i < len; i++, j++) {
-		c = toupper(str[i]);
+	if (out_len)
+		*out_len = len >> 1;
 
-		if (c >= '0' && c <= '9')
-			buf[j] = c - '0';
-		else if (c >= 'A' && c <= 'F')
-			buf[j] = 10 + c - 'A';
+	return buf;
+}
 
-		i += 1;
+/*
+ * Formats up to 16 bytes into positions 1 to 66 of a hexdump line and
+ * terminates it, the caller sets the direction character at position 0.
+ */
+static void hexdump_line(char str[68], const uint8_t *buf, size_t len)
+{
+	char hex[32];
+	size_t i;
 
-		c = toupper(str[i]);
+	hex_encode(hex, buf, len, false);
 
-		if (c >= '0' && c <= '9')
-			buf[j] = buf[j] * 16 + c - '0';
-		else if (c >= 'A' && c <= 'F')
-			buf[j] = buf[j] * 16 + 10 + c - 'A';
+	for (i = 0; i < len; i++) {
+		str[(i * 3) + 1] = ' ';
+		str[(i * 3) + 2] = hex[i * 2];
+		str[(i * 3) + 3] = hex[i * 2 + 1];
+		str[i + 51] = isprint(buf[i]) ? buf[i] : '.';
 	}
 
-	if (out_len)
-		*out_len = j;
+	for (; i < 16; i++) {
+		str[(i * 3) + 1] = ' ';
+		str[(i * 3) + 2] = ' ';
+		str[(i * 3) + 3] = ' ';
+		str[i + 51] = ' ';
+	}
 
-	return buf;
+	str[49] = ' ';
+	str[50] = ' ';
+	str[67] = '\0';
 }
 
 static void hexdump(const char dir, const unsigned char *buf, size_t len,
 			l_util_hexdump_func_t function, void *user_data)
 {
-	static const char hexdigits[] = "0123456789abcdef";
 	char str[68];
 	size_t i;
 
@@ -462,33 +1021,10 @@ static void hexdump(const char dir, const unsigned char *buf, size_t len,
 
 	str[0] = dir;
 
-	for (i = 0; i < len; i++) {
-		str[((i % 16) * 3) + 1] = ' ';
-		str[((i % 16) * 3) + 2] = hexdigits[buf[i] >> 4];
-		str[((i % 16) * 3) + 3] = hexdigits[buf[i] & 0xf];
-		str[(i % 16) + 51] = isprint(buf[i]) ? buf[i] : '.';
-
-		if ((i + 1) % 16 == 0) {
-			str[49] = ' ';
-			str[50] = ' ';
-			str[67] = '\0';
-			function(str, user_data);
-			str[0] = ' ';
-		}
-	}
-
-	if (i % 16 > 0) {
-		size_t j;
-		for (j = (i % 16); j < 16; j++) {
-			str[(j * 3) + 1] = ' ';
-			str[(j * 3) + 2] = ' ';
-			str[(j * 3) + 3] = ' ';
-			str[j + 51] = ' ';
-		}
-		str[49] = ' ';
-		str[50] = ' ';
-		str[67] = '\0';
+	for (i = 0; i < len; i += 16) {
+		hexdump_line(str, buf + i, len - i < 16 ? len - i : 16);
 		function(str, user_data);
+		str[0] = ' ';
 	}
 }
 
@@ -517,56 +1053,35 @@ LIB_EXPORT void l_util_hexdumpv(bool in, const struct iovec *iov,
 					l_util_hexdump_func_t function,
 					void *user_data)
 {
-	static const char hexdigits[] = "0123456789abcdef";
 	char str[68];
+	uint8_t line[16];
+	size_t n = 0;
 	size_t i;
-	size_t len;
 	size_t c;
-	const uint8_t *buf;
 
 	if (unlikely(!iov || !n_iov))
 		return;
 
 	str[0] = in ? '<' : '>';
 
-	for (i = 0, len = 0; i < n_iov; i++)
-		len += iov[i].iov_len;
+	for (i = 0; i < n_iov; i++) {
+		const uint8_t *buf = iov[i].iov_base;
 
-	c = 0;
-	buf = iov[0].iov_base;
+		for (c = 0; c < iov[i].iov_len; c++) {
+			line[n++] = buf[c];
 
-	for (i = 0; i < len; i++, c++) {
-		if (c == iov[0].iov_len) {
-			c = 0;
-			iov += 1;
-			buf = iov[0].iov_base;
-		}
-
-		str[((i % 16) * 3) + 1] = ' ';
-		str[((i % 16) * 3) + 2] = hexdigits[buf[c] >> 4];
-		str[((i % 16) * 3) + 3] = hexdigits[buf[c] & 0xf];
-		str[(i % 16) + 51] = isprint(buf[c]) ? buf[c] : '.';
+			if (n < 16)
+				continue;
 
-		if ((i + 1) % 16 == 0) {
-			str[49] = ' ';
-			str[50] = ' ';
-			str[67] = '\0';
+			hexdump_line(str, line, n);
 			function(str, user_data);
 			str[0] = ' ';
+			n = 0;
 		}
 	}
 
-	if (i % 16 > 0) {
-		size_t j;
-		for (j = (i % 16); j < 16; j++) {
-			str[(j * 3) + 1] = ' ';
-			str[(j * 3) + 2] = ' ';
-			str[(j * 3) + 3] = ' ';
-			str[j + 51] = ' ';
-		}
-		str[49] = ' ';
-		str[50] = ' ';
-		str[67] = '\0';
+	if (n > 0) {
+		hexdump_line(str, line, n);
 		function(str, user_data);
 	}
 }
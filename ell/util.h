@@ -242,6 +242,15 @@ void l_free(void *ptr);
 void *l_realloc(void *mem, size_t size)
 			__attribute__ ((warn_unused_result, malloc));
 
+struct l_malloc_stats {
+	size_t live_bytes;
+	size_t peak_bytes;
+	size_t live_allocations;
+	uint64_t total_allocations;
+};
+
+bool l_malloc_get_stats(struct l_malloc_stats *stats);
+
 static inline void auto_free(void *a)
 {
 	void **p = (void **)a;
@@ -304,6 +313,8 @@ void l_util_debug(l_util_hexdump_func_t function, void *user_data,
 
 const char *l_util_get_debugfs_path(void);
 
+void l_malloc_dump_stats(l_util_hexdump_func_t function, void *user_data);
+
 #define L_TFR(expression)                          \
   (__extension__                                   \
     ({ long int __result;                          \
@@ -0,0 +1,88 @@
+/*
+ *
+ *  Embedded Linux library
+ *
+ *  Copyright (C) 2011-2014  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <ell/ell.h>
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: %s [hashes]\n", program_invocation_short_name);
+}
+
+int main(int argc, char *argv[])
+{
+	static const uint64_t seed[2] = { 1, 2 };
+	static const unsigned int lengths[] = { 8, 16, 32, 64 };
+	volatile unsigned int sum = 0;
+	unsigned int hashes = 1000000;
+	char key[65];
+	unsigned int i, j;
+
+	if (argc > 2) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	if (argc > 1)
+		hashes = strtoul(argv[1], NULL, 10);
+
+	for (i = 0; i < L_ARRAY_SIZE(lengths); i++) {
+		uint64_t superfast_usec;
+		uint64_t seeded_usec;
+		uint64_t start;
+
+		memset(key, 'a', lengths[i]);
+		key[lengths[i]] = '\0';
+
+		start = l_time_now();
+
+		for (j = 0; j < hashes; j++) {
+			key[j % lengths[i]] = 'a' + j % 26;
+			sum += l_str_hash(key);
+		}
+
+		superfast_usec = l_time_diff(start, l_time_now());
+		start = l_time_now();
+
+		for (j = 0; j < hashes; j++) {
+			key[j % lengths[i]] = 'a' + j % 26;
+			sum += l_str_hash_seeded(key, seed);
+		}
+
+		seeded_usec = l_time_diff(start, l_time_now());
+
+		printf("%2u byte keys: l_str_hash %" PRIu64 " usec, "
+			"l_str_hash_seeded %" PRIu64 " usec\n", lengths[i],
+			superfast_usec, seeded_usec);
+	}
+
+	return EXIT_SUCCESS;
+}
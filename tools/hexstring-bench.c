@@ -0,0 +1,92 @@
+/*
+ *
+ *  Embedded Linux library
+ *
+ *  Copyright (C) 2011-2014  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include <ell/ell.h>
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: %s [megabytes]\n",
+			program_invocation_short_name);
+}
+
+int main(int argc, char *argv[])
+{
+	static const size_t sizes[] = { 16, 256, 4096, 65536, 1024 * 1024 };
+	size_t max_size = sizes[L_ARRAY_SIZE(sizes) - 1];
+	size_t total = 16 * 1024 * 1024;
+	unsigned char *buf;
+	size_t i, n;
+
+	if (argc > 2) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	if (argc > 1)
+		total = strtoul(argv[1], NULL, 10) * 1024 * 1024;
+
+	buf = l_malloc(max_size);
+
+	for (i = 0; i < max_size; i++)
+		buf[i] = i * 7;
+
+	for (i = 0; i < L_ARRAY_SIZE(sizes); i++) {
+		size_t rounds = total / sizes[i];
+		uint64_t encode_usec;
+		uint64_t decode_usec;
+		uint64_t start;
+		char *hex = l_util_hexstring(buf, sizes[i]);
+
+		start = l_time_now();
+
+		for (n = 0; n < rounds; n++)
+			l_free(l_util_hexstring(buf, sizes[i]));
+
+		encode_usec = l_time_diff(start, l_time_now());
+		start = l_time_now();
+
+		for (n = 0; n < rounds; n++)
+			l_free(l_util_from_hexstring(hex, NULL));
+
+		decode_usec = l_time_diff(start, l_time_now());
+
+		printf("%7zu bytes: encode %" PRIu64 " MB/s, "
+				"decode %" PRIu64 " MB/s\n", sizes[i],
+				(uint64_t) total / (encode_usec ?: 1),
+				(uint64_t) total / (decode_usec ?: 1));
+
+		l_free(hex);
+	}
+
+	l_free(buf);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,236 @@
+/*
+ *
+ *  Embedded Linux library
+ *
+ *  Copyright (C) 2011-2014  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <getopt.h>
+
+#include <ell/ell.h>
+
+/* What enumerating a typical laptop looks up */
+static const char *default_modaliases[] = {
+	"usb:v1D6Bp0002d0606dc09dsc00dp01ic09isc00ip00in00",
+	"usb:v1D6Bp0003d0606dc09dsc00dp03ic09isc00ip00in00",
+	"usb:v046DpC52Bd2411dc00dsc00dp00ic03isc01ip01in00",
+	"usb:v046DpC534d2901dc00dsc00dp00ic03isc01ip02in01",
+	"usb:v8087p0026d0002dcE0dsc01dp01icE0isc01ip01in00",
+	"usb:v8087p0033d0000dcE0dsc01dp01icE0isc01ip01in01",
+	"usb:v0BDAp58F4d0001dcEFdsc02dp01ic0Eisc01ip00in00",
+	"usb:v04F2pB6DDd0017dcEFdsc02dp01ic0Eisc02ip01in01",
+	"usb:v0781p5583d0100dc00dsc00dp00ic08isc06ip50in00",
+	"usb:v05ACp12A8d1201dc00dsc00dp00ic06isc01ip01in00",
+	"usb:v0BDAp8153d3000dc00dsc00dp00icFFisc00ip00in00",
+	"usb:v27C6p609Cd0100dcEFdsc00dp00icFFisc00ip00in00",
+	"pci:v00008086d00009A14sv000017AAsd000022D8bc06sc00i00",
+	"pci:v00008086d00009A49sv000017AAsd000022D8bc03sc00i00",
+	"pci:v00008086d0000A0EDsv000017AAsd000022D8bc0Csc03i30",
+	"pci:v00008086d0000A0F0sv00008086sd00000074bc02sc80i00",
+	"pci:v00008086d0000A0C8sv000017AAsd000022D8bc04sc03i80",
+	"pci:v000010ECd00008168sv000017AAsd00003820bc02sc00i00",
+	"pci:v0000144Dd0000A809sv0000144Dsd0000A801bc01sc08i02",
+	"pci:v000010DEd00002520sv000017AAsd00003A4Fbc03sc00i00",
+	"pci:v00001002d00001638sv000017AAsd00003A4Fbc03sc00i00",
+	"pci:v00001022d00001630sv000017AAsd00003A4Fbc06sc00i00",
+	"acpi:PNP0C0A:",
+	"acpi:INT33D5:",
+	"input:b0003v046DpC52Be0111-e0,1,2,4,k71,72,73,ramlsfw",
+	"OUI:000F79",
+	"OUI:001B63",
+	"bluetooth:v003F",
+	"bluetooth:v004C",
+	"sdio:c02",
+};
+
+static char **read_modaliases(const char *filename)
+{
+	char *contents;
+	char **modaliases;
+	size_t len;
+
+	contents = l_file_get_contents(filename, &len);
+	if (!contents)
+		return NULL;
+
+	contents = l_realloc(contents, len + 1);
+	contents[len] = '\0';
+
+	modaliases = l_strsplit(contents, '\n');
+	l_free(contents);
+
+	return modaliases;
+}
+
+static void count_entry(const char *key, const char *value, void *user_data)
+{
+	unsigned int *entries = user_data;
+
+	*entries += 1;
+}
+
+static void count_many_entry(unsigned int index, const char *key,
+				const char *value, void *user_data)
+{
+	unsigned int *entries = user_data;
+
+	*entries += 1;
+}
+
+static uint64_t now_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: %s [-c cache size] [-f | -m] "
+			"[hwdb.bin [modaliases [rounds]]]\n"
+			"  -c  cache lookup results\n"
+			"  -f  iterate results without allocating\n"
+			"  -m  look up all modaliases in one traversal\n",
+			program_invocation_short_name);
+}
+
+int main(int argc, char *argv[])
+{
+	struct l_hwdb *hwdb;
+	char **list = NULL;
+	const char **modaliases = default_modaliases;
+	unsigned int count = L_ARRAY_SIZE(default_modaliases);
+	unsigned int rounds = 1000;
+	unsigned int cache_size = 0;
+	unsigned int entries = 0;
+	unsigned int lookups;
+	unsigned int i, j;
+	uint64_t start, elapsed;
+	bool foreach = false;
+	bool many = false;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "c:fmh")) != -1) {
+		switch (opt) {
+		case 'c':
+			cache_size = strtoul(optarg, NULL, 10);
+			break;
+		case 'f':
+			foreach = true;
+			break;
+		case 'm':
+			many = true;
+			break;
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	argc -= optind - 1;
+	argv += optind - 1;
+
+	if (argc > 4 || (foreach && many)) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	if (argc > 1)
+		hwdb = l_hwdb_new(argv[1]);
+	else
+		hwdb = l_hwdb_new_default();
+
+	if (!hwdb) {
+		fprintf(stderr, "Failed to load hwdb\n");
+		return EXIT_FAILURE;
+	}
+
+	if (argc > 2) {
+		list = read_modaliases(argv[2]);
+		if (!list) {
+			fprintf(stderr, "Failed to read %s\n", argv[2]);
+			l_hwdb_unref(hwdb);
+			return EXIT_FAILURE;
+		}
+
+		modaliases = (const char **) list;
+		count = l_strv_length(list);
+
+		/* Drop the empty string after the final newline */
+		if (count && !list[count - 1][0])
+			count -= 1;
+	}
+
+	if (argc > 3)
+		rounds = strtoul(argv[3], NULL, 10);
+
+	if (cache_size)
+		l_hwdb_set_cache_size(hwdb, cache_size);
+
+	start = now_usec();
+
+	for (i = 0; i < rounds; i++) {
+		if (many) {
+			l_hwdb_lookup_many(hwdb, modaliases, count,
+						count_many_entry, &entries);
+			continue;
+		}
+
+		for (j = 0; j < count; j++) {
+			struct l_hwdb_entry *result, *entry;
+
+			if (foreach) {
+				l_hwdb_lookup_foreach(hwdb, modaliases[j],
+						count_entry, &entries);
+				continue;
+			}
+
+			result = l_hwdb_lookup(hwdb, "%s", modaliases[j]);
+
+			for (entry = result; entry; entry = entry->next)
+				entries += 1;
+
+			l_hwdb_lookup_free(result);
+		}
+	}
+
+	elapsed = now_usec() - start;
+	lookups = rounds * count;
+
+	printf("%u lookups of %u modaliases with %u entries in %" PRIu64
+		" usec, %.2f usec per lookup\n", lookups, count,
+		entries / (rounds ? rounds : 1), elapsed,
+		lookups ? (double) elapsed / lookups : 0.0);
+
+	l_strfreev(list);
+	l_hwdb_unref(hwdb);
+
+	return EXIT_SUCCESS;
+}
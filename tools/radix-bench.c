@@ -0,0 +1,110 @@
+/*
+ *
+ *  Embedded Linux library
+ *
+ *  Copyright (C) 2019  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <ell/ell.h>
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: %s [keys [rounds]]\n",
+			program_invocation_short_name);
+}
+
+int main(int argc, char *argv[])
+{
+	struct l_radix *radix;
+	struct l_hashmap *hashmap;
+	unsigned int num_keys = 10000;
+	unsigned int rounds = 10;
+	unsigned int i, n;
+	int status = EXIT_FAILURE;
+	uint64_t start, radix_usec, hashmap_usec;
+	char **keys;
+
+	if (argc > 3) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	if (argc > 1)
+		num_keys = strtoul(argv[1], NULL, 10);
+
+	if (argc > 2)
+		rounds = strtoul(argv[2], NULL, 10);
+
+	radix = l_radix_new();
+	hashmap = l_hashmap_string_new();
+	keys = l_new(char *, num_keys);
+
+	for (i = 0; i < num_keys; i++) {
+		keys[i] = l_strdup_printf("/org/example/object%u/sub%u",
+							i / 100, i % 100);
+		l_radix_insert(radix, keys[i], strlen(keys[i]), keys[i]);
+		l_hashmap_insert(hashmap, keys[i], keys[i]);
+	}
+
+	start = l_time_now();
+
+	for (n = 0; n < rounds; n++)
+		for (i = 0; i < num_keys; i++)
+			if (l_radix_lookup(radix, keys[i],
+						strlen(keys[i])) != keys[i])
+				goto mismatch;
+
+	radix_usec = l_time_diff(start, l_time_now());
+	start = l_time_now();
+
+	for (n = 0; n < rounds; n++)
+		for (i = 0; i < num_keys; i++)
+			if (l_hashmap_lookup(hashmap, keys[i]) != keys[i])
+				goto mismatch;
+
+	hashmap_usec = l_time_diff(start, l_time_now());
+
+	printf("%u lookups: l_radix %" PRIu64 " usec, "
+			"l_hashmap %" PRIu64 " usec\n",
+			num_keys * rounds, radix_usec, hashmap_usec);
+	status = EXIT_SUCCESS;
+
+done:
+	for (i = 0; i < num_keys; i++)
+		l_free(keys[i]);
+
+	l_free(keys);
+	l_hashmap_destroy(hashmap, NULL);
+	l_radix_destroy(radix, NULL);
+
+	return status;
+
+mismatch:
+	fprintf(stderr, "Lookup of %s returned the wrong value\n", keys[i]);
+	goto done;
+}
@@ -0,0 +1,117 @@
+/*
+ *
+ *  Embedded Linux library
+ *
+ *  Copyright (C) 2019  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <assert.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <ell/ell.h>
+
+static void test_arena(const void *data)
+{
+	struct l_arena *arena;
+	uint8_t *ptrs[100];
+	char *str;
+	unsigned int i;
+
+	assert(!l_arena_alloc(NULL, 16));
+	assert(!l_arena_strdup(NULL, "foo"));
+	l_arena_reset(NULL);
+	l_arena_free(NULL);
+
+	arena = l_arena_new(64);
+	assert(arena);
+
+	/* Spill over into several blocks and an oversized block */
+	for (i = 0; i < L_ARRAY_SIZE(ptrs); i++) {
+		size_t size = i == 50 ? 100000 : i + 1;
+
+		ptrs[i] = l_arena_alloc(arena, size);
+		assert(ptrs[i]);
+		assert(((uintptr_t) ptrs[i] & 15) == 0);
+		memset(ptrs[i], i, size);
+	}
+
+	for (i = 0; i < L_ARRAY_SIZE(ptrs); i++) {
+		size_t size = i == 50 ? 100000 : i + 1;
+
+		assert(ptrs[i][0] == i && ptrs[i][size - 1] == i);
+	}
+
+	str = l_arena_strdup(arena, "Hello World");
+	assert(!strcmp(str, "Hello World"));
+
+	str = l_arena_strndup(arena, "Hello World", 5);
+	assert(!strcmp(str, "Hello"));
+
+	str = l_arena_strndup(arena, "Hi", 5);
+	assert(!strcmp(str, "Hi"));
+
+	assert(!l_arena_strdup(arena, NULL));
+
+	str = l_arena_memdup(arena, "abc", 4);
+	assert(!memcmp(str, "abc", 4));
+
+	str = l_arena_alloc0(arena, 32);
+	for (i = 0; i < 32; i++)
+		assert(str[i] == 0);
+
+	l_arena_free(arena);
+}
+
+static void test_arena_reset(const void *data)
+{
+	struct l_arena *arena;
+	void *first;
+	unsigned int n;
+
+	arena = l_arena_new(1024);
+	first = l_arena_alloc(arena, 8);
+
+	for (n = 0; n < 100; n++) {
+		unsigned int i;
+
+		l_arena_reset(arena);
+
+		/* Memory of the initial block is handed out again */
+		assert(l_arena_alloc(arena, 8) == first);
+
+		for (i = 0; i < 1000; i++)
+			memset(l_arena_alloc(arena, 24), 0xaa, 24);
+	}
+
+	l_arena_free(arena);
+}
+
+int main(int argc, char *argv[])
+{
+	l_test_init(&argc, &argv);
+
+	l_test_add("arena", test_arena, NULL);
+	l_test_add("arena reset", test_arena_reset, NULL);
+
+	return l_test_run();
+}
@@ -126,6 +126,101 @@ static void test_base64_encode(const void *data)
 	l_free(encoded);
 }
 
+static void test_base64_decode_invalid(const void *data)
+{
+	static const char *invalid[] = {
+		"QQ", "QUJ", "Q===", "QQ=A", "QQ=", "QU*D", "QUJD\x80",
+	};
+	static const char *valid[] = {
+		"QQ==", "Q Q = =", "QUI=\n", "QQ==garbage", "QUJD=",
+	};
+	unsigned int i;
+	uint8_t *decoded;
+	size_t len;
+
+	for (i = 0; i < L_ARRAY_SIZE(invalid); i++)
+		assert(!l_base64_decode(invalid[i], strlen(invalid[i]), &len));
+
+	for (i = 0; i < L_ARRAY_SIZE(valid); i++) {
+		decoded = l_base64_decode(valid[i], strlen(valid[i]), &len);
+		assert(decoded);
+		assert(decoded[0] == 'A');
+		l_free(decoded);
+	}
+}
+
+static void test_base64_roundtrip(const void *data)
+{
+	uint8_t buf[300];
+	uint8_t out[300 + 3];
+	unsigned int i, len, pos;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = i * 37 + 11;
+
+	for (len = 1; len <= sizeof(buf); len++) {
+		struct l_base64_decoder *decoder;
+		size_t encoded_len, decoded_len, n, chunk;
+		uint8_t *decoded;
+		char *encoded;
+
+		encoded = l_base64_encode(buf, len, 64, &encoded_len);
+		assert(encoded);
+
+		decoded = l_base64_decode(encoded, encoded_len, &decoded_len);
+		assert(decoded);
+		assert(decoded_len == len);
+		assert(!memcmp(decoded, buf, len));
+		l_free(decoded);
+
+		/* Feed the same text in chunks of varying size */
+		decoder = l_base64_decoder_new();
+		decoded_len = 0;
+
+		for (pos = 0; pos < encoded_len; pos += chunk) {
+			chunk = (pos + len) % 7 + 1;
+
+			if (chunk > encoded_len - pos)
+				chunk = encoded_len - pos;
+
+			assert(l_base64_decoder_feed(decoder, encoded + pos,
+							chunk,
+							out + decoded_len, &n));
+			decoded_len += n;
+		}
+
+		assert(l_base64_decoder_finish(decoder));
+		assert(decoded_len == len);
+		assert(!memcmp(out, buf, len));
+
+		l_base64_decoder_free(decoder);
+		l_free(encoded);
+	}
+}
+
+static void test_base64_decoder_invalid(const void *data)
+{
+	struct l_base64_decoder *decoder = l_base64_decoder_new();
+	uint8_t out[16];
+	size_t n;
+
+	assert(l_base64_decoder_feed(decoder, "QU", 2, out, &n));
+	assert(n == 0);
+	assert(!l_base64_decoder_finish(decoder));
+	assert(l_base64_decoder_feed(decoder, "I", 1, out, &n));
+	assert(!l_base64_decoder_finish(decoder));
+	assert(l_base64_decoder_feed(decoder, "=", 1, out, &n));
+	assert(n == 2);
+	assert(!memcmp(out, "AB", 2));
+	assert(l_base64_decoder_finish(decoder));
+	l_base64_decoder_free(decoder);
+
+	decoder = l_base64_decoder_new();
+	assert(!l_base64_decoder_feed(decoder, "QU!D", 4, out, &n));
+	assert(!l_base64_decoder_finish(decoder));
+	l_base64_decoder_free(decoder);
+}
+
 int main(int argc, char *argv[])
 {
 	l_test_init(&argc, &argv);
@@ -140,5 +235,10 @@ int main(int argc, char *argv[])
 	l_test_add("base64/encode/test3", test_base64_encode, &encode_3);
 	l_test_add("base64/encode/test4", test_base64_encode, &encode_4);
 
+	l_test_add("base64/decode/invalid", test_base64_decode_invalid, NULL);
+	l_test_add("base64/roundtrip", test_base64_roundtrip, NULL);
+	l_test_add("base64/decoder/invalid", test_base64_decoder_invalid,
+									NULL);
+
 	return l_test_run();
 }
@@ -0,0 +1,295 @@
+/*
+ *
+ *  Embedded Linux library
+ *
+ *  Copyright (C) 2019  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <ell/ell.h>
+
+#define N_KEYS 10000
+
+static void test_chashmap(const void *data)
+{
+	struct l_chashmap *map;
+	unsigned int i;
+
+	map = l_chashmap_new();
+	assert(map);
+	assert(l_chashmap_isempty(map));
+
+	for (i = 1; i <= N_KEYS; i++)
+		assert(l_chashmap_insert(map, L_UINT_TO_PTR(i),
+						L_UINT_TO_PTR(i * 2)));
+
+	assert(!l_chashmap_insert(map, L_UINT_TO_PTR(1), NULL));
+	assert(l_chashmap_size(map) == N_KEYS);
+
+	for (i = 1; i <= N_KEYS; i++)
+		assert(l_chashmap_lookup(map, L_UINT_TO_PTR(i)) ==
+						L_UINT_TO_PTR(i * 2));
+
+	assert(!l_chashmap_lookup(map, L_UINT_TO_PTR(N_KEYS + 1)));
+
+	for (i = 1; i <= N_KEYS; i += 2)
+		assert(l_chashmap_remove(map, L_UINT_TO_PTR(i)) ==
+						L_UINT_TO_PTR(i * 2));
+
+	assert(!l_chashmap_remove(map, L_UINT_TO_PTR(1)));
+	assert(l_chashmap_size(map) == N_KEYS / 2);
+
+	for (i = 1; i <= N_KEYS; i++)
+		assert(!!l_chashmap_lookup(map, L_UINT_TO_PTR(i)) == !(i & 1));
+
+	l_chashmap_destroy(map, NULL);
+}
+
+static void count_entry(const void *key, void *value, void *user_data)
+{
+	unsigned int *count = user_data;
+
+	assert(l_str_has_prefix(key, "key"));
+	(*count)++;
+}
+
+static void test_string(const void *data)
+{
+	struct l_chashmap *map = l_chashmap_string_new();
+	char key[32];
+	unsigned int count = 0;
+	unsigned int i;
+
+	for (i = 0; i < 100; i++) {
+		snprintf(key, sizeof(key), "key%u", i);
+		assert(l_chashmap_insert(map, key, l_strdup(key)));
+	}
+
+	snprintf(key, sizeof(key), "key%u", 42);
+	assert(!strcmp(l_chashmap_lookup(map, key), "key42"));
+
+	l_free(l_chashmap_remove(map, key));
+	assert(!l_chashmap_lookup(map, key));
+
+	l_chashmap_foreach(map, count_entry, &count);
+	assert(count == 99);
+
+	l_chashmap_destroy(map, l_free);
+}
+
+#define N_READERS 4
+#define N_STABLE 1000
+#define N_ROUNDS 200
+
+struct shared {
+	struct l_chashmap *map;
+	bool done;
+};
+
+struct value {
+	unsigned int key;
+};
+
+static void *reader_thread(void *user_data)
+{
+	struct shared *shared = user_data;
+	unsigned int i;
+
+	while (!__atomic_load_n(&shared->done, __ATOMIC_ACQUIRE)) {
+		for (i = 0; i < N_STABLE * 2; i++) {
+			struct value *value;
+
+			l_chashmap_read_lock();
+
+			value = l_chashmap_lookup(shared->map,
+							L_UINT_TO_PTR(i));
+			if (i < N_STABLE)
+				assert(value);
+
+			if (value)
+				assert(value->key == i);
+
+			l_chashmap_read_unlock();
+		}
+	}
+
+	return NULL;
+}
+
+static void test_concurrent(const void *data)
+{
+	struct shared shared = { .map = l_chashmap_new() };
+	pthread_t readers[N_READERS];
+	struct value *values[N_STABLE];
+	unsigned int i, round;
+
+	for (i = 0; i < N_STABLE; i++) {
+		struct value *value = l_new(struct value, 1);
+
+		value->key = i;
+		assert(l_chashmap_insert(shared.map, L_UINT_TO_PTR(i), value));
+	}
+
+	for (i = 0; i < N_READERS; i++)
+		assert(!pthread_create(&readers[i], NULL, reader_thread,
+								&shared));
+
+	/* Churn through volatile keys, growing the table on the way */
+	for (round = 0; round < N_ROUNDS; round++) {
+		for (i = 0; i < L_ARRAY_SIZE(values); i++) {
+			values[i] = l_new(struct value, 1);
+			values[i]->key = N_STABLE + i;
+
+			assert(l_chashmap_insert(shared.map,
+					L_UINT_TO_PTR(N_STABLE + i),
+					values[i]));
+		}
+
+		for (i = 0; i < L_ARRAY_SIZE(values); i++)
+			assert(l_chashmap_remove(shared.map,
+					L_UINT_TO_PTR(N_STABLE + i)) ==
+					values[i]);
+
+		l_chashmap_synchronize();
+
+		for (i = 0; i < L_ARRAY_SIZE(values); i++)
+			l_free(values[i]);
+	}
+
+	__atomic_store_n(&shared.done, true, __ATOMIC_RELEASE);
+
+	for (i = 0; i < N_READERS; i++)
+		pthread_join(readers[i], NULL);
+
+	assert(l_chashmap_size(shared.map) == N_STABLE);
+	l_chashmap_destroy(shared.map, l_free);
+}
+
+#define N_WRITERS 4
+#define N_WRITER_KEYS 500
+#define N_WRITER_PASSES 20
+#define N_THREAD_ROUNDS 40
+
+struct writer {
+	struct l_chashmap *map;
+	unsigned int base;
+};
+
+static void *writer_thread(void *user_data)
+{
+	struct writer *writer = user_data;
+	struct value *values[N_WRITER_KEYS];
+	unsigned int i, pass;
+
+	for (pass = 0; pass < N_WRITER_PASSES; pass++) {
+		for (i = 0; i < N_WRITER_KEYS; i++) {
+			unsigned int key = writer->base + i;
+
+			values[i] = l_new(struct value, 1);
+			values[i]->key = key;
+
+			assert(l_chashmap_insert(writer->map,
+						L_UINT_TO_PTR(key), values[i]));
+		}
+
+		for (i = 0; i < N_WRITER_KEYS; i++) {
+			unsigned int key = writer->base + i;
+			struct value *value;
+
+			l_chashmap_read_lock();
+			value = l_chashmap_lookup(writer->map,
+							L_UINT_TO_PTR(key));
+			assert(value == values[i] && value->key == key);
+			l_chashmap_read_unlock();
+		}
+
+		/* Keep the last pass in the map for the final check */
+		if (pass == N_WRITER_PASSES - 1)
+			break;
+
+		for (i = 0; i < N_WRITER_KEYS; i++)
+			assert(l_chashmap_remove(writer->map,
+					L_UINT_TO_PTR(writer->base + i)) ==
+					values[i]);
+
+		l_chashmap_synchronize();
+
+		for (i = 0; i < N_WRITER_KEYS; i++)
+			l_free(values[i]);
+	}
+
+	return NULL;
+}
+
+static void test_writers(const void *data)
+{
+	struct l_chashmap *map = l_chashmap_new();
+	struct writer writers[N_WRITERS];
+	pthread_t threads[N_WRITERS];
+	unsigned int round, i;
+
+	/*
+	 * Every round starts a fresh set of threads, so that far more threads
+	 * than there are epoch slots come and go over the whole test
+	 */
+	for (round = 0; round < N_THREAD_ROUNDS; round++) {
+		for (i = 0; i < N_WRITERS; i++) {
+			writers[i].map = map;
+			writers[i].base = i * N_WRITER_KEYS;
+
+			assert(!pthread_create(&threads[i], NULL,
+						writer_thread, &writers[i]));
+		}
+
+		for (i = 0; i < N_WRITERS; i++)
+			assert(!pthread_join(threads[i], NULL));
+
+		assert(l_chashmap_size(map) == N_WRITERS * N_WRITER_KEYS);
+
+		for (i = 0; i < N_WRITERS * N_WRITER_KEYS; i++) {
+			struct value *value;
+
+			value = l_chashmap_remove(map, L_UINT_TO_PTR(i));
+			assert(value && value->key == i);
+			l_free(value);
+		}
+
+		assert(l_chashmap_isempty(map));
+	}
+
+	l_chashmap_destroy(map, NULL);
+}
+
+int main(int argc, char *argv[])
+{
+	l_test_init(&argc, &argv);
+
+	l_test_add("chashmap", test_chashmap, NULL);
+	l_test_add("chashmap string", test_string, NULL);
+	l_test_add("chashmap concurrent", test_concurrent, NULL);
+	l_test_add("chashmap writers", test_writers, NULL);
+
+	return l_test_run();
+}
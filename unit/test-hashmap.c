@@ -25,6 +25,7 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 
 #include <ell/ell.h>
@@ -271,6 +272,46 @@ static void test_foreach_remove(const void *test_data)
 	l_hashmap_destroy(hashmap, NULL);
 };
 
+static void test_seeded(const void *test_data)
+{
+	static const uint64_t seed1[2] = { 1, 2 };
+	static const uint64_t seed2[2] = { 3, 4 };
+	struct l_hashmap *hashmap;
+	unsigned int i, n = 0;
+	char key[32];
+
+	assert(l_str_hash_seeded("org.example.Name", seed1) ==
+				l_str_hash_seeded("org.example.Name", seed1));
+
+	for (i = 0; i < 64; i++) {
+		snprintf(key, sizeof(key), "key%u", i);
+
+		if (l_str_hash_seeded(key, seed1) !=
+					l_str_hash_seeded(key, seed2))
+			n++;
+	}
+
+	assert(n > 60);
+
+	hashmap = l_hashmap_string_new();
+	assert(l_hashmap_set_hash_seed(hashmap, seed1));
+
+	for (i = 0; i < 1024; i++) {
+		snprintf(key, sizeof(key), "key%u", i);
+		assert(l_hashmap_insert(hashmap, key, L_UINT_TO_PTR(i + 1)));
+	}
+
+	assert(!l_hashmap_set_hash_seed(hashmap, seed2));
+	assert(!l_hashmap_set_seeded_hash_function(hashmap, NULL));
+
+	for (i = 0; i < 1024; i++) {
+		snprintf(key, sizeof(key), "key%u", i);
+		assert(l_hashmap_lookup(hashmap, key) == L_UINT_TO_PTR(i + 1));
+	}
+
+	l_hashmap_destroy(hashmap, NULL);
+}
+
 int main(int argc, char *argv[])
 {
 	l_test_init(&argc, &argv);
@@ -279,6 +320,7 @@ int main(int argc, char *argv[])
 	l_test_add("String Test", test_str, NULL);
 	l_test_add("Duplicate Test", test_duplicate, NULL);
 	l_test_add("Foreach Remove Test", test_foreach_remove, NULL);
+	l_test_add("Seeded Hash Test", test_seeded, NULL);
 
 	return l_test_run();
 }
@@ -26,6 +26,7 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <ell/ell.h>
 
@@ -73,11 +74,199 @@ static void check_entry(const char *modalias, struct l_hwdb_entry *entries,
 	}
 }
 
+#define MAX_RESULTS 32
+
+struct hwdb_results {
+	const char *keys[MAX_RESULTS];
+	const char *values[MAX_RESULTS];
+	unsigned int count;
+};
+
+static void collect_entry(const char *key, const char *value, void *user_data)
+{
+	struct hwdb_results *results = user_data;
+
+	assert(results->count < MAX_RESULTS);
+	results->keys[results->count] = key;
+	results->values[results->count] = value;
+	results->count++;
+}
+
+/*
+ * unit/hwdb.bin has 32 byte entries and was checked against the fnmatch()
+ * based lookup.  The entries are in the order l_hwdb_lookup returns them.
+ */
+static const struct {
+	const char *modalias;
+	const char *entries[5];
+} fixture[] = {
+	/* Literal prefixes and a trailing '*' */
+	{ "usb:v1D6Bp0002d0606dc09dsc00dp01ic09isc00ip00in00", {
+		"ID_MODEL_FROM_DATABASE=2.0 root hub",
+		"ID_VENDOR_FROM_DATABASE=Linux Foundation",
+		"ID_USB_CLASS_FROM_DATABASE=Hub" } },
+	{ "usb:v1D6Bp0003d0606dc09dsc00dp03ic09isc00ip00in00", {
+		"ID_MODEL_FROM_DATABASE=3.0 root hub",
+		"ID_VENDOR_FROM_DATABASE=Linux Foundation",
+		"ID_USB_CLASS_FROM_DATABASE=Hub" } },
+	/* Bracket ranges and '?' */
+	{ "usb:v046DpC534d2901dc00dsc00dp00ic03isc01ip01in00", {
+		"ID_RECEIVER=1",
+		"ID_MODEL_FROM_DATABASE=Unifying Receiver",
+		"ID_VENDOR_FROM_DATABASE=Logitech, Inc." } },
+	{ "usb:v046DpC534", {
+		"ID_RECEIVER=1",
+		"ID_EXACT=1",
+		"ID_MODEL_FROM_DATABASE=Unifying Receiver",
+		"ID_VENDOR_FROM_DATABASE=Logitech, Inc." } },
+	{ "usb:v046DpC52Bd2411dc00dsc00dp00ic03isc01ip01in00", {
+		"ID_RECEIVER=1",
+		"ID_VENDOR_FROM_DATABASE=Logitech, Inc." } },
+	{ "usb:v046Dp1044d0100dc00dsc00dp00ic03isc01ip01in00", {
+		"ID_GLOB=1",
+		"ID_VENDOR_FROM_DATABASE=Logitech, Inc." } },
+	/* Negated range and '*' in the middle */
+	{ "usb:vABCDp0001d0100dc09dsc00dp00ic09isc00ip00in00", {
+		"ID_NOT_DIGIT=1",
+		"ID_USB_CLASS_FROM_DATABASE=Hub" } },
+	/* Escaped '*' */
+	{ "usb:v*", {
+		"ID_ESCAPED=1",
+		"ID_NOT_DIGIT=1" } },
+	{ "usb:v", { NULL } },
+	{ "OUI:000F79", {
+		"ID_OUI_FROM_DATABASE=Bluetooth Interest Group Inc." } },
+	{ "bluetooth:v003F", {
+		"ID_VENDOR_FROM_DATABASE=Bluetooth SIG, Inc." } },
+	{ "bluetooth:v0078p0001", { NULL } },
+	/* Two entries on one node, at the 32 byte stride */
+	{ "sdio:c02", {
+		"ID_SECOND=2",
+		"ID_SDIO_CLASS_FROM_DATABASE=Bluetooth Type-A standard interface" } },
+	{ "acpi:PNP0A08:", {
+		"ID_ACPI=1" } },
+	{ "acpi:PNP0A08", { NULL } },
+	{ "pci:v00008086d00001234sv00000000sd00000000bc02sc00i00", {
+		"ID_INTEL_ETHERNET=1" } },
+	{ "pci:v000010ECd00008168sv000017AAsd00003820bc02sc00i00", {
+		NULL } },
+	{ "", { NULL } },
+	{ "u", { NULL } },
+};
+
+static void check_fixture_entry(const char * const *expected,
+					const char *key, const char *value)
+{
+	size_t len = strlen(key);
+
+	assert(*expected);
+	assert(!strncmp(*expected, key, len));
+	assert((*expected)[len] == '=');
+	assert(!strcmp(*expected + len + 1, value));
+}
+
+static void collect_many_entry(unsigned int index, const char *key,
+				const char *value, void *user_data)
+{
+	struct hwdb_results *results = user_data;
+
+	collect_entry(key, value, &results[index]);
+}
+
+/* The callbacks get the entries in the reverse order of the list */
+static void check_fixture_results(unsigned int n,
+					const struct hwdb_results *results)
+{
+	const char * const *expected = fixture[n].entries;
+	unsigned int i;
+
+	for (i = 0; i < results->count; i++)
+		check_fixture_entry(expected + results->count - i - 1,
+					results->keys[i], results->values[i]);
+
+	assert(!expected[results->count]);
+}
+
+static void check_fixture_lookup(struct l_hwdb *hwdb, unsigned int n)
+{
+	const char * const *expected = fixture[n].entries;
+	struct hwdb_results results = { .count = 0 };
+	struct l_hwdb_entry *entries, *entry;
+	unsigned int i = 0;
+
+	entries = l_hwdb_lookup(hwdb, "%s", fixture[n].modalias);
+
+	for (entry = entries; entry; entry = entry->next)
+		check_fixture_entry(expected + i++, entry->key, entry->value);
+
+	assert(!expected[i]);
+	l_hwdb_lookup_free(entries);
+
+	assert(l_hwdb_lookup_foreach(hwdb, fixture[n].modalias,
+						collect_entry, &results));
+	check_fixture_results(n, &results);
+}
+
+static void check_fixture_lookups(struct l_hwdb *hwdb)
+{
+	const char *modaliases[L_ARRAY_SIZE(fixture)];
+	struct hwdb_results many[L_ARRAY_SIZE(fixture)];
+	unsigned int count = L_ARRAY_SIZE(fixture);
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		check_fixture_lookup(hwdb, i);
+		modaliases[i] = fixture[i].modalias;
+	}
+
+	memset(many, 0, sizeof(many));
+
+	assert(l_hwdb_lookup_many(hwdb, modaliases, count,
+						collect_many_entry, many));
+
+	for (i = 0; i < count; i++)
+		check_fixture_results(i, &many[i]);
+}
+
+static void check_fixture(void)
+{
+	struct l_hwdb *hwdb;
+	struct hwdb_stats stats = { 0 };
+	int round;
+
+	hwdb = l_hwdb_new(UNITDIR "hwdb.bin");
+	assert(hwdb);
+
+	l_hwdb_foreach(hwdb, check_entry, &stats);
+	assert(stats.aliases == 16);
+	assert(stats.entries == 17);
+
+	check_fixture_lookups(hwdb);
+
+	/* Each lookup misses and then hits, since it evicted the others */
+	assert(l_hwdb_set_cache_size(hwdb, 2));
+
+	for (round = 0; round < 2; round++)
+		check_fixture_lookups(hwdb);
+
+	/* The second round is served from the cache alone */
+	assert(l_hwdb_set_cache_size(hwdb, L_ARRAY_SIZE(fixture)));
+
+	for (round = 0; round < 2; round++)
+		check_fixture_lookups(hwdb);
+
+	assert(l_hwdb_set_cache_size(hwdb, 0));
+
+	l_hwdb_unref(hwdb);
+}
+
 int main(int argc, char *argv[])
 {
 	struct l_hwdb *hwdb;
 	struct hwdb_stats stats = { 0 };
 
+	check_fixture();
+
 	hwdb = l_hwdb_new_default();
 	if (!hwdb) {
 		printf("hwdb.bin not loaded\n");
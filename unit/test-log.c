@@ -0,0 +1,500 @@
+/*
+ *
+ *  Embedded Linux library
+ *
+ *  Copyright (C) 2019  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <assert.h>
+#include <sys/socket.h>
+
+#include <ell/ell.h>
+
+#include "ell/log-private.h"
+
+#define MAX_RECORDS 2048
+
+static char *records[MAX_RECORDS];
+static unsigned int num_records;
+
+static void record_handler(int priority, const char *file, const char *line,
+			const char *func, const char *format, va_list ap)
+{
+	assert(num_records < MAX_RECORDS);
+	assert(!strcmp(file, __FILE__) || strstr(file, "log.c"));
+	assert(strlen(line) > 0 && strlen(func) > 0);
+
+	records[num_records++] = l_strdup_vprintf(format, ap);
+}
+
+static void records_clear(void)
+{
+	while (num_records)
+		l_free(records[--num_records]);
+}
+
+static void test_async_flush(const void *data)
+{
+	unsigned int i;
+
+	l_log_set_handler(record_handler);
+	assert(l_log_enable_async(0));
+	assert(!l_log_enable_async(0));
+
+	for (i = 0; i < 10; i++)
+		l_info("message %u", i);
+
+	/* Nothing is handed to the handler until the main loop runs */
+	assert(num_records == 0);
+
+	l_log_flush();
+	assert(num_records == 10);
+
+	for (i = 0; i < 10; i++) {
+		char expected[32];
+
+		snprintf(expected, sizeof(expected), "message %u\n", i);
+		assert(!strcmp(records[i], expected));
+	}
+
+	records_clear();
+
+	l_warn("pending");
+	l_main_iterate(0);
+	assert(num_records == 1);
+	assert(!strcmp(records[0], "pending\n"));
+	records_clear();
+
+	/* Disabling hands over what is still queued */
+	l_error("last");
+	l_log_disable_async();
+	assert(num_records == 1);
+	records_clear();
+
+	l_info("sync");
+	assert(num_records == 1);
+	records_clear();
+
+	l_log_set_null();
+}
+
+static void test_async_overflow(const void *data)
+{
+	char payload[200];
+	unsigned long dropped;
+	unsigned int i;
+
+	memset(payload, 'x', sizeof(payload) - 1);
+	payload[sizeof(payload) - 1] = '\0';
+
+	l_log_set_handler(record_handler);
+	assert(l_log_enable_async(4096));
+
+	for (i = 0; i < 500; i++)
+		l_info("%s", payload);
+
+	l_log_flush();
+
+	assert(num_records > 1 && num_records < 500);
+	assert(sscanf(records[num_records - 1], "%lu log messages dropped",
+							&dropped) == 1);
+	assert(dropped + num_records - 1 == 500);
+	records_clear();
+
+	/* There is room again and drops are only reported once */
+	l_info("%s", payload);
+	l_log_flush();
+	assert(num_records == 1);
+	records_clear();
+
+	l_log_disable_async();
+	l_log_set_null();
+}
+
+#define THREAD_RECORDS 1000
+
+static void *log_thread(void *user_data)
+{
+	unsigned int i;
+
+	for (i = 0; i < THREAD_RECORDS; i++)
+		l_info("thread %u", i);
+
+	return NULL;
+}
+
+static void test_async_thread(const void *data)
+{
+	pthread_t thread;
+	unsigned int i;
+
+	l_log_set_handler(record_handler);
+	assert(l_log_enable_async(256 * 1024));
+
+	assert(pthread_create(&thread, NULL, log_thread, NULL) == 0);
+
+	while (num_records < THREAD_RECORDS)
+		l_main_iterate(-1);
+
+	assert(pthread_join(thread, NULL) == 0);
+
+	for (i = 0; i < THREAD_RECORDS; i++) {
+		unsigned int n;
+
+		assert(sscanf(records[i], "thread %u", &n) == 1);
+		assert(n == i);
+	}
+
+	records_clear();
+
+	l_log_disable_async();
+	l_log_set_null();
+}
+
+static void *log_once_thread(void *user_data)
+{
+	l_info("exiting %u", L_PTR_TO_UINT(user_data));
+
+	return NULL;
+}
+
+static unsigned int count_fds(void)
+{
+	DIR *dir = opendir("/proc/self/fd");
+	unsigned int count = 0;
+
+	assert(dir);
+
+	while (readdir(dir))
+		count++;
+
+	closedir(dir);
+
+	return count;
+}
+
+#define EXIT_THREADS 100
+
+static void test_async_thread_exit(const void *data)
+{
+	bool seen[EXIT_THREADS] = {};
+	unsigned int fds;
+	unsigned int i;
+
+	l_log_set_handler(record_handler);
+	assert(l_log_enable_async(0));
+
+	fds = count_fds();
+
+	/* Every thread leaves a ring behind for the main loop to reap */
+	for (i = 0; i < EXIT_THREADS; i++) {
+		pthread_t thread;
+
+		assert(pthread_create(&thread, NULL, log_once_thread,
+						L_UINT_TO_PTR(i)) == 0);
+		assert(pthread_join(thread, NULL) == 0);
+	}
+
+	while (num_records < EXIT_THREADS)
+		l_main_iterate(-1);
+
+	l_main_iterate(0);
+
+	/* Rings are flushed one after the other, not in logging order */
+	for (i = 0; i < EXIT_THREADS; i++) {
+		unsigned int n;
+
+		assert(sscanf(records[i], "exiting %u", &n) == 1);
+		assert(n < EXIT_THREADS && !seen[n]);
+		seen[n] = true;
+	}
+
+	records_clear();
+
+	/* The notification eventfds of the retired rings are gone */
+	assert(count_fds() == fds);
+
+	l_log_disable_async();
+	l_log_set_null();
+}
+
+#define SOCKET_RECORDS 100
+
+static void test_async_socket(const void *data)
+{
+	bool journal = L_PTR_TO_UINT(data);
+	int fds[2];
+	unsigned int i;
+
+	assert(socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, fds) == 0);
+
+	l_log_set_ident("test-log");
+	_log_set_socket(fds[1], journal);
+	assert(l_log_enable_async(0));
+
+	/* More than a single sendmmsg batch */
+	for (i = 0; i < SOCKET_RECORDS; i++)
+		l_info("datagram %u", i);
+
+	l_log_flush();
+
+	/* Every record arrives as a datagram of its own and in order */
+	for (i = 0; i < SOCKET_RECORDS; i++) {
+		char buf[1024];
+		char expected[64];
+		ssize_t len;
+
+		len = recv(fds[0], buf, sizeof(buf) - 1, MSG_DONTWAIT);
+		assert(len > 0);
+		buf[len] = '\0';
+
+		if (journal) {
+			snprintf(expected, sizeof(expected),
+					"MESSAGE=datagram %u\n", i);
+			assert(!strncmp(buf, expected, strlen(expected)));
+			assert(strstr(buf, "\nPRIORITY=6\n"));
+			assert(strstr(buf, "\nCODE_FILE="));
+			assert(strstr(buf, "\nCODE_FUNC=test_async_socket\n"));
+		} else {
+			snprintf(expected, sizeof(expected),
+					"<6>test-log[%lu]: datagram %u\n",
+					(unsigned long) getpid(), i);
+			assert(!strcmp(buf, expected));
+		}
+	}
+
+	assert(recv(fds[0], NULL, 0, MSG_DONTWAIT) < 0 && errno == EAGAIN);
+
+	l_log_disable_async();
+	l_log_set_null();
+	l_log_set_ident("");
+
+	close(fds[0]);
+}
+
+static void test_async_stderr(const void *data)
+{
+	static const char expected[] = "one\ntwo\nthree\n";
+	char buf[64];
+	int pipefd[2];
+	int saved;
+	ssize_t len;
+
+	assert(pipe(pipefd) == 0);
+	saved = dup(STDERR_FILENO);
+	assert(dup2(pipefd[1], STDERR_FILENO) == STDERR_FILENO);
+
+	l_log_set_stderr();
+	assert(l_log_enable_async(0));
+
+	l_info("one");
+	l_info("two");
+	l_info("three");
+	l_log_flush();
+
+	len = read(pipefd[0], buf, sizeof(buf));
+
+	l_log_disable_async();
+	l_log_set_null();
+
+	assert(dup2(saved, STDERR_FILENO) == STDERR_FILENO);
+	close(saved);
+	close(pipefd[0]);
+	close(pipefd[1]);
+
+	assert(len == (ssize_t) strlen(expected));
+	assert(!memcmp(buf, expected, len));
+}
+
+static bool has_suffix(const char *str, const char *suffix)
+{
+	size_t len = strlen(str);
+	size_t suffix_len = strlen(suffix);
+
+	return len >= suffix_len && !strcmp(str + len - suffix_len, suffix);
+}
+
+#define DEBUG_FORMAT "%d %u %ld %zu %x %#llx %05.1f %c %s %-4s| %*d %.*s %%"
+#define DEBUG_ARGS -1, 2u, -3L, (size_t) 4, 255, 0x1234567890ULL, 1.5, \
+			'z', str, "ab", 4, 7, 2, "xyz"
+
+static void test_debug_binary(const void *data)
+{
+	static const char *str = "hello";
+	char expected[128];
+	char copy[16] = "before";
+	char buf[256];
+	int pipefd[2];
+	ssize_t len;
+
+	l_log_set_handler(record_handler);
+	l_debug_enable("*test-log.c");
+	assert(l_debug_enable_binary(0));
+	assert(!l_debug_enable_binary(0));
+
+	l_debug(DEBUG_FORMAT, DEBUG_ARGS);
+	l_debug("copy %s", copy);
+	strcpy(copy, "after");
+	errno = ENOENT;
+	l_debug("error %m");
+
+	/* Nothing is formatted until the messages are dumped */
+	assert(num_records == 0);
+
+	l_debug_dump();
+	assert(num_records == 3);
+
+	snprintf(expected, sizeof(expected), "test_debug_binary() "
+					DEBUG_FORMAT "\n", DEBUG_ARGS);
+	assert(records[0][0] == '[');
+	assert(has_suffix(records[0], expected));
+	assert(has_suffix(records[1], "test_debug_binary() copy before\n"));
+
+	snprintf(expected, sizeof(expected), "error %s\n", strerror(ENOENT));
+	assert(has_suffix(records[2], expected));
+	records_clear();
+
+	l_debug_dump();
+	assert(num_records == 0);
+
+	/* The crash safe dump avoids strerror */
+	errno = ENOENT;
+	l_debug("error %m");
+
+	assert(pipe(pipefd) == 0);
+	assert(l_debug_dump_fd(pipefd[1]));
+	close(pipefd[1]);
+
+	len = read(pipefd[0], buf, sizeof(buf) - 1);
+	close(pipefd[0]);
+	assert(len > 0);
+	buf[len] = '\0';
+
+	snprintf(expected, sizeof(expected), "error %d\n", ENOENT);
+	assert(has_suffix(buf, expected));
+
+	l_debug_disable_binary();
+
+	/* Back to formatting right away */
+	l_debug("sync");
+	assert(num_records == 1);
+	assert(has_suffix(records[0], "test_debug_binary() sync\n"));
+	records_clear();
+
+	l_debug_disable();
+	l_log_set_null();
+}
+
+static void test_debug_binary_overflow(const void *data)
+{
+	char long_str[2048];
+	char buf[65536];
+	char *line, *last = NULL;
+	unsigned int i, first;
+	int pipefd[2];
+	ssize_t len;
+
+	memset(long_str, 'a', sizeof(long_str) - 1);
+	long_str[sizeof(long_str) - 1] = '\0';
+
+	l_debug_enable("*test-log.c");
+	assert(l_debug_enable_binary(4096));
+
+	/* Longer strings than fit into a record get truncated */
+	l_debug("%s %d", long_str, 1);
+
+	for (i = 0; i < 1000; i++)
+		l_debug("seq %u", i);
+
+	assert(pipe(pipefd) == 0);
+	assert(l_debug_dump_fd(pipefd[1]));
+	close(pipefd[1]);
+
+	len = read(pipefd[0], buf, sizeof(buf) - 1);
+	close(pipefd[0]);
+	assert(len > 0);
+	buf[len] = '\0';
+
+	/* The oldest messages were overwritten */
+	line = strstr(buf, "() seq ");
+	assert(line);
+	assert(sscanf(line, "() seq %u", &first) == 1);
+	assert(first > 0);
+
+	while ((line = strstr(line + 1, "() seq ")))
+		last = line;
+
+	assert(last && !strcmp(last, "() seq 999\n"));
+
+	l_debug_disable_binary();
+	assert(l_debug_enable_binary(4096));
+
+	l_debug("%s %d", long_str, 1);
+
+	assert(pipe(pipefd) == 0);
+	assert(l_debug_dump_fd(pipefd[1]));
+	close(pipefd[1]);
+
+	len = read(pipefd[0], buf, sizeof(buf) - 1);
+	close(pipefd[0]);
+	assert(len > 0);
+	buf[len] = '\0';
+
+	assert(strstr(buf, "aaaa"));
+	assert(has_suffix(buf, "...\n"));
+
+	l_debug_disable_binary();
+	l_debug_disable();
+}
+
+int main(int argc, char *argv[])
+{
+	int ret;
+
+	l_test_init(&argc, &argv);
+
+	if (!l_main_init())
+		return -1;
+
+	l_test_add("async flush", test_async_flush, NULL);
+	l_test_add("async overflow", test_async_overflow, NULL);
+	l_test_add("async thread", test_async_thread, NULL);
+	l_test_add("async thread exit", test_async_thread_exit, NULL);
+	l_test_add("async syslog", test_async_socket, L_UINT_TO_PTR(false));
+	l_test_add("async journal", test_async_socket, L_UINT_TO_PTR(true));
+	l_test_add("async stderr", test_async_stderr, NULL);
+	l_test_add("debug binary", test_debug_binary, NULL);
+	l_test_add("debug binary overflow", test_debug_binary_overflow, NULL);
+
+	ret = l_test_run();
+
+	l_main_exit();
+
+	return ret;
+}
@@ -0,0 +1,211 @@
+/*
+ *
+ *  Embedded Linux library
+ *
+ *  Copyright (C) 2019  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <assert.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <ell/ell.h>
+
+#include "ell/private.h"
+
+struct test_object {
+	uint32_t id;
+	uint8_t payload[52];
+};
+
+static void test_mempool(const void *data)
+{
+	struct l_mempool *pool;
+	struct test_object *objects[1000];
+	unsigned int i;
+
+	assert(!l_mempool_new(0));
+	assert(!l_mempool_alloc(NULL));
+	l_mempool_free(NULL, NULL);
+	l_mempool_destroy(NULL);
+
+	pool = l_mempool_new(sizeof(struct test_object));
+	assert(pool);
+
+	for (i = 0; i < L_ARRAY_SIZE(objects); i++) {
+		unsigned int j;
+
+		objects[i] = l_mempool_alloc(pool);
+		assert(objects[i]);
+
+		assert(objects[i]->id == 0);
+		for (j = 0; j < sizeof(objects[i]->payload); j++)
+			assert(objects[i]->payload[j] == 0);
+
+		objects[i]->id = i;
+		memset(objects[i]->payload, 0xff, sizeof(objects[i]->payload));
+	}
+
+	for (i = 0; i < L_ARRAY_SIZE(objects); i++)
+		assert(objects[i]->id == i);
+
+	for (i = 0; i < L_ARRAY_SIZE(objects); i += 2)
+		l_mempool_free(pool, objects[i]);
+
+	for (i = 0; i < L_ARRAY_SIZE(objects); i += 2) {
+		objects[i] = l_mempool_alloc(pool);
+		assert(objects[i]->id == 0);
+		objects[i]->id = i;
+	}
+
+	for (i = 0; i < L_ARRAY_SIZE(objects); i++)
+		assert(objects[i]->id == i);
+
+	l_mempool_free(pool, NULL);
+	l_mempool_destroy(pool);
+}
+
+static void test_mempool_large(const void *data)
+{
+	struct l_mempool *pool;
+	uint8_t *objects[32];
+	unsigned int i;
+
+	pool = l_mempool_new(3000);
+	assert(pool);
+
+	for (i = 0; i < L_ARRAY_SIZE(objects); i++) {
+		objects[i] = l_mempool_alloc(pool);
+		assert(objects[i][0] == 0 && objects[i][2999] == 0);
+		memset(objects[i], i, 3000);
+	}
+
+	for (i = 0; i < L_ARRAY_SIZE(objects); i++)
+		assert(objects[i][0] == i && objects[i][2999] == i);
+
+	l_mempool_destroy(pool);
+}
+
+#define THREAD_ITERATIONS 100000
+
+static void *size_class_thread(void *user_data)
+{
+	size_t size = L_PTR_TO_UINT(user_data);
+	uint8_t *objects[64];
+	unsigned int i;
+	unsigned int n;
+
+	for (n = 0; n < THREAD_ITERATIONS; n++) {
+		unsigned int count = n % L_ARRAY_SIZE(objects) + 1;
+
+		for (i = 0; i < count; i++) {
+			objects[i] = mempool_alloc(size);
+			assert(objects[i][0] == 0 && objects[i][size - 1] == 0);
+			objects[i][0] = i + 1;
+			objects[i][size - 1] = i + 1;
+		}
+
+		for (i = 0; i < count; i++) {
+			assert(objects[i][0] == i + 1);
+			assert(objects[i][size - 1] == i + 1);
+			mempool_free(objects[i], size);
+		}
+	}
+
+	return NULL;
+}
+
+static void test_mempool_size_classes(const void *data)
+{
+	static const size_t sizes[] = { 1, 16, 17, 24, 40, 64, 100, 128, 129,
+									4096 };
+	pthread_t threads[L_ARRAY_SIZE(sizes)];
+	struct l_queue *queue;
+	unsigned int i;
+
+	for (i = 0; i < L_ARRAY_SIZE(sizes); i++)
+		assert(!pthread_create(&threads[i], NULL, size_class_thread,
+						L_UINT_TO_PTR(sizes[i])));
+
+	/* Pooled entries handed back by one thread get reused by others */
+	queue = l_queue_new();
+
+	for (i = 0; i < THREAD_ITERATIONS; i++)
+		l_queue_push_tail(queue, L_UINT_TO_PTR(i));
+
+	for (i = 0; i < THREAD_ITERATIONS; i++)
+		assert(l_queue_pop_head(queue) == L_UINT_TO_PTR(i));
+
+	l_queue_destroy(queue, NULL);
+
+	for (i = 0; i < L_ARRAY_SIZE(sizes); i++)
+		assert(!pthread_join(threads[i], NULL));
+}
+
+#define EXIT_OBJECT_SIZE	80
+#define EXIT_THREADS		100
+
+static void *thread_exit_thread(void *user_data)
+{
+	void *objects[100];
+	unsigned int i;
+
+	for (i = 0; i < L_ARRAY_SIZE(objects); i++)
+		objects[i] = mempool_alloc(EXIT_OBJECT_SIZE);
+
+	for (i = 0; i < L_ARRAY_SIZE(objects); i++)
+		mempool_free(objects[i], EXIT_OBJECT_SIZE);
+
+	return NULL;
+}
+
+static void test_mempool_thread_exit(const void *data)
+{
+	unsigned int slabs = 0;
+	unsigned int i;
+
+	/* The objects cached by exiting threads are reused by the next ones */
+	for (i = 0; i < EXIT_THREADS; i++) {
+		pthread_t thread;
+
+		assert(!pthread_create(&thread, NULL, thread_exit_thread,
+									NULL));
+		assert(!pthread_join(thread, NULL));
+
+		if (!i)
+			slabs = mempool_slab_count(EXIT_OBJECT_SIZE);
+	}
+
+	assert(mempool_slab_count(EXIT_OBJECT_SIZE) == slabs);
+}
+
+int main(int argc, char *argv[])
+{
+	l_test_init(&argc, &argv);
+
+	l_test_add("mempool", test_mempool, NULL);
+	l_test_add("mempool large objects", test_mempool_large, NULL);
+	l_test_add("mempool size classes", test_mempool_size_classes, NULL);
+	l_test_add("mempool thread exit", test_mempool_thread_exit, NULL);
+
+	return l_test_run();
+}
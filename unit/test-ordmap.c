@@ -0,0 +1,244 @@
+/*
+ *
+ *  Embedded Linux library
+ *
+ *  Copyright (C) 2019  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ell/ell.h>
+
+#define N_KEYS 2000
+
+static void test_basic(const void *data)
+{
+	struct l_ordmap *map;
+	unsigned int i;
+
+	map = l_ordmap_new(NULL);
+	assert(map);
+	assert(l_ordmap_isempty(map));
+	assert(!l_ordmap_lookup(map, L_UINT_TO_PTR(1)));
+	assert(!l_ordmap_remove(map, L_UINT_TO_PTR(1)));
+
+	for (i = 1; i <= N_KEYS; i++)
+		assert(l_ordmap_insert(map, L_UINT_TO_PTR(i * 2),
+						L_UINT_TO_PTR(i)));
+
+	assert(!l_ordmap_insert(map, L_UINT_TO_PTR(2), L_UINT_TO_PTR(5)));
+	assert(l_ordmap_size(map) == N_KEYS);
+
+	for (i = 1; i <= N_KEYS; i++) {
+		assert(l_ordmap_lookup(map, L_UINT_TO_PTR(i * 2)) ==
+							L_UINT_TO_PTR(i));
+		assert(!l_ordmap_lookup(map, L_UINT_TO_PTR(i * 2 + 1)));
+	}
+
+	for (i = N_KEYS; i >= 1; i--)
+		assert(l_ordmap_remove(map, L_UINT_TO_PTR(i * 2)) ==
+							L_UINT_TO_PTR(i));
+
+	assert(l_ordmap_isempty(map));
+	l_ordmap_destroy(map, NULL);
+}
+
+static void test_bounds(const void *data)
+{
+	struct l_ordmap *map = l_ordmap_new(NULL);
+	struct l_ordmap_iter iter;
+	unsigned int i;
+
+	assert(!l_ordmap_iter_first(&iter, map));
+	assert(!l_ordmap_iter_lower_bound(&iter, map, L_UINT_TO_PTR(3)));
+
+	for (i = 1; i <= N_KEYS; i++)
+		l_ordmap_insert(map, L_UINT_TO_PTR(i * 10), L_UINT_TO_PTR(i));
+
+	assert(l_ordmap_iter_lower_bound(&iter, map, L_UINT_TO_PTR(0)));
+	assert(iter.key == L_UINT_TO_PTR(10));
+
+	for (i = 1; i < N_KEYS; i++) {
+		assert(l_ordmap_iter_lower_bound(&iter, map,
+						L_UINT_TO_PTR(i * 10)));
+		assert(iter.key == L_UINT_TO_PTR(i * 10));
+		assert(iter.value == L_UINT_TO_PTR(i));
+
+		assert(l_ordmap_iter_upper_bound(&iter, map,
+						L_UINT_TO_PTR(i * 10)));
+		assert(iter.key == L_UINT_TO_PTR(i * 10 + 10));
+
+		assert(l_ordmap_iter_lower_bound(&iter, map,
+						L_UINT_TO_PTR(i * 10 + 5)));
+		assert(iter.key == L_UINT_TO_PTR(i * 10 + 10));
+	}
+
+	assert(!l_ordmap_iter_upper_bound(&iter, map,
+						L_UINT_TO_PTR(N_KEYS * 10)));
+	assert(!l_ordmap_iter_lower_bound(&iter, map,
+						L_UINT_TO_PTR(N_KEYS * 10 + 1)));
+
+	l_ordmap_destroy(map, NULL);
+}
+
+static int compare_str(const void *a, const void *b)
+{
+	return strcmp(a, b);
+}
+
+static void foreach_str(const void *key, void *value, void *user_data)
+{
+	const char **last = user_data;
+
+	assert(!*last || strcmp(*last, key) < 0);
+	*last = key;
+}
+
+static void test_compare(const void *data)
+{
+	static const char *words[] = {
+		"pear", "apple", "fig", "banana", "cherry", "date", "grape",
+		"kiwi", "lemon", "mango", "nectarine", "orange", "plum",
+		"quince", "raspberry", "strawberry", "tangerine", "ugli",
+	};
+	struct l_ordmap *map = l_ordmap_new(compare_str);
+	struct l_ordmap_iter iter;
+	const char *last = NULL;
+	unsigned int i;
+
+	for (i = 0; i < L_ARRAY_SIZE(words); i++)
+		assert(l_ordmap_insert(map, words[i], (void *) words[i]));
+
+	l_ordmap_foreach(map, foreach_str, &last);
+	assert(!strcmp(last, "ugli"));
+
+	assert(l_ordmap_iter_lower_bound(&iter, map, "c"));
+	assert(!strcmp(iter.key, "cherry"));
+	assert(l_ordmap_iter_next(&iter));
+	assert(!strcmp(iter.key, "date"));
+
+	assert(l_ordmap_lookup(map, "kiwi") == words[7]);
+
+	l_ordmap_destroy(map, NULL);
+}
+
+static bool remove_odd(const void *key, void *value, void *user_data)
+{
+	return L_PTR_TO_UINT(key) & 1;
+}
+
+static void test_iter_remove(const void *data)
+{
+	struct l_ordmap *map = l_ordmap_new(NULL);
+	struct l_ordmap_iter iter;
+	unsigned int i;
+	bool valid;
+
+	for (i = 0; i < N_KEYS; i++)
+		l_ordmap_insert(map, L_UINT_TO_PTR(i), L_UINT_TO_PTR(i + 1));
+
+	assert(l_ordmap_foreach_remove(map, remove_odd, NULL) == N_KEYS / 2);
+	assert(l_ordmap_size(map) == N_KEYS / 2);
+
+	/* Remove every other remaining entry while walking the map */
+	i = 0;
+
+	for (valid = l_ordmap_iter_first(&iter, map); valid;
+					valid = l_ordmap_iter_next(&iter)) {
+		assert(iter.key == L_UINT_TO_PTR(i * 2));
+
+		if (i++ % 2 == 0)
+			assert(l_ordmap_iter_remove(&iter) ==
+						L_UINT_TO_PTR(i * 2 - 1));
+	}
+
+	assert(i == N_KEYS / 2);
+	assert(l_ordmap_size(map) == N_KEYS / 4);
+
+	for (valid = l_ordmap_iter_first(&iter, map); valid;
+					valid = l_ordmap_iter_next(&iter))
+		assert(l_ordmap_iter_remove(&iter));
+
+	assert(l_ordmap_isempty(map));
+	l_ordmap_destroy(map, NULL);
+}
+
+static void test_random(const void *data)
+{
+	struct l_ordmap *map = l_ordmap_new(NULL);
+	struct l_ordmap_iter iter;
+	static bool present[4096];
+	unsigned int i, k, count = 0;
+	bool valid;
+
+	srand(42);
+
+	for (i = 0; i < 50000; i++) {
+		k = rand() % L_ARRAY_SIZE(present);
+
+		if (rand() % 3) {
+			assert(l_ordmap_insert(map, L_UINT_TO_PTR(k),
+					L_UINT_TO_PTR(k + 1)) == !present[k]);
+			count += !present[k];
+			present[k] = true;
+		} else {
+			assert(l_ordmap_remove(map, L_UINT_TO_PTR(k)) ==
+					(present[k] ? L_UINT_TO_PTR(k + 1) :
+									NULL));
+			count -= present[k];
+			present[k] = false;
+		}
+
+		assert(l_ordmap_size(map) == count);
+	}
+
+	k = 0;
+
+	for (valid = l_ordmap_iter_first(&iter, map); valid;
+					valid = l_ordmap_iter_next(&iter)) {
+		while (!present[k])
+			k++;
+
+		assert(iter.key == L_UINT_TO_PTR(k));
+		assert(iter.value == L_UINT_TO_PTR(k + 1));
+		k++;
+	}
+
+	while (k < L_ARRAY_SIZE(present))
+		assert(!present[k++]);
+
+	l_ordmap_destroy(map, NULL);
+}
+
+int main(int argc, char *argv[])
+{
+	l_test_init(&argc, &argv);
+
+	l_test_add("ordmap", test_basic, NULL);
+	l_test_add("ordmap bounds", test_bounds, NULL);
+	l_test_add("ordmap compare func", test_compare, NULL);
+	l_test_add("ordmap iterator remove", test_iter_remove, NULL);
+	l_test_add("ordmap random", test_random, NULL);
+
+	return l_test_run();
+}
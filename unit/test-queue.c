@@ -103,12 +103,109 @@ static void test_insert(const void *data)
 	l_queue_destroy(queue, NULL);
 }
 
+struct sort_item {
+	int key;
+	unsigned int order;
+};
+
+static int sort_item_compare(const void *a, const void *b, void *user)
+{
+	const struct sort_item *ia = a;
+	const struct sort_item *ib = b;
+
+	return ia->key - ib->key;
+}
+
+static void test_sort(const void *data)
+{
+	int unsorted[] = { 30, 0, 50, 10, 20, 30, 5, 30, 0 };
+	int sorted[] = { 0, 0, 5, 10, 20, 30, 30, 30, 50 };
+	struct sort_item items[L_ARRAY_SIZE(unsorted)];
+	struct l_queue *queue;
+	const struct l_queue_entry *entry;
+	const struct sort_item *prev = NULL;
+	unsigned int i;
+
+	queue = l_queue_new();
+	assert(queue);
+
+	assert(l_queue_sort(queue, sort_item_compare, NULL));
+	assert(l_queue_isempty(queue));
+
+	for (i = 0; i < L_ARRAY_SIZE(unsorted); i++) {
+		items[i].key = unsorted[i];
+		items[i].order = i;
+		l_queue_push_tail(queue, &items[i]);
+	}
+
+	assert(l_queue_sort(queue, sort_item_compare, NULL));
+	assert(l_queue_length(queue) == L_ARRAY_SIZE(unsorted));
+
+	for (i = 0, entry = l_queue_get_entries(queue); entry;
+					entry = entry->next, i++) {
+		const struct sort_item *item = entry->data;
+
+		assert(item->key == sorted[i]);
+
+		if (prev && prev->key == item->key)
+			assert(prev->order < item->order);
+
+		prev = item;
+	}
+
+	assert(i == L_ARRAY_SIZE(sorted));
+	assert(l_queue_peek_tail(queue) == prev);
+
+	/* The queue must still be usable after being relinked */
+	l_queue_push_tail(queue, &items[0]);
+	assert(l_queue_peek_tail(queue) == &items[0]);
+
+	l_queue_destroy(queue, NULL);
+}
+
+static void test_sort_large(const void *data)
+{
+	unsigned int count = L_PTR_TO_UINT(data);
+	struct l_queue *queue;
+	const struct l_queue_entry *entry;
+	uint32_t seed = 1;
+	unsigned int i;
+	int prev = -1;
+
+	queue = l_queue_new();
+	assert(queue);
+
+	for (i = 0; i < count; i++) {
+		seed = seed * 1103515245 + 12345;
+		l_queue_push_tail(queue, L_INT_TO_PTR((seed >> 1) & 0xfffff));
+	}
+
+	assert(l_queue_sort(queue, queue_compare, NULL));
+	assert(l_queue_length(queue) == count);
+
+	for (i = 0, entry = l_queue_get_entries(queue); entry;
+					entry = entry->next, i++) {
+		int n = L_PTR_TO_INT(entry->data);
+
+		assert(n >= prev);
+		prev = n;
+	}
+
+	assert(i == count);
+	assert(L_PTR_TO_INT(l_queue_peek_tail(queue)) == prev);
+
+	l_queue_destroy(queue, NULL);
+}
+
 int main(int argc, char *argv[])
 {
 	l_test_init(&argc, &argv);
 
 	l_test_add("queue push & pop", test_push_pop, NULL);
 	l_test_add("queue insert", test_insert, NULL);
+	l_test_add("queue sort", test_sort, NULL);
+	l_test_add("queue sort 1M entries", test_sort_large,
+						L_UINT_TO_PTR(1000000));
 
 	return l_test_run();
 }
@@ -0,0 +1,347 @@
+/*
+ *
+ *  Embedded Linux library
+ *
+ *  Copyright (C) 2019  Intel Corporation. All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ell/ell.h>
+
+static bool radix_insert_str(struct l_radix *radix, const char *key,
+								void *value)
+{
+	return l_radix_insert(radix, key, strlen(key), value);
+}
+
+static void *radix_lookup_str(struct l_radix *radix, const char *key)
+{
+	return l_radix_lookup(radix, key, strlen(key));
+}
+
+static void *radix_remove_str(struct l_radix *radix, const char *key)
+{
+	return l_radix_remove(radix, key, strlen(key));
+}
+
+static void test_radix(const void *data)
+{
+	struct l_radix *radix;
+
+	assert(l_radix_isempty(NULL));
+	assert(!l_radix_insert(NULL, "a", 1, NULL));
+
+	radix = l_radix_new();
+	assert(l_radix_isempty(radix));
+
+	assert(radix_insert_str(radix, "romane", L_UINT_TO_PTR(1)));
+	assert(radix_insert_str(radix, "romanus", L_UINT_TO_PTR(2)));
+	assert(radix_insert_str(radix, "romulus", L_UINT_TO_PTR(3)));
+	assert(radix_insert_str(radix, "rubens", L_UINT_TO_PTR(4)));
+	assert(radix_insert_str(radix, "ruber", L_UINT_TO_PTR(5)));
+	assert(radix_insert_str(radix, "rubicon", L_UINT_TO_PTR(6)));
+	assert(radix_insert_str(radix, "rubicundus", L_UINT_TO_PTR(7)));
+	assert(radix_insert_str(radix, "rub", L_UINT_TO_PTR(8)));
+	assert(radix_insert_str(radix, "", L_UINT_TO_PTR(9)));
+	assert(!radix_insert_str(radix, "ruber", L_UINT_TO_PTR(10)));
+	assert(!radix_insert_str(radix, "rub", L_UINT_TO_PTR(10)));
+
+	assert(l_radix_size(radix) == 9);
+
+	assert(radix_lookup_str(radix, "romane") == L_UINT_TO_PTR(1));
+	assert(radix_lookup_str(radix, "romanus") == L_UINT_TO_PTR(2));
+	assert(radix_lookup_str(radix, "romulus") == L_UINT_TO_PTR(3));
+	assert(radix_lookup_str(radix, "rubens") == L_UINT_TO_PTR(4));
+	assert(radix_lookup_str(radix, "ruber") == L_UINT_TO_PTR(5));
+	assert(radix_lookup_str(radix, "rubicon") == L_UINT_TO_PTR(6));
+	assert(radix_lookup_str(radix, "rubicundus") == L_UINT_TO_PTR(7));
+	assert(radix_lookup_str(radix, "rub") == L_UINT_TO_PTR(8));
+	assert(radix_lookup_str(radix, "") == L_UINT_TO_PTR(9));
+	assert(!radix_lookup_str(radix, "ru"));
+	assert(!radix_lookup_str(radix, "roman"));
+	assert(!radix_lookup_str(radix, "rubiconx"));
+
+	assert(radix_remove_str(radix, "rub") == L_UINT_TO_PTR(8));
+	assert(!radix_remove_str(radix, "rub"));
+	assert(!radix_remove_str(radix, "rubi"));
+	assert(radix_remove_str(radix, "rubicon") == L_UINT_TO_PTR(6));
+	assert(radix_remove_str(radix, "") == L_UINT_TO_PTR(9));
+	assert(l_radix_size(radix) == 6);
+
+	assert(radix_lookup_str(radix, "rubicundus") == L_UINT_TO_PTR(7));
+	assert(radix_lookup_str(radix, "romanus") == L_UINT_TO_PTR(2));
+	assert(!radix_lookup_str(radix, "rub"));
+
+	l_radix_destroy(radix, NULL);
+}
+
+static void test_radix_lookup_prefix(const void *data)
+{
+	struct l_radix *radix = l_radix_new();
+	size_t len;
+
+	assert(radix_insert_str(radix, "/", L_UINT_TO_PTR(1)));
+	assert(radix_insert_str(radix, "/org/", L_UINT_TO_PTR(2)));
+	assert(radix_insert_str(radix, "/org/example/", L_UINT_TO_PTR(3)));
+	assert(radix_insert_str(radix, "/org/example/foo", L_UINT_TO_PTR(4)));
+
+	assert(l_radix_lookup_prefix(radix, "/org/example/foo/bar", 20,
+					&len) == L_UINT_TO_PTR(4));
+	assert(len == 16);
+
+	assert(l_radix_lookup_prefix(radix, "/org/example/fo", 15,
+					&len) == L_UINT_TO_PTR(3));
+	assert(len == 13);
+
+	assert(l_radix_lookup_prefix(radix, "/org/exam", 9,
+					&len) == L_UINT_TO_PTR(2));
+	assert(len == 5);
+
+	assert(l_radix_lookup_prefix(radix, "/net", 4,
+					&len) == L_UINT_TO_PTR(1));
+	assert(len == 1);
+
+	assert(!l_radix_lookup_prefix(radix, "org", 3, NULL));
+	assert(!l_radix_lookup_prefix(radix, "", 0, NULL));
+
+	l_radix_destroy(radix, NULL);
+}
+
+struct collect {
+	char *keys[64];
+	unsigned int count;
+};
+
+static void collect_key(const void *key, size_t len, void *value,
+							void *user_data)
+{
+	struct collect *collect = user_data;
+
+	assert(collect->count < L_ARRAY_SIZE(collect->keys));
+	collect->keys[collect->count++] = l_strndup(key, len);
+}
+
+static void collect_free(struct collect *collect)
+{
+	while (collect->count)
+		l_free(collect->keys[--collect->count]);
+}
+
+static int compare_strings(const void *a, const void *b)
+{
+	return strcmp(*(const char **) a, *(const char **) b);
+}
+
+static void test_radix_foreach(const void *data)
+{
+	static const char *keys[] = { "b", "ab", "abc", "a", "ba", "zz",
+					"abd", "", "abcde", "c", "aa" };
+	const char *sorted[L_ARRAY_SIZE(keys)];
+	struct l_radix *radix = l_radix_new();
+	struct collect collect = {};
+	unsigned int i;
+
+	for (i = 0; i < L_ARRAY_SIZE(keys); i++)
+		assert(radix_insert_str(radix, keys[i], NULL));
+
+	memcpy(sorted, keys, sizeof(keys));
+	qsort(sorted, L_ARRAY_SIZE(sorted), sizeof(char *), compare_strings);
+
+	l_radix_foreach(radix, collect_key, &collect);
+	assert(collect.count == L_ARRAY_SIZE(keys));
+
+	for (i = 0; i < collect.count; i++)
+		assert(!strcmp(collect.keys[i], sorted[i]));
+
+	collect_free(&collect);
+
+	l_radix_foreach_prefix(radix, "ab", 2, collect_key, &collect);
+	assert(collect.count == 4);
+	assert(!strcmp(collect.keys[0], "ab"));
+	assert(!strcmp(collect.keys[1], "abc"));
+	assert(!strcmp(collect.keys[2], "abcde"));
+	assert(!strcmp(collect.keys[3], "abd"));
+	collect_free(&collect);
+
+	l_radix_foreach_prefix(radix, "abcd", 4, collect_key, &collect);
+	assert(collect.count == 1);
+	assert(!strcmp(collect.keys[0], "abcde"));
+	collect_free(&collect);
+
+	l_radix_foreach_prefix(radix, "x", 1, collect_key, &collect);
+	assert(collect.count == 0);
+
+	l_radix_foreach_prefix(radix, "", 0, collect_key, &collect);
+	assert(collect.count == L_ARRAY_SIZE(keys));
+	collect_free(&collect);
+
+	l_radix_destroy(radix, NULL);
+}
+
+#define RANDOM_KEYS 20000
+
+static char *random_key(void)
+{
+	static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz"
+					"ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789/.";
+	char buf[16];
+	unsigned int len = 1 + rand() % (sizeof(buf) - 1);
+	unsigned int i;
+
+	/* Mostly short keys drawn from a small alphabet to share prefixes */
+	for (i = 0; i < len - 1; i++) {
+		if (rand() % 4)
+			buf[i] = alphabet[rand() % 4];
+		else
+			buf[i] = alphabet[rand() % (sizeof(alphabet) - 1)];
+	}
+
+	buf[i] = '\0';
+
+	return l_strdup(buf);
+}
+
+static void test_radix_random(const void *data)
+{
+	struct l_radix *radix = l_radix_new();
+	struct l_hashmap *hashmap = l_hashmap_string_new();
+	char **keys = l_new(char *, RANDOM_KEYS);
+	unsigned int i;
+
+	srand(42);
+
+	for (i = 0; i < RANDOM_KEYS; i++) {
+		bool present;
+
+		keys[i] = random_key();
+		present = l_hashmap_lookup(hashmap, keys[i]);
+
+		assert(radix_insert_str(radix, keys[i],
+					L_UINT_TO_PTR(i + 1)) == !present);
+
+		if (!present)
+			l_hashmap_insert(hashmap, keys[i], L_UINT_TO_PTR(i + 1));
+	}
+
+	assert(l_radix_size(radix) == l_hashmap_size(hashmap));
+
+	for (i = 0; i < RANDOM_KEYS; i++)
+		assert(radix_lookup_str(radix, keys[i]) ==
+					l_hashmap_lookup(hashmap, keys[i]));
+
+	/* Remove every other key, shrinking and merging nodes on the way */
+	for (i = 0; i < RANDOM_KEYS; i += 2) {
+		void *expected = l_hashmap_remove(hashmap, keys[i]);
+
+		assert(radix_remove_str(radix, keys[i]) == expected);
+	}
+
+	assert(l_radix_size(radix) == l_hashmap_size(hashmap));
+
+	for (i = 0; i < RANDOM_KEYS; i++) {
+		void *value = l_hashmap_lookup(hashmap, keys[i]);
+		char *prefix;
+
+		assert(radix_lookup_str(radix, keys[i]) == value);
+
+		/* Any present key is its own longest prefix match */
+		if (!value)
+			continue;
+
+		prefix = l_strdup_printf("%s/extra", keys[i]);
+		assert(l_radix_lookup_prefix(radix, prefix, strlen(prefix),
+								NULL));
+		l_free(prefix);
+	}
+
+	for (i = 1; i < RANDOM_KEYS; i += 2)
+		l_hashmap_remove(hashmap, keys[i]) ;
+
+	for (i = 1; i < RANDOM_KEYS; i += 2)
+		radix_remove_str(radix, keys[i]);
+
+	assert(l_radix_isempty(radix));
+
+	for (i = 0; i < RANDOM_KEYS; i++)
+		l_free(keys[i]);
+
+	l_free(keys);
+	l_hashmap_destroy(hashmap, NULL);
+	l_radix_destroy(radix, NULL);
+}
+
+static void test_radix_wide(const void *data)
+{
+	struct l_radix *radix = l_radix_new();
+	unsigned int i;
+	uint8_t key[2];
+
+	/* Fan out to all 256 byte values to cover every node size */
+	for (i = 0; i < 256; i++) {
+		key[0] = i;
+		key[1] = 255 - i;
+		assert(l_radix_insert(radix, key, 2, L_UINT_TO_PTR(i + 1)));
+		assert(l_radix_insert(radix, key, 1, L_UINT_TO_PTR(i + 1000)));
+	}
+
+	for (i = 0; i < 256; i++) {
+		key[0] = i;
+		key[1] = 255 - i;
+		assert(l_radix_lookup(radix, key, 2) == L_UINT_TO_PTR(i + 1));
+		assert(l_radix_lookup(radix, key, 1) ==
+						L_UINT_TO_PTR(i + 1000));
+	}
+
+	for (i = 0; i < 256; i++) {
+		key[0] = i;
+		key[1] = 255 - i;
+		assert(l_radix_remove(radix, key, 2) == L_UINT_TO_PTR(i + 1));
+	}
+
+	for (i = 0; i < 256; i++) {
+		key[0] = 255 - i;
+		assert(l_radix_lookup(radix, key, 1) ==
+					L_UINT_TO_PTR(255 - i + 1000));
+		assert(l_radix_remove(radix, key, 1) ==
+					L_UINT_TO_PTR(255 - i + 1000));
+	}
+
+	assert(l_radix_isempty(radix));
+
+	l_radix_destroy(radix, NULL);
+}
+
+int main(int argc, char *argv[])
+{
+	l_test_init(&argc, &argv);
+
+	l_test_add("radix", test_radix, NULL);
+	l_test_add("radix longest prefix", test_radix_lookup_prefix, NULL);
+	l_test_add("radix foreach", test_radix_foreach, NULL);
+	l_test_add("radix random", test_radix_random, NULL);
+	l_test_add("radix wide", test_radix_wide, NULL);
+
+	return l_test_run();
+}
@@ -28,6 +28,9 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdint.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
 #include <assert.h>
 
 #include <ell/ell.h>
@@ -131,6 +134,273 @@ static void test_printf(const void *data)
 	l_ringbuf_free(rb);
 }
 
+static void ringbuf_copy(struct l_ringbuf *rb, size_t offset, char *buf,
+								size_t count)
+{
+	size_t i, len;
+
+	for (i = 0; i < count; i += len) {
+		char *ptr = l_ringbuf_peek(rb, offset + i, &len);
+
+		len = minsize(len, count - i);
+		memcpy(buf + i, ptr, len);
+	}
+}
+
+static void test_printf_wrap(const void *data)
+{
+	static size_t rb_capa = 512;
+	struct l_ringbuf *rb;
+	char check[512];
+	int i;
+
+	rb = l_ringbuf_new(rb_capa);
+	assert(rb != NULL);
+
+	/* Keep one byte queued so that the output wraps at every offset */
+	assert(l_ringbuf_printf(rb, "%c", '-') == 1);
+
+	for (i = 0; i < 10000; i++) {
+		size_t count = 1 + (i * 7) % (rb_capa - 1);
+		char str[512];
+		size_t len, n;
+
+		for (n = 0; n < count; n++)
+			str[n] = 'a' + (i + n) % 26;
+
+		len = l_ringbuf_printf(rb, "%.*s", (int) count, str);
+		assert(len == count);
+		assert(l_ringbuf_len(rb) == count + 1);
+
+		ringbuf_copy(rb, 1, check, count);
+		assert(!memcmp(check, str, count));
+
+		assert(l_ringbuf_drain(rb, count) == count);
+	}
+
+	/* Output which does not fit must not be committed */
+	assert(l_ringbuf_printf(rb, "%*c", (int) rb_capa, 'x') == -1);
+	assert(l_ringbuf_len(rb) == 1);
+
+	l_ringbuf_free(rb);
+}
+
+static void test_reserve_commit(const void *data)
+{
+	struct l_ringbuf *rb;
+	size_t len;
+	void *ptr;
+	int fds[2];
+
+	rb = l_ringbuf_new(64);
+	assert(rb != NULL);
+
+	/* Move the write position close to the end of the buffer */
+	ptr = l_ringbuf_reserve(rb, &len);
+	assert(ptr != NULL);
+	assert(len == 64);
+	assert(l_ringbuf_commit(rb, 60) == 60);
+	assert(l_ringbuf_drain(rb, 50) == 50);
+
+	ptr = l_ringbuf_reserve(rb, &len);
+	assert(len == 4);
+	memcpy(ptr, "abcd", 4);
+	assert(l_ringbuf_commit(rb, 4) == 4);
+
+	ptr = l_ringbuf_reserve(rb, &len);
+	assert(ptr == l_ringbuf_peek(rb, 0, NULL) - 50);
+	assert(len == 50);
+
+	/* Producers can read straight into the ring */
+	assert(pipe(fds) == 0);
+	assert(write(fds[1], "efgh", 4) == 4);
+	assert(read(fds[0], ptr, len) == 4);
+	assert(l_ringbuf_commit(rb, 4) == 4);
+	assert(l_ringbuf_len(rb) == 18);
+
+	ptr = l_ringbuf_peek(rb, 10, &len);
+	assert(len == 4);
+	assert(!memcmp(ptr, "abcd", 4));
+	ptr = l_ringbuf_peek(rb, 14, &len);
+	assert(!memcmp(ptr, "efgh", 4));
+
+	assert(l_ringbuf_commit(rb, 100) == 46);
+	assert(!l_ringbuf_reserve(rb, &len));
+	assert(l_ringbuf_commit(rb, 1) == 0);
+
+	close(fds[0]);
+	close(fds[1]);
+	l_ringbuf_free(rb);
+
+	assert(!l_ringbuf_reserve(NULL, &len));
+	assert(l_ringbuf_commit(NULL, 1) == 0);
+}
+
+static void test_mirrored(const void *data)
+{
+	struct l_ringbuf *rb;
+	size_t capacity, len;
+	char *ptr;
+	size_t i;
+
+	rb = l_ringbuf_new_mirrored(100);
+	if (!rb) {
+		l_info("Mirrored ring buffers not supported, skipping...");
+		return;
+	}
+
+	capacity = l_ringbuf_capacity(rb);
+	assert(capacity >= 100);
+	assert(!(capacity & (capacity - 1)));
+
+	/* Leave 5 bytes before the end, then write across the wrap */
+	assert(l_ringbuf_commit(rb, capacity - 5) == capacity - 5);
+	assert(l_ringbuf_drain(rb, capacity - 15) == capacity - 15);
+
+	assert(l_ringbuf_printf(rb, "%s", "0123456789") == 10);
+	assert(l_ringbuf_drain(rb, 10) == 10);
+
+	ptr = l_ringbuf_peek(rb, 0, &len);
+	assert(len == 10);
+	assert(!memcmp(ptr, "0123456789", 10));
+
+	ptr = l_ringbuf_reserve(rb, &len);
+	assert(ptr != NULL);
+	assert(len == capacity - 10);
+
+	for (i = 0; i < 26; i++)
+		ptr[i] = 'a' + i;
+
+	assert(l_ringbuf_commit(rb, 26) == 26);
+
+	ptr = l_ringbuf_peek(rb, 0, &len);
+	assert(len == 36);
+	assert(!memcmp(ptr, "0123456789abcdefghijklmnopqrstuvwxyz", 36));
+
+	ptr = l_ringbuf_peek(rb, 10, NULL);
+	assert(!memcmp(ptr, "abcdefghijklmnopqrstuvwxyz", 26));
+
+	l_ringbuf_free(rb);
+}
+
+#define SPSC_RECORDS 200000
+
+static void *spsc_producer(void *user_data)
+{
+	struct l_ringbuf *rb = user_data;
+	unsigned int i = 0;
+
+	while (i < SPSC_RECORDS) {
+		if (l_ringbuf_avail(rb) < 9) {
+			sched_yield();
+			continue;
+		}
+
+		assert(l_ringbuf_printf(rb, "%08x\n", i) == 9);
+		i++;
+	}
+
+	return NULL;
+}
+
+static void test_spsc(const void *data)
+{
+	struct l_ringbuf *rb;
+	pthread_t thread;
+	struct pollfd pfd;
+	unsigned int expected = 0;
+	unsigned int wakeups = 0;
+	unsigned int armed = 0;
+	char record[10];
+
+	rb = l_ringbuf_new(4096);
+	assert(rb != NULL);
+	assert(l_ringbuf_get_notify_fd(rb) == -1);
+	assert(!l_ringbuf_arm_notify(rb));
+
+	assert(l_ringbuf_enable_spsc(rb));
+	assert(l_ringbuf_get_notify_fd(rb) >= 0);
+
+	pfd.fd = l_ringbuf_get_notify_fd(rb);
+	pfd.events = POLLIN;
+
+	assert(pthread_create(&thread, NULL, spsc_producer, rb) == 0);
+
+	while (expected < SPSC_RECORDS) {
+		while (l_ringbuf_len(rb) >= 9) {
+			size_t len, i;
+			char *ptr;
+
+			for (i = 0; i < 9; i += len) {
+				ptr = l_ringbuf_peek(rb, i, &len);
+				len = minsize(len, 9 - i);
+				memcpy(record + i, ptr, len);
+			}
+
+			record[9] = '\0';
+			assert(strtoul(record, NULL, 16) == expected);
+			assert(l_ringbuf_drain(rb, 9) == 9);
+			expected++;
+		}
+
+		if (expected == SPSC_RECORDS)
+			break;
+
+		if (!l_ringbuf_arm_notify(rb))
+			continue;
+
+		armed++;
+		assert(poll(&pfd, 1, 10000) == 1);
+		wakeups++;
+	}
+
+	assert(pthread_join(thread, NULL) == 0);
+	assert(l_ringbuf_len(rb) == 0);
+	assert(wakeups == armed);
+
+	l_ringbuf_free(rb);
+}
+
+static void test_spsc_notify(const void *data)
+{
+	struct l_ringbuf *rb;
+	struct pollfd pfd;
+	uint64_t count;
+	size_t len;
+	void *ptr;
+
+	rb = l_ringbuf_new(4096);
+	assert(rb != NULL);
+	assert(l_ringbuf_enable_spsc(rb));
+
+	pfd.fd = l_ringbuf_get_notify_fd(rb);
+	pfd.events = POLLIN;
+
+	/* Without an armed consumer the producer never signals */
+	assert(l_ringbuf_printf(rb, "abc") == 3);
+	assert(poll(&pfd, 1, 0) == 0);
+
+	/* Arming with data pending must tell the consumer to drain first */
+	assert(!l_ringbuf_arm_notify(rb));
+	assert(l_ringbuf_drain(rb, 3) == 3);
+
+	assert(l_ringbuf_arm_notify(rb));
+	assert(poll(&pfd, 1, 0) == 0);
+
+	/* The first write wakes the consumer, later ones do not signal again */
+	assert(l_ringbuf_printf(rb, "abc") == 3);
+	assert(poll(&pfd, 1, 0) == 1);
+	assert(l_ringbuf_printf(rb, "def") == 3);
+	ptr = l_ringbuf_reserve(rb, &len);
+	assert(ptr != NULL && len >= 3);
+	memcpy(ptr, "ghi", 3);
+	assert(l_ringbuf_commit(rb, 3) == 3);
+	assert(read(pfd.fd, &count, sizeof(count)) == sizeof(count));
+	assert(count == 1);
+
+	l_ringbuf_free(rb);
+}
+
 int main(int argc, char *argv[])
 {
 	l_test_init(&argc, &argv);
@@ -138,6 +408,11 @@ int main(int argc, char *argv[])
 	l_test_add("/ringbuf/power2", test_power2, NULL);
 	l_test_add("/ringbuf/alloc", test_alloc, NULL);
 	l_test_add("/ringbuf/printf", test_printf, NULL);
+	l_test_add("/ringbuf/printf-wrap", test_printf_wrap, NULL);
+	l_test_add("/ringbuf/reserve-commit", test_reserve_commit, NULL);
+	l_test_add("/ringbuf/mirrored", test_mirrored, NULL);
+	l_test_add("/ringbuf/spsc", test_spsc, NULL);
+	l_test_add("/ringbuf/spsc-notify", test_spsc_notify, NULL);
 
 	return l_test_run();
 
@@ -27,6 +27,10 @@
 #include <assert.h>
 #include <stdio.h>
 #include <limits.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 
 #include <ell/ell.h>
 
@@ -188,6 +192,80 @@ static void test_load_from_file(const void *test_data)
 	l_settings_free(settings);
 }
 
+static void test_load_nocopy(const void *test_data)
+{
+	struct l_settings *settings;
+	const char *value;
+	char *data, *res;
+	size_t len = strlen(data2);
+	char dir[] = "/tmp/ell-test-settings-XXXXXX";
+	char *filename;
+	int fd;
+
+	settings = l_settings_new();
+	l_settings_set_debug(settings, settings_debug, NULL, NULL);
+	assert(l_settings_load_from_data_nocopy(settings, data1,
+							strlen(data1)));
+	test_settings(settings);
+	l_settings_free(settings);
+
+	settings = l_settings_new();
+	l_settings_set_debug(settings, settings_debug, NULL, NULL);
+	assert(l_settings_load_from_file_nocopy(settings,
+						UNITDIR "settings.test"));
+	test_settings(settings);
+	l_settings_free(settings);
+
+	/* The buffer is not NUL terminated after the last value */
+	data = l_memdup(data2, len);
+	data[len - 1] = 'X';
+
+	settings = l_settings_new();
+	assert(l_settings_load_from_data_nocopy(settings, data, len));
+
+	value = l_settings_get_value(settings, "Group2", "Key");
+	assert(!strcmp(value, "ValueX"));
+	assert(l_settings_get_value(settings, "Group2", "Key") == value);
+
+	assert(l_settings_set_value(settings, "Group1", "Key", "Changed"));
+	assert(l_settings_remove_key(settings, "Group1", "IntegerA"));
+
+	res = l_settings_to_data(settings, NULL);
+	assert(l_str_has_prefix(res, "[Group1]\nKey=Changed\nIntegerB="));
+	assert(l_str_has_suffix(res, "\n\n[Group2]\nKey=ValueX\n"));
+	l_free(res);
+
+	l_settings_free(settings);
+	l_free(data);
+
+	/* Rewriting the file in place doesn't affect a loaded file */
+	assert(mkdtemp(dir));
+	filename = l_strdup_printf("%s/test.conf", dir);
+	fd = open(filename, O_WRONLY | O_CREAT | O_EXCL, 0600);
+	assert(fd >= 0);
+	assert(write(fd, data2, len) == (ssize_t) len);
+	close(fd);
+
+	settings = l_settings_new();
+	assert(l_settings_load_from_file_nocopy(settings, filename));
+
+	fd = open(filename, O_WRONLY);
+	assert(fd >= 0);
+	assert(pwrite(fd, "[Other]\nX=Y\n", 13, 0) == 13);
+	assert(!ftruncate(fd, 13));
+	close(fd);
+
+	assert(!strcmp(l_settings_get_value(settings, "Group1", "Key"),
+								"Value"));
+	assert(!strcmp(l_settings_get_value(settings, "Group2", "Key"),
+								"Value"));
+	l_settings_free(settings);
+
+	assert(!unlink(filename));
+	assert(!rmdir(dir));
+	l_free(filename);
+}
+
 static void test_set_methods(const void *test_data)
 {
 	struct l_settings *settings;
@@ -290,6 +368,85 @@ static void test_to_data(const void *test_data)
 	l_settings_free(settings);
 }
 
+static char *read_fd(int fd)
+{
+	char *buf;
+	off_t len = lseek(fd, 0, SEEK_END);
+
+	assert(len >= 0);
+	buf = l_malloc(len + 1);
+	assert(pread(fd, buf, len, 0) == len);
+	buf[len] = '\0';
+
+	return buf;
+}
+
+static void test_write_to_fd(const void *test_data)
+{
+	char dir[] = "/tmp/ell-test-settings-XXXXXX";
+	struct l_settings *settings;
+	struct stat st;
+	char *filename;
+	char *data;
+	char *res;
+	FILE *f;
+	int i;
+
+	settings = l_settings_new();
+	l_settings_load_from_data(settings, data2, strlen(data2));
+
+	/* More strings than fit into one writev */
+	for (i = 0; i < 100; i++) {
+		char key[16];
+
+		sprintf(key, "Key%d", i);
+		assert(l_settings_set_int(settings, "Many", key, i));
+	}
+
+	data = l_settings_to_data(settings, NULL);
+
+	f = tmpfile();
+	assert(f);
+	assert(l_settings_write_to_fd(settings, fileno(f)));
+	res = read_fd(fileno(f));
+	assert(!strcmp(res, data));
+	assert(!fclose(f));
+	l_free(res);
+
+	l_free(data);
+
+	assert(mkdtemp(dir));
+	filename = l_strdup_printf("%s/test.conf", dir);
+
+	/* A new file is private, an existing one keeps its mode */
+	assert(l_settings_save_atomic(settings, filename));
+	assert(!stat(filename, &st));
+	assert((st.st_mode & 07777) == 0600);
+
+	assert(!chmod(filename, 0644));
+	assert(l_settings_remove_key(settings, "Many", "Key0"));
+	assert(l_settings_save_atomic(settings, filename));
+	assert(!stat(filename, &st));
+	assert((st.st_mode & 07777) == 0644);
+
+	assert(!l_settings_save_atomic(settings, "/nonexistent/test.conf"));
+
+	data = l_settings_to_data(settings, NULL);
+	l_settings_free(settings);
+
+	settings = l_settings_new();
+	assert(l_settings_load_from_file(settings, filename));
+	res = l_settings_to_data(settings, NULL);
+	assert(!strcmp(res, data));
+	l_free(res);
+	l_free(data);
+	l_settings_free(settings);
+
+	assert(!unlink(filename));
+	assert(!rmdir(dir));
+	l_free(filename);
+}
+
 static const char *no_group_data = "key_without_group=value\n";
 static const char *key_before_group_data = "key_without_group=value\n"
 						"[GROUP]\n"
@@ -309,16 +466,424 @@ static void test_invalid_data(const void *test_data)
 	l_settings_free(settings);
 }
 
+static void test_group(const void *test_data)
+{
+	struct l_settings *settings;
+	const struct l_settings_group *group;
+	int int32;
+	int64_t int64;
+	char *str;
+	char **strv;
+
+	settings = l_settings_new();
+	assert(l_settings_load_from_data(settings, data1, strlen(data1)));
+
+	assert(!l_settings_get_group(settings, "Foobar2"));
+	group = l_settings_get_group(settings, "Foobar");
+	assert(group);
+
+	assert(l_settings_group_has_key(group, "Key"));
+	assert(!l_settings_group_has_key(group, "Key2"));
+	assert(!strcmp(l_settings_group_get_value(group, "Key"), "Value"));
+
+	assert(l_settings_group_get_int(group, "IntegerA", &int32));
+	assert(int32 == 2147483647);
+	assert(!l_settings_group_get_int(group, "IntegerG", &int32));
+	assert(l_settings_group_get_int64(group, "IntegerE", &int64));
+	assert(int64 == INT64_MIN);
+
+	str = l_settings_group_get_string(group, "String");
+	assert(str && !strcmp(str, "\tFoobar "));
+	l_free(str);
+
+	strv = l_settings_group_get_string_list(group, "StringList", ',');
+	assert(strv && l_strv_length(strv) == 3);
+	l_strfreev(strv);
+
+	assert(!l_settings_group_get_value(NULL, "Key"));
+	assert(!l_settings_group_get_int(NULL, "IntegerA", &int32));
+
+	l_settings_free(settings);
+}
+
+static const char *duplicate_data = "[A]\nKey=1\nKey=2\nOther=x\n\n"
+					"[B]\nKey=b\n\n"
+					"[A]\nKey=3\n";
+
+static void test_duplicates(const void *test_data)
+{
+	struct l_settings *settings;
+	char *data;
+
+	settings = l_settings_new();
+	assert(l_settings_load_from_data(settings, duplicate_data,
+						strlen(duplicate_data)));
+
+	/* The first occurrence wins */
+	assert(!strcmp(l_settings_get_value(settings, "A", "Key"), "1"));
+
+	assert(l_settings_remove_key(settings, "A", "Key"));
+	assert(!strcmp(l_settings_get_value(settings, "A", "Key"), "2"));
+	assert(l_settings_remove_key(settings, "A", "Key"));
+	assert(!l_settings_has_key(settings, "A", "Key"));
+	assert(!l_settings_remove_key(settings, "A", "Key"));
+
+	assert(l_settings_remove_group(settings, "A"));
+	assert(!strcmp(l_settings_get_value(settings, "A", "Key"), "3"));
+	assert(l_settings_remove_group(settings, "A"));
+	assert(!l_settings_has_group(settings, "A"));
+	assert(!l_settings_remove_group(settings, "A"));
+
+	assert(l_settings_set_value(settings, "A", "Key", "4"));
+	data = l_settings_to_data(settings, NULL);
+	assert(!strcmp(data, "[B]\nKey=b\n\n[A]\nKey=4\n"));
+	l_free(data);
+
+	l_settings_free(settings);
+}
+
+static void test_many(const void *test_data)
+{
+	struct l_settings *settings;
+	struct l_string *expected;
+	char *data, *str;
+	unsigned int i, j;
+
+	settings = l_settings_new();
+	expected = l_string_new(0);
+
+	/* Insert in an order the index doesn't sort into */
+	for (i = 0; i < 200; i++) {
+		char group_name[32];
+
+		snprintf(group_name, sizeof(group_name), "Group%u", 199 - i);
+
+		if (i)
+			l_string_append_c(expected, '\n');
+
+		l_string_append_printf(expected, "[%s]\n", group_name);
+
+		for (j = 0; j < 50; j++) {
+			char key[32];
+
+			snprintf(key, sizeof(key), "Key%u", (j * 7) % 50);
+			assert(l_settings_set_uint(settings, group_name, key,
+								i * j));
+			l_string_append_printf(expected, "%s=%u\n", key,
+								i * j);
+		}
+	}
+
+	for (i = 0; i < 200; i++) {
+		const struct l_settings_group *group;
+		char group_name[32];
+		unsigned int value;
+
+		snprintf(group_name, sizeof(group_name), "Group%u", 199 - i);
+		group = l_settings_get_group(settings, group_name);
+		assert(group);
+
+		for (j = 0; j < 50; j++) {
+			char key[32];
+
+			snprintf(key, sizeof(key), "Key%u", (j * 7) % 50);
+			assert(l_settings_group_get_uint(group, key, &value));
+			assert(value == i * j);
+		}
+	}
+
+	data = l_settings_to_data(settings, NULL);
+	str = l_string_unwrap(expected);
+	assert(!strcmp(data, str));
+	l_free(data);
+	l_free(str);
+
+	l_settings_free(settings);
+}
+
+static struct l_string *watch_events;
+
+static void watch_event(const char *group_name, const char *key,
+				enum l_settings_watch_event event,
+				void *user_data)
+{
+	static const char event_str[] = "+*-";
+
+	l_string_append_printf(watch_events, "%c%s%s%s\n", event_str[event],
+					group_name, key ? "/" : "", key ? : "");
+}
+
+static char *watch_wait(void)
+{
+	char *str;
+	int i;
+
+	for (i = 0; i < 50 && !l_string_length(watch_events); i++)
+		l_main_iterate(100);
+
+	str = l_string_unwrap(watch_events);
+	watch_events = l_string_new(64);
+
+	return str;
+}
+
+static void watch_write(const char *filename, const char *data)
+{
+	char *tmp = l_strdup_printf("%s.tmp", filename);
+	FILE *f;
+
+	f = fopen(tmp, "w");
+	assert(f);
+	assert(fputs(data, f) >= 0);
+	assert(!fclose(f));
+	assert(!rename(tmp, filename));
+
+	l_free(tmp);
+}
+
+static void test_watch(const void *test_data)
+{
+	char dir[] = "/tmp/ell-test-settings-XXXXXX";
+	struct l_settings_watch *watch;
+	const struct l_settings *settings;
+	char *filename;
+	char *str;
+
+	assert(mkdtemp(dir));
+	filename = l_strdup_printf("%s/test.conf", dir);
+	watch_events = l_string_new(64);
+
+	/* The initial load is not reported, a missing file is empty */
+	watch = l_settings_watch_new(filename, watch_event, NULL, NULL);
+	assert(watch);
+
+	settings = l_settings_watch_get_settings(watch);
+	assert(settings);
+	assert(!l_settings_has_group(settings, "Group1"));
+
+	watch_write(filename, "[Group1]\nKey1=A\nKey2=B\n[Group2]\nKey=C\n");
+	str = watch_wait();
+	assert(!strcmp(str, "+Group1\n+Group1/Key1\n+Group1/Key2\n"
+					"+Group2\n+Group2/Key\n"));
+	l_free(str);
+
+	settings = l_settings_watch_get_settings(watch);
+	assert(!strcmp(l_settings_get_value(settings, "Group1", "Key2"), "B"));
+
+	/* Neither unchanged contents nor a file failing to parse count */
+	watch_write(filename, "[Group1]\nKey1=A\nKey2=B\n[Group2]\nKey=C\n");
+	watch_write(filename, "Key=Value\n");
+	watch_write(filename, "[Group1]\nKey1=A\nKey2=X\nKey3=Y\n"
+					"[Group3]\nKey=D\n");
+	str = watch_wait();
+	assert(!strcmp(str, "*Group1/Key2\n+Group1/Key3\n*Group1\n"
+				"+Group3\n+Group3/Key\n"
+				"-Group2/Key\n-Group2\n"));
+	l_free(str);
+
+	settings = l_settings_watch_get_settings(watch);
+	assert(!strcmp(l_settings_get_value(settings, "Group3", "Key"), "D"));
+	assert(!l_settings_has_group(settings, "Group2"));
+
+	assert(!unlink(filename));
+	str = watch_wait();
+	assert(!strcmp(str, "-Group1/Key1\n-Group1/Key2\n-Group1/Key3\n"
+				"-Group1\n-Group3/Key\n-Group3\n"));
+	l_free(str);
+
+	l_settings_watch_destroy(watch);
+	l_string_free(watch_events);
+
+	l_free(filename);
+	assert(!rmdir(dir));
+}
+
+static struct l_settings_watch *destroy_watch;
+static unsigned int destroy_calls;
+
+static void watch_destroy_event(const char *group_name, const char *key,
+				enum l_settings_watch_event event,
+				void *user_data)
+{
+	watch_event(group_name, key, event, user_data);
+
+	/* The remaining events of this change are not reported */
+	l_settings_watch_destroy(destroy_watch);
+}
+
+static void watch_destroyed(void *user_data)
+{
+	destroy_calls += 1;
+}
+
+static void test_watch_destroy(const void *test_data)
+{
+	char dir[] = "/tmp/ell-test-settings-XXXXXX";
+	char *filename;
+	char *str;
+	int i;
+
+	assert(mkdtemp(dir));
+	filename = l_strdup_printf("%s/test.conf", dir);
+	watch_events = l_string_new(64);
+	destroy_calls = 0;
+
+	destroy_watch = l_settings_watch_new(filename, watch_destroy_event,
+						NULL, watch_destroyed);
+	assert(destroy_watch);
+
+	watch_write(filename, "[Group1]\nKey1=A\nKey2=B\n");
+	str = watch_wait();
+	assert(!strcmp(str, "+Group1\n"));
+	l_free(str);
+	assert(destroy_calls == 1);
+
+	/* Let the deferred free run, later changes go unnoticed */
+	for (i = 0; i < 5; i++)
+		l_main_iterate(0);
+
+	watch_write(filename, "[Group2]\nKey=C\n");
+
+	for (i = 0; i < 5; i++)
+		l_main_iterate(10);
+
+	assert(!l_string_length(watch_events));
+	assert(destroy_calls == 1);
+	l_string_free(watch_events);
+
+	assert(!unlink(filename));
+	l_free(filename);
+	assert(!rmdir(dir));
+}
+
+static void cache_debug(const char *str, void *user_data)
+{
+	bool *stale = user_data;
+
+	printf("%s\n", str);
+	*stale = true;
+}
+
+static void test_cache(const void *test_data)
+{
+	char dir[] = "/tmp/ell-test-settings-XXXXXX";
+	struct l_settings *settings;
+	struct timespec times[2] = { { 0, UTIME_OMIT }, { 1, 0 } };
+	char *filename;
+	char *cachename;
+	bool stale;
+	FILE *f;
+
+	assert(mkdtemp(dir));
+	filename = l_strdup_printf("%s/test.conf", dir);
+	cachename = l_strdup_printf("%s.cache", filename);
+
+	/* Without a cache the text is parsed */
+	watch_write(filename, data1);
+	settings = l_settings_new();
+	assert(l_settings_load_from_file_cached(settings, filename));
+	test_settings(settings);
+	l_settings_free(settings);
+
+	/* An old mtime is trusted, a recent one makes loads hash the file */
+	assert(!utimensat(AT_FDCWD, filename, times, 0));
+	assert(!l_settings_write_cache(cachename));
+	assert(l_settings_write_cache(filename));
+	assert(!access(cachename, R_OK));
+
+	stale = false;
+	settings = l_settings_new();
+	l_settings_set_debug(settings, cache_debug, &stale, NULL);
+	assert(l_settings_load_from_file_cached(settings, filename));
+	assert(!stale);
+	test_settings(settings);
+	l_settings_free(settings);
+
+	/* Touching the file keeps the cache valid */
+	times[1].tv_sec = 2;
+	assert(!utimensat(AT_FDCWD, filename, times, 0));
+
+	stale = false;
+	settings = l_settings_new();
+	l_settings_set_debug(settings, cache_debug, &stale, NULL);
+	assert(l_settings_load_from_file_cached(settings, filename));
+	assert(!stale);
+	test_settings(settings);
+	l_settings_free(settings);
+
+	/* Same size but different contents */
+	watch_write(filename, "[Group]\nKey=A\n");
+	assert(l_settings_write_cache(filename));
+	watch_write(filename, "[Group]\nKey=B\n");
+
+	stale = false;
+	settings = l_settings_new();
+	l_settings_set_debug(settings, cache_debug, &stale, NULL);
+	assert(l_settings_load_from_file_cached(settings, filename));
+	assert(stale);
+	assert(!strcmp(l_settings_get_value(settings, "Group", "Key"), "B"));
+	l_settings_free(settings);
+
+	/* A damaged cache is ignored */
+	assert(l_settings_write_cache(filename));
+	assert(!truncate(cachename, 100));
+
+	stale = false;
+	settings = l_settings_new();
+	l_settings_set_debug(settings, cache_debug, &stale, NULL);
+	assert(l_settings_load_from_file_cached(settings, filename));
+	assert(stale);
+	assert(!strcmp(l_settings_get_value(settings, "Group", "Key"), "B"));
+	l_settings_free(settings);
+
+	/* An empty file has an empty cache */
+	f = fopen(filename, "w");
+	assert(f);
+	assert(!fclose(f));
+	assert(l_settings_write_cache(filename));
+
+	stale = false;
+	settings = l_settings_new();
+	l_settings_set_debug(settings, cache_debug, &stale, NULL);
+	assert(l_settings_load_from_file_cached(settings, filename));
+	assert(!stale);
+	assert(!l_settings_has_group(settings, "Group"));
+	l_settings_free(settings);
+
+	assert(!unlink(cachename));
+	assert(!unlink(filename));
+	assert(!rmdir(dir));
+	l_free(cachename);
+	l_free(filename);
+}
+
 int main(int argc, char *argv[])
 {
+	int ret;
+
 	l_test_init(&argc, &argv);
 
+	if (!l_main_init())
+		return -1;
+
 	l_test_add("Load from Data", test_load_from_data, NULL);
 	l_test_add("Load from File", test_load_from_file, NULL);
+	l_test_add("Load without Copying", test_load_nocopy, NULL);
 	l_test_add("Set Methods", test_set_methods, NULL);
 	l_test_add("Export to Data 1", test_to_data, data2);
+	l_test_add("Write to File Descriptor", test_write_to_fd, NULL);
+	l_test_add("Group Handle", test_group, NULL);
+	l_test_add("Duplicate Names", test_duplicates, NULL);
+	l_test_add("Many Groups and Keys", test_many, NULL);
+	l_test_add("Watch", test_watch, NULL);
+	l_test_add("Watch destroyed from callback", test_watch_destroy, NULL);
+	l_test_add("Binary Cache", test_cache, NULL);
 	l_test_add("Invalid Data 1", test_invalid_data, no_group_data);
 	l_test_add("Invalid Data 2", test_invalid_data, key_before_group_data);
 
-	return l_test_run();
+	ret = l_test_run();
+
+	l_main_exit();
+
+	return ret;
 }
@@ -25,6 +25,7 @@
 #endif
 
 #include <stdio.h>
+#include <endian.h>
 #include "ell/siphash-private.h"
 
 /*
@@ -103,9 +104,18 @@ static const uint8_t vectors[64][8] = {
 	{ 0x72, 0x45, 0x06, 0xeb, 0x4c, 0x32, 0x8a, 0x95 },
 };
 
+/* SipHash-1-3 of the first n bytes of the same input, for n = 0, 9, 18 ... */
+static const uint64_t vectors13[8] = {
+	0xabac0158050fc4dcULL, 0x25a48eb36c063de4ULL, 0x8ffc389cb473e63eULL,
+	0xa91dc74e4ade3b35ULL, 0x2cf508d3ada26206ULL, 0xc2164bfc9f042196ULL,
+	0x318fb34c73f0bce6ULL, 0x9d199062b7bbb3a8ULL,
+};
+
 int main(int argc, char *argv[])
 {
 	uint8_t in[64], out[8], k[16];
+	uint64_t k13[2];
+	int failed = 0;
 	int i;
 
 	for (i = 0; i < 16; i++)
@@ -116,9 +126,22 @@ int main(int argc, char *argv[])
 
 		_siphash24(out, in, i, k);
 
-		if (memcmp(out, vectors[i], 8))
+		if (memcmp(out, vectors[i], 8)) {
 			printf("[%d] mismatch\n", i);
+			failed++;
+		}
+	}
+
+	memcpy(k13, k, sizeof(k13));
+	k13[0] = le64toh(k13[0]);
+	k13[1] = le64toh(k13[1]);
+
+	for (i = 0; i < 8; i++) {
+		if (_siphash13(in, i * 9, k13) != vectors13[i]) {
+			printf("[%d] SipHash-1-3 mismatch\n", i * 9);
+			failed++;
+		}
 	}
 
-	return 0;
+	return failed ? 1 : 0;
 }
@@ -347,6 +347,332 @@ static void test_uintset_intersect_test(const void *user_data)
 	l_uintset_free(set_r);
 }
 
+static void test_uintset_large_range(const void *data)
+{
+	struct l_uintset *set;
+	size_t empty_usage;
+
+	set = l_uintset_new_from_range(0, UINT32_MAX - 1);
+	assert(set);
+
+	/* Not found is get_max + 1, which must not be an element */
+	assert(l_uintset_find_min(set) == UINT32_MAX);
+	assert(l_uintset_find_max(set) == UINT32_MAX);
+	assert(!l_uintset_put(set, UINT32_MAX));
+	assert(!l_uintset_contains(set, UINT32_MAX));
+
+	empty_usage = l_uintset_get_memory_usage(set);
+
+	assert(l_uintset_put(set, 7));
+	assert(l_uintset_put(set, 0x80000000));
+	assert(l_uintset_put(set, UINT32_MAX - 1));
+
+	assert(l_uintset_contains(set, 7));
+	assert(l_uintset_contains(set, 0x80000000));
+	assert(l_uintset_contains(set, UINT32_MAX - 1));
+	assert(!l_uintset_contains(set, 8));
+
+	assert(l_uintset_find_min(set) == 7);
+	assert(l_uintset_find_max(set) == UINT32_MAX - 1);
+	assert(l_uintset_find_unused_min(set) == 0);
+	assert(l_uintset_find_unused(set, 0x80000000) == 0x80000001);
+	assert(l_uintset_find_unused(set, UINT32_MAX - 1) == 0);
+
+	/* Three sparse chunks must not cost anywhere near a flat bitmap */
+	assert(l_uintset_get_memory_usage(set) < empty_usage + 512);
+
+	assert(l_uintset_take(set, 0x80000000));
+	assert(!l_uintset_contains(set, 0x80000000));
+	assert(l_uintset_take(set, 7));
+	assert(l_uintset_find_min(set) == UINT32_MAX - 1);
+
+	l_uintset_free(set);
+
+	/* A full set at the top of the range has no unused number */
+	set = l_uintset_new_from_range(UINT32_MAX - 2, UINT32_MAX - 1);
+	assert(l_uintset_put(set, UINT32_MAX - 2));
+	assert(l_uintset_put(set, UINT32_MAX - 1));
+	assert(l_uintset_find_unused_min(set) == UINT32_MAX);
+	assert(l_uintset_find_unused(set, UINT32_MAX - 1) == UINT32_MAX);
+	l_uintset_free(set);
+
+	assert(!l_uintset_new_from_range(0, UINT32_MAX));
+	assert(!l_uintset_new_from_range(UINT32_MAX, UINT32_MAX));
+	assert(!l_uintset_new_from_range(10, 9));
+}
+
+static void test_uintset_dense(const void *data)
+{
+	struct l_uintset *set;
+	uint32_t i;
+
+	set = l_uintset_new_from_range(100, 100 + 300000);
+	assert(set);
+
+	for (i = 100; i <= 100 + 300000; i++)
+		assert(l_uintset_put(set, i));
+
+	/* Fully populated ranges collapse into runs */
+	assert(l_uintset_get_memory_usage(set) < 1024);
+	assert(l_uintset_find_unused_min(set) == 100 + 300001);
+	assert(l_uintset_find_min(set) == 100);
+	assert(l_uintset_find_max(set) == 100 + 300000);
+
+	assert(l_uintset_take(set, 200000));
+	assert(l_uintset_find_unused_min(set) == 200000);
+	assert(l_uintset_find_unused(set, 200001) == 200000);
+
+	for (i = 100; i <= 100 + 300000; i += 2)
+		assert(l_uintset_take(set, i));
+
+	for (i = 100; i <= 100 + 300000; i++)
+		assert(l_uintset_contains(set, i) ==
+					(i % 2 == 1 && i != 200000));
+
+	assert(l_uintset_find_unused(set, 101) == 102);
+	assert(l_uintset_find_max(set) == 100 + 299999);
+
+	l_uintset_free(set);
+}
+
+static void uintset_count(uint32_t number, void *user_data)
+{
+	uint32_t *last = user_data;
+
+	assert(number > last[0] || !last[1]);
+	last[0] = number;
+	last[1]++;
+}
+
+static void test_uintset_random(const void *data)
+{
+	static const uint32_t range = 4 * 65536 + 1234;
+	struct l_uintset *set;
+	uint8_t *ref;
+	uint32_t seed = 42;
+	uint32_t count = 0;
+	uint32_t last[2] = { 0, 0 };
+	uint32_t i;
+
+	set = l_uintset_new_from_range(1000, 1000 + range - 1);
+	ref = l_new(uint8_t, range);
+
+	/*
+	 * Mix clustered and scattered updates so that chunks move between
+	 * the array, bitmap and run representations.
+	 */
+	for (i = 0; i < 2000000; i++) {
+		uint32_t n;
+
+		seed = seed * 1103515245 + 12345;
+		n = (seed >> 8) % range;
+
+		if (i % 3)
+			n = ((n & ~0x3fffU) | ((seed >> 4) & 0x1fff)) % range;
+
+		if (seed & 0x80000000) {
+			assert(l_uintset_put(set, 1000 + n));
+			count += !ref[n];
+			ref[n] = 1;
+		} else {
+			assert(l_uintset_take(set, 1000 + n));
+			count -= ref[n];
+			ref[n] = 0;
+		}
+	}
+
+	for (i = 0; i < range; i++)
+		assert(l_uintset_contains(set, 1000 + i) == ref[i]);
+
+	for (i = 0; i < range; i++)
+		if (!ref[i])
+			break;
+
+	assert(l_uintset_find_unused_min(set) == 1000 + i);
+
+	l_uintset_foreach(set, uintset_count, last);
+	assert(last[1] == count);
+
+	l_uintset_free(set);
+	l_free(ref);
+}
+
+static void test_uintset_allocator(const void *data)
+{
+	static const uint32_t count = 500000;
+	struct l_uintset *set;
+	uint32_t id = 1;
+	uint32_t i;
+
+	set = l_uintset_new_from_range(1, count);
+	assert(set);
+
+	for (i = 0; i < count; i++) {
+		id = l_uintset_find_unused(set, id);
+		assert(id == i + 1);
+		assert(l_uintset_put(set, id));
+	}
+
+	assert(l_uintset_find_unused(set, 1) == count + 1);
+	assert(l_uintset_find_unused_min(set) == count + 1);
+	assert(l_uintset_size(set) == count);
+
+	/* Release a spread of IDs and make sure they are handed out again */
+	for (i = 7; i <= count; i += 65537)
+		assert(l_uintset_take(set, i));
+
+	for (i = 7; i <= count; i += 65537) {
+		assert(l_uintset_find_unused(set, 1) == i);
+		assert(l_uintset_put(set, i));
+	}
+
+	assert(l_uintset_take(set, count));
+	assert(l_uintset_find_unused(set, 2) == count);
+	assert(l_uintset_take(set, 3));
+	assert(l_uintset_find_unused(set, count) == count);
+	assert(l_uintset_find_unused(set, 4) == count);
+	assert(l_uintset_put(set, count));
+	assert(l_uintset_find_unused(set, 4) == 3);
+
+	l_uintset_free(set);
+}
+
+struct uintset_algebra {
+	const uint8_t *ref;
+	uint32_t base;
+	uint32_t count;
+};
+
+static void uintset_check_ref(uint32_t number, void *user_data)
+{
+	struct uintset_algebra *check = user_data;
+
+	assert(check->ref[number - check->base]);
+	check->count++;
+}
+
+static void uintset_verify(struct l_uintset *set, const uint8_t *ref,
+						uint32_t base, uint32_t range)
+{
+	struct uintset_algebra check = { ref, base, 0 };
+	uint64_t expected = 0;
+	uint32_t i;
+
+	for (i = 0; i < range; i++)
+		expected += ref[i];
+
+	assert(l_uintset_size(set) == expected);
+
+	l_uintset_foreach(set, uintset_check_ref, &check);
+	assert(check.count == expected);
+}
+
+static void uintset_fill(struct l_uintset *set, uint8_t *ref, uint32_t base,
+				uint32_t chunk, uint32_t density, uint32_t *seed)
+{
+	uint32_t i;
+
+	for (i = chunk * 65536; i < (chunk + 1) * 65536; i++) {
+		*seed = *seed * 1103515245 + 12345;
+
+		if (density == 100 || ((*seed >> 8) % 100) < density) {
+			assert(l_uintset_put(set, base + i));
+			ref[i] = 1;
+		}
+	}
+}
+
+/* Fills @chunk with runs of @len numbers every 100 numbers from @offset */
+static void uintset_fill_runs(struct l_uintset *set, uint8_t *ref,
+				uint32_t base, uint32_t chunk,
+				uint32_t offset, uint32_t len)
+{
+	uint32_t i;
+
+	for (i = chunk * 65536; i < (chunk + 1) * 65536; i++) {
+		if ((i - chunk * 65536 + 100 - offset) % 100 >= len)
+			continue;
+
+		assert(l_uintset_put(set, base + i));
+		ref[i] = 1;
+	}
+}
+
+static void test_uintset_algebra(const void *data)
+{
+	static const uint8_t density_a[] = { 0, 1, 50, 100, 1, 50, 100, 20 };
+	static const uint8_t density_b[] = { 1, 0, 50, 1, 100, 100, 50, 0 };
+	static const uint32_t base = 5;
+	static const uint32_t range = 10 * 65536;
+	struct l_uintset *set_a, *set_b, *set_r;
+	uint8_t *ref_a, *ref_b, *ref_r;
+	uint32_t seed = 7;
+	uint32_t i;
+
+	set_a = l_uintset_new_from_range(base, base + range - 1);
+	set_b = l_uintset_new_from_range(base, base + range - 1);
+	ref_a = l_new(uint8_t, range);
+	ref_b = l_new(uint8_t, range);
+	ref_r = l_new(uint8_t, range);
+
+	for (i = 0; i < L_ARRAY_SIZE(density_a); i++) {
+		uintset_fill(set_a, ref_a, base, i, density_a[i], &seed);
+		uintset_fill(set_b, ref_b, base, i, density_b[i], &seed);
+	}
+
+	/* Add a couple of long runs on top of the random fill */
+	for (i = 7 * 65536 + 100; i < 7 * 65536 + 30000; i++) {
+		assert(l_uintset_put(set_a, base + i));
+		ref_a[i] = 1;
+	}
+
+	/* Partially overlapping runs, and runs against a bitmap */
+	uintset_fill_runs(set_a, ref_a, base, 8, 0, 60);
+	uintset_fill_runs(set_b, ref_b, base, 8, 30, 60);
+	uintset_fill_runs(set_a, ref_a, base, 9, 10, 70);
+	uintset_fill(set_b, ref_b, base, 9, 50, &seed);
+
+	uintset_verify(set_a, ref_a, base, range);
+	uintset_verify(set_b, ref_b, base, range);
+
+	set_r = l_uintset_union(set_a, set_b);
+	for (i = 0; i < range; i++)
+		ref_r[i] = ref_a[i] | ref_b[i];
+	uintset_verify(set_r, ref_r, base, range);
+	l_uintset_free(set_r);
+
+	set_r = l_uintset_difference(set_a, set_b);
+	for (i = 0; i < range; i++)
+		ref_r[i] = ref_a[i] & !ref_b[i];
+	uintset_verify(set_r, ref_r, base, range);
+	l_uintset_free(set_r);
+
+	set_r = l_uintset_intersect(set_a, set_b);
+	for (i = 0; i < range; i++)
+		ref_r[i] = ref_a[i] & ref_b[i];
+	uintset_verify(set_r, ref_r, base, range);
+	l_uintset_free(set_r);
+
+	set_r = l_uintset_clone(set_a);
+	uintset_verify(set_r, ref_a, base, range);
+	assert(l_uintset_take(set_r, base + 3 * 65536));
+	assert(l_uintset_contains(set_a, base + 3 * 65536));
+	assert(l_uintset_find_unused(set_r, base + 3 * 65536) ==
+							base + 3 * 65536);
+	l_uintset_free(set_r);
+
+	assert(!l_uintset_union(set_a, NULL));
+	assert(!l_uintset_difference(NULL, set_b));
+	assert(!l_uintset_clone(NULL));
+	assert(l_uintset_size(NULL) == 0);
+
+	l_uintset_free(set_a);
+	l_uintset_free(set_b);
+	l_free(ref_a);
+	l_free(ref_b);
+	l_free(ref_r);
+}
+
 int main(int argc, char *argv[])
 {
 	l_test_init(&argc, &argv);
@@ -364,6 +690,11 @@ int main(int argc, char *argv[])
 							&intersect_data_1);
 	l_test_add("l_uintset intersect test 2", test_uintset_intersect_test,
 							&intersect_data_2);
+	l_test_add("l_uintset large range", test_uintset_large_range, NULL);
+	l_test_add("l_uintset dense", test_uintset_dense, NULL);
+	l_test_add("l_uintset random", test_uintset_random, NULL);
+	l_test_add("l_uintset allocator", test_uintset_allocator, NULL);
+	l_test_add("l_uintset algebra", test_uintset_algebra, NULL);
 
 	return l_test_run();
 }
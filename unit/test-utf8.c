@@ -905,6 +905,13 @@ static struct utf8_from_utf16_test utf8_from_utf16_test4 = {
 	.utf16_size = 8,
 };
 
+/* U+1F600 and U+10437 need surrogate pairs */
+static struct utf8_from_utf16_test utf8_from_utf16_test5 = {
+	.utf16 = { 0x61, 0xd83d, 0xde00, 0x20ac, 0xd801, 0xdc37, 0x00 },
+	.utf16_size = 14,
+	.utf8 = "a\xf0\x9f\x98\x80\xe2\x82\xac\xf0\x90\x90\xb7",
+};
+
 static void test_utf8_from_utf16(const void *test_data)
 {
 	const struct utf8_from_utf16_test *test = test_data;
@@ -934,6 +941,50 @@ static void test_utf8_to_utf16(const void *test_data)
 	l_free(utf16);
 }
 
+/*
+ * Place a single non-ASCII sequence or a NUL at every offset of a longer
+ * ASCII string, so that it lands both in and after the blocks checked by
+ * the ASCII fast path.
+ */
+static void test_utf8_validate_long(const void *test_data)
+{
+	static const struct {
+		const char *seq;
+		bool valid;
+	} seqs[] = {
+		{ "\xce\xba", true },
+		{ "\xf0\x9f\x98\x80", true },
+		{ "\xce", false },
+		{ "\x80", false },
+		{ "\xef\xbf\xbe", false },
+		{ "\0", false },
+	};
+	char buf[80];
+	const char *end;
+	size_t i, pos;
+
+	memset(buf, 'x', sizeof(buf));
+	assert(l_utf8_validate(buf, sizeof(buf), &end));
+	assert(end == buf + sizeof(buf));
+
+	for (i = 0; i < L_ARRAY_SIZE(seqs); i++) {
+		size_t len = strlen(seqs[i].seq) ?: 1;
+
+		for (pos = 0; pos + len <= 64; pos++) {
+			memset(buf, 'x', sizeof(buf));
+			memcpy(buf + pos, seqs[i].seq, len);
+
+			assert(l_utf8_validate(buf, sizeof(buf), &end) ==
+							seqs[i].valid);
+
+			if (seqs[i].valid)
+				assert(end == buf + sizeof(buf));
+			else
+				assert(end == buf + pos);
+		}
+	}
+}
+
 int main(int argc, char *argv[])
 {
 	l_test_init(&argc, &argv);
@@ -1098,6 +1149,7 @@ int main(int argc, char *argv[])
 					&utf8_validate_test79);
 	l_test_add("Validate UTF 80", test_utf8_validate,
 					&utf8_validate_test80);
+	l_test_add("Validate UTF long", test_utf8_validate_long, NULL);
 
 	l_test_add("Strlen UTF 1", test_utf8_strlen,
 					&utf8_strlen_test1);
@@ -1110,11 +1162,15 @@ int main(int argc, char *argv[])
 					&utf8_from_utf16_test3);
 	l_test_add("utf8_from_utf16 4", test_utf8_from_utf16,
 					&utf8_from_utf16_test4);
+	l_test_add("utf8_from_utf16 5", test_utf8_from_utf16,
+					&utf8_from_utf16_test5);
 
 	l_test_add("utf8_to_utf16 1", test_utf8_to_utf16,
 					&utf8_from_utf16_test1);
 	l_test_add("utf8_to_utf16 2", test_utf8_to_utf16,
 					&utf8_from_utf16_test2);
+	l_test_add("utf8_to_utf16 3", test_utf8_to_utf16,
+					&utf8_from_utf16_test5);
 
 	return l_test_run();
 }
@@ -25,6 +25,7 @@
 #endif
 
 #include <assert.h>
+#include <stdio.h>
 
 #include <ell/ell.h>
 
@@ -73,6 +74,95 @@ static void test_from_hexstring(const void *test_data)
 	assert(!bytes);
 }
 
+static void test_hexstring_roundtrip(const void *test_data)
+{
+	unsigned char buf[256];
+	unsigned char *bytes;
+	char *hex;
+	size_t len, i;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = i;
+
+	for (len = 1; len <= sizeof(buf); len++) {
+		hex = l_util_hexstring(buf + sizeof(buf) - len, len);
+
+		for (i = 0; i < len; i++) {
+			char expected[3];
+
+			snprintf(expected, sizeof(expected), "%02x",
+						buf[sizeof(buf) - len + i]);
+			assert(!memcmp(hex + i * 2, expected, 2));
+		}
+
+		bytes = l_util_from_hexstring(hex, &i);
+		assert(bytes);
+		assert(i == len);
+		assert(!memcmp(bytes, buf + sizeof(buf) - len, len));
+		l_free(bytes);
+
+		/* Any invalid digit must be caught, also in the middle */
+		hex[len] = 'g';
+		assert(!l_util_from_hexstring(hex, NULL));
+		hex[len] = '\x80';
+		assert(!l_util_from_hexstring(hex, NULL));
+		l_free(hex);
+
+		hex = l_util_hexstring_upper(buf, len);
+		bytes = l_util_from_hexstring(hex, NULL);
+		assert(bytes);
+		assert(!memcmp(bytes, buf, len));
+		l_free(bytes);
+		l_free(hex);
+	}
+}
+
+static void hexdump_cb(const char *str, void *user_data)
+{
+	struct l_string *out = user_data;
+
+	l_string_append(out, str);
+	l_string_append_c(out, '\n');
+}
+
+static void test_hexdump(const void *test_data)
+{
+	static const char expected[] =
+		"< 00 01 02 03 04 05 06 07 08 09 0a 0b 0c 0d 0e 0f  "
+		"................\n"
+		"  41 42 43                                         "
+		"ABC             \n";
+	unsigned char buf[19];
+	struct iovec iov[3];
+	struct l_string *out;
+	char *str;
+	size_t i;
+
+	for (i = 0; i < 16; i++)
+		buf[i] = i;
+
+	memcpy(buf + 16, "ABC", 3);
+
+	out = l_string_new(0);
+	l_util_hexdump(true, buf, sizeof(buf), hexdump_cb, out);
+	str = l_string_unwrap(out);
+	assert(!strcmp(str, expected));
+	l_free(str);
+
+	iov[0].iov_base = buf;
+	iov[0].iov_len = 5;
+	iov[1].iov_base = buf + 5;
+	iov[1].iov_len = 0;
+	iov[2].iov_base = buf + 5;
+	iov[2].iov_len = sizeof(buf) - 5;
+
+	out = l_string_new(0);
+	l_util_hexdumpv(true, iov, L_ARRAY_SIZE(iov), hexdump_cb, out);
+	str = l_string_unwrap(out);
+	assert(!strcmp(str, expected));
+	l_free(str);
+}
+
 static void test_has_suffix(const void *test_data)
 {
 	const char *str = "string";
@@ -124,6 +214,54 @@ static void test_strlcpy(const void *test_data)
 	do_strlcpy(10, 12);
 }
 
+static void count_lines(const char *str, void *user_data)
+{
+	unsigned int *lines = user_data;
+
+	(*lines)++;
+}
+
+static void test_malloc_stats(const void *test_data)
+{
+	struct l_malloc_stats before;
+	struct l_malloc_stats after;
+	unsigned int lines = 0;
+	char *buf, *str, *copy;
+
+	assert(!l_malloc_get_stats(NULL));
+
+	if (!l_malloc_get_stats(&before)) {
+		assert(before.live_bytes == 0 && before.peak_bytes == 0);
+		assert(before.total_allocations == 0);
+
+		l_malloc_dump_stats(count_lines, &lines);
+		assert(lines == 0);
+		return;
+	}
+
+	buf = l_malloc(1000);
+	str = l_strdup("hello");
+	buf = l_realloc(buf, 2000);
+	copy = l_memdup(str, 6);
+
+	assert(l_malloc_get_stats(&after));
+	assert(after.live_bytes == before.live_bytes + 2000 + 6 + 6);
+	assert(after.live_allocations == before.live_allocations + 3);
+	assert(after.total_allocations >= before.total_allocations + 3);
+	assert(after.peak_bytes >= after.live_bytes);
+
+	l_malloc_dump_stats(count_lines, &lines);
+	assert(lines >= 2);
+
+	l_free(copy);
+	l_free(str);
+	l_free(buf);
+
+	assert(l_malloc_get_stats(&after));
+	assert(after.live_bytes == before.live_bytes);
+	assert(after.live_allocations == before.live_allocations);
+}
+
 int main(int argc, char *argv[])
 {
 	l_test_init(&argc, &argv);
@@ -131,10 +269,15 @@ int main(int argc, char *argv[])
 	l_test_add("l_util_hexstring", test_hexstring, NULL);
 	l_test_add("l_util_hexstring_upper", test_hexstring_upper, NULL);
 	l_test_add("l_util_from_hexstring", test_from_hexstring, NULL);
+	l_test_add("l_util_hexstring round trip", test_hexstring_roundtrip,
+									NULL);
+	l_test_add("l_util_hexdump", test_hexdump, NULL);
 
 	l_test_add("l_util_has_suffix", test_has_suffix, NULL);
 
 	l_test_add("l_strlcpy", test_strlcpy, NULL);
 
+	l_test_add("l_malloc_get_stats", test_malloc_stats, NULL);
+
 	return l_test_run();
 }